@@ -0,0 +1,185 @@
+#include "AssetLoader.h"
+#include "MemoryTracker.h"
+#include "AssetPack.h"
+#include "FrameArena.h"
+
+//for singleton
+AssetLoader* AssetLoader::instance = nullptr;
+
+namespace
+{
+	//set on the worker threads, for jobs that would otherwise queue more jobs and wait on them
+	thread_local bool isWorker = false;
+}
+
+AssetLoader::AssetLoader()
+{
+	stopping = false;
+
+	//workers look assets up in the pack, make sure it exists before any of them could
+	AssetPack::GetInstance();
+
+	//leave one core for the GL thread
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	threadCount = threadCount > 1 ? threadCount - 1 : 1;
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		workers.push_back(std::thread(&AssetLoader::WorkerLoop, this));
+	}
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+AssetLoader* AssetLoader::GetInstance()
+{
+	if (instance == nullptr)
+	{
+		instance = new AssetLoader();
+	}
+	return instance;
+}
+
+void AssetLoader::Release()
+{
+	delete instance;
+	instance = nullptr;
+}
+
+void AssetLoader::WorkerLoop()
+{
+	//everything a worker allocates is for loading something
+	MemoryTracker::SetThreadTag(MemoryTag::Assets);
+	isWorker = true;
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (jobs.empty())
+			{
+				//only get here when stopping and everything queued is done
+				FrameArena::ReleaseThread();
+				return;
+			}
+			job = jobs.front();
+			jobs.pop_front();
+		}
+		job();
+	}
+}
+
+bool AssetLoader::IsWorkerThread()
+{
+	return isWorker;
+}
+
+void AssetLoader::Enqueue(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobs.push_back(job);
+	}
+	jobAvailable.notify_one();
+}
+
+std::string AssetLoader::ReadFile(const std::string& path)
+{
+	std::string bytes;
+	AssetView view = AssetPack::GetInstance()->Load(path, bytes);
+
+	//packed, copy it out of the mapping
+	if (view.IsValid() && view.data != bytes.data())
+	{
+		bytes.assign(view.data, view.size);
+	}
+	return bytes;
+}
+
+unsigned long long AssetLoader::HashBytes(const char* bytes, size_t size, unsigned long long hash)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char)bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::future<std::string> AssetLoader::ReadFileAsync(const std::string& path)
+{
+	return Run<std::string>([path]() { return ReadFile(path); });
+}
+
+void AssetLoader::RunOnMainThread(std::function<bool()> task)
+{
+	std::lock_guard<std::mutex> lock(mainThreadMutex);
+	mainThreadTasks.push_back(task);
+}
+
+void AssetLoader::Update(double budgetMs)
+{
+	deadline = std::chrono::high_resolution_clock::now()
+		+ std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double, std::milli>(budgetMs));
+
+	//only look at each task once per frame, the ones that aren't done go to the back
+	size_t pending;
+	{
+		std::lock_guard<std::mutex> lock(mainThreadMutex);
+		pending = mainThreadTasks.size();
+	}
+
+	for (size_t i = 0; i < pending; i++)
+	{
+		std::function<bool()> task;
+		{
+			std::lock_guard<std::mutex> lock(mainThreadMutex);
+			task = mainThreadTasks.front();
+			mainThreadTasks.pop_front();
+		}
+
+		//tasks may queue more tasks, so don't hold the lock while running one
+		bool finished = task();
+		if (!finished)
+		{
+			std::lock_guard<std::mutex> lock(mainThreadMutex);
+			mainThreadTasks.push_back(task);
+		}
+
+		if (!HasTimeLeft())
+		{
+			break;
+		}
+	}
+}
+
+bool AssetLoader::HasTimeLeft() const
+{
+	return std::chrono::high_resolution_clock::now() < deadline;
+}
+
+void AssetLoader::Flush()
+{
+	while (IsBusy())
+	{
+		Update(1000.0);
+		std::this_thread::yield();
+	}
+}
+
+bool AssetLoader::IsBusy()
+{
+	std::lock_guard<std::mutex> lock(mainThreadMutex);
+	return !mainThreadTasks.empty();
+}
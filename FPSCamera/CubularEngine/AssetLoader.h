@@ -0,0 +1,142 @@
+#pragma once
+#include "stdafx.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+/// <summary>
+/// Singleton that moves asset work off the GL thread. File reads and image decodes run
+/// on a small pool of worker threads and hand back futures. Anything that has to touch
+/// GL (uploads) is queued as a main thread task and run by Update() within a time budget
+/// each frame, so loading never stalls a frame for long.
+/// </summary>
+class AssetLoader
+{
+private:
+	/// <summary>
+	/// Singleton implementation (private constructor & destructor)
+	/// </summary>
+	AssetLoader();
+	~AssetLoader();
+
+	static AssetLoader* instance;
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex jobMutex;
+	std::condition_variable jobAvailable;
+	bool stopping;
+
+	//GL thread tasks, each returns true once it's finished
+	std::deque<std::function<bool()>> mainThreadTasks;
+	std::mutex mainThreadMutex;
+
+	//when the current Update() has to stop
+	std::chrono::high_resolution_clock::time_point deadline;
+
+	void WorkerLoop();
+
+public:
+	/// <summary>
+	/// Singleton reference to the instance
+	/// </summary>
+	static AssetLoader* GetInstance();
+
+	/// <summary>
+	/// De-allocation, waits for the workers to finish what they're doing
+	/// </summary>
+	static void Release();
+
+	/// <summary>
+	/// Whether the calling thread is one of the workers. A job mustn't wait on jobs it queued
+	/// itself, with every worker doing the same there'd be none left to run them.
+	/// </summary>
+	static bool IsWorkerThread();
+
+	/// <summary>
+	/// Runs a job on a worker thread
+	/// </summary>
+	void Enqueue(std::function<void()> job);
+
+	/// <summary>
+	/// Runs a function on a worker thread and gives back a future for its result
+	/// </summary>
+	template<typename T>
+	std::future<T> Run(std::function<T()> work)
+	{
+		std::shared_ptr<std::packaged_task<T()>> task = std::make_shared<std::packaged_task<T()>>(work);
+		std::future<T> result = task->get_future();
+		Enqueue([task]() { (*task)(); });
+		return result;
+	}
+
+	/// <summary>
+	/// Reads a whole file on a worker thread. The string is empty if the file can't be read.
+	/// </summary>
+	std::future<std::string> ReadFileAsync(const std::string& path);
+
+	/// <summary>
+	/// Queues a task for the GL thread. It gets called every Update() until it returns
+	/// true, so it can wait on futures or split big uploads over several frames.
+	/// </summary>
+	void RunOnMainThread(std::function<bool()> task);
+
+	/// <summary>
+	/// Runs queued GL thread tasks until the time budget is used up. Call once per frame.
+	/// </summary>
+	/// <param name="budgetMs">How many milliseconds this frame can spend on loading</param>
+	void Update(double budgetMs);
+
+	/// <summary>
+	/// Whether the Update() that is running still has budget left. Tasks with lots of
+	/// small steps can use this to do more than one step per frame.
+	/// </summary>
+	bool HasTimeLeft() const;
+
+	/// <summary>
+	/// Runs GL thread tasks until none are left (for loading screens / shutdown)
+	/// </summary>
+	void Flush();
+
+	/// <summary>
+	/// Whether there are GL thread tasks waiting
+	/// </summary>
+	bool IsBusy();
+
+	/// <summary>
+	/// Reads a whole file on the calling thread (what the workers use), out of the
+	/// AssetPack if it's packed
+	/// </summary>
+	static std::string ReadFile(const std::string& path);
+
+	/// <summary>
+	/// 64 bit FNV-1a, good enough to tell files apart for caching
+	/// </summary>
+	static unsigned long long HashBytes(const char* bytes, size_t size, unsigned long long hash = 14695981039346656037ull);
+
+	static unsigned long long HashBytes(const std::string& bytes, unsigned long long hash = 14695981039346656037ull)
+	{
+		return HashBytes(bytes.data(), bytes.size(), hash);
+	}
+
+	/// <summary>
+	/// True once a future has its value, without blocking
+	/// </summary>
+	template<typename T>
+	static bool IsReady(const std::future<T>& future)
+	{
+		return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	template<typename T>
+	static bool IsReady(const std::shared_future<T>& future)
+	{
+		return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+};
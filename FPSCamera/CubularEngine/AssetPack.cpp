@@ -0,0 +1,275 @@
+#include "AssetPack.h"
+#include "AssetLoader.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+//for singleton
+AssetPack* AssetPack::instance = nullptr;
+
+static const unsigned int PackMagic = 0x4b415043; //"CPAK"
+static const unsigned int PackVersion = 1;
+
+//sits at the very start of the pack
+struct PackHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long entryCount;
+	unsigned long long tocOffset;
+};
+
+//one table of contents record, followed by pathLength bytes of path
+struct PackRecord
+{
+	unsigned long long offset;
+	unsigned long long size;
+	unsigned int pathLength;
+	unsigned int padding;
+};
+
+AssetPack::AssetPack()
+{
+}
+
+AssetPack::~AssetPack()
+{
+}
+
+AssetPack* AssetPack::GetInstance()
+{
+	if (instance == nullptr)
+	{
+		instance = new AssetPack();
+	}
+	return instance;
+}
+
+void AssetPack::Release()
+{
+	delete instance;
+	instance = nullptr;
+}
+
+std::string AssetPack::NormalizePath(const std::string& path)
+{
+	std::string normalized = path;
+	for (size_t i = 0; i < normalized.size(); i++)
+	{
+		if (normalized[i] == '\\')
+		{
+			normalized[i] = '/';
+		}
+	}
+	while (normalized.compare(0, 2, "./") == 0)
+	{
+		normalized.erase(0, 2);
+	}
+	return normalized;
+}
+
+bool AssetPack::Cook(const std::string& directory, const std::string& packPath)
+{
+	std::vector<std::string> paths;
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator it(directory, error), end; it != end; it.increment(error))
+	{
+		if (it->is_regular_file())
+		{
+			paths.push_back(it->path().generic_string());
+		}
+	}
+
+	std::ofstream pack(packPath, std::ios::binary);
+	if (!pack.good())
+	{
+		std::cout << "Can't write asset pack: " << packPath << std::endl;
+		return false;
+	}
+
+	PackHeader header;
+	header.magic = PackMagic;
+	header.version = PackVersion;
+	header.entryCount = paths.size();
+	header.tocOffset = 0;
+	pack.write((const char*)&header, sizeof(header));
+
+	static const char zeros[Alignment] = {};
+	std::vector<PackRecord> records;
+	unsigned long long offset = sizeof(header);
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		std::string bytes = AssetLoader::ReadFile(paths[i]);
+
+		//pad up to the next aligned spot
+		size_t padding = (size_t)((Alignment - offset % Alignment) % Alignment);
+		pack.write(zeros, padding);
+		offset += padding;
+
+		PackRecord record;
+		record.offset = offset;
+		record.size = bytes.size();
+		record.pathLength = (unsigned int)NormalizePath(paths[i]).size();
+		record.padding = 0;
+		records.push_back(record);
+
+		pack.write(bytes.data(), bytes.size());
+		offset += bytes.size();
+	}
+
+	//the table goes last, so every asset could be streamed out without knowing the sizes up front
+	header.tocOffset = offset;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		std::string path = NormalizePath(paths[i]);
+		pack.write((const char*)&records[i], sizeof(PackRecord));
+		pack.write(path.data(), path.size());
+	}
+	pack.seekp(0);
+	pack.write((const char*)&header, sizeof(header));
+
+	std::cout << "Cooked " << paths.size() << " assets into " << packPath << std::endl;
+	return pack.good();
+}
+
+bool AssetPack::Mount(const std::string& packPath)
+{
+	entries.clear();
+	if (!file.Open(packPath))
+	{
+		return false;
+	}
+
+	const unsigned char* data = file.GetData();
+	size_t size = file.GetSize();
+
+	PackHeader header;
+	if (size < sizeof(header))
+	{
+		file.Close();
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != PackMagic || header.version != PackVersion || header.tocOffset > size)
+	{
+#ifdef _DEBUG
+		std::cout << "Asset pack " << packPath << " is from another version, using loose files" << std::endl;
+#endif
+		file.Close();
+		return false;
+	}
+
+	size_t position = (size_t)header.tocOffset;
+	for (unsigned long long i = 0; i < header.entryCount; i++)
+	{
+		//a table that runs off the end means the pack was cut short (a cook that didn't finish),
+		//whatever it does list can't be trusted either
+		PackRecord record;
+		bool truncated = position + sizeof(record) > size;
+		if (!truncated)
+		{
+			memcpy(&record, data + position, sizeof(record));
+			position += sizeof(record);
+			truncated = position + record.pathLength > size || record.offset + record.size > size;
+		}
+		if (truncated)
+		{
+#ifdef _DEBUG
+			std::cout << "Asset pack " << packPath << " is truncated, using loose files" << std::endl;
+#endif
+			entries.clear();
+			file.Close();
+			return false;
+		}
+
+		Entry entry;
+		entry.offset = record.offset;
+		entry.size = record.size;
+		entries[std::string((const char*)data + position, record.pathLength)] = entry;
+		position += record.pathLength;
+	}
+
+	std::error_code error;
+	packTime = std::filesystem::last_write_time(packPath, error);
+	return true;
+}
+
+bool AssetPack::IsLooseNewer(const std::string& path) const
+{
+	std::error_code error;
+	std::filesystem::file_time_type looseTime = std::filesystem::last_write_time(path, error);
+	return !error && looseTime > packTime;
+}
+
+AssetView AssetPack::Find(const std::string& path) const
+{
+	AssetView view;
+	if (!file.IsOpen())
+	{
+		return view;
+	}
+	auto it = entries.find(NormalizePath(path));
+	if (it != entries.end() && !IsLooseNewer(path))
+	{
+		view.data = (const char*)file.GetData() + it->second.offset;
+		view.size = (size_t)it->second.size;
+	}
+	return view;
+}
+
+AssetView AssetPack::Load(const std::string& path, std::string& fallbackStorage) const
+{
+	AssetView view = Find(path);
+	if (view.IsValid())
+	{
+		return view;
+	}
+
+	std::ifstream loose(path, std::ios::binary);
+	if (!loose.good())
+	{
+		return view;
+	}
+	loose.seekg(0, std::ios::end);
+	fallbackStorage.resize((size_t)loose.tellg());
+	loose.seekg(0, std::ios::beg);
+	loose.read(&fallbackStorage[0], fallbackStorage.size());
+
+	view.data = fallbackStorage.data();
+	view.size = fallbackStorage.size();
+	return view;
+}
+
+bool AssetPack::Exists(const std::string& path) const
+{
+	if (Find(path).IsValid())
+	{
+		return true;
+	}
+	std::error_code error;
+	return std::filesystem::exists(path, error);
+}
+
+bool AssetPack::IsBuildFresh(const std::string& sourcePath, const std::string& builtPath) const
+{
+	std::error_code error;
+	//cooked along with its source, stale only if the source was edited after the cook, then a
+	//loose build newer than the edit still does
+	if (Find(builtPath).IsValid() && !IsLooseNewer(sourcePath))
+	{
+		return true;
+	}
+
+	if (!std::filesystem::exists(builtPath, error))
+	{
+		return false;
+	}
+
+	//a missing source is fine, the build might be all that shipped
+	if (!std::filesystem::exists(sourcePath, error))
+	{
+		return true;
+	}
+	return std::filesystem::last_write_time(builtPath, error) >= std::filesystem::last_write_time(sourcePath, error);
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include "stdafx.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+
+/// <summary>
+/// A read-only window onto an asset's bytes. Points straight into the mapped pack
+/// (or into the caller's fallback buffer for loose files), nothing is copied.
+/// </summary>
+struct AssetView
+{
+	const char* data;
+	size_t size;
+
+	AssetView()
+	{
+		data = nullptr;
+		size = 0;
+	}
+
+	bool IsValid() const { return data != nullptr; }
+};
+
+/// <summary>
+/// Singleton over one cooked archive of the assets folder. The cooker writes every file
+/// into a single pack, each one aligned so it can be used in place, with a table of
+/// contents at the end. At runtime the pack is memory-mapped once and assets are
+/// handed out as views into it. Anything not in the pack falls back to the loose file, and
+/// so does anything whose loose file was changed after the pack was cooked.
+/// </summary>
+class AssetPack
+{
+private:
+	/// <summary>
+	/// Singleton implementation (private constructor & destructor)
+	/// </summary>
+	AssetPack();
+	~AssetPack();
+
+	static AssetPack* instance;
+
+	struct Entry
+	{
+		unsigned long long offset;
+		unsigned long long size;
+	};
+
+	MappedFile file;
+	std::unordered_map<std::string, Entry> entries;
+
+	//when the pack was cooked, loose files edited since win over their packed copies
+	std::filesystem::file_time_type packTime;
+
+	/// <summary>
+	/// Whether there's a loose copy of an asset that was written after the pack
+	/// </summary>
+	bool IsLooseNewer(const std::string& path) const;
+
+	/// <summary>
+	/// Forward slashes, no leading "./", so lookups match however the path was written
+	/// </summary>
+	static std::string NormalizePath(const std::string& path);
+
+public:
+	/// <summary>
+	/// Every asset starts on a multiple of this, so views can be used directly as aligned data
+	/// </summary>
+	static const size_t Alignment = 64;
+
+	/// <summary>
+	/// Singleton reference to the instance
+	/// </summary>
+	static AssetPack* GetInstance();
+
+	/// <summary>
+	/// De-allocation, unmaps the pack (views into it become invalid)
+	/// </summary>
+	static void Release();
+
+	/// <summary>
+	/// Bundles every file under a directory into one pack. Paths inside the pack keep
+	/// the directory name in front, so "assets/shaders/x.glsl" is looked up as written.
+	/// </summary>
+	/// <returns>Whether the pack was written</returns>
+	static bool Cook(const std::string& directory, const std::string& packPath);
+
+	/// <summary>
+	/// Maps a cooked pack. Call before any worker threads start reading assets, the
+	/// table isn't touched afterwards so lookups are safe from any thread.
+	/// </summary>
+	/// <returns>False (nothing mounted) if the pack can't be mapped, is from another version or is cut short</returns>
+	bool Mount(const std::string& packPath);
+
+	bool IsMounted() const { return file.IsOpen(); }
+
+	/// <summary>
+	/// A view of a packed asset, invalid if it isn't in the pack or its loose file is newer
+	/// </summary>
+	AssetView Find(const std::string& path) const;
+
+	/// <summary>
+	/// A view of an asset from the pack, or from the loose file read into fallbackStorage
+	/// </summary>
+	/// <returns>An invalid view if the asset is nowhere to be found</returns>
+	AssetView Load(const std::string& path, std::string& fallbackStorage) const;
+
+	/// <summary>
+	/// Whether an asset exists, in the pack or as a loose file
+	/// </summary>
+	bool Exists(const std::string& path) const;
+
+	/// <summary>
+	/// Whether a file built from a source asset (a cache, a binary form) can be used: if it was
+	/// cooked into the pack, unless the source was changed since; if it's loose only when it's
+	/// at least as new as the source
+	/// </summary>
+	bool IsBuildFresh(const std::string& sourcePath, const std::string& builtPath) const;
+};
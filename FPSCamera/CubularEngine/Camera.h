@@ -66,6 +66,12 @@ public:
 
 	void SetRight();
 
+	/// <summary>
+	/// How many pixels one world unit covers at a distance of one unit,
+	/// divide by the distance to get the on-screen size of something
+	/// </summary>
+	float GetPixelsPerUnit() const { return height / (2.0f * tanf(fov * 0.5f)); }
+
 	glm::vec3 forward;
 	glm::mat4 viewMatrix;       //cached view matrix
 	glm::mat4 projectionMatrix; //cached projection matrix
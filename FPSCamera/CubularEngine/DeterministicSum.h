@@ -0,0 +1,48 @@
+#pragma once
+#include "stdafx.h"
+#include <cstddef>
+
+/// <summary>
+/// Compensated (Kahan) running sum: it keeps the low bits every addition rounds away and feeds
+/// them back into the next one, so a long run of small terms doesn't drift. For double and the
+/// glm double vectors.
+/// </summary>
+template<typename T>
+struct KahanSum
+{
+	T sum;
+	T compensation;
+
+	KahanSum() : sum(0), compensation(0) {}
+
+	void Add(T value)
+	{
+		T corrected = value - compensation;
+		T total = sum + corrected;
+		compensation = (total - sum) - corrected;
+		sum = total;
+	}
+};
+
+/// <summary>
+/// Adds up partials[0, count) as a balanced tree whose shape only depends on count:
+/// ((0 + 1) + (2 + 3)) + ... As long as each partial covers a fixed block of the data (an
+/// EntityWorld chunk, say) and not whatever range a thread happened to get, the total comes
+/// out bitwise the same however many threads worked the partials out. Overwrites partials.
+/// </summary>
+template<typename T>
+T PairwiseSum(T* partials, size_t count)
+{
+	if (count == 0)
+	{
+		return T(0);
+	}
+	for (size_t stride = 1; stride < count; stride *= 2)
+	{
+		for (size_t i = 0; i + stride < count; i += stride * 2)
+		{
+			partials[i] += partials[i + stride];
+		}
+	}
+	return partials[0];
+}
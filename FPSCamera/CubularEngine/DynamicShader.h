@@ -4,6 +4,8 @@
 
 #include <glm/glm.hpp>
 #include "stdafx.h"
+#include "ProgramCache.h"
+#include "AssetLoader.h"
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -17,84 +19,26 @@ public:
 	// ------------------------------------------------------------------------
 	DynamicShader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
 	{
-		// 1. retrieve the vertex/fragment source code from filePath
-		std::string vertexCode;
-		std::string fragmentCode;
+		// 1. retrieve the vertex/fragment source code from filePath (or the asset pack)
+		std::string vertexCode = AssetLoader::ReadFile(vertexPath);
+		std::string fragmentCode = AssetLoader::ReadFile(fragmentPath);
 		std::string geometryCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-		std::ifstream gShaderFile;
-		// ensure ifstream objects can throw exceptions:
-		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try
-		{
-			// open files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			// read file's buffer contents into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			// close file handlers
-			vShaderFile.close();
-			fShaderFile.close();
-			// convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-			// if geometry shader path is present, also load a geometry shader
-			if (geometryPath != nullptr)
-			{
-				gShaderFile.open(geometryPath);
-				std::stringstream gShaderStream;
-				gShaderStream << gShaderFile.rdbuf();
-				gShaderFile.close();
-				geometryCode = gShaderStream.str();
-			}
-		}
-		catch (std::ifstream::failure e)
-		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-		}
-		const char* vShaderCode = vertexCode.c_str();
-		const char * fShaderCode = fragmentCode.c_str();
-		// 2. compile shaders
-		unsigned int vertex, fragment;
-		// vertex shader
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
-		checkCompileErrors(vertex, "VERTEX");
-		// fragment Shader
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
-		checkCompileErrors(fragment, "FRAGMENT");
-		// if geometry shader is given, compile geometry shader
-		unsigned int geometry;
+		// if geometry shader path is present, also load a geometry shader
 		if (geometryPath != nullptr)
+			geometryCode = AssetLoader::ReadFile(geometryPath);
+		if (vertexCode.empty() || fragmentCode.empty() || (geometryPath != nullptr && geometryCode.empty()))
 		{
-			const char * gShaderCode = geometryCode.c_str();
-			geometry = glCreateShader(GL_GEOMETRY_SHADER);
-			glShaderSource(geometry, 1, &gShaderCode, NULL);
-			glCompileShader(geometry);
-			checkCompileErrors(geometry, "GEOMETRY");
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 		}
-		// shader Program
-		ID = glCreateProgram();
-		glAttachShader(ID, vertex);
-		glAttachShader(ID, fragment);
-		if (geometryPath != nullptr)
-			glAttachShader(ID, geometry);
-		glLinkProgram(ID);
-		checkCompileErrors(ID, "PROGRAM");
-		// delete the shaders as they're linked into our program now and no longer necessery
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
-		if (geometryPath != nullptr)
-			glDeleteShader(geometry);
-
+		compile(vertexCode, fragmentCode, geometryPath != nullptr ? &geometryCode : nullptr);
+	}
+	// builds the shader from sources that are already in memory (e.g. read by the AssetLoader)
+	// ------------------------------------------------------------------------
+	static DynamicShader FromSource(const std::string& vertexCode, const std::string& fragmentCode, const std::string* geometryCode = nullptr)
+	{
+		DynamicShader shader;
+		shader.compile(vertexCode, fragmentCode, geometryCode);
+		return shader;
 	}
 	// activate the shader
 	// ------------------------------------------------------------------------
@@ -162,30 +106,20 @@ public:
 	}
 
 private:
-	// utility function for checking shader compilation/linking errors.
+	DynamicShader()
+	{
+		ID = 0;
+	}
+	// compiles and links the program, through the ProgramCache so later runs can skip the compile
 	// ------------------------------------------------------------------------
-	void checkCompileErrors(GLuint shader, std::string type)
+	void compile(const std::string& vertexCode, const std::string& fragmentCode, const std::string* geometryCode)
 	{
-		GLint success;
-		GLchar infoLog[1024];
-		if (type != "PROGRAM")
-		{
-			glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-			if (!success)
-			{
-				glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-				std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-			}
-		}
-		else
-		{
-			glGetProgramiv(shader, GL_LINK_STATUS, &success);
-			if (!success)
-			{
-				glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-				std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
-			}
-		}
+		std::vector<ShaderSource> sources;
+		sources.push_back({ GL_VERTEX_SHADER, vertexCode });
+		sources.push_back({ GL_FRAGMENT_SHADER, fragmentCode });
+		if (geometryCode != nullptr)
+			sources.push_back({ GL_GEOMETRY_SHADER, *geometryCode });
+		ID = ProgramCache::GetInstance()->Build(sources);
 	}
 };
 #endif
@@ -0,0 +1,151 @@
+#include "EntityPool.h"
+#include "MemoryTracker.h"
+#include "TransformSystem.h"
+#include <new>
+#include <algorithm>
+#include <utility>
+
+EntityPool::EntityPool(ComponentMask tags)
+{
+	this->tags = tags;
+}
+
+EntityPool::~EntityPool()
+{
+	Clear();
+	for (size_t b = 0; b < blocks.size(); b++)
+	{
+		::operator delete(blocks[b]);
+	}
+}
+
+void EntityPool::Grow(size_t count)
+{
+	MemoryScope physicsMemory(MemoryTag::Physics);
+	GameEntity* block = static_cast<GameEntity*>(::operator new(sizeof(GameEntity) * count));
+	blocks.push_back(block);
+
+	unsigned int first = (unsigned int)slots.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		slots.push_back(&block[i]);
+	}
+	activeIndex.resize(slots.size(), 0);
+
+	//handed out lowest slot first
+	freeSlots.reserve(freeSlots.size() + count);
+	for (size_t i = count; i > 0; i--)
+	{
+		freeSlots.push_back(first + (unsigned int)(i - 1));
+	}
+	active.reserve(slots.size());
+}
+
+void EntityPool::Reserve(size_t count)
+{
+	if (freeSlots.size() < count)
+	{
+		size_t missing = count - freeSlots.size();
+		Grow(missing > BlockSize ? missing : BlockSize);
+	}
+	TransformSystem::GetInstance()->Reserve(count);
+	EntityWorld::GetInstance()->Reserve(GameEntity::Components | tags, count);
+}
+
+GameEntity* EntityPool::Spawn(Mesh* mesh, Material* material, glm::vec3 position, glm::vec3 eulerAngles, glm::vec3 scale)
+{
+	if (freeSlots.empty())
+	{
+		Grow(BlockSize);
+	}
+	unsigned int slot = freeSlots.back();
+	freeSlots.pop_back();
+
+	GameEntity* entity = new (slots[slot]) GameEntity(mesh, material, position, eulerAngles, scale, tags);
+	entity->poolSlot = slot;
+	activeIndex[slot] = (unsigned int)active.size();
+	active.push_back(entity);
+	return entity;
+}
+
+void EntityPool::SpawnBatch(const SceneEntity* descriptions, size_t count, const std::vector<Mesh*>& meshes,
+	const std::vector<Material*>& materials, std::vector<GameEntity*>* outEntities)
+{
+	Reserve(count);
+	if (outEntities != nullptr)
+	{
+		outEntities->reserve(outEntities->size() + count);
+	}
+
+	for (size_t e = 0; e < count; e++)
+	{
+		const SceneEntity& description = descriptions[e];
+		GameEntity* entity = Spawn(meshes[description.mesh], materials[description.material],
+			description.position, description.rotation, description.scale);
+
+		entity->SetVelocity(description.velocity);
+		entity->SetStartVelocity(description.velocity);
+		entity->SetMass(description.mass);
+		entity->SetOrbital((description.flags & SceneEntityAttractor) == 0);
+		if (outEntities != nullptr)
+		{
+			outEntities->push_back(entity);
+		}
+	}
+}
+
+void EntityPool::Retire(GameEntity* entity)
+{
+	unsigned int slot = entity->poolSlot;
+
+	//fill the hole with the last active entity
+	unsigned int index = activeIndex[slot];
+	GameEntity* last = active.back();
+	active[index] = last;
+	activeIndex[last->poolSlot] = index;
+	active.pop_back();
+
+	entity->~GameEntity();
+	freeSlots.push_back(slot);
+}
+
+void EntityPool::Clear()
+{
+	for (size_t i = active.size(); i > 0; i--)
+	{
+		active[i - 1]->~GameEntity();
+	}
+	active.clear();
+
+	freeSlots.clear();
+	for (size_t slot = slots.size(); slot > 0; slot--)
+	{
+		freeSlots.push_back((unsigned int)(slot - 1));
+	}
+}
+
+void EntityPool::SortActive()
+{
+	EntityWorld* world = EntityWorld::GetInstance();
+	std::vector<std::pair<size_t, GameEntity*>> rows(active.size());
+	for (size_t i = 0; i < active.size(); i++)
+	{
+		rows[i] = std::make_pair(world->GetRow(active[i]->GetHandle()), active[i]);
+	}
+	std::sort(rows.begin(), rows.end());
+
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		active[i] = rows[i].second;
+		activeIndex[active[i]->poolSlot] = (unsigned int)i;
+	}
+}
+
+void EntityPool::SetActiveOrder(const std::vector<GameEntity*>& order)
+{
+	for (size_t i = 0; i < order.size() && i < active.size(); i++)
+	{
+		active[i] = order[i];
+		activeIndex[active[i]->poolSlot] = (unsigned int)i;
+	}
+}
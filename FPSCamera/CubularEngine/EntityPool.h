@@ -0,0 +1,112 @@
+#pragma once
+#include "stdafx.h"
+#include "GameEntity.h"
+#include "SceneFile.h"
+#include <vector>
+
+/// <summary>
+/// Pooled storage for GameEntities. Entities are built in place inside big blocks, so their
+/// addresses never change, and retired slots go on a free list to be handed out again.
+/// The live entities are also kept in one dense list (retiring swaps the last one into the
+/// hole), which is what the per-frame loops walk, so dead bodies cost nothing.
+/// </summary>
+class EntityPool
+{
+private:
+	//how many slots a block gets unless a batch asks for more
+	static const size_t BlockSize = 1024;
+
+	//raw storage, every slot is constructed & destroyed by hand
+	std::vector<GameEntity*> blocks;
+
+	//where each slot lives, by slot index
+	std::vector<GameEntity*> slots;
+
+	//slot -> where it is in the active list
+	std::vector<unsigned int> activeIndex;
+
+	//slots that aren't in use, the next one to hand out is at the back
+	std::vector<unsigned int> freeSlots;
+
+	//every live entity, in no particular order until SortActive()
+	std::vector<GameEntity*> active;
+
+	//components every entity of this pool gets on top of GameEntity::Components
+	ComponentMask tags;
+
+	/// <summary>
+	/// Adds a block with room for count more entities
+	/// </summary>
+	void Grow(size_t count);
+
+public:
+	/// <param name="tags">Extra components (tags) for everything spawned here, e.g. IsSimulated</param>
+	EntityPool(ComponentMask tags = 0);
+	~EntityPool();
+
+	/// <summary>
+	/// The game holds pointers into the pool, so it stays put
+	/// </summary>
+	EntityPool(const EntityPool&) = delete;
+	EntityPool& operator=(const EntityPool&) = delete;
+
+	/// <summary>
+	/// Makes sure count more entities fit without allocating, with one block allocation at most
+	/// (and reserves their transforms and component chunks too)
+	/// </summary>
+	void Reserve(size_t count);
+
+	/// <summary>
+	/// Builds one entity in a free slot
+	/// </summary>
+	GameEntity* Spawn(Mesh* mesh, Material* material, glm::vec3 position, glm::vec3 eulerAngles, glm::vec3 scale);
+
+	/// <summary>
+	/// Builds a whole batch of entities from their initial states, reserving room for all of them first
+	/// </summary>
+	/// <param name="descriptions">Initial state of each entity</param>
+	/// <param name="count">How many entities to make</param>
+	/// <param name="meshes">What SceneEntity::mesh indexes into</param>
+	/// <param name="materials">What SceneEntity::material indexes into</param>
+	/// <param name="outEntities">Receives the new entities, in the same order (can be nullptr)</param>
+	void SpawnBatch(const SceneEntity* descriptions, size_t count, const std::vector<Mesh*>& meshes,
+		const std::vector<Material*>& materials, std::vector<GameEntity*>* outEntities);
+
+	/// <summary>
+	/// Destroys an entity and gives its slot back. Moves the last active entity into its place
+	/// in the active list, so walk the list backwards when retiring while iterating.
+	/// </summary>
+	void Retire(GameEntity* entity);
+
+	/// <summary>
+	/// Retires every entity, the next spawns start from the first slot again
+	/// </summary>
+	void Clear();
+
+	/// <summary>
+	/// Puts the active list in the order the entities' components are stored in, so loops over
+	/// it walk memory front to back. Call it after SpatialSort::Run has reordered them.
+	/// </summary>
+	void SortActive();
+
+	/// <summary>
+	/// Puts the active list in the given order, which has to hold exactly the active entities
+	/// (e.g. to restore the order a saved simulation had)
+	/// </summary>
+	void SetActiveOrder(const std::vector<GameEntity*>& order);
+
+	/// <summary>
+	/// The live entities, dense
+	/// </summary>
+	const std::vector<GameEntity*>& GetActive() const { return active; }
+
+	/// <summary>
+	/// A stable id for an entity while it's alive (the slot index), for per-entity side data
+	/// </summary>
+	unsigned int GetSlot(const GameEntity* entity) const { return entity->poolSlot; }
+
+	/// <summary>
+	/// How many entities fit without growing
+	/// </summary>
+	size_t GetCapacity() const { return slots.size(); }
+};
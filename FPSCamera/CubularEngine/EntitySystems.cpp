@@ -0,0 +1,224 @@
+#include "EntitySystems.h"
+#include "Mesh.h"
+#include "Material.h"
+#include "ImpostorRenderer.h"
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "DeterministicSum.h"
+
+namespace
+{
+	struct Attractor
+	{
+		EntityHandle handle;
+		glm::vec3 position;
+	};
+
+	//chunks per job, a chunk is only ~100 entities
+	const size_t ChunksPerJob = 4;
+
+	//every chunk with the components, in the world's order (which doesn't depend on the threads)
+	void GatherChunks(ComponentMask components, FrameVector<EntityChunkView>& outChunks)
+	{
+		EntityWorld* world = EntityWorld::GetInstance();
+		size_t chunkCount = 0;
+		world->ForEachChunk(components, [&](const EntityChunkView&) { chunkCount++; });
+		outChunks.reserve(chunkCount);
+		world->ForEachChunk(components, [&](const EntityChunkView& chunk) { outChunks.push_back(chunk); });
+	}
+
+	//ForEachChunk, with the chunks spread over the job system's threads. Only for systems that
+	//write nothing but their own rows, the TransformSystem setters aren't thread safe
+	template<typename Function>
+	void ForEachChunkParallel(ComponentMask components, Function function)
+	{
+		ArenaScope scope;
+		FrameVector<EntityChunkView> chunks;
+		GatherChunks(components, chunks);
+
+		JobSystem::GetInstance()->ParallelFor(chunks.size(), ChunksPerJob, [&](size_t begin, size_t end) {
+			for (size_t c = begin; c < end; c++)
+			{
+				function(chunks[c]);
+			}
+		});
+	}
+}
+
+void EntitySystems::Attract(ComponentMask required)
+{
+	EntityWorld* world = EntityWorld::GetInstance();
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	ComponentMask components = required | HasTransform | HasMotion | HasFlags;
+
+	//there are only ever a few attractors, so gather them once instead of testing every pair.
+	//they're gathered in storage order on this thread, so every entity adds its pulls up in the
+	//same order whichever thread it lands on. scratch for this frame only
+	ArenaScope scope;
+	FrameVector<Attractor> attractors;
+	attractors.reserve(64);
+	world->ForEachChunk(components, [&](const EntityChunkView& chunk) {
+		const EntityHandle* handles = chunk.GetHandles();
+		const Transform* transform = chunk.Get<Transform>();
+		const EntityFlags* flags = chunk.Get<EntityFlags>();
+		for (size_t i = 0; i < chunk.GetCount(); i++)
+		{
+			if ((flags[i].bits & (EntityEnabled | EntityOrbital)) == EntityEnabled)
+			{
+				Attractor attractor = { handles[i], transforms->GetPosition(transform[i].id) };
+				attractors.push_back(attractor);
+			}
+		}
+	});
+
+	ForEachChunkParallel(components, [&](const EntityChunkView& chunk) {
+		const EntityHandle* handles = chunk.GetHandles();
+		const Transform* transform = chunk.Get<Transform>();
+		Motion* motion = chunk.Get<Motion>();
+		for (size_t i = 0; i < chunk.GetCount(); i++)
+		{
+			glm::vec3 position = transforms->GetPosition(transform[i].id);
+			float vel = glm::length(motion[i].velocity);
+			if (vel == 0) {
+				vel = .2f;
+			}
+
+			glm::vec3 acc = glm::vec3(0.f, 0.f, 0.f);
+			for (size_t a = 0; a < attractors.size(); a++)
+			{
+				if (attractors[a].handle != handles[i]) {
+					acc += glm::normalize(attractors[a].position - position) * vel;
+				}
+			}
+			motion[i].acceleration = acc;
+		}
+	});
+}
+
+void EntitySystems::Integrate(ComponentMask required, float dt)
+{
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	EntityWorld::GetInstance()->ForEachChunk(required | HasTransform | HasMotion | HasFlags, [&](const EntityChunkView& chunk) {
+		const Transform* transform = chunk.Get<Transform>();
+		Motion* motion = chunk.Get<Motion>();
+		const EntityFlags* flags = chunk.Get<EntityFlags>();
+		for (size_t i = 0; i < chunk.GetCount(); i++)
+		{
+			if ((flags[i].bits & EntityEnabled) == 0)
+			{
+				continue;
+			}
+			if (flags[i].bits & EntityGravity) {
+				motion[i].acceleration = glm::vec3(0.0f, -4.6f, 0.0f);
+			}
+			motion[i].velocity += motion[i].acceleration * dt;
+
+			//the setter only marks the transform dirty if it actually moved
+			transforms->SetPosition(transform[i].id, transforms->GetPosition(transform[i].id) + motion[i].velocity * dt);
+		}
+	});
+}
+
+void EntitySystems::Animate(ComponentMask required)
+{
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	EntityWorld::GetInstance()->ForEachChunk(required | HasTransform | HasAnimation | HasFlags, [&](const EntityChunkView& chunk) {
+		const Transform* transform = chunk.Get<Transform>();
+		Animation* animation = chunk.Get<Animation>();
+		const EntityFlags* flags = chunk.Get<EntityFlags>();
+		for (size_t i = 0; i < chunk.GetCount(); i++)
+		{
+			if ((flags[i].bits & (EntityEnabled | EntityOrbital)) == EntityEnabled)
+			{
+				animation[i].eulerAngles.y += .01f;
+				transforms->SetRotation(transform[i].id, glm::angleAxis(animation[i].eulerAngles.y, glm::vec3(0.f, 1.f, 0.f)));
+			}
+		}
+	});
+}
+
+void EntitySystems::UpdateBounds(ComponentMask required)
+{
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	ForEachChunkParallel(required | HasTransform | HasRenderable | HasCollider, [&](const EntityChunkView& chunk) {
+		const Transform* transform = chunk.Get<Transform>();
+		const Renderable* renderable = chunk.Get<Renderable>();
+		Collider* collider = chunk.Get<Collider>();
+		for (size_t i = 0; i < chunk.GetCount(); i++)
+		{
+			glm::vec3 position = transforms->GetPosition(transform[i].id);
+			collider[i].min = position + glm::min(renderable[i].mesh->boundsMin, glm::vec3(0.0f));
+			collider[i].max = position + glm::max(renderable[i].mesh->boundsMax, glm::vec3(0.0f));
+		}
+	});
+}
+
+SimTotals EntitySystems::Measure(ComponentMask required)
+{
+	ArenaScope scope;
+	FrameVector<EntityChunkView> chunks;
+	GatherChunks(required | HasMotion | HasFlags, chunks);
+
+	//one partial per chunk, whichever thread works it out
+	FrameVector<size_t> counts(chunks.size());
+	FrameVector<double> masses(chunks.size());
+	FrameVector<glm::dvec3> momenta(chunks.size());
+	FrameVector<double> energies(chunks.size());
+	JobSystem::GetInstance()->ParallelFor(chunks.size(), ChunksPerJob, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; c++)
+		{
+			const Motion* motion = chunks[c].Get<Motion>();
+			const EntityFlags* flags = chunks[c].Get<EntityFlags>();
+			size_t count = 0;
+			KahanSum<double> mass;
+			KahanSum<glm::dvec3> momentum;
+			KahanSum<double> energy;
+			for (size_t i = 0; i < chunks[c].GetCount(); i++)
+			{
+				if ((flags[i].bits & EntityEnabled) == 0)
+				{
+					continue;
+				}
+				glm::dvec3 velocity = glm::dvec3(motion[i].velocity);
+				count++;
+				mass.Add(motion[i].mass);
+				momentum.Add(velocity * (double)motion[i].mass);
+				energy.Add(0.5 * motion[i].mass * glm::dot(velocity, velocity));
+			}
+			counts[c] = count;
+			masses[c] = mass.sum;
+			momenta[c] = momentum.sum;
+			energies[c] = energy.sum;
+		}
+	});
+
+	SimTotals totals;
+	totals.count = PairwiseSum(counts.data(), counts.size());
+	totals.mass = PairwiseSum(masses.data(), masses.size());
+	totals.momentum = PairwiseSum(momenta.data(), momenta.size());
+	totals.kineticEnergy = PairwiseSum(energies.data(), energies.size());
+	return totals;
+}
+
+void EntitySystems::Draw(const Renderable& renderable, TransformId transform, Camera* camera, ImpostorRenderer* impostors)
+{
+	//deciding between impostor and mesh only needs position & scale, not the matrix
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	Draw(renderable, transforms->GetWorldMatrix(transform), transforms->GetPosition(transform), transforms->GetMaxScale(transform), camera, impostors);
+}
+
+void EntitySystems::Draw(const Renderable& renderable, const glm::mat4& world, glm::vec3 position, float maxScale, Camera* camera, ImpostorRenderer* impostors)
+{
+	float distance = glm::distance(camera->GetPos(), position);
+	float pixelsPerUnit = camera->GetPixelsPerUnit();
+
+	//too small to see any shape, just draw a dot
+	float radius = renderable.mesh->boundingRadius * maxScale;
+	if (impostors != nullptr && distance > radius && radius * pixelsPerUnit / distance < impostors->pixelThreshold) {
+		impostors->Submit(position, radius, renderable.material->GetColor());
+		return;
+	}
+
+	renderable.material->Bind(camera, world);
+	renderable.mesh->Render(renderable.mesh->SelectLOD(distance, maxScale, pixelsPerUnit));
+}
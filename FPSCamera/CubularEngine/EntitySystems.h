@@ -0,0 +1,67 @@
+#pragma once
+#include "stdafx.h"
+#include "EntityWorld.h"
+#include "Camera.h"
+
+class ImpostorRenderer;
+
+/// <summary>
+/// Conserved quantities of a set of entities, see EntitySystems::Measure
+/// </summary>
+struct SimTotals
+{
+	size_t count;               //enabled entities
+	double mass;
+	glm::dvec3 momentum;
+	double kineticEnergy;
+};
+
+/// <summary>
+/// The per-frame work on entities, each pass walking EntityWorld's chunks and touching only
+/// the columns it needs. Every pass takes the components an entity must have on top of its
+/// own, e.g. IsSimulated to leave the menu boxes alone.
+/// </summary>
+class EntitySystems
+{
+public:
+	/// <summary>
+	/// Sets every enabled entity's acceleration towards the enabled attractors (non orbital entities).
+	/// Reads positions, velocities and flags. The chunks are split over the JobSystem.
+	/// </summary>
+	static void Attract(ComponentMask required);
+
+	/// <summary>
+	/// Moves every enabled entity by its velocity, after applying its acceleration (or gravity).
+	/// Reads & writes positions and velocities only.
+	/// </summary>
+	static void Integrate(ComponentMask required, float dt);
+
+	/// <summary>
+	/// Spins the attractors around their vertical axis
+	/// </summary>
+	static void Animate(ComponentMask required);
+
+	/// <summary>
+	/// Recomputes the world space bounds of every entity from its position and mesh bounds,
+	/// with the chunks split over the JobSystem
+	/// </summary>
+	static void UpdateBounds(ComponentMask required);
+
+	/// <summary>
+	/// Adds up the mass, momentum and kinetic energy of every enabled entity. Each chunk is
+	/// summed in row order and the chunks' sums are combined in a fixed tree, so the result is
+	/// bitwise the same whatever the JobSystem's thread count.
+	/// </summary>
+	static SimTotals Measure(ComponentMask required);
+
+	/// <summary>
+	/// Draws one entity, picking the mesh LOD from its size on screen. If it covers less than a
+	/// few pixels it is handed to the impostor renderer instead (when one is given).
+	/// </summary>
+	static void Draw(const Renderable& renderable, TransformId transform, Camera* camera, ImpostorRenderer* impostors);
+
+	/// <summary>
+	/// Same, for an entity that isn't in the TransformSystem anymore (e.g. a simulation snapshot)
+	/// </summary>
+	static void Draw(const Renderable& renderable, const glm::mat4& world, glm::vec3 position, float maxScale, Camera* camera, ImpostorRenderer* impostors);
+};
@@ -0,0 +1,347 @@
+#include "EntityWorld.h"
+#include "MemoryTracker.h"
+#include <cstring>
+#include <algorithm>
+#include <new>
+
+namespace
+{
+	//bytes per chunk, small enough that a system's columns of one chunk sit in L1/L2 together
+	const size_t ChunkBytes = 16 * 1024;
+
+	//columns start on a cache line
+	const size_t ColumnAlignment = 64;
+
+	//bytes per row of each component, tags take none
+	const size_t componentSizes[ComponentTypeCount] = {
+		sizeof(Transform),
+		sizeof(Motion),
+		sizeof(Renderable),
+		sizeof(Collider),
+		sizeof(EntityFlags),
+		sizeof(Animation),
+		sizeof(SpawnPoint),
+		0
+	};
+
+	size_t AlignUp(size_t value)
+	{
+		return (value + ColumnAlignment - 1) & ~(ColumnAlignment - 1);
+	}
+}
+
+//for singleton
+EntityWorld* EntityWorld::instance = nullptr;
+
+EntityWorld::EntityWorld()
+{
+}
+
+EntityWorld::~EntityWorld()
+{
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		for (size_t c = 0; c < archetypes[a]->chunks.size(); c++)
+		{
+			::operator delete(archetypes[a]->chunks[c].memory, std::align_val_t(ColumnAlignment));
+		}
+		delete archetypes[a];
+	}
+}
+
+EntityWorld* EntityWorld::GetInstance()
+{
+	if (instance == nullptr)
+	{
+		instance = new EntityWorld();
+	}
+	return instance;
+}
+
+void EntityWorld::Release()
+{
+	delete instance;
+	instance = nullptr;
+}
+
+EntityWorld::Archetype* EntityWorld::GetArchetype(ComponentMask mask, unsigned int& outIndex)
+{
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		if (archetypes[a]->mask == mask)
+		{
+			outIndex = (unsigned int)a;
+			return archetypes[a];
+		}
+	}
+
+	Archetype* archetype = new Archetype();
+	archetype->mask = mask;
+	archetype->entityCount = 0;
+
+	//the handle column, then one column per component
+	size_t rowBytes = sizeof(EntityHandle);
+	for (int type = 0; type < ComponentTypeCount; type++)
+	{
+		if (mask & (1 << type))
+		{
+			rowBytes += componentSizes[type];
+		}
+	}
+	//leave room for aligning every column
+	size_t capacity = (ChunkBytes - ColumnAlignment * ComponentTypeCount) / rowBytes;
+	archetype->capacity = capacity > 0 ? capacity : 1;
+
+	size_t offset = AlignUp(sizeof(EntityHandle) * archetype->capacity);
+	for (int type = 0; type < ComponentTypeCount; type++)
+	{
+		archetype->offsets[type] = offset;
+		if (mask & (1 << type))
+		{
+			offset = AlignUp(offset + componentSizes[type] * archetype->capacity);
+		}
+	}
+
+	outIndex = (unsigned int)archetypes.size();
+	archetypes.push_back(archetype);
+	return archetype;
+}
+
+void EntityWorld::AddChunk(Archetype* archetype)
+{
+	MemoryScope physicsMemory(MemoryTag::Physics);
+	Chunk chunk;
+	//the column offsets are aligned relative to the start, so the start has to be too
+	chunk.memory = static_cast<unsigned char*>(::operator new(ChunkBytes, std::align_val_t(ColumnAlignment)));
+	chunk.count = 0;
+	archetype->chunks.push_back(chunk);
+}
+
+EntityHandle EntityWorld::Create(ComponentMask components)
+{
+	unsigned int archetypeIndex;
+	Archetype* archetype = GetArchetype(components, archetypeIndex);
+
+	size_t dense = archetype->entityCount;
+	size_t chunkIndex = dense / archetype->capacity;
+	if (chunkIndex == archetype->chunks.size())
+	{
+		AddChunk(archetype);
+	}
+	Chunk& chunk = archetype->chunks[chunkIndex];
+	size_t row = chunk.count;
+
+	EntityHandle handle;
+	if (!freeRecords.empty())
+	{
+		handle.index = freeRecords.back();
+		freeRecords.pop_back();
+	}
+	else
+	{
+		handle.index = (unsigned int)records.size();
+		records.push_back(Record());
+		records.back().generation = 0;
+	}
+	Record& record = records[handle.index];
+	record.archetype = archetypeIndex;
+	record.chunk = (unsigned int)chunkIndex;
+	record.row = (unsigned int)row;
+	record.alive = true;
+	handle.generation = record.generation;
+
+	reinterpret_cast<EntityHandle*>(chunk.memory)[row] = handle;
+	for (int type = 0; type < ComponentTypeCount; type++)
+	{
+		if (components & (1 << type))
+		{
+			memset(chunk.memory + archetype->offsets[type] + componentSizes[type] * row, 0, componentSizes[type]);
+		}
+	}
+
+	chunk.count++;
+	archetype->entityCount++;
+	return handle;
+}
+
+void EntityWorld::Reserve(ComponentMask components, size_t count)
+{
+	unsigned int archetypeIndex;
+	Archetype* archetype = GetArchetype(components, archetypeIndex);
+
+	size_t needed = (archetype->entityCount + count + archetype->capacity - 1) / archetype->capacity;
+	archetype->chunks.reserve(needed);
+	while (archetype->chunks.size() < needed)
+	{
+		AddChunk(archetype);
+	}
+
+	size_t spare = freeRecords.size();
+	if (count > spare)
+	{
+		records.reserve(records.size() + count - spare);
+	}
+}
+
+void EntityWorld::Destroy(EntityHandle handle)
+{
+	const Record* found = Find(handle);
+	if (found == nullptr)
+	{
+		return;
+	}
+	Record& record = records[handle.index];
+	Archetype* archetype = archetypes[record.archetype];
+
+	//the archetype's last row fills the hole, so the chunks stay packed
+	size_t last = archetype->entityCount - 1;
+	Chunk& lastChunk = archetype->chunks[last / archetype->capacity];
+	size_t lastRow = last % archetype->capacity;
+	Chunk& chunk = archetype->chunks[record.chunk];
+
+	if (&lastChunk != &chunk || lastRow != record.row)
+	{
+		EntityHandle moved = reinterpret_cast<EntityHandle*>(lastChunk.memory)[lastRow];
+		reinterpret_cast<EntityHandle*>(chunk.memory)[record.row] = moved;
+		for (int type = 0; type < ComponentTypeCount; type++)
+		{
+			if (archetype->mask & (1 << type))
+			{
+				size_t size = componentSizes[type];
+				size_t column = archetype->offsets[type];
+				memcpy(chunk.memory + column + size * record.row, lastChunk.memory + column + size * lastRow, size);
+			}
+		}
+		records[moved.index].chunk = record.chunk;
+		records[moved.index].row = record.row;
+	}
+
+	lastChunk.count--;
+	archetype->entityCount--;
+
+	record.alive = false;
+	record.generation++;
+	freeRecords.push_back(handle.index);
+}
+
+const EntityWorld::Record* EntityWorld::Find(EntityHandle handle) const
+{
+	if (handle.index >= records.size())
+	{
+		return nullptr;
+	}
+	const Record& record = records[handle.index];
+	if (!record.alive || record.generation != handle.generation)
+	{
+		return nullptr;
+	}
+	return &record;
+}
+
+unsigned char* EntityWorld::GetComponent(EntityHandle handle, ComponentType type) const
+{
+	const Record* record = Find(handle);
+	if (record == nullptr)
+	{
+		return nullptr;
+	}
+	const Archetype* archetype = archetypes[record->archetype];
+	if ((archetype->mask & (1 << type)) == 0)
+	{
+		return nullptr;
+	}
+	return archetype->chunks[record->chunk].memory + archetype->offsets[type] + componentSizes[type] * record->row;
+}
+
+size_t EntityWorld::Count(ComponentMask required) const
+{
+	size_t count = 0;
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		if ((archetypes[a]->mask & required) == required)
+		{
+			count += archetypes[a]->entityCount;
+		}
+	}
+	return count;
+}
+
+void EntityWorld::GetArchetypes(ComponentMask required, std::vector<ComponentMask>& outMasks) const
+{
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		if ((archetypes[a]->mask & required) == required && archetypes[a]->entityCount > 0)
+		{
+			outMasks.push_back(archetypes[a]->mask);
+		}
+	}
+}
+
+size_t EntityWorld::GetRow(EntityHandle handle) const
+{
+	const Record* record = Find(handle);
+	if (record == nullptr)
+	{
+		return (size_t)-1;
+	}
+	return record->chunk * archetypes[record->archetype]->capacity + record->row;
+}
+
+void EntityWorld::Reorder(ComponentMask components, const unsigned int* order)
+{
+	Archetype* archetype = nullptr;
+	for (size_t a = 0; a < archetypes.size() && archetype == nullptr; a++)
+	{
+		if (archetypes[a]->mask == components)
+		{
+			archetype = archetypes[a];
+		}
+	}
+	if (archetype == nullptr)
+	{
+		return;
+	}
+	size_t count = archetype->entityCount;
+	size_t capacity = archetype->capacity;
+
+	//one column at a time: copy it out dense, then gather it back in the new order
+	std::vector<unsigned char> scratch;
+	for (int type = -1; type < ComponentTypeCount; type++)
+	{
+		size_t size;
+		size_t column;
+		if (type < 0)
+		{
+			size = sizeof(EntityHandle);
+			column = 0;
+		}
+		else if ((archetype->mask & (1 << type)) != 0 && componentSizes[type] > 0)
+		{
+			size = componentSizes[type];
+			column = archetype->offsets[type];
+		}
+		else
+		{
+			continue;
+		}
+
+		scratch.resize(size * count);
+		for (size_t c = 0; c * capacity < count; c++)
+		{
+			size_t rows = std::min(capacity, count - c * capacity);
+			memcpy(&scratch[size * c * capacity], archetype->chunks[c].memory + column, size * rows);
+		}
+		for (size_t dense = 0; dense < count; dense++)
+		{
+			memcpy(archetype->chunks[dense / capacity].memory + column + size * (dense % capacity), &scratch[size * order[dense]], size);
+		}
+	}
+
+	//the handle column is in its new order, point the records at the new rows
+	for (size_t dense = 0; dense < count; dense++)
+	{
+		EntityHandle handle = reinterpret_cast<EntityHandle*>(archetype->chunks[dense / capacity].memory)[dense % capacity];
+		records[handle.index].chunk = (unsigned int)(dense / capacity);
+		records[handle.index].row = (unsigned int)(dense % capacity);
+	}
+}
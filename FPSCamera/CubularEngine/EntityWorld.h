@@ -0,0 +1,321 @@
+#pragma once
+#include "stdafx.h"
+#include "TransformSystem.h"
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+class Mesh;
+class Material;
+
+/// <summary>
+/// Refers to an entity without pointing into its storage, which moves. The generation
+/// goes up every time an index is reused, so a handle to a destroyed entity stays dead.
+/// </summary>
+struct EntityHandle
+{
+	unsigned int index;
+	unsigned int generation;
+
+	bool operator==(const EntityHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+};
+
+const EntityHandle NullEntity = { 0xFFFFFFFF, 0 };
+
+struct AABB {
+	glm::vec3 min;
+	glm::vec3 max;
+
+	AABB(const glm::vec3 &minVal, const glm::vec3 &maxVal)
+	{
+		min = minVal;
+		max = maxVal;
+	}
+	AABB()
+	{
+		min = glm::vec3(0.0f);
+		max = glm::vec3(0.0f);
+	}
+};
+
+//components. Each is plain data, stored in its own column of a chunk, so a system only
+//pulls the columns it reads through the cache
+
+//hot: the entity's slot in the TransformSystem (position, rotation, scale, world matrix)
+struct Transform
+{
+	TransformId id;
+};
+
+//hot: what the physics integrates
+struct Motion
+{
+	glm::vec3 velocity;
+	glm::vec3 acceleration;
+	float mass;
+};
+
+//hot: what rendering draws
+struct Renderable
+{
+	Mesh* mesh;
+	Material* material;
+};
+
+//hot: world space bounds for the collision pass
+typedef AABB Collider;
+
+//EntityFlags::bits
+const unsigned int EntityEnabled = 1;       //updated & drawn
+const unsigned int EntityOrbital = 2;       //pulled in by attractors, instead of pulling
+const unsigned int EntityGravity = 4;       //falls, ignoring its acceleration
+
+//hot: read by nearly every system, so it's kept tiny
+struct EntityFlags
+{
+	unsigned int bits;
+};
+
+//cold: rotation state, only the menu animation and spinning attractors touch it
+struct Animation
+{
+	glm::vec3 eulerAngles;
+	glm::quat startQuat;
+	glm::quat rotQuat;
+	float timer;
+};
+
+//cold: where a reset puts the entity back
+struct SpawnPoint
+{
+	glm::vec3 position;
+	glm::vec3 velocity;
+};
+
+//tag, no data: the entity is part of the simulation (the bodies, not the menu boxes)
+struct Simulated
+{
+};
+
+enum ComponentType
+{
+	ComponentTransform,
+	ComponentMotion,
+	ComponentRenderable,
+	ComponentCollider,
+	ComponentFlags,
+	ComponentAnimation,
+	ComponentSpawnPoint,
+	ComponentSimulated,
+	ComponentTypeCount
+};
+
+typedef unsigned int ComponentMask;
+
+const ComponentMask HasTransform = 1 << ComponentTransform;
+const ComponentMask HasMotion = 1 << ComponentMotion;
+const ComponentMask HasRenderable = 1 << ComponentRenderable;
+const ComponentMask HasCollider = 1 << ComponentCollider;
+const ComponentMask HasFlags = 1 << ComponentFlags;
+const ComponentMask HasAnimation = 1 << ComponentAnimation;
+const ComponentMask HasSpawnPoint = 1 << ComponentSpawnPoint;
+const ComponentMask IsSimulated = 1 << ComponentSimulated;
+
+/// <summary>
+/// Which ComponentType a component struct is
+/// </summary>
+template<typename T> struct ComponentTraits;
+template<> struct ComponentTraits<Transform> { static const ComponentType type = ComponentTransform; };
+template<> struct ComponentTraits<Motion> { static const ComponentType type = ComponentMotion; };
+template<> struct ComponentTraits<Renderable> { static const ComponentType type = ComponentRenderable; };
+template<> struct ComponentTraits<Collider> { static const ComponentType type = ComponentCollider; };
+template<> struct ComponentTraits<EntityFlags> { static const ComponentType type = ComponentFlags; };
+template<> struct ComponentTraits<Animation> { static const ComponentType type = ComponentAnimation; };
+template<> struct ComponentTraits<SpawnPoint> { static const ComponentType type = ComponentSpawnPoint; };
+
+/// <summary>
+/// One chunk's worth of entities of the same archetype, as columns
+/// </summary>
+class EntityChunkView
+{
+private:
+	unsigned char* memory;
+	const size_t* offsets;
+	size_t count;
+
+public:
+	EntityChunkView(unsigned char* memory, const size_t* offsets, size_t count)
+		: memory(memory), offsets(offsets), count(count)
+	{
+	}
+
+	size_t GetCount() const { return count; }
+
+	/// <summary>
+	/// The column of one component, GetCount() entries long. Only valid for components the archetype has.
+	/// </summary>
+	template<typename T> T* Get() const
+	{
+		return reinterpret_cast<T*>(memory + offsets[ComponentTraits<T>::type]);
+	}
+
+	/// <summary>
+	/// Which entity each row is
+	/// </summary>
+	const EntityHandle* GetHandles() const
+	{
+		return reinterpret_cast<const EntityHandle*>(memory);
+	}
+};
+
+/// <summary>
+/// Singleton that stores every entity's components by archetype (the set of components it
+/// has). Each archetype keeps its entities in fixed size chunks, one column per component,
+/// packed with no holes: destroying an entity moves the archetype's last one into its row.
+/// Systems walk the chunks of every archetype that has what they need (ForEachChunk), and
+/// only touch those columns, so cold data (reset points, animation) stays out of the cache.
+/// </summary>
+class EntityWorld
+{
+private:
+	/// <summary>
+	/// Singleton implementation (private constructor & destructor)
+	/// </summary>
+	EntityWorld();
+	~EntityWorld();
+
+	static EntityWorld* instance;
+
+	struct Chunk
+	{
+		unsigned char* memory;
+		size_t count;
+	};
+
+	struct Archetype
+	{
+		ComponentMask mask;
+		size_t capacity;                        //rows per chunk
+		size_t offsets[ComponentTypeCount];     //where each column starts in a chunk
+		size_t entityCount;
+		std::vector<Chunk> chunks;              //only the last chunk in use can have room
+	};
+
+	//where an entity index lives
+	struct Record
+	{
+		unsigned int archetype;
+		unsigned int chunk;
+		unsigned int row;
+		unsigned int generation;
+		bool alive;
+	};
+
+	std::vector<Archetype*> archetypes;
+	std::vector<Record> records;
+	std::vector<unsigned int> freeRecords;
+
+	Archetype* GetArchetype(ComponentMask mask, unsigned int& outIndex);
+	void AddChunk(Archetype* archetype);
+
+	const Record* Find(EntityHandle handle) const;
+	unsigned char* GetComponent(EntityHandle handle, ComponentType type) const;
+
+public:
+	/// <summary>
+	/// Singleton reference to the instance
+	/// </summary>
+	static EntityWorld* GetInstance();
+
+	/// <summary>
+	/// De-allocation
+	/// </summary>
+	static void Release();
+
+	/// <summary>
+	/// Makes a new entity with the given components, all zeroed
+	/// </summary>
+	EntityHandle Create(ComponentMask components);
+
+	/// <summary>
+	/// Makes room for count more entities of an archetype, so a big batch doesn't allocate chunk by chunk
+	/// </summary>
+	void Reserve(ComponentMask components, size_t count);
+
+	/// <summary>
+	/// Destroys an entity (if it's still alive), its handle won't resolve anymore
+	/// </summary>
+	void Destroy(EntityHandle handle);
+
+	bool IsAlive(EntityHandle handle) const { return Find(handle) != nullptr; }
+
+	/// <summary>
+	/// One of an entity's components, nullptr if it's dead or doesn't have it.
+	/// The pointer is only good until the next Create/Destroy.
+	/// </summary>
+	template<typename T> T* Get(EntityHandle handle) const
+	{
+		return reinterpret_cast<T*>(GetComponent(handle, ComponentTraits<T>::type));
+	}
+
+	/// <summary>
+	/// Calls function(const EntityChunkView&) for every chunk with entities that have at
+	/// least the required components. Don't create or destroy entities from inside it.
+	/// </summary>
+	template<typename Function> void ForEachChunk(ComponentMask required, Function function) const
+	{
+		for (size_t a = 0; a < archetypes.size(); a++)
+		{
+			const Archetype* archetype = archetypes[a];
+			if ((archetype->mask & required) != required)
+			{
+				continue;
+			}
+			for (size_t c = 0; c < archetype->chunks.size() && archetype->chunks[c].count > 0; c++)
+			{
+				function(EntityChunkView(archetype->chunks[c].memory, archetype->offsets, archetype->chunks[c].count));
+			}
+		}
+	}
+
+	/// <summary>
+	/// Like ForEachChunk, but only for the archetype with exactly these components,
+	/// in storage order (row r of chunk c is the archetype's row c * capacity + r)
+	/// </summary>
+	template<typename Function> void ForEachChunkOf(ComponentMask components, Function function) const
+	{
+		for (size_t a = 0; a < archetypes.size(); a++)
+		{
+			const Archetype* archetype = archetypes[a];
+			if (archetype->mask != components)
+			{
+				continue;
+			}
+			for (size_t c = 0; c < archetype->chunks.size() && archetype->chunks[c].count > 0; c++)
+			{
+				function(EntityChunkView(archetype->chunks[c].memory, archetype->offsets, archetype->chunks[c].count));
+			}
+		}
+	}
+
+	/// <summary>
+	/// The component sets of every archetype that has at least the required components and any entities
+	/// </summary>
+	void GetArchetypes(ComponentMask required, std::vector<ComponentMask>& outMasks) const;
+
+	/// <summary>
+	/// Where an entity is among its archetype's entities in storage order, -1 if it's dead
+	/// </summary>
+	size_t GetRow(EntityHandle handle) const;
+
+	/// <summary>
+	/// Moves an archetype's entities around, row r gets what was in row order[r]. order has
+	/// to be a permutation of the archetype's rows. Handles keep pointing at the same entities.
+	/// </summary>
+	void Reorder(ComponentMask components, const unsigned int* order);
+
+	/// <summary>
+	/// How many live entities have at least the required components
+	/// </summary>
+	size_t Count(ComponentMask required) const;
+};
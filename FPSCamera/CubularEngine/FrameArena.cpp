@@ -0,0 +1,121 @@
+#include "FrameArena.h"
+#include <mutex>
+#include <algorithm>
+
+namespace
+{
+	thread_local FrameArena* threadArena = nullptr;
+
+	//every thread's arena, so they can all be freed from the main thread
+	std::vector<FrameArena*> arenas;
+	std::mutex arenasMutex;
+}
+
+FrameArena::FrameArena()
+{
+	capacity = DefaultCapacity;
+	memory = static_cast<unsigned char*>(::operator new(capacity));
+	top = 0;
+	overflowBytes = 0;
+	highWater = 0;
+}
+
+FrameArena::~FrameArena()
+{
+	for (size_t i = 0; i < overflow.size(); i++)
+	{
+		::operator delete(overflow[i]);
+	}
+	::operator delete(memory);
+}
+
+FrameArena* FrameArena::GetInstance()
+{
+	if (threadArena == nullptr)
+	{
+		threadArena = new FrameArena();
+		std::lock_guard<std::mutex> lock(arenasMutex);
+		arenas.push_back(threadArena);
+	}
+	return threadArena;
+}
+
+void FrameArena::Release()
+{
+	std::lock_guard<std::mutex> lock(arenasMutex);
+	for (size_t i = 0; i < arenas.size(); i++)
+	{
+		delete arenas[i];
+	}
+	arenas.clear();
+	threadArena = nullptr;
+}
+
+void FrameArena::ReleaseThread()
+{
+	if (threadArena == nullptr)
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(arenasMutex);
+		arenas.erase(std::remove(arenas.begin(), arenas.end(), threadArena), arenas.end());
+	}
+	delete threadArena;
+	threadArena = nullptr;
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	//aligned in memory, not just from the start of the block (which is only malloc aligned)
+	size_t address = ((size_t)(memory + top) + alignment - 1) & ~(alignment - 1);
+	size_t start = address - (size_t)memory;
+	if (start + size <= capacity)
+	{
+		top = start + size;
+		return memory + start;
+	}
+
+	//doesn't fit this frame, Reset makes the block big enough for next time
+	void* allocation = ::operator new(size + alignment);
+	overflow.push_back(allocation);
+	overflowBytes += size + alignment;
+	address = ((size_t)allocation + alignment - 1) & ~(alignment - 1);
+	return (void*)address;
+}
+
+void FrameArena::Reset()
+{
+	size_t used = GetUsed();
+	if (used > highWater)
+	{
+		highWater = used;
+	}
+
+	if (!overflow.empty())
+	{
+		for (size_t i = 0; i < overflow.size(); i++)
+		{
+			::operator delete(overflow[i]);
+		}
+		overflow.clear();
+
+		//one block for the whole frame next time, with some room to spare
+		while (capacity < used)
+		{
+			capacity *= 2;
+		}
+		::operator delete(memory);
+		memory = static_cast<unsigned char*>(::operator new(capacity));
+		overflowBytes = 0;
+	}
+	top = 0;
+}
+
+void FrameArena::Rewind(size_t marker)
+{
+	if (marker < top)
+	{
+		top = marker;
+	}
+}
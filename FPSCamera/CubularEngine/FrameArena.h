@@ -0,0 +1,129 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+#include <cstddef>
+
+/// <summary>
+/// Singleton bump allocator for data that only lives for one frame. Allocating is moving a
+/// pointer, freeing is Reset() at the top of the frame, which drops everything at once.
+/// If a frame needs more than the block holds, the rest comes from the heap and the block
+/// grows at the next Reset() to fit it, so the steady state never touches the heap.
+/// There's one per thread, GetInstance() is the calling thread's. The thread that owns a frame
+/// (the render thread, the simulation thread) resets its own, a job's allocations only last as
+/// long as the job and the job system's workers reset theirs whenever they run out of work.
+/// </summary>
+class FrameArena
+{
+private:
+	/// <summary>
+	/// Singleton implementation (private constructor & destructor)
+	/// </summary>
+	FrameArena();
+	~FrameArena();
+
+	unsigned char* memory;
+	size_t capacity;
+	size_t top;
+
+	//what didn't fit in the block this frame, freed on Reset
+	std::vector<void*> overflow;
+	size_t overflowBytes;
+
+	size_t highWater;
+
+public:
+	static const size_t DefaultCapacity = 1024 * 1024;
+
+	/// <summary>
+	/// This thread's arena, made on first use
+	/// </summary>
+	static FrameArena* GetInstance();
+
+	/// <summary>
+	/// De-allocation of every thread's arena. The other threads' thread_local pointers aren't
+	/// touched, so stop every thread that used an arena (or have it ReleaseThread()) first.
+	/// </summary>
+	static void Release();
+
+	/// <summary>
+	/// De-allocation of the calling thread's arena, for threads that end before the game does
+	/// </summary>
+	static void ReleaseThread();
+
+	/// <summary>
+	/// Room for size bytes until the next Reset(), never nullptr
+	/// </summary>
+	void* Allocate(size_t size, size_t alignment = 16);
+
+	/// <summary>
+	/// Frees everything allocated since the last Reset(), once per frame before anything uses the arena
+	/// </summary>
+	void Reset();
+
+	/// <summary>
+	/// Where the arena is at, to go back to with Rewind (see ArenaScope)
+	/// </summary>
+	size_t GetMarker() const { return top; }
+
+	/// <summary>
+	/// Frees everything allocated in the block after the marker. Overflow allocations stay until Reset().
+	/// </summary>
+	void Rewind(size_t marker);
+
+	size_t GetUsed() const { return top + overflowBytes; }
+	size_t GetCapacity() const { return capacity; }
+
+	/// <summary>
+	/// The most any frame has used so far
+	/// </summary>
+	size_t GetHighWater() const { return highWater; }
+};
+
+/// <summary>
+/// Gives back everything allocated from the frame arena during its lifetime, for
+/// temporaries that are done well before the end of the frame
+/// </summary>
+class ArenaScope
+{
+private:
+	size_t marker;
+
+public:
+	ArenaScope() { marker = FrameArena::GetInstance()->GetMarker(); }
+	~ArenaScope() { FrameArena::GetInstance()->Rewind(marker); }
+
+	ArenaScope(const ArenaScope&) = delete;
+	ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+/// <summary>
+/// Standard allocator over the frame arena, so containers can be used as per-frame scratch.
+/// Deallocating does nothing, so reserve() up front instead of letting them grow.
+/// </summary>
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	ArenaAllocator() {}
+	template<typename U> ArenaAllocator(const ArenaAllocator<U>&) {}
+
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(FrameArena::GetInstance()->Allocate(count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+	}
+
+	void deallocate(T*, size_t)
+	{
+	}
+
+	template<typename U> bool operator==(const ArenaAllocator<U>&) const { return true; }
+	template<typename U> bool operator!=(const ArenaAllocator<U>&) const { return false; }
+};
+
+/// <summary>
+/// A vector that lives in the frame arena, gone after the next FrameArena::Reset()
+/// </summary>
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
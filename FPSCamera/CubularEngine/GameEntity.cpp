@@ -1,4 +1,5 @@
 #include "GameEntity.h"
+#include "EntitySystems.h"
 #include "glm/gtc/matrix_transform.hpp"
 #include <iostream>
 #include <glm/gtc/quaternion.hpp>
@@ -7,191 +8,171 @@ GameEntity::GameEntity(Mesh * mesh,
     Material * material,
     glm::vec3 position, 
     glm::vec3 eulerAngles, 
-    glm::vec3 scale)
-{
-    this->mesh = mesh;
-    this->material = material;
-    this->position = position;
-    this->eulerAngles = eulerAngles;
-    this->scale = scale;
-    worldMatrix = glm::identity<glm::mat4>();
-	activated = false;
-	gravity = false;
-	mass = 1.0f;
-	enabled = true;
-	orbital = true;
-	startPos = position;
-	startQuat = glm::quat(eulerAngles);
-	rotQuat = glm::quat(glm::vec3(0, 180, 0));
+    glm::vec3 scale,
+    ComponentMask tags)
+{
+    TransformId transform = TransformSystem::GetInstance()->Create(position, glm::identity<glm::quat>(), scale);
+
+    EntityWorld* world = EntityWorld::GetInstance();
+    handle = world->Create(Components | tags);
+    world->Get<Transform>(handle)->id = transform;
+
+    Renderable* renderable = world->Get<Renderable>(handle);
+    renderable->mesh = mesh;
+    renderable->material = material;
+
+    world->Get<Motion>(handle)->mass = 1.0f;
+    world->Get<EntityFlags>(handle)->bits = EntityEnabled | EntityOrbital;
+    world->Get<SpawnPoint>(handle)->position = position;
+
+    Animation* animation = world->Get<Animation>(handle);
+    animation->eulerAngles = eulerAngles;
+    animation->startQuat = glm::quat(eulerAngles);
+    animation->rotQuat = glm::quat(glm::vec3(0, 180, 0));
 }
 
 GameEntity::~GameEntity()
 {
+	TransformSystem::GetInstance()->Destroy(GetTransform());
+	EntityWorld::GetInstance()->Destroy(handle);
+}
+
+void GameEntity::SetFlag(unsigned int flag, bool value)
+{
+	EntityFlags& flags = GetFlags();
+	flags.bits = value ? (flags.bits | flag) : (flags.bits & ~flag);
 }
 
 //updates the object
 void GameEntity::Update(float dt)
 {
-	if (enabled) {
-		if (gravity) {
-			acceleration = glm::vec3(0.0f, -4.6f, 0.0f);
+	EntityFlags& flags = GetFlags();
+	if (flags.bits & EntityEnabled) {
+		Motion& motion = GetMotion();
+		if (flags.bits & EntityGravity) {
+			motion.acceleration = glm::vec3(0.0f, -4.6f, 0.0f);
 		}
-		velocity += acceleration * dt;
-		position += velocity * dt;
-
-		worldMatrix = glm::identity<glm::mat4>();
-		worldMatrix = glm::translate(worldMatrix, position);
-		if (!orbital) {
-			eulerAngles.y += .01;
-			worldMatrix = glm::rotate(worldMatrix, eulerAngles.y, glm::vec3(0.f, 1.f, 0.f));
+		motion.velocity += motion.acceleration * dt;
+
+		//the setters only mark the transform dirty if something actually changed
+		TransformSystem* transforms = TransformSystem::GetInstance();
+		TransformId transform = GetTransform();
+		transforms->SetPosition(transform, transforms->GetPosition(transform) + motion.velocity * dt);
+		if ((flags.bits & EntityOrbital) == 0) {
+			Animation* animation = EntityWorld::GetInstance()->Get<Animation>(handle);
+			animation->eulerAngles.y += .01f;
+			transforms->SetRotation(transform, glm::angleAxis(animation->eulerAngles.y, glm::vec3(0.f, 1.f, 0.f)));
 		}
-		worldMatrix = glm::scale(worldMatrix, scale);
 	}
 }
 
 //renders the object
-void GameEntity::Render(Camera* camera)
+void GameEntity::Render(Camera* camera, ImpostorRenderer* impostors)
 {
-	if (enabled) {
-		material->Bind(camera, worldMatrix);
-		mesh->Render();
+	if (IsEnabled()) {
+		EntitySystems::Draw(*EntityWorld::GetInstance()->Get<Renderable>(handle), GetTransform(), camera, impostors);
 	}
 }
 
 //adds position to the object
 void GameEntity::AddPosition(glm::vec3 pos)
 {
-	position += pos;
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	TransformId transform = GetTransform();
+	transforms->SetPosition(transform, transforms->GetPosition(transform) + pos);
 }
 
 //adds velocity to the object
 void GameEntity::AddVelocity(glm::vec3 vel)
 {
-	velocity += vel;
+	GetMotion().velocity += vel;
 }
 
 //set the velocity of the object
 void GameEntity::SetVelocity(glm::vec3 vel)
 {
-	velocity = vel;
+	GetMotion().velocity = vel;
 }
 
 //Adds acceleration to the object
 void GameEntity::AddAcceleration(glm::vec3 acc)
 {
-	acceleration += acc;
+	GetMotion().acceleration += acc;
 }
 
 //Sets the acceleration
 void GameEntity::SetAcceleration(glm::vec3 acc)
 {
-	acceleration = acc;
+	GetMotion().acceleration = acc;
 }
 
 //toggles gravit for the objects
 void GameEntity::ToggleGravity()
 {
-	gravity = !gravity;
+	GetFlags().bits ^= EntityGravity;
 }
 
 //calculated the bounding box of the object
 void GameEntity::CalculateBox()
 {
-	AABB newBox;
-
-	newBox.min = position;
-	newBox.max = newBox.min;
-
-	for (size_t i = 0; i < mesh->vertCount; i++)
-	{
-		glm::vec3 tempVert = glm::vec3(position.x + mesh->vertices[i], position.y + mesh->vertices[i + 1], position.z + mesh->vertices[i + 2]);
-
-		if (tempVert.x > newBox.max.x)
-		{
-			newBox.max.x = tempVert.x;
-		}
-		if (tempVert.y > newBox.max.y)
-		{
-			newBox.max.y = tempVert.y;
-		}
-		if (tempVert.z > newBox.max.z)
-		{
-			newBox.max.z = tempVert.z;
-		}
-
-		if (tempVert.x < newBox.min.x)
-		{
-			newBox.min.x = tempVert.x;
-		}
-		if (tempVert.y < newBox.min.y)
-		{
-			newBox.min.y = tempVert.y;
-		}
-		if (tempVert.z < newBox.min.z)
-		{
-			newBox.min.z = tempVert.z;
-		}
-	}
+	//the mesh keeps its model space bounds, so this no longer walks the vertices
+	EntityWorld* world = EntityWorld::GetInstance();
+	const Mesh* mesh = world->Get<Renderable>(handle)->mesh;
+	Collider* box = world->Get<Collider>(handle);
+	glm::vec3 position = GetPos();
 
-	box.min.x = newBox.min.x;
-	box.min.y = newBox.min.y;
-	box.min.z = newBox.min.z;
-	box.max.x = newBox.max.x;
-	box.max.y = newBox.max.y;
-	box.max.z = newBox.max.z;
+	box->min = position + glm::min(mesh->boundsMin, glm::vec3(0.0f));
+	box->max = position + glm::max(mesh->boundsMax, glm::vec3(0.0f));
 }
 
 //cets the points of the bounding box
-std::vector<glm::vec3> GameEntity::GetPoints()
+void GameEntity::GetPoints(glm::vec3 outPoints[8]) const
 {
-	std::vector<glm::vec3> points;
+	const AABB& box = GetBox();
 
-	points.push_back(glm::vec3(box.min.x, box.min.y, box.min.z));
-	points.push_back(glm::vec3(box.min.x, box.max.y, box.min.z));
-	points.push_back(glm::vec3(box.min.x, box.max.y, box.max.z));
-	points.push_back(glm::vec3(box.min.x, box.min.y, box.max.z));
+	outPoints[0] = glm::vec3(box.min.x, box.min.y, box.min.z);
+	outPoints[1] = glm::vec3(box.min.x, box.max.y, box.min.z);
+	outPoints[2] = glm::vec3(box.min.x, box.max.y, box.max.z);
+	outPoints[3] = glm::vec3(box.min.x, box.min.y, box.max.z);
 
-	points.push_back(glm::vec3(box.max.x, box.max.y, box.max.z));
-	points.push_back(glm::vec3(box.max.x, box.max.y, box.min.z));
-	points.push_back(glm::vec3(box.max.x, box.min.y, box.min.z));
-	points.push_back(glm::vec3(box.max.x, box.min.y, box.max.z));
-
-	return points;
+	outPoints[4] = glm::vec3(box.max.x, box.max.y, box.max.z);
+	outPoints[5] = glm::vec3(box.max.x, box.max.y, box.min.z);
+	outPoints[6] = glm::vec3(box.max.x, box.min.y, box.min.z);
+	outPoints[7] = glm::vec3(box.max.x, box.min.y, box.max.z);
 }
 
 //gets the normals of the bounding box
-std::vector<glm::vec3> GameEntity::GetNormals()
+void GameEntity::GetNormals(glm::vec3 outNormals[3]) const
 {
-	std::vector<glm::vec3> normals;
-	std::vector<glm::vec3> points = GetPoints();
+	glm::vec3 points[8];
+	GetPoints(points);
 
 	glm::vec3 U(points[1] - points[0]);
 	glm::vec3 V(points[2] - points[0]);
 
-	normals.push_back(glm::normalize(glm::vec3((U.y * V.z) - (U.z * V.y), (U.z * V.x) - (U.x * V.z), (U.x * V.y) - (U.y * V.x))));
+	outNormals[0] = glm::normalize(glm::vec3((U.y * V.z) - (U.z * V.y), (U.z * V.x) - (U.x * V.z), (U.x * V.y) - (U.y * V.x)));
 
 	glm::vec3 U1(points[5] - points[4]);
 	glm::vec3 V1(points[2] - points[4]);
 
-	normals.push_back(glm::normalize(glm::vec3((U1.y * V1.z) - (U1.z * V1.y), (U1.z * V1.x) - (U1.x * V1.z), (U1.x * V1.y) - (U1.y * V1.x))));
+	outNormals[1] = glm::normalize(glm::vec3((U1.y * V1.z) - (U1.z * V1.y), (U1.z * V1.x) - (U1.x * V1.z), (U1.x * V1.y) - (U1.y * V1.x)));
 
 	glm::vec3 U2(points[1] - points[0]);
 	glm::vec3 V2(points[5] - points[0]);
 
-	normals.push_back(glm::normalize(glm::vec3((U2.y * V2.z) - (U2.z * V2.y), (U2.z * V2.x) - (U2.x * V2.z), (U2.x * V2.y) - (U2.y * V2.x))));
-
-	return normals;
+	outNormals[2] = glm::normalize(glm::vec3((U2.y * V2.z) - (U2.z * V2.y), (U2.z * V2.x) - (U2.x * V2.z), (U2.x * V2.y) - (U2.y * V2.x)));
 }
 
 //gets the minimum and maximum bounds of the bounding box
-void GameEntity::GetMinMax(glm::vec3 axis, float & min, float & max)
+void GameEntity::GetMinMax(glm::vec3 axis, float & min, float & max) const
 {
-	std::vector<glm::vec3> points = GetPoints();
+	glm::vec3 points[8];
+	GetPoints(points);
 
 	min = glm::dot(points[0], axis);
 	max = min;
 
-	for (int i = 1; i < points.size(); i++)
+	for (int i = 1; i < 8; i++)
 	{
 		float currProj = glm::dot(points[i], axis);
 
@@ -210,34 +191,47 @@ void GameEntity::GetMinMax(glm::vec3 axis, float & min, float & max)
 //Sets the mass of the object
 void GameEntity::SetMass(float mass)
 {
-	this->mass = mass;
+	GetMotion().mass = mass;
 }
 
 //Add scale to the object
 void GameEntity::AddScale(glm::vec3 scale)
 {
-	this->scale += scale;
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	TransformId transform = GetTransform();
+	transforms->SetScale(transform, transforms->GetScale(transform) + scale);
 }
 
 //Set scale of the object
 void GameEntity::SetScale(glm::vec3 scale)
 {
-	this->scale = scale;
+	TransformSystem::GetInstance()->SetScale(GetTransform(), scale);
+}
+
+//sets where a reset puts the velocity back to
+void GameEntity::SetStartVelocity(glm::vec3 vel)
+{
+	EntityWorld::GetInstance()->Get<SpawnPoint>(handle)->velocity = vel;
 }
 
 //reset's the object's position and velocity
 void GameEntity::Reset()
 {
-	position = startPos;
-	velocity = startVel;
-	enabled = true;
+	const SpawnPoint* spawn = EntityWorld::GetInstance()->Get<SpawnPoint>(handle);
+	TransformSystem::GetInstance()->SetPosition(GetTransform(), spawn->position);
+	GetMotion().velocity = spawn->velocity;
+	SetEnabled(true);
 }
 
 //slerps the objects around the designated axis based on time
 void GameEntity::SLERP(float dt)
 {
-	timer += dt;
-	glm::quat interQuat = glm::mix(startQuat, rotQuat, timer);
-	glm::mat4 rotMatrix = glm::mat4_cast(interQuat);
-	worldMatrix = worldMatrix * rotMatrix;
+	Animation* animation = EntityWorld::GetInstance()->Get<Animation>(handle);
+	animation->timer += dt;
+	glm::quat interQuat = glm::mix(animation->startQuat, animation->rotQuat, animation->timer);
+
+	//the rotation keeps stacking up frame after frame, so it spins
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	TransformId transform = GetTransform();
+	transforms->SetRotation(transform, transforms->GetRotation(transform) * interQuat);
 }
@@ -3,117 +3,123 @@
 #include "Mesh.h"
 #include "Material.h"
 #include "Camera.h"
+#include "TransformSystem.h"
+#include "EntityWorld.h"
 #include <glm/gtc/quaternion.hpp>
 
-
-struct AABB {
-	glm::vec3 min;
-	glm::vec3 max;
-
-	AABB(const glm::vec3 &minVal, const glm::vec3 &maxVal)
-	{
-		min = minVal;
-		max = maxVal;
-	}
-	AABB()
-	{
-		min = glm::vec3(0.0f);
-		max = glm::vec3(0.0f);
-	}
-};
+class ImpostorRenderer;
 
 /// <summary>
-/// Represents one 'renderable' objet
+/// Represents one 'renderable' objet. Its data lives in the EntityWorld as components, this is
+/// a handle with the old object API on top, for code that hasn't moved to EntitySystems yet.
 /// </summary>
 class GameEntity
 {
 private:
-    Mesh* mesh;        
-    Material* material;
-
-    //TODO - maybe this should be in a transform class?
-    
-    glm::vec3 eulerAngles;
-    glm::vec3 scale;
-    
-    glm::mat4 worldMatrix;
-
-	//physics stuff
-	glm::vec3 position;
-	glm::vec3 velocity;
-	glm::vec3 acceleration;
-	glm::vec3 startPos;
-	
-	float timer=0;
-	bool gravity;
-	glm::quat startQuat;
-	glm::quat rotQuat;
+	EntityHandle handle;
+
+	//position, rotation & scale live in the TransformSystem, which also
+	//caches the world matrix and only rebuilds it when one of them changes.
+	//not cached here, SpatialSort moves transforms to other ids
+	TransformId GetTransform() const { return EntityWorld::GetInstance()->Get<Transform>(handle)->id; }
+
+	//which EntityPool slot this lives in, if it came from one
+	friend class EntityPool;
+	unsigned int poolSlot = 0;
+
+	Motion& GetMotion() const { return *EntityWorld::GetInstance()->Get<Motion>(handle); }
+	EntityFlags& GetFlags() const { return *EntityWorld::GetInstance()->Get<EntityFlags>(handle); }
+	void SetFlag(unsigned int flag, bool value);
 
 public: 
+	/// <summary>
+	/// What every GameEntity has
+	/// </summary>
+	static const ComponentMask Components = HasTransform | HasMotion | HasRenderable | HasCollider | HasFlags | HasAnimation | HasSpawnPoint;
+
     /// <summary>
     /// Basic paramterized constructor for most of our private vars
     /// </summary>
+    /// <param name="tags">Extra components (tags) on top of Components, e.g. IsSimulated</param>
     GameEntity(
         Mesh* mesh,
         Material* material,
         glm::vec3 position,
         glm::vec3 eulerAngles,
-        glm::vec3 scale
+        glm::vec3 scale,
+        ComponentMask tags = 0
     );
 
+    /// <summary>
+    /// Entities own a transform slot, so they can't be copied
+    /// </summary>
+    GameEntity(const GameEntity&) = delete;
+    GameEntity& operator=(const GameEntity&) = delete;
+
     /// <summary>
     /// Destruction
     /// </summary>
     virtual ~GameEntity();
 
+	EntityHandle GetHandle() const { return handle; }
+
     /// <summary>
-    /// Updates the worldMatrix
+    /// Moves the entity, which marks its transform dirty. The world matrix gets
+    /// rebuilt by TransformSystem::UpdateMatrices(). EntitySystems::Integrate does the same for many.
     /// </summary>
     virtual void Update(float dt);
 
     /// <summary>
-    /// Renders the gameEntity based on a camera
+    /// Renders the gameEntity based on a camera (see EntitySystems::Draw)
     /// </summary>
-    void Render(Camera* camera);
+    void Render(Camera* camera, ImpostorRenderer* impostors = nullptr);
 
-	bool activated;
-	
 	void AddPosition(glm::vec3 pos);
 	glm::vec3 GetPos() {
-		return position;
+		return TransformSystem::GetInstance()->GetPosition(GetTransform());
 	}
 	void AddVelocity(glm::vec3 vel);
 	void SetVelocity(glm::vec3 vel);
 	glm::vec3 GetVelocity()
 	{
-		return velocity;
+		return GetMotion().velocity;
 	}
 	void AddAcceleration(glm::vec3 acc);
 	void SetAcceleration(glm::vec3 acc);
 	void ToggleGravity();
 
-	AABB box;
+	const AABB& GetBox() const { return *EntityWorld::GetInstance()->Get<Collider>(handle); }
 	void CalculateBox();
-	std::vector<glm::vec3> GetPoints();
-	std::vector<glm::vec3> GetNormals();
-	void GetMinMax(glm::vec3 axis, float& min, float& max);
-
-	float mass;
+	/// <summary>
+	/// The 8 corners of the box. Fixed size, so the collision checks never allocate.
+	/// </summary>
+	void GetPoints(glm::vec3 outPoints[8]) const;
+	/// <summary>
+	/// The box's 3 face normals
+	/// </summary>
+	void GetNormals(glm::vec3 outNormals[3]) const;
+	void GetMinMax(glm::vec3 axis, float& min, float& max) const;
+
+	float GetMass() const { return GetMotion().mass; }
 	void SetMass(float mass);
 
-	bool enabled;
-	bool orbital;
+	bool IsEnabled() const { return (GetFlags().bits & EntityEnabled) != 0; }
+	void SetEnabled(bool enabled) { SetFlag(EntityEnabled, enabled); }
+	bool IsOrbital() const { return (GetFlags().bits & EntityOrbital) != 0; }
+	void SetOrbital(bool orbital) { SetFlag(EntityOrbital, orbital); }
 
 	void AddScale(glm::vec3 scale);
 	void SetScale(glm::vec3 scale);
 	glm::vec3 GetScale() {
-		return scale;
+		return TransformSystem::GetInstance()->GetScale(GetTransform());
 	}
 
-	glm::vec3 startVel;
+	/// <summary>
+	/// The velocity Reset() gives back
+	/// </summary>
+	void SetStartVelocity(glm::vec3 vel);
 
 	void Reset();
 	void SLERP(float dt);
 
 };
-
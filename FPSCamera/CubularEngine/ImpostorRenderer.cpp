@@ -0,0 +1,94 @@
+#include "ImpostorRenderer.h"
+#include "MemoryTracker.h"
+#include <cstring>
+
+ImpostorRenderer::ImpostorRenderer(StreamingBuffer* stream)
+{
+	this->stream = stream;
+	pixelThreshold = 3.0f;
+	minPixelRadius = 1.5f;
+
+	shader = new DynamicShader("assets/shaders/impostorVertex.glsl", "assets/shaders/impostorFragment.glsl");
+
+	//one quad as a triangle strip, corners go from -1 to 1
+	GLfloat corners[] = {
+		-1.0f, -1.0f,
+		1.0f, -1.0f,
+		-1.0f, 1.0f,
+		1.0f, 1.0f
+	};
+
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+
+	glGenBuffers(1, &quadVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	MemoryTracker::TrackGpu(GpuResource::VertexArray, VAO, 0, MemoryTag::Render);
+	MemoryTracker::TrackGpu(GpuResource::Buffer, quadVBO, sizeof(corners), MemoryTag::Render);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*)0);
+
+	//these two advance once per instance instead of once per vertex, the
+	//pointers get set every Flush since the data moves around the stream
+	glEnableVertexAttribArray(1);
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(2, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+ImpostorRenderer::~ImpostorRenderer()
+{
+	MemoryTracker::UntrackGpu(GpuResource::Buffer, quadVBO);
+	MemoryTracker::UntrackGpu(GpuResource::VertexArray, VAO);
+	MemoryTracker::UntrackGpu(GpuResource::Program, shader->ID);
+	glDeleteBuffers(1, &quadVBO);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteProgram(shader->ID);
+	delete shader;
+}
+
+void ImpostorRenderer::Submit(glm::vec3 position, float radius, glm::vec3 color)
+{
+	Instance instance;
+	instance.positionRadius = glm::vec4(position, radius);
+	instance.color = glm::vec4(color, 1.0f);
+	instances.push_back(instance);
+}
+
+void ImpostorRenderer::Flush(Camera* camera)
+{
+	if (instances.empty())
+	{
+		return;
+	}
+
+	GLintptr offset;
+	void* out = stream->Allocate(instances.size() * sizeof(Instance), sizeof(Instance), offset);
+	if (out == nullptr)
+	{
+		instances.clear();
+		return;
+	}
+	memcpy(out, &instances[0], instances.size() * sizeof(Instance));
+	stream->Flush();
+
+	shader->use();
+	shader->setMat4("view", camera->GetView());
+	shader->setMat4("projection", camera->GetProjection());
+	shader->setFloat("pixelsPerUnit", camera->GetPixelsPerUnit());
+	shader->setFloat("minPixelRadius", minPixelRadius);
+
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, stream->GetBuffer());
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid*)offset);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid*)(offset + sizeof(glm::vec4)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)instances.size());
+	glBindVertexArray(0);
+
+	instances.clear();
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "stdafx.h"
+#include "Camera.h"
+#include "DynamicShader.h"
+#include "StreamingBuffer.h"
+#include <vector>
+
+/// <summary>
+/// Draws bodies that only cover a few pixels as instanced, camera facing discs.
+/// Entities Submit() themselves while rendering and everything goes out in one
+/// draw call on Flush(). The instance data is streamed through a shared StreamingBuffer.
+/// </summary>
+class ImpostorRenderer
+{
+private:
+	//per instance data, laid out the way the vertex shader reads it
+	struct Instance
+	{
+		glm::vec4 positionRadius;
+		glm::vec4 color;
+	};
+
+	std::vector<Instance> instances;
+
+	DynamicShader* shader;
+	GLuint VAO;
+	GLuint quadVBO;
+
+	//where the instance data gets written every frame
+	StreamingBuffer* stream;
+
+public:
+	/// <summary>
+	/// Loads the impostor shader and creates the quad buffer
+	/// </summary>
+	/// <param name="stream">Where the per-instance data gets written every frame</param>
+	ImpostorRenderer(StreamingBuffer* stream);
+
+	/// <summary>
+	/// Destruction
+	/// </summary>
+	~ImpostorRenderer();
+
+	/// <summary>
+	/// Bodies projecting to fewer pixels than this (in radius) get drawn as impostors
+	/// </summary>
+	float pixelThreshold;
+
+	/// <summary>
+	/// Smallest radius (in pixels) an impostor gets drawn with
+	/// </summary>
+	float minPixelRadius;
+
+	/// <summary>
+	/// Queues one body for this frame
+	/// </summary>
+	/// <param name="position">World position</param>
+	/// <param name="radius">World radius</param>
+	/// <param name="color">Color of the disc</param>
+	void Submit(glm::vec3 position, float radius, glm::vec3 color);
+
+	/// <summary>
+	/// Draws everything that was submitted this frame and clears the queue
+	/// </summary>
+	void Flush(Camera* camera);
+};
@@ -0,0 +1,209 @@
+#include "JobSystem.h"
+#include "FrameArena.h"
+
+namespace
+{
+	//0 on the main thread and on threads the job system didn't start
+	thread_local unsigned int threadIndex = 0;
+
+	//how often an idle worker looks for work before going to sleep
+	const int SpinCount = 64;
+}
+
+//for singleton
+JobSystem* JobSystem::instance = nullptr;
+unsigned int JobSystem::requestedThreads = 0;
+
+JobSystem::JobSystem()
+	: queuedJobs(0)
+{
+	stopping = false;
+
+	//the main thread works too, so one worker per other core
+	unsigned int threadCount = requestedThreads;
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+		threadCount = threadCount > 1 ? threadCount : 2;
+	}
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		WorkQueue* queue = new WorkQueue();
+		queue->head = 0;
+		queue->count = 0;
+		queues.push_back(queue);
+	}
+	for (unsigned int i = 1; i < threadCount; i++)
+	{
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+	for (size_t i = 0; i < queues.size(); i++)
+	{
+		delete queues[i];
+	}
+}
+
+JobSystem* JobSystem::GetInstance()
+{
+	if (instance == nullptr)
+	{
+		instance = new JobSystem();
+	}
+	return instance;
+}
+
+void JobSystem::Release()
+{
+	delete instance;
+	instance = nullptr;
+}
+
+void JobSystem::SetThreadCount(unsigned int count)
+{
+	requestedThreads = count;
+}
+
+unsigned int JobSystem::GetThreadIndex()
+{
+	return threadIndex;
+}
+
+void JobSystem::Schedule(const Job& job)
+{
+	WorkQueue* queue = queues[threadIndex];
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if (queue->count < QueueSize)
+		{
+			queue->jobs[(queue->head + queue->count) % QueueSize] = job;
+			queue->count++;
+			queued = true;
+		}
+	}
+	if (!queued)
+	{
+		Execute(job);
+		return;
+	}
+
+	queuedJobs.fetch_add(1);
+	{
+		//taking the lock means a worker can't miss this between checking queuedJobs and sleeping
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_one();
+}
+
+bool JobSystem::PopOwn(unsigned int thread, Job& outJob)
+{
+	WorkQueue* queue = queues[thread];
+	std::lock_guard<std::mutex> lock(queue->mutex);
+	if (queue->count == 0)
+	{
+		return false;
+	}
+	queue->count--;
+	outJob = queue->jobs[(queue->head + queue->count) % QueueSize];
+	return true;
+}
+
+bool JobSystem::Steal(unsigned int thread, Job& outJob)
+{
+	//start with the next thread along, so thieves spread out over the victims
+	for (size_t offset = 1; offset < queues.size(); offset++)
+	{
+		WorkQueue* queue = queues[(thread + offset) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if (queue->count > 0)
+		{
+			outJob = queue->jobs[queue->head];
+			queue->head = (queue->head + 1) % QueueSize;
+			queue->count--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::Execute(const Job& job)
+{
+	MemoryTag previous = MemoryTracker::SetThreadTag(job.tag);
+	job.function(job.data, job.begin, job.end);
+	MemoryTracker::SetThreadTag(previous);
+	if (job.counter != nullptr)
+	{
+		job.counter->pending.fetch_sub(1);
+	}
+}
+
+bool JobSystem::RunPendingJob()
+{
+	Job job;
+	if (!PopOwn(threadIndex, job) && !Steal(threadIndex, job))
+	{
+		return false;
+	}
+	queuedJobs.fetch_sub(1);
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Wait(const JobCounter& counter)
+{
+	while (counter.pending.load() > 0)
+	{
+		if (!RunPendingJob())
+		{
+			//the last jobs are running on other threads
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::WorkerLoop(unsigned int thread)
+{
+	threadIndex = thread;
+	while (true)
+	{
+		int spins = 0;
+		while (spins < SpinCount)
+		{
+			if (RunPendingJob())
+			{
+				spins = 0;
+			}
+			else
+			{
+				spins++;
+				std::this_thread::yield();
+			}
+		}
+
+		//nothing the jobs allocated from this thread's arena is still in use
+		FrameArena::GetInstance()->Reset();
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+		if (stopping)
+		{
+			//the workers go with the job system, their arenas with them
+			lock.unlock();
+			FrameArena::ReleaseThread();
+			return;
+		}
+	}
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include "stdafx.h"
+#include "MemoryTracker.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/// <summary>
+/// Counts jobs that haven't finished yet, JobSystem::Wait() on it to join them
+/// </summary>
+struct JobCounter
+{
+	std::atomic<int> pending;
+
+	JobCounter() : pending(0) {}
+};
+
+/// <summary>
+/// One piece of work: function(data, begin, end). Plain data, so scheduling never allocates.
+/// </summary>
+struct Job
+{
+	void (*function)(void* data, size_t begin, size_t end);
+	void* data;
+	size_t begin;
+	size_t end;
+	JobCounter* counter;    //decremented once it's run, can be nullptr
+	MemoryTag tag;          //what the scheduling thread was counting its allocations as
+};
+
+/// <summary>
+/// Singleton pool of worker threads for CPU work within a frame (the AssetLoader's workers are
+/// for loading). Every thread, the main thread included, has its own queue: it pushes and pops
+/// its own jobs at the back, so it keeps working on what's still in its cache, and when it runs
+/// dry it steals from the front of the others'. A thread waiting on a counter runs jobs until
+/// the counter is done instead of sleeping, so waiting inside a job can't deadlock.
+/// </summary>
+class JobSystem
+{
+private:
+	/// <summary>
+	/// Singleton implementation (private constructor & destructor)
+	/// </summary>
+	JobSystem();
+	~JobSystem();
+
+	static JobSystem* instance;
+
+	//threads for the next instance, 0 for one per core
+	static unsigned int requestedThreads;
+
+	//fixed size ring, pushing to a full one runs the job right away instead
+	static const size_t QueueSize = 4096;
+
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		Job jobs[QueueSize];
+		size_t head;    //oldest, where thieves take from
+		size_t count;
+	};
+
+	//queues[0] is the thread that made the job system (the main thread)
+	std::vector<WorkQueue*> queues;
+	std::vector<std::thread> workers;
+
+	//idle workers sleep until something is queued
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> queuedJobs;
+	bool stopping;
+
+	bool PopOwn(unsigned int thread, Job& outJob);
+	bool Steal(unsigned int thread, Job& outJob);
+	void Execute(const Job& job);
+	void WorkerLoop(unsigned int thread);
+
+public:
+	/// <summary>
+	/// Singleton reference to the instance
+	/// </summary>
+	static JobSystem* GetInstance();
+
+	/// <summary>
+	/// De-allocation, waits for the workers to stop. Nothing may be queued anymore.
+	/// </summary>
+	static void Release();
+
+	/// <summary>
+	/// How many threads (the main thread included) the job system is made with the next time,
+	/// 0 for one per core. Release() it first for this to apply to the running one.
+	/// </summary>
+	static void SetThreadCount(unsigned int count);
+
+	/// <summary>
+	/// Queues a job on this thread's queue (threads that aren't the job system's use the main thread's)
+	/// </summary>
+	void Schedule(const Job& job);
+
+	/// <summary>
+	/// Runs one queued job on this thread, false if there wasn't any
+	/// </summary>
+	bool RunPendingJob();
+
+	/// <summary>
+	/// Helps out with queued jobs until every job counted by counter has finished
+	/// </summary>
+	void Wait(const JobCounter& counter);
+
+	/// <summary>
+	/// Calls function(begin, end) over [0, count) in ranges of at most grain, spread over every
+	/// thread, and returns once they're all done. Runs inline if it all fits in one range.
+	/// </summary>
+	template<typename Function>
+	void ParallelFor(size_t count, size_t grain, Function function)
+	{
+		if (count <= grain)
+		{
+			if (count > 0)
+			{
+				function((size_t)0, count);
+			}
+			return;
+		}
+
+		JobCounter counter;
+		Job job;
+		job.function = [](void* data, size_t begin, size_t end) { (*static_cast<Function*>(data))(begin, end); };
+		job.data = &function;
+		job.counter = &counter;
+		job.tag = MemoryTracker::GetThreadTag();
+		counter.pending = (int)((count - grain + grain - 1) / grain);
+		for (size_t begin = grain; begin < count; begin += grain)
+		{
+			job.begin = begin;
+			job.end = begin + grain < count ? begin + grain : count;
+			Schedule(job);
+		}
+
+		//the first range here, the others are probably still queued
+		function((size_t)0, grain);
+		Wait(counter);
+	}
+
+	/// <summary>
+	/// Threads that run jobs, the main thread included
+	/// </summary>
+	unsigned int GetThreadCount() const { return (unsigned int)queues.size(); }
+
+	/// <summary>
+	/// Which of the job system's threads this is, 0 for the main thread (and anything that isn't one of the workers)
+	/// </summary>
+	static unsigned int GetThreadIndex();
+};
@@ -34,7 +34,6 @@ KDTree::~KDTree()
 	{
 		delete tree[i];
 	}
-	explosion->drop();
 }
 
 //Puts specified object as a leaf of one of the nodes of the tree
@@ -98,12 +97,12 @@ void KDTree::ClearObjsInTree()
 }
 
 //Clears the tree and places all active objects in the tree
-void KDTree::UpdateTree(vector<GameEntity*> objs, int numObjs)
+void KDTree::UpdateTree(const vector<GameEntity*>& objs, int numObjs)
 {
 	ClearObjsInTree();
 	for (size_t i = 0; i < numObjs; i++)
 	{
-		if (objs[i]->enabled) {
+		if (objs[i]->IsEnabled()) {
 			PutInTree(objs[i]);
 		}
 	}
@@ -112,11 +111,10 @@ void KDTree::UpdateTree(vector<GameEntity*> objs, int numObjs)
 //checks if two objects are in the same node
 bool KDTree::CheckIfSameSpace(GameEntity * obj1, GameEntity * obj2)
 {
-	vector<GameEntity*> nodeObjs;
 	int numObjs = 0;
 	for (size_t i = 0; i < 14; i++)
 	{
-		nodeObjs = tree[i]->GetObjects();
+		const vector<GameEntity*>& nodeObjs = tree[i]->GetObjects();
 		numObjs = tree[i]->GetNumObjs();
 		bool obj1Here = false;
 		bool obj2Here = false;
@@ -140,14 +138,15 @@ bool KDTree::CheckIfSameSpace(GameEntity * obj1, GameEntity * obj2)
 
 //checks each node's objects against each other to see if there are collisions
 ///on a collision, momentum between the objects is preserved, and the larger of the objects grows in scale
-void KDTree::CheckCollisions(vector<GameEntity*> objs, int numTotalObjs)
+int KDTree::CheckCollisions(const vector<GameEntity*>& objs, int numTotalObjs)
 {
-	vector<GameEntity*> nodeObjs;
 	int numObjs = 0;
-	for (size_t i = 0; i < 14; i++)
+	int merges = 0;
+	for (size_t n = 0; n < 14; n++)
 	{
-		nodeObjs = tree[i]->GetObjects();
-		numObjs = tree[i]->numObjs;
+		//a reference, so it sees the node refilled when the tree is rebuilt below
+		const vector<GameEntity*>& nodeObjs = tree[n]->GetObjects();
+		numObjs = tree[n]->numObjs;
 		if (numObjs > 0) {
 			
 			for (size_t i = 0; i < numObjs; i++)
@@ -158,9 +157,9 @@ void KDTree::CheckCollisions(vector<GameEntity*> objs, int numTotalObjs)
 
 						if (SAT(*nodeObjs[i], *nodeObjs[j])) {
 
-							if (nodeObjs[i]->orbital) {
-								float newMass = nodeObjs[i]->mass + nodeObjs[j]->mass;
-								glm::vec3 newVel = (nodeObjs[i]->mass*nodeObjs[i]->GetVelocity() + nodeObjs[j]->mass*nodeObjs[j]->GetVelocity()) / newMass;
+							if (nodeObjs[i]->IsOrbital()) {
+								float newMass = nodeObjs[i]->GetMass() + nodeObjs[j]->GetMass();
+								glm::vec3 newVel = (nodeObjs[i]->GetMass()*nodeObjs[i]->GetVelocity() + nodeObjs[j]->GetMass()*nodeObjs[j]->GetVelocity()) / newMass;
 
 								nodeObjs[j]->SetMass(newMass);
 								nodeObjs[j]->SetVelocity(newVel);
@@ -169,12 +168,12 @@ void KDTree::CheckCollisions(vector<GameEntity*> objs, int numTotalObjs)
 								}
 								nodeObjs[j]->AddScale(nodeObjs[i]->GetScale() / 4.f);
 
-								nodeObjs[i]->AddPosition(glm::vec3(1000.f, 1000.f, 1000.f));
-								nodeObjs[i]->enabled = false;
+								//retired from its pool after this pass
+								nodeObjs[i]->SetEnabled(false);
 							}
 							else {
-								float newMass = nodeObjs[i]->mass + nodeObjs[j]->mass;
-								glm::vec3 newVel = (nodeObjs[i]->mass*nodeObjs[i]->GetVelocity() + nodeObjs[j]->mass*nodeObjs[j]->GetVelocity()) / newMass;
+								float newMass = nodeObjs[i]->GetMass() + nodeObjs[j]->GetMass();
+								glm::vec3 newVel = (nodeObjs[i]->GetMass()*nodeObjs[i]->GetVelocity() + nodeObjs[j]->GetMass()*nodeObjs[j]->GetVelocity()) / newMass;
 
 								nodeObjs[i]->SetMass(newMass);
 								nodeObjs[i]->SetVelocity(newVel);
@@ -183,15 +182,12 @@ void KDTree::CheckCollisions(vector<GameEntity*> objs, int numTotalObjs)
 								}
 								nodeObjs[i]->AddScale(nodeObjs[j]->GetScale()/4.f);
 
-								nodeObjs[j]->AddPosition(glm::vec3(1000.f, 1000.f, 1000.f));
-								nodeObjs[j]->enabled = false;
+								//retired from its pool after this pass
+								nodeObjs[j]->SetEnabled(false);
 							}
 							UpdateTree(objs, numTotalObjs);
-							nodeObjs = tree[i]->GetObjects();
-							numObjs = tree[i]->numObjs;
-
-							explosion->setSoundVolume(.3f);
-							explosion->play2D("assets/Audio/explosion.mp3", GL_FALSE);
+							numObjs = tree[n]->numObjs;
+							merges++;
 						}
 					}
 
@@ -199,18 +195,20 @@ void KDTree::CheckCollisions(vector<GameEntity*> objs, int numTotalObjs)
 			}
 		}
 	}
-	
+	return merges;
 }
 
 //checks to see if there are any collisions
-bool KDTree::SAT(GameEntity a, GameEntity b)
+bool KDTree::SAT(GameEntity& a, GameEntity& b)
 {
-	std::vector<glm::vec3> aNormals = a.GetNormals();
-	std::vector<glm::vec3> bNormals = b.GetNormals();
+	glm::vec3 aNormals[3];
+	glm::vec3 bNormals[3];
+	a.GetNormals(aNormals);
+	b.GetNormals(bNormals);
 
 	bool notColliding = false;
 
-	for (int i = 0; i < aNormals.size(); i++)
+	for (int i = 0; i < 3; i++)
 	{
 		float aMin, aMax;
 		a.GetMinMax(aNormals[i], aMin, aMax);
@@ -224,7 +222,7 @@ bool KDTree::SAT(GameEntity a, GameEntity b)
 
 	if (!notColliding)
 	{
-		for (int i = 0; i < bNormals.size(); i++)
+		for (int i = 0; i < 3; i++)
 		{
 			float aMin, aMax;
 			a.GetMinMax(bNormals[i], aMin, aMax);
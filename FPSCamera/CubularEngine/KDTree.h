@@ -2,8 +2,6 @@
 #include <vector>
 #include "Node.h"
 #include "GameEntity.h"
-#include <irrKlang.h>
-using namespace irrklang;
 
 class KDTree
 {
@@ -16,13 +14,12 @@ public:
 
 	void PutInTree(GameEntity* obj);
 	void ClearObjsInTree();
-	void UpdateTree(vector<GameEntity*> objs, int numObjs);
+	void UpdateTree(const vector<GameEntity*>& objs, int numObjs);
 	bool CheckIfSameSpace(GameEntity* obj1, GameEntity* obj2);
-	void CheckCollisions(vector<GameEntity*> objs, int numObjs);
+	//returns how many bodies merged, the sound is up to whoever draws them
+	int CheckCollisions(const vector<GameEntity*>& objs, int numObjs);
 	GameEntity* center;
 
-	bool SAT(GameEntity a, GameEntity b);
-
-	ISoundEngine *explosion = createIrrKlangDevice();
+	bool SAT(GameEntity& a, GameEntity& b);
 };
 
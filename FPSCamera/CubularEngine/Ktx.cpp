@@ -0,0 +1,126 @@
+#include "Ktx.h"
+#include <fstream>
+#include <cstring>
+
+static const unsigned char Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const GLuint Endianness = 0x04030201;
+
+//the header right after the identifier
+struct KtxHeader
+{
+	GLuint endianness;
+	GLuint glType;
+	GLuint glTypeSize;
+	GLuint glFormat;
+	GLuint glInternalFormat;
+	GLuint glBaseInternalFormat;
+	GLuint pixelWidth;
+	GLuint pixelHeight;
+	GLuint pixelDepth;
+	GLuint numberOfArrayElements;
+	GLuint numberOfFaces;
+	GLuint numberOfMipmapLevels;
+	GLuint bytesOfKeyValueData;
+};
+
+bool Ktx::IsKtx(const char* bytes, size_t size)
+{
+	return size >= sizeof(Identifier) && memcmp(bytes, Identifier, sizeof(Identifier)) == 0;
+}
+
+bool Ktx::Parse(const char* bytes, size_t size, KtxImage& outImage)
+{
+	if (!IsKtx(bytes, size) || size < sizeof(Identifier) + sizeof(KtxHeader))
+	{
+		return false;
+	}
+
+	KtxHeader header;
+	memcpy(&header, bytes + sizeof(Identifier), sizeof(header));
+
+	//we only ever write little endian, compressed, single face 2D textures
+	if (header.endianness != Endianness || header.glType != 0 || header.pixelDepth > 1
+		|| header.numberOfArrayElements > 0 || header.numberOfFaces != 1)
+	{
+		return false;
+	}
+
+	size_t offset = sizeof(Identifier) + sizeof(KtxHeader) + header.bytesOfKeyValueData;
+	GLuint levelCount = header.numberOfMipmapLevels > 0 ? header.numberOfMipmapLevels : 1;
+
+	outImage.internalFormat = header.glInternalFormat;
+	outImage.baseFormat = header.glBaseInternalFormat;
+	outImage.width = (int)header.pixelWidth;
+	outImage.height = (int)header.pixelHeight;
+	outImage.levels.clear();
+	outImage.data.clear();
+
+	int width = outImage.width;
+	int height = outImage.height;
+	for (GLuint i = 0; i < levelCount; i++)
+	{
+		GLuint imageSize;
+		if (offset + sizeof(imageSize) > size)
+		{
+			return false;
+		}
+		memcpy(&imageSize, bytes + offset, sizeof(imageSize));
+		offset += sizeof(imageSize);
+		if (offset + imageSize > size)
+		{
+			return false;
+		}
+
+		KtxLevel level;
+		level.width = width;
+		level.height = height;
+		level.offset = outImage.data.size();
+		level.size = imageSize;
+		outImage.levels.push_back(level);
+		outImage.data.append(bytes + offset, imageSize);
+
+		//levels are padded to 4 bytes
+		offset += (imageSize + 3) & ~3u;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return true;
+}
+
+bool Ktx::Write(const std::string& path, const KtxImage& image)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.good())
+	{
+		return false;
+	}
+
+	KtxHeader header;
+	header.endianness = Endianness;
+	header.glType = 0;
+	header.glTypeSize = 1;
+	header.glFormat = 0;
+	header.glInternalFormat = image.internalFormat;
+	header.glBaseInternalFormat = image.baseFormat;
+	header.pixelWidth = (GLuint)image.width;
+	header.pixelHeight = (GLuint)image.height;
+	header.pixelDepth = 0;
+	header.numberOfArrayElements = 0;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = (GLuint)image.levels.size();
+	header.bytesOfKeyValueData = 0;
+
+	file.write((const char*)Identifier, sizeof(Identifier));
+	file.write((const char*)&header, sizeof(header));
+
+	static const char padding[3] = { 0, 0, 0 };
+	for (size_t i = 0; i < image.levels.size(); i++)
+	{
+		const KtxLevel& level = image.levels[i];
+		GLuint imageSize = (GLuint)level.size;
+		file.write((const char*)&imageSize, sizeof(imageSize));
+		file.write(image.data.data() + level.offset, level.size);
+		file.write(padding, ((imageSize + 3) & ~3u) - imageSize);
+	}
+	return file.good();
+}
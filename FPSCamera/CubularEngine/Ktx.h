@@ -0,0 +1,52 @@
+#pragma once
+#include "stdafx.h"
+#include <string>
+#include <vector>
+
+/// <summary>
+/// One mip level inside a KtxImage's data
+/// </summary>
+struct KtxLevel
+{
+	int width;
+	int height;
+	size_t offset;
+	size_t size;
+};
+
+/// <summary>
+/// A block compressed 2D texture with its whole mip chain
+/// </summary>
+struct KtxImage
+{
+	GLenum internalFormat;
+	GLenum baseFormat;
+	int width;
+	int height;
+	std::vector<KtxLevel> levels;
+	std::string data;   //every level back to back
+};
+
+/// <summary>
+/// Reads and writes the KTX 1.1 container, only the subset we bake:
+/// compressed, one face, no array layers, no key/value data.
+/// </summary>
+class Ktx
+{
+public:
+	/// <summary>
+	/// Whether a file starts with the KTX identifier
+	/// </summary>
+	static bool IsKtx(const char* bytes, size_t size);
+
+	/// <summary>
+	/// Parses a KTX file that's already in memory (the level data is copied out)
+	/// </summary>
+	/// <returns>False if it isn't a KTX file we can use</returns>
+	static bool Parse(const char* bytes, size_t size, KtxImage& outImage);
+
+	/// <summary>
+	/// Writes an image to disk as KTX
+	/// </summary>
+	static bool Write(const std::string& path, const KtxImage& image);
+};
@@ -42,12 +42,33 @@
 #include "KDTree.h"
 #include "stb_image.h"
 #include "DynamicShader.h"
+#include "ImpostorRenderer.h"
+#include "StreamingBuffer.h"
+#include "TrailRenderer.h"
+#include "TextureManager.h"
+#include "AssetLoader.h"
+#include "TextureBaker.h"
+#include "ProgramCache.h"
+#include "ShaderVariantBuilder.h"
+#include "AssetPack.h"
+#include "PackFileFactory.h"
+#include "Scene.h"
+#include "EntityPool.h"
+#include "EntitySystems.h"
+#include "JobSystem.h"
+#include "Simulation.h"
+#include "SimRecorder.h"
+#include "RewindBuffer.h"
+#include "FrameArena.h"
+#include "MemoryTracker.h"
+#include "SceneGenerator.h"
 
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <filesystem>
 #include <iostream>
+#include <cstdio>
 #include <glm/gtc/quaternion.hpp>
 
 #include <irrKlang.h>
@@ -70,45 +91,80 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 	xposCam = xpos;
 	yposCam = ypos;
 }
-//function to load skybox, takes in vector of different image values
-unsigned int loadSkybox(std::vector<std::string> faces) {
-
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-	int width, height, nrChannels;
-	//loads each face png of the cube map
-	for (unsigned int i = 0; i < faces.size(); i++)
-	{
-		unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-		if (data)
-		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-				0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
-			);
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-			stbi_image_free(data);
-		}
-	}
-	//creates texture ID along with the image values
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-	return textureID;
-}
-
-
-int main()
+int main(int argc, char* argv[])
 {
+    int exitCode = 0;
     {
+        AssetLoader* assetLoader = AssetLoader::GetInstance();
+
+        //offline steps: compress every image under assets/ to .ktx, and --cook also converts
+        //the scenes to binary and bundles the whole folder (bakes included) into one pack, then quit
+        if (argc > 1 && (std::string(argv[1]) == "--bake-textures" || std::string(argv[1]) == "--cook"))
+        {
+            int failed = TextureBaker::BakeDirectory("assets");
+            if (std::string(argv[1]) == "--cook")
+            {
+                failed += SceneFile::CookDirectory("assets");
+                if (!AssetPack::Cook("assets", "assets.pak"))
+                {
+                    failed++;
+                }
+            }
+            AssetLoader::Release();
+            AssetPack::Release();
+            return failed == 0 ? 0 : 1;
+        }
+
+        //--generate disk|plummer|clusters|cube [count] [seed] swaps the scene's bodies for a
+        //generated stress test, the same count & seed always give the same bodies
+        GeneratorKind generatorKind = GeneratorKind::UniformCube;
+        GeneratorSettings generatorSettings;
+        bool generate = argc > 2 && std::string(argv[1]) == "--generate" && SceneGenerator::ParseKind(argv[2], generatorKind);
+        if (generate)
+        {
+            generatorSettings.count = argc > 3 ? (size_t)strtoull(argv[3], nullptr, 10) : 10000;
+            generatorSettings.seed = argc > 4 ? strtoull(argv[4], nullptr, 10) : 1;
+        }
+
+        //--verify-determinism [steps] runs the bodies from the start with one job thread and with
+        //all of them, and quits with 1 if they don't end up bitwise the same (replays would drift)
+        bool verifyDeterminism = argc > 1 && std::string(argv[1]) == "--verify-determinism";
+        unsigned int verifySteps = argc > 2 && verifyDeterminism ? (unsigned int)strtoul(argv[2], nullptr, 10) : 600;
+
+        //--record file saves every game session (from pressing 2 until leaving it) for --replay file
+        //to step again as fast as it can, without showing the window, e.g. as a repeatable benchmark
+        std::string recordPath = argc > 2 && std::string(argv[1]) == "--record" ? argv[2] : "";
+        std::string replayPath = argc > 2 && std::string(argv[1]) == "--replay" ? argv[2] : "";
+        bool headless = verifyDeterminism || !replayPath.empty();
+
+        //--load file (after any of the above) starts the bodies from a state saved with F5 instead of the scene's,
+        //--rewind-mb N keeps N MB of history to seek back through with [ and ] while paused
+        std::string loadPath;
+        size_t rewindBytes = RewindBuffer::DefaultMaxBytes;
+        for (int a = 1; a + 1 < argc; a++)
+        {
+            if (std::string(argv[a]) == "--load")
+            {
+                loadPath = argv[a + 1];
+            }
+            if (std::string(argv[a]) == "--rewind-mb")
+            {
+                rewindBytes = (size_t)strtoull(argv[a + 1], nullptr, 10) * 1024 * 1024;
+            }
+        }
+
+        //everything below reads through the pack when there is one, loose files otherwise
+        AssetPack::GetInstance()->Mount("assets.pak");
+
+        //start reading the shaders on the workers while the window & context get made
+        ShaderVariantBuilder* shaderVariants = ShaderVariantBuilder::GetInstance();
+        shaderVariants->Prefetch({
+            "assets/shaders/vertexShader.glsl",
+            "assets/shaders/surfaceFragment.glsl",
+            "assets/shaders/lighting.glsl" });
+        std::future<std::string> skyboxVertexSource = assetLoader->ReadFileAsync("assets/shaders/skyboxVertex.glsl");
+        std::future<std::string> skyboxFragmentSource = assetLoader->ReadFileAsync("assets/shaders/skyboxFragment.glsl");
+
         //init GLFW
         {
             if (glfwInit() == GLFW_FALSE)
@@ -128,6 +184,11 @@ int main()
         //create & init window, set viewport
         int width = 1600;
         int height = 1200;
+        if (headless)
+        {
+            //the meshes still need a context, but nobody needs to see it
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        }
         GLFWwindow* window = glfwCreateWindow(width, height, "FPS Camera", nullptr, nullptr);
         {
             if (window == nullptr)
@@ -174,140 +235,18 @@ int main()
         std::cout << "GLEW successfully initialized!" << std::endl;
 #endif // _DEBUG
 
-        //init the shader program
-        //TODO - this seems like a better job for a shader manager
-        //       perhaps the Shader class can be refactored to fit a shader program
-        //       rather than be a thing for vs and fs
-        GLuint shaderProgram = glCreateProgram();
-        {
-
-            //create vS and attach to shader program
-            Shader *vs = new Shader();
-            vs->InitFromFile("assets/shaders/vertexShader.glsl", GL_VERTEX_SHADER);
-            glAttachShader(shaderProgram, vs->GetShaderLoc());
-
-            //create FS and attach to shader program
-            Shader *fs = new Shader();
-            fs->InitFromFile("assets/shaders/fragmentShader.glsl", GL_FRAGMENT_SHADER);
-            glAttachShader(shaderProgram, fs->GetShaderLoc());
-
-            //link everything that's attached together
-            glLinkProgram(shaderProgram);
-
-            GLint isLinked;
-            glGetProgramiv(shaderProgram, GL_LINK_STATUS, &isLinked);
-            if (!isLinked)
-            {
-                char infolog[1024];
-                glGetProgramInfoLog(shaderProgram, 1024, NULL, infolog);
-#ifdef _DEBUG
-                std::cout << "Shader Program linking failed with error: " << infolog << std::endl;
-                std::cin.get();
-#endif
+        //start the two surface variants the materials use, from the program cache if this
+        //driver has built them before. the driver may compile them in the background, they're
+        //only waited on right before the meshes need them, after the skybox loads are kicked off
 
-                // Delete the shader, and set the index to zero so that this object knows it doesn't have a shader.
-                glDeleteProgram(shaderProgram);
-                glfwTerminate();
-                _CrtDumpMemoryLeaks();
-                return 1;
-            }
+        //flat white for the sun
+        GLuint shaderProgram = shaderVariants->GetProgram("assets/shaders/vertexShader.glsl", "assets/shaders/surfaceFragment.glsl", {});
 
-            //everything's in the program, we don't need this
-            delete fs;
-            delete vs;
-        }
-
-		GLuint lightShaderProgram = glCreateProgram();
-		{
+        //same vertex shader, lit for the planets
+        GLuint lightShaderProgram = shaderVariants->GetProgram("assets/shaders/vertexShader.glsl", "assets/shaders/surfaceFragment.glsl", { "LIT", "SPECULAR" });
 
-			//same vertex shader as the cube, but the fragment shader will be different to produce a light
-			Shader *lightVertex = new Shader();
-			lightVertex->InitFromFile("assets/shaders/vertexShader.glsl", GL_VERTEX_SHADER);
-			glAttachShader(lightShaderProgram, lightVertex->GetShaderLoc());
-
-			//Different shader from the regular box shader
-			Shader *lightFragment = new Shader();
-			lightFragment->InitFromFile("assets/shaders/lightShader.glsl", GL_FRAGMENT_SHADER);
-			glAttachShader(lightShaderProgram, lightFragment->GetShaderLoc());
-
-			//link everything that's attached together
-			glLinkProgram(lightShaderProgram);
-
-			GLint isLinked;
-			glGetProgramiv(lightShaderProgram, GL_LINK_STATUS, &isLinked);
-			if (!isLinked)
-			{
-				char infolog[1024];
-				glGetProgramInfoLog(lightShaderProgram, 1024, NULL, infolog);
-#ifdef _DEBUG
-				std::cout << "Light Shader Program linking failed with error: " << infolog << std::endl;
-				std::cin.get();
-#endif
-
-				// Delete the shader, and set the index to zero so that this object knows it doesn't have a shader.
-				glDeleteProgram(lightShaderProgram);
-				glfwTerminate();
-				_CrtDumpMemoryLeaks();
-				return 1;
-			}
-
-			//everything's in the program, we don't need this
-			delete lightFragment;
-			delete lightVertex;
-		}
-
-#ifdef _DEBUG
-        std::cout << "Shaders compiled attached, and linked!" << std::endl;
-#endif // _DEBUG
-		//position of the light to use for angle calculations
-		glm::vec3 lightPosition = glm::vec3(0.f, 25.f, -5.f);
-        //init the mesh (the cubes)
-        //TODO - replace this with model loading
-		GLfloat vertices[] = {
-			-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-			0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-			0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-			0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-			-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-			-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-
-			-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-			0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-			0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-			0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-			-0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-			-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-
-			-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-			-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-			-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-			-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-			-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-			-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-
-			0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-			0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-			0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-			0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-			0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-			0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-
-			-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-			0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-			0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-			0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-			-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-			-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-
-			-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-			0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-			0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-			0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-			-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-			-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f
-		};
 		//passes shaders to properly display the skybox
-		DynamicShader skyboxShader("assets/shaders/skyboxVertex.glsl", "assets/shaders/skyboxFragment.glsl");
+		DynamicShader skyboxShader = DynamicShader::FromSource(skyboxVertexSource.get(), skyboxFragmentSource.get());
 		//position of the skybox vertices, basically just a cube
 		float skyboxVertices[] = {
 			// positions          
@@ -361,6 +300,8 @@ int main()
 		glBindVertexArray(skyboxVAO);
 		glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+		MemoryTracker::TrackGpu(GpuResource::VertexArray, skyboxVAO, 0, MemoryTag::Render);
+		MemoryTracker::TrackGpu(GpuResource::Buffer, skyboxVBO, sizeof(skyboxVertices), MemoryTag::Render);
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 		//face data for game
@@ -395,84 +336,38 @@ int main()
 		};
 		
 
-		unsigned int cubemapTexture = loadSkybox(mainFaces);
-		//cube1
-		float cube1X = 0.0f;
-		float cube1Y = 0.0f;
-		GLfloat cube1Vertices[] = {
-			-1.0f,-1.0f ,-1.0f, // triangle 1 : begin
-			-1.0f,-1.0f , 1.0f,
-			-1.0f, 1.0f , 1.0f, // triangle 1 : end
-			1.0f, 1.0f ,-1.0f, // triangle 2 : begin
-			-1.0f,-1.0f ,-1.0f,
-			-1.0f, 1.0f ,-1.0f, // triangle 2 : end
-			1.0f,-1.0f , 1.0f,
-			-1.0f,-1.0f ,-1.0f,
-			1.0f,-1.0f ,-1.0f,
-			1.0f, 1.0f ,-1.0f,
-			1.0f,-1.0f ,-1.0f,
-			-1.0f,-1.0f ,-1.0f,
-			-1.0f,-1.0f ,-1.0f,
-			-1.0f, 1.0f, 1.0f,
-			-1.0f, 1.0f,-1.0f,
-			1.0f,-1.0f, 1.0f,
-			-1.0f,-1.0f, 1.0f,
-			-1.0f,-1.0f,-1.0f,
-			-1.0f, 1.0f, 1.0f,
-			-1.0f,-1.0f, 1.0f,
-			1.0f,-1.0f, 1.0f,
-			1.0f, 1.0f, 1.0f,
-			1.0f,-1.0f,-1.0f,
-			1.0f, 1.0f,-1.0f,
-			1.0f,-1.0f,-1.0f,
-			1.0f, 1.0f, 1.0f,
-			1.0f,-1.0f, 1.0f,
-			1.0f, 1.0f, 1.0f,
-			1.0f, 1.0f,-1.0f,
-			-1.0f, 1.0f,-1.0f,
-			1.0f, 1.0f, 1.0f,
-			-1.0f, 1.0f,-1.0f,
-			-1.0f, 1.0f, 1.0f,
-			1.0f, 1.0f, 1.0f,
-			-1.0f, 1.0f, 1.0f,
-			1.0f,-1.0f, 1.0f
+		//load all three skyboxes in the background, menu first since that's what shows first.
+		//the faces get decoded on the workers and uploaded a bit each frame, so the first
+		//frame doesn't wait on them and switching scenes afterwards is just picking a texture
+		TextureManager* textureManager = TextureManager::GetInstance();
+		int skyboxesLoading = 3;
+		auto onSkyboxLoaded = [&skyboxesLoading, textureManager](TextureHandle) {
+			//once they're all on the GPU the decoded pixels aren't needed
+			if (--skyboxesLoading == 0)
+			{
+				textureManager->TrimImageCache();
+			}
 		};
+		TextureHandle menuSkybox = textureManager->LoadCubemapAsync(mainFaces, onSkyboxLoaded);
+		TextureHandle gameSkybox = textureManager->LoadCubemapAsync(faces, onSkyboxLoaded);
+		TextureHandle creditsSkybox = textureManager->LoadCubemapAsync(creditsFaces, onSkyboxLoaded);
 
+		//looked up when drawing, it stays black until its upload is done
+		TextureHandle skybox = menuSkybox;
 
-		//cube2
-		float cube2X = 0.1f;
-		float cube2Y = 0.1f;
-
-
-		//cube3
-		float cube3X = 1.0f;
-		float cube3Y = 7.0f;
-
-
-		//cube4
-		float cube4X = -4.0f;
-		float cube4Y = 6.0f;
-
-
-		//cube5
-		float cube5X = 3.0f;
-		float cube5Y = -6.0f;
-
-
-		//cube6
-		float cube6X = -7.5f;
-		float cube6Y = 8.0f;
-
-
-		//cube7
-		float cube7X = 0.0f;
-		float cube7Y = -5.0f;
-
-
-		//cube8
-		float cube8X = -6.0f;
-		float cube8Y = -9.0f;
-
+		//the meshes look up attributes in the programs, so they have to be linked by now
+		if (!shaderVariants->FinishAll())
+		{
+#ifdef _DEBUG
+			std::cin.get();
+#endif
+			glfwTerminate();
+			_CrtDumpMemoryLeaks();
+			return 1;
+		}
+#ifdef _DEBUG
+        std::cout << "Shaders compiled attached, and linked!" << std::endl;
+#endif // _DEBUG
 		//TODO - maybe a CameraManager?
 		Camera* myCamera = new Camera(
 			glm::vec3(0.0f, 0.0f, -30.f),    //position of camera
@@ -508,148 +403,85 @@ int main()
 			1000.f                           //the far Z-plane
 		);
 
-		Mesh* cube1Mesh = new Mesh();
-		cube1Mesh->InitWithVertexArray(vertices, _countof(vertices), lightShaderProgram);
-		//vec3's to pass to the lighted object shader, so that they can represent light correctly
-		glm::vec3 lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
-		glm::vec3 objectColor = glm::vec3(1.0f, 0.5f, 0.31f);
-		glm::vec3 ambientColor = glm::vec3(.5f, 0.5f, .8f);
-		Material* myMaterial = new Material(lightShaderProgram, lightColor, objectColor, lightPosition, myCamera->position, ambientColor, glm::vec3(1.0f, 0.5f, .31f), glm::vec3(0.5f, 0.5f, 0.5f), 64.0f);
-		Mesh* lightMesh = new Mesh();
-		lightMesh->InitWithVertexArray(vertices, _countof(vertices), shaderProgram);
-		Material* lightMaterial = new Material(shaderProgram, lightColor, objectColor);
-
-        //TODO - maybe a GameEntityManager?
-		//Initialize all the cubes
-        GameEntity* cube1 = new GameEntity(
-            lightMesh,
-            lightMaterial,
-            glm::vec3(0.1f, 0.1f, 0.1f),
-            glm::vec3(0.f, 0.f, 0.f),
-            glm::vec3(1.f, 1.f, 1.f)
-        );
-
-		GameEntity* cube2 = new GameEntity(
-			cube1Mesh,
-			myMaterial,
-			glm::vec3(8.0f, 0.f, 0.f),
-			glm::vec3(0.f, 0.f, 0.f),
-			glm::vec3(.5f, .5f, .5f)
-		);
-
-		GameEntity* cube3 = new GameEntity(
-			cube1Mesh,
-			myMaterial,
-			glm::vec3(2.f, 0.f, 0.f),
-			glm::vec3(0.f, 0.f, 0.f),
-			glm::vec3(.5f, .5f, .5f)
-		);
-
-		GameEntity* cube4 = new GameEntity(
-			cube1Mesh,
-			myMaterial,
-			glm::vec3(16.f, 0.f, 0.f),
-			glm::vec3(0.f, 0.f, 0.f),
-			glm::vec3(.5f, .5f, .5f)
-		);
-
-		GameEntity* cube5 = new GameEntity(
-			cube1Mesh,
-			myMaterial,
-			glm::vec3(12.f, 1.f, 0.f),
-			glm::vec3(0.f, 0.f, 0.f),
-			glm::vec3(.5f, .5f, .5f)
-		);
-
-		GameEntity* cube6 = new GameEntity(
-			cube1Mesh,
-			myMaterial,
-			glm::vec3(20.f, -2.f, 0.f),
-			glm::vec3(0.f, 0.f, 0.f),
-			glm::vec3(.5f, .5f, .5f)
-		);
-
-		GameEntity* cube7 = new GameEntity(
-			cube1Mesh,
-			myMaterial,
-			glm::vec3(cube7X, cube7Y, -6.f),
-			glm::vec3(0.f, 0.f, 0.f),
-			glm::vec3(.5f, .5f, .5f)
-		);
-
-		GameEntity* cube8 = new GameEntity(
-			cube1Mesh,
-			myMaterial,
-			glm::vec3(cube8X, cube8Y, 8.f),
-			glm::vec3(0.f, 0.f, 0.f),
-			glm::vec3(.5f, .5f, .5f)
-		);
-
-		GameEntity* cube9 = new GameEntity(
-			cube1Mesh,
-			myMaterial,
-			glm::vec3(5.0f, 3.0 ,6.0f),
-			glm::vec3(0.f, 0.f, 0.f),
-			glm::vec3(.5f, .5f, .5f)
-		);
-
-		GameEntity* cube10 = new GameEntity(
-			cube1Mesh,
-			myMaterial,
-			glm::vec3(-8.0f, 13.0f, -4.0f),
-			glm::vec3(0.f, 0.f, 0.f),
-			glm::vec3(.5f, .5f, .5f)
-		);
-
-		GameEntity* menuBox = new GameEntity(
-			cube1Mesh,
-			myMaterial,
-			glm::vec3(-300.0f, 0.0f, 0.0f),
-			glm::vec3(0.f, 0.f, 0.f),
-			glm::vec3(1.f, 1.f, 1.f)
-		);
-		GameEntity* creditsBox = new GameEntity(
-			cube1Mesh,
-			myMaterial,
-			glm::vec3(300.0f, 0.0f, 0.0f),
-			glm::vec3(0.f, 0.f, 0.f),
-			glm::vec3(1.f, 1.f, 1.f)
-		);
+		//per-frame vertex data (impostor instances, trails) all goes through one ring buffer
+		StreamingBuffer* streamingBuffer = new StreamingBuffer(GL_ARRAY_BUFFER, 4 * 1024 * 1024);
+
+		//anything only a few pixels big gets drawn in one instanced call
+		ImpostorRenderer* impostors = new ImpostorRenderer(streamingBuffer);
+
+		//the last 128 positions of every body, drawn as fading lines
+		TrailRenderer* trails = new TrailRenderer(streamingBuffer, 128);
+
+		//the bodies, their starting velocities and the menu/credits boxes all come from the scene file
+		//(or its binary form, after the first run). the programs are the ones the file can name
+		Scene* scene = new Scene();
+		scene->RegisterProgram("flat", shaderProgram);
+		scene->RegisterProgram("lit", lightShaderProgram);
+		//the bodies live in their own pool, clicking spawns into it and merged bodies are retired from it
+		EntityPool* bodies = new EntityPool(IsSimulated);
+		scene->BindGroup("bodies", bodies);
+		const vector<GameEntity*>& cubes = bodies->GetActive();
+		vector<GameEntity*> menuBoxes;
+		Mesh* cube1Mesh = nullptr;
+		Mesh* planetMesh = nullptr;
+		Material* myMaterial = nullptr;
+		MemoryTag previousTag = MemoryTracker::SetThreadTag(MemoryTag::Assets);
+		SceneData sceneData;
+		bool sceneLoaded = SceneFile::Load("assets/scenes/solar.scene", sceneData);
+		if (sceneLoaded && generate)
+		{
+			generatorSettings.mesh = (unsigned int)std::max(sceneData.FindMesh("cube"), 0);
+			generatorSettings.material = (unsigned int)std::max(sceneData.FindMaterial("lit"), 0);
+			SceneGenerator::ReplaceGroup(sceneData, "bodies", generatorKind, generatorSettings);
+		}
+		if (sceneLoaded && scene->Instantiate(sceneData))
+		{
+			menuBoxes = scene->GetGroup("menu");
+			cube1Mesh = scene->GetMesh("cube");
+			planetMesh = scene->GetMesh("planet");
+			myMaterial = scene->GetMaterial("lit");
+		}
+		MemoryTracker::SetThreadTag(previousTag);
 
-        
-
-		vector<GameEntity*> cubes;
-		cubes.push_back(cube1);
-		cubes.push_back(cube2);
-		cubes.push_back(cube3);
-		cubes.push_back(cube4);
-		cubes.push_back(cube5);
-		cubes.push_back(cube6);
-		cubes.push_back(cube7);
-		cubes.push_back(cube8);
-		cubes.push_back(cube9);
-		cubes.push_back(cube10);
-
-		cubes[0]->orbital = false;
-		cubes[0]->SetMass(10.f);
-
-		cubes[1]->AddVelocity(glm::vec3(0.f, 1.0f, 4.0f));
-		cubes[2]->AddVelocity(glm::vec3(0.f, 0.f, 2.0f));
-		cubes[3]->AddVelocity(glm::vec3(0.f, 0.f, 8.0f));
-		cubes[4]->AddVelocity(glm::vec3(0.f, 0.f, 6.0f));
-		cubes[5]->AddVelocity(glm::vec3(0.f, 0.f, 10.0f));
-		cubes[6]->AddVelocity(glm::vec3(0.f, 0.f, 5.0f));
-		cubes[7]->AddVelocity(glm::vec3(0.f, 0.f, 4.0f));
-		cubes[8]->AddVelocity(glm::vec3(0.f, 0.f, 5.0f));
-		cubes[9]->AddVelocity(glm::vec3(0.f, 0.f, 4.0f));
-
-		for (size_t i = 0; i < cubes.size(); i++)
+		//without them there's nothing to run, skip straight to the teardown below
+		bool sceneReady = !cubes.empty() && !menuBoxes.empty() && cube1Mesh != nullptr && planetMesh != nullptr && myMaterial != nullptr;
+		if (!sceneReady)
 		{
-			cubes[i]->startVel = cubes[i]->GetVelocity();
+			std::cout << "The scene is missing its bodies, menu box, cube/planet meshes or lit material" << std::endl;
+#ifdef _DEBUG
+			std::cin.get();
+#endif
+			exitCode = 1;
 		}
+		GameEntity* menuBox = sceneReady ? menuBoxes[0] : nullptr;
 
 		KDTree* tree = new KDTree();
-		tree->center = cubes[0];
+		tree->center = sceneReady ? cubes[0] : nullptr;
+
+		//the bodies step on their own thread at a fixed 60Hz, this thread draws whatever they last published
+		Simulation* simulation = new Simulation(scene, "bodies", bodies, tree, 1.0f / 60.0f);
+		simulation->SetRecordPath(recordPath);
+		simulation->SetSavePath("simulation.state");
+		simulation->SetStartState(loadPath);
+		simulation->SetRewindLimits(rewindBytes, RewindBuffer::DefaultKeyframeInterval);
+		if (sceneReady && verifyDeterminism)
+		{
+			exitCode = simulation->VerifyDeterminism(verifySteps, std::cout) ? 0 : 1;
+		}
+		if (sceneReady && !replayPath.empty())
+		{
+			SimRecording recording;
+			if (SimRecorder::Load(replayPath, scene, recording))
+			{
+				MemoryScope physicsMemory(MemoryTag::Physics);
+				exitCode = simulation->Replay(recording, std::cout) ? 0 : 1;
+			}
+			else
+			{
+				std::cout << "Can't read the recording " << replayPath << std::endl;
+				exitCode = 1;
+			}
+		}
 
         Input::GetInstance()->Init(window);
 
@@ -660,9 +492,9 @@ int main()
 		yposCam = 300;
 
 		tm = 0.0f;
-		glm::vec3 gamePos = glm::vec3(0.0f, 0.0f, -30.f);
-		glm::vec3 menuPos = glm::vec3(-300.f, 0.f, -10.f);
-		glm::vec3 creditsPos = glm::vec3(300.f, 0.f, -10.f);
+		glm::vec3 gamePos = scene->GetCameraPosition("game", glm::vec3(0.0f, 0.0f, -30.f));
+		glm::vec3 menuPos = scene->GetCameraPosition("menu", glm::vec3(-300.f, 0.f, -10.f));
+		glm::vec3 creditsPos = scene->GetCameraPosition("credits", glm::vec3(300.f, 0.f, -10.f));
 
 		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 		glfwSetCursorPosCallback(window, mouse_callback);
@@ -679,61 +511,137 @@ int main()
 		skyboxShader.setInt("skybox", 0);
 
 		//audio player
-		ISoundEngine *music = createIrrKlangDevice();
-		music->play2D("assets/Audio/bensound-relaxing.mp3", GL_TRUE);
-		music->setSoundVolume(.3f);
+		ISoundEngine *music;
+		ISoundEngine *explosion;
+		{
+			MemoryScope audioMemory(MemoryTag::Audio);
+			music = createIrrKlangDevice();
+			PackFileFactory::Install(music);
+			music->play2D("assets/Audio/bensound-relaxing.mp3", GL_TRUE);
+			music->setSoundVolume(.3f);
+
+			//the merges the simulation reports, played from here since irrKlang isn't for the job workers
+			explosion = createIrrKlangDevice();
+			PackFileFactory::Install(explosion);
+			explosion->setSoundVolume(.3f);
+		}
+		unsigned long long lastMerges = 0;
+		bool firstF1Press = true;
+
+		bool firstF2Press = true;
+		bool firstTwoPress = true;
+		bool firstF5Press = true;
+		bool firstSeekPress = true;
+
+		//the heap allocation count goes in the window title once a second
+		double statsTime = 0.0;
+
+		float dt = 0.0f;
+
+		//simulation steps at the last title update, for the steps per second
+		unsigned long long statsSteps = 0;
 
         //main loop
-        while (!glfwWindowShouldClose(window))
+        while (sceneReady && !headless && !glfwWindowShouldClose(window))
         {
 			prevTime = tm;
 			tm = glfwGetTime();
 
-			float dt = tm - prevTime;
+			dt = tm - prevTime;
+
+			//last frame's scratch is done with
+			FrameArena::GetInstance()->Reset();
+			MemoryTracker::BeginFrame();
+			if (tm - statsTime >= 1.0)
+			{
+				statsTime = tm;
+				unsigned long long steps = simulation->GetStepCount();
+				char title[160];
+				snprintf(title, sizeof(title), "FPS Camera - %zu heap allocations/frame, frame arena %zu/%zu KB, %llu steps/s",
+					MemoryTracker::GetTotal().frameAllocations, FrameArena::GetInstance()->GetHighWater() / 1024,
+					FrameArena::GetInstance()->GetCapacity() / 1024, steps - statsSteps);
+				statsSteps = steps;
+				glfwSetWindowTitle(window, title);
+			}
             /* INPUT */
             
                 //checks events to see if there are pending input
                 glfwPollEvents();
 
+                //move on to the streaming region the GPU is done with
+                streamingBuffer->BeginFrame();
+
+                //finish off whatever the loading workers have ready, a couple of ms at most
+                {
+                    MemoryScope assetMemory(MemoryTag::Assets);
+                    assetLoader->Update(2.0);
+                }
+
                 //breaks out of the loop if user presses ESC
                 if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
                 {
                     break;
                 }
+				if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS) //prints where the memory is
+				{
+					if (firstF1Press) {
+						firstF1Press = false;
+						MemoryTracker::Report(std::cout, false);
+					}
+				}
+				else {
+					firstF1Press = true;
+				}
+				if (glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS) //prints how the last simulation step's tasks ran (and writes framegraph.json for chrome://tracing)
+				{
+					if (firstF2Press) {
+						firstF2Press = false;
+						simulation->PrintFrameGraph();
+					}
+				}
+				else {
+					firstF2Press = true;
+				}
 				if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) //switches to the menu
 				{
+					//the menu box is drawn from the world directly, which the simulation can't be stepping
+					simulation->Stop();
 					menu = true;
 					game = false;
 					credits = false;
 					myCamera->position = menuPos;
-					cubemapTexture = loadSkybox(mainFaces);
+					skybox = menuSkybox;
 				}
 				if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) //switches to the game
 				{
-					menu = false;
-					game = true;
-					credits = false;
-					myCamera->position = gamePos;
-					cubemapTexture = loadSkybox(faces);
-					for (size_t i = 0; i < cubes.size(); i++)
-					{
-						if (i < 10) {
-							cubes[i]->Reset();
-						}
-						else {
-							cubes[i]->enabled = false;
-						}
+					//once per press, restarting respawns the whole group (and the recording)
+					if (firstTwoPress) {
+						firstTwoPress = false;
+						menu = false;
+						game = true;
+						credits = false;
+						myCamera->position = gamePos;
+						skybox = gameSkybox;
+						simulation->Stop();
+						simulation->ResetBodies();
+						myCamera->Reset();
+						trails->ClearAll();
+						lastMerges = 0;
+						playing = true;
+						simulation->Start(playing);
 					}
-					myCamera->Reset();
-					playing = true;
+				}
+				else {
+					firstTwoPress = true;
 				}
 				if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) //switches to the credits
 				{
+					simulation->Stop();
 					menu = false;
 					game = false;
 					credits = true;
 					myCamera->position = menuPos;
-					cubemapTexture = loadSkybox(creditsFaces);
+					skybox = creditsSkybox;
 				}
 				
 				if (game) 
@@ -743,22 +651,44 @@ int main()
 						if (firstPPress) {
 							firstPPress = false;
 							playing = !playing;
+							simulation->SetPlaying(playing);
 						}
 					}
 					else {
 						firstPPress = true;
 					}
-					if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) //resets the game
+					if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS) //saves the bodies, for --load
 					{
-						for (size_t i = 0; i < cubes.size(); i++)
-						{
-							if (i < 10) {
-								cubes[i]->Reset();
-							}
-							else {
-								cubes[i]->enabled = false;
+						if (firstF5Press) {
+							firstF5Press = false;
+							simulation->SaveState();
+						}
+					}
+					else {
+						firstF5Press = true;
+					}
+					//half a second back or forward through the history, only while paused
+					bool seekBack = glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS;
+					bool seekForward = glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS;
+					if (!playing && (seekBack || seekForward))
+					{
+						if (firstSeekPress) {
+							firstSeekPress = false;
+							const SimSnapshot& snapshot = simulation->GetSnapshot();
+							unsigned long long target = snapshot.tick + 30;
+							if (seekBack) {
+								target = std::max(snapshot.tick, snapshot.oldestTick + 30) - 30;
 							}
+							simulation->Seek(target);
 						}
+					}
+					else {
+						firstSeekPress = true;
+					}
+					if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) //resets the game
+					{
+						//the trails of the old bodies go when the new ones are published
+						simulation->Reset();
 						myCamera->Reset();
 					}
 
@@ -766,9 +696,8 @@ int main()
 					{
 						if (firstLeftClick) {
 							firstLeftClick = false;
-							cubes.push_back(new GameEntity(cube1Mesh, myMaterial, myCamera->GetPos(), glm::vec3(0.f, 0.f, 0.f),
-								glm::vec3(.5f, .5f, .5f)));
-							cubes.back()->AddVelocity(myCamera->forward*instantiateSpeed);
+							simulation->Spawn(cube1Mesh, myMaterial, myCamera->GetPos(), myCamera->forward*instantiateSpeed,
+								glm::vec3(.5f, .5f, .5f), 1.f, true);
 						}
 					}
 					else {
@@ -779,11 +708,8 @@ int main()
 					{
 						if (firstRightClick) {
 							firstRightClick = false;
-							cubes.push_back(new GameEntity(cube1Mesh, myMaterial, myCamera->GetPos(), glm::vec3(0.f, 0.f, 0.f),
-								glm::vec3(1.f, 1.f, 1.f)));
-							cubes.back()->AddVelocity(myCamera->forward*instantiateSpeed*2.f);
-							cubes.back()->orbital = false;
-							cubes.back()->SetMass(5.f);
+							simulation->Spawn(planetMesh, myMaterial, myCamera->GetPos(), myCamera->forward*instantiateSpeed*2.f,
+								glm::vec3(1.f, 1.f, 1.f), 5.f, false);
 						}
 					}
 					else {
@@ -792,46 +718,27 @@ int main()
 
 					/* GAMEPLAY UPDATE */
 					if (playing) {
+						myCamera->Update();
+						myCamera->UpdateRotation(xposCam, yposCam);
+					}
 
-						for (size_t i = 0; i < cubes.size(); i++)
-						{
-							cubes[i]->CalculateBox();
-						}
-
-						tree->UpdateTree(cubes, cubes.size());
-
-						tree->CheckCollisions(cubes, cubes.size());
-
-						for (size_t i = 0; i < cubes.size(); i++)
-						{
-							glm::vec3 acc = glm::vec3(0.f, 0.f, 0.f);
-							for (size_t j = 0; j < cubes.size(); j++)
-							{
-								if (i != j) {
-									if (!cubes[j]->orbital) {
-										glm::vec3 dir = glm::normalize(cubes[j]->GetPos() - cubes[i]->GetPos());
-										float vel = glm::length(cubes[i]->GetVelocity());
-										if (vel == 0) {
-											vel = .2f;
-										}
-										//float centAcc = vel / glm::distance(cubes[0]->GetPos(), cubes[1]->GetPos());
-										acc += dir * vel;
-									}
-								}
-							}
-							cubes[i]->SetAcceleration(acc);
+					//the trails only move when the simulation has stepped, not every frame
+					if (simulation->AcquireSnapshot()) {
+						const SimSnapshot& snapshot = simulation->GetSnapshot();
+						if (snapshot.merges > lastMerges) {
+							explosion->play2D("assets/Audio/explosion.mp3", GL_FALSE);
 						}
-
-						for (size_t i = 0; i < cubes.size(); i++)
+						lastMerges = snapshot.merges;
+						trails->BeginUpdate();
+						for (size_t i = 0; i < snapshot.bodies.size(); i++)
 						{
-							cubes[i]->Update(dt);
+							//trails are kept by pool slot, the handle tells a new body in an old slot apart
+							const BodyState& body = snapshot.bodies[i];
+							unsigned long long owner = ((unsigned long long)body.handle.generation << 32) | body.handle.index;
+							trails->Record(body.slot, owner, body.position);
 						}
-
-
-						myCamera->Update();
-						myCamera->UpdateRotation(xposCam, yposCam);
+						trails->EndUpdate();
 					}
-					glm::mat4 view = myCamera->viewMatrix;
 
 					/* PRE-RENDER */
 					{
@@ -843,19 +750,24 @@ int main()
 					}
 
 					/* RENDER */
-					for (size_t i = 0; i < cubes.size(); i++)
+					MemoryScope renderMemory(MemoryTag::Render);
+					const SimSnapshot& snapshot = simulation->GetSnapshot();
+					for (size_t i = 0; i < snapshot.bodies.size(); i++)
 					{
-						cubes[i]->Render(myCamera);
+						const BodyState& body = snapshot.bodies[i];
+						EntitySystems::Draw(body.renderable, body.world, body.position, body.maxScale, myCamera, impostors);
 					}
+					impostors->Flush(myCamera);
+					trails->Render(myCamera);
 					glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
 					skyboxShader.use();
-					view = glm::mat4(glm::mat3(myCamera->viewMatrix)); // remove translation from the view matrix
+					glm::mat4 view = glm::mat4(glm::mat3(myCamera->viewMatrix)); // remove translation from the view matrix
 					skyboxShader.setMat4("view", view);
 					skyboxShader.setMat4("projection", myCamera->projectionMatrix);
 
 					glBindVertexArray(skyboxVAO);
 					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+					glBindTexture(GL_TEXTURE_CUBE_MAP, textureManager->GetTexture(skybox));
 					glDrawArrays(GL_TRIANGLES, 0, 36);
 					glBindVertexArray(0);
 					glDepthFunc(GL_LESS);
@@ -864,6 +776,7 @@ int main()
 				if (menu) {
 					
 					menuBox->SLERP(dt);
+					TransformSystem::GetInstance()->UpdateMatrices();
 					//myCamera->Update();
 					myCamera->Update();
 					myCamera->UpdateRotation(xposCam, yposCam);
@@ -887,7 +800,7 @@ int main()
 
 					glBindVertexArray(skyboxVAO);
 					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+					glBindTexture(GL_TEXTURE_CUBE_MAP, textureManager->GetTexture(skybox));
 					glDrawArrays(GL_TRIANGLES, 0, 36);
 					glBindVertexArray(0);
 					glDepthFunc(GL_LESS);
@@ -915,7 +828,7 @@ int main()
 
 					glBindVertexArray(skyboxVAO);
 					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+					glBindTexture(GL_TEXTURE_CUBE_MAP, textureManager->GetTexture(skybox));
 					glDrawArrays(GL_TRIANGLES, 0, 36);
 					glBindVertexArray(0);
 					glDepthFunc(GL_LESS);
@@ -926,29 +839,59 @@ int main()
                 //'clear' for next draw call
                 glBindVertexArray(0);
                 glUseProgram(0);
+                //everything reading this frame's streaming region has been issued
+                streamingBuffer->EndFrame();
                 //swaps the front buffer with the back buffer
                 glfwSwapBuffers(window);
             }
         }
 
-        //de-allocate our mesh!
-        delete cube1Mesh;
-
-        delete myMaterial;
+        //the simulation thread has to be done with the bodies before they go
+        delete simulation;
+        delete impostors;
+        delete trails;
+        delete streamingBuffer;
+        glDeleteBuffers(1, &skyboxVBO);
+        glDeleteVertexArrays(1, &skyboxVAO);
+        MemoryTracker::UntrackGpu(GpuResource::Buffer, skyboxVBO);
+        MemoryTracker::UntrackGpu(GpuResource::VertexArray, skyboxVAO);
 
-		for (size_t i = 0; i < cubes.size(); i++)
-		{
-			delete cubes[i];
-		}
+		//the bodies' pool is ours, the rest of the scene's entities go with it
+		delete bodies;
+		delete scene;
 
         delete myCamera;
 		delete menuCam;
 		delete creditsCam;
 		delete tree;
-		delete menuBox;
-		delete creditsBox;
 		music->drop();
+		explosion->drop();
         Input::Release();
+        EntityWorld::Release();
+        TransformSystem::Release();
+        JobSystem::Release();
+        ShaderVariantBuilder::Release();
+        ProgramCache::Release();
+
+        //let any load that's still going finish before its textures get deleted
+        assetLoader->Flush();
+        AssetLoader::Release();
+
+        //every other thread has given its arena back by now, this one's is all that's left
+        FrameArena::Release();
+
+        textureManager->ReleaseTexture(gameSkybox);
+        textureManager->ReleaseTexture(menuSkybox);
+        textureManager->ReleaseTexture(creditsSkybox);
+        textureManager->EvictUnused();
+        TextureManager::Release();
+
+        //nothing may look at the mapped pack after this
+        AssetPack::Release();
+
+        //anything still on the GPU by now was never deleted
+        std::cout << "Memory at exit" << std::endl;
+        MemoryTracker::Report(std::cout, true);
     }
 
     //clean up
@@ -956,6 +899,6 @@ int main()
 #ifdef _DEBUG
     _CrtDumpMemoryLeaks();
 #endif // _DEBUG
-    return 0;
+    return exitCode;
 }
 
@@ -0,0 +1,41 @@
+#pragma once
+#include "stdafx.h"
+#include <string>
+
+/// <summary>
+/// A read-only file mapped into memory (CreateFileMapping on Windows, mmap elsewhere).
+/// The OS pages it in on demand and the pointer stays valid until Close() or the destructor.
+/// </summary>
+class MappedFile
+{
+private:
+	const unsigned char* data;
+	size_t size;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	//owns the mapping, so no copies
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/// <summary>
+	/// Maps a whole file, closing whatever was mapped before
+	/// </summary>
+	/// <returns>Whether the file could be opened and mapped</returns>
+	bool Open(const std::string& path);
+
+	void Close();
+
+	bool IsOpen() const { return data != nullptr; }
+	const unsigned char* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+};
@@ -48,6 +48,11 @@ public:
 		Camera* camera,
 		glm::mat4 worldMatrix
 	);
+
+	/// <summary>
+	/// The color of the object this material is on
+	/// </summary>
+	glm::vec3 GetColor() const { return colorObj; }
 };
 
 
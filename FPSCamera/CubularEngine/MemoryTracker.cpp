@@ -0,0 +1,432 @@
+#include "MemoryTracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <map>
+#include <mutex>
+
+namespace
+{
+	const size_t TagCount = (size_t)MemoryTag::Count;
+	const size_t ResourceCount = (size_t)GpuResource::Count;
+
+	//in front of every block, 16 bytes so what follows keeps malloc's alignment
+	struct BlockHeader
+	{
+		size_t size;
+		size_t tag;
+	};
+	const size_t HeaderSize = 16;
+	static_assert(sizeof(BlockHeader) <= HeaderSize, "the block header has to fit in front of the block");
+
+	//all plain atomics, operator new can run on any thread and before anything is constructed
+	struct TagCounters
+	{
+		std::atomic<size_t> liveAllocations;
+		std::atomic<size_t> liveBytes;
+		std::atomic<size_t> peakBytes;
+		std::atomic<size_t> totalAllocations;
+		std::atomic<size_t> totalBytes;
+	};
+	TagCounters counters[TagCount];
+	std::atomic<size_t> totalLiveBytes(0);
+	std::atomic<size_t> totalPeakBytes(0);
+
+	//main thread only, for the per frame numbers
+	size_t frameStartAllocations[TagCount];
+	size_t frameStartBytes[TagCount];
+	size_t lastFrameAllocations[TagCount];
+	size_t lastFrameBytes[TagCount];
+
+	thread_local MemoryTag threadTag = MemoryTag::General;
+
+	struct GpuObject
+	{
+		size_t bytes;
+		MemoryTag tag;
+	};
+
+	//function statics, so they're made on first use rather than in some static init order
+	std::map<unsigned long long, GpuObject>& GetGpuObjects()
+	{
+		static std::map<unsigned long long, GpuObject> objects;
+		return objects;
+	}
+
+	std::mutex& GetGpuMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	unsigned long long GpuKey(GpuResource type, GLuint id)
+	{
+		return ((unsigned long long)type << 32) | id;
+	}
+
+	void RaisePeak(std::atomic<size_t>& peak, size_t value)
+	{
+		size_t current = peak.load(std::memory_order_relaxed);
+		while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void* TrackedAllocate(size_t size)
+	{
+		BlockHeader* header = static_cast<BlockHeader*>(malloc(size + HeaderSize));
+		if (header == nullptr)
+		{
+			return nullptr;
+		}
+		size_t tag = (size_t)threadTag;
+		header->size = size;
+		header->tag = tag;
+
+		TagCounters& tagCounters = counters[tag];
+		tagCounters.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+		tagCounters.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+		tagCounters.totalBytes.fetch_add(size, std::memory_order_relaxed);
+		RaisePeak(tagCounters.peakBytes, tagCounters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size);
+		RaisePeak(totalPeakBytes, totalLiveBytes.fetch_add(size, std::memory_order_relaxed) + size);
+
+		return reinterpret_cast<unsigned char*>(header) + HeaderSize;
+	}
+
+	//an ordinary tracked block with room to move up to the alignment, where it starts is kept
+	//just in front of the aligned address for the free
+	void* TrackedAllocateAligned(size_t size, size_t alignment)
+	{
+		unsigned char* block = static_cast<unsigned char*>(TrackedAllocate(size + alignment + sizeof(void*)));
+		if (block == nullptr)
+		{
+			return nullptr;
+		}
+		uintptr_t aligned = ((uintptr_t)block + sizeof(void*) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		reinterpret_cast<void**>(aligned)[-1] = block;
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	void TrackedFree(void* memory)
+	{
+		if (memory == nullptr)
+		{
+			return;
+		}
+		BlockHeader* header = reinterpret_cast<BlockHeader*>(static_cast<unsigned char*>(memory) - HeaderSize);
+
+		//counted against the tag it was allocated under, whoever frees it
+		TagCounters& tagCounters = counters[header->tag];
+		tagCounters.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+		tagCounters.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+		totalLiveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+		free(header);
+	}
+
+	void TrackedFreeAligned(void* memory)
+	{
+		if (memory != nullptr)
+		{
+			TrackedFree(static_cast<void**>(memory)[-1]);
+		}
+	}
+
+	void PrintBytes(std::ostream& out, size_t bytes)
+	{
+		if (bytes >= 10 * 1024 * 1024)
+		{
+			out << bytes / (1024 * 1024) << " MB";
+		}
+		else if (bytes >= 10 * 1024)
+		{
+			out << bytes / 1024 << " KB";
+		}
+		else
+		{
+			out << bytes << " B";
+		}
+	}
+}
+
+//every new in the program goes through here. malloc underneath keeps the CRT debug heap's leak report working
+void* operator new(size_t size)
+{
+	void* memory = TrackedAllocate(size);
+	if (memory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return TrackedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return TrackedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	TrackedFree(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	TrackedFree(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	TrackedFree(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	TrackedFree(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	TrackedFree(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	TrackedFree(memory);
+}
+
+//over-aligned types and std::align_val_t allocations (entity chunks, frame arenas)
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* memory = TrackedAllocateAligned(size, (size_t)alignment);
+	if (memory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return TrackedAllocateAligned(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return TrackedAllocateAligned(size, (size_t)alignment);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	TrackedFreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+	TrackedFreeAligned(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+	TrackedFreeAligned(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept
+{
+	TrackedFreeAligned(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	TrackedFreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	TrackedFreeAligned(memory);
+}
+
+const char* MemoryTracker::GetTagName(MemoryTag tag)
+{
+	switch (tag)
+	{
+	case MemoryTag::General:
+		return "general";
+	case MemoryTag::Physics:
+		return "physics";
+	case MemoryTag::Render:
+		return "render";
+	case MemoryTag::Assets:
+		return "assets";
+	case MemoryTag::Audio:
+		return "audio";
+	default:
+		return "?";
+	}
+}
+
+const char* MemoryTracker::GetResourceName(GpuResource type)
+{
+	switch (type)
+	{
+	case GpuResource::Texture:
+		return "textures";
+	case GpuResource::Buffer:
+		return "buffers";
+	case GpuResource::Program:
+		return "programs";
+	case GpuResource::VertexArray:
+		return "vertex arrays";
+	default:
+		return "?";
+	}
+}
+
+MemoryTag MemoryTracker::SetThreadTag(MemoryTag tag)
+{
+	MemoryTag previous = threadTag;
+	threadTag = tag;
+	return previous;
+}
+
+MemoryTag MemoryTracker::GetThreadTag()
+{
+	return threadTag;
+}
+
+void MemoryTracker::BeginFrame()
+{
+	for (size_t tag = 0; tag < TagCount; tag++)
+	{
+		size_t allocations = counters[tag].totalAllocations.load(std::memory_order_relaxed);
+		size_t bytes = counters[tag].totalBytes.load(std::memory_order_relaxed);
+		lastFrameAllocations[tag] = allocations - frameStartAllocations[tag];
+		lastFrameBytes[tag] = bytes - frameStartBytes[tag];
+		frameStartAllocations[tag] = allocations;
+		frameStartBytes[tag] = bytes;
+	}
+}
+
+MemoryStats MemoryTracker::GetStats(MemoryTag tag)
+{
+	size_t index = (size_t)tag;
+	const TagCounters& tagCounters = counters[index];
+
+	MemoryStats stats;
+	stats.liveAllocations = tagCounters.liveAllocations.load(std::memory_order_relaxed);
+	stats.liveBytes = tagCounters.liveBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = tagCounters.peakBytes.load(std::memory_order_relaxed);
+	stats.totalAllocations = tagCounters.totalAllocations.load(std::memory_order_relaxed);
+	stats.totalBytes = tagCounters.totalBytes.load(std::memory_order_relaxed);
+	stats.frameAllocations = lastFrameAllocations[index];
+	stats.frameBytes = lastFrameBytes[index];
+	return stats;
+}
+
+MemoryStats MemoryTracker::GetTotal()
+{
+	MemoryStats total = {};
+	for (size_t tag = 0; tag < TagCount; tag++)
+	{
+		MemoryStats stats = GetStats((MemoryTag)tag);
+		total.liveAllocations += stats.liveAllocations;
+		total.liveBytes += stats.liveBytes;
+		total.totalAllocations += stats.totalAllocations;
+		total.totalBytes += stats.totalBytes;
+		total.frameAllocations += stats.frameAllocations;
+		total.frameBytes += stats.frameBytes;
+	}
+	//the tags peak at different times, so their peaks don't add up
+	total.peakBytes = totalPeakBytes.load(std::memory_order_relaxed);
+	return total;
+}
+
+void MemoryTracker::TrackGpu(GpuResource type, GLuint id, size_t bytes, MemoryTag tag)
+{
+	std::lock_guard<std::mutex> lock(GetGpuMutex());
+	GpuObject& object = GetGpuObjects()[GpuKey(type, id)];
+	object.bytes = bytes;
+	object.tag = tag;
+}
+
+void MemoryTracker::AddGpuBytes(GpuResource type, GLuint id, size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(GetGpuMutex());
+	auto found = GetGpuObjects().find(GpuKey(type, id));
+	if (found != GetGpuObjects().end())
+	{
+		found->second.bytes += bytes;
+	}
+}
+
+void MemoryTracker::UntrackGpu(GpuResource type, GLuint id)
+{
+	std::lock_guard<std::mutex> lock(GetGpuMutex());
+	GetGpuObjects().erase(GpuKey(type, id));
+}
+
+GpuStats MemoryTracker::GetGpuStats(GpuResource type)
+{
+	std::lock_guard<std::mutex> lock(GetGpuMutex());
+	GpuStats stats = { 0, 0 };
+	const std::map<unsigned long long, GpuObject>& objects = GetGpuObjects();
+	for (auto it = objects.lower_bound(GpuKey(type, 0)); it != objects.end() && (it->first >> 32) == (unsigned long long)type; ++it)
+	{
+		stats.count++;
+		stats.bytes += it->second.bytes;
+	}
+	return stats;
+}
+
+void MemoryTracker::Report(std::ostream& out, bool listGpuObjects)
+{
+	out << "Heap by tag (live / peak, last frame, total allocations):" << std::endl;
+	for (size_t tag = 0; tag <= TagCount; tag++)
+	{
+		MemoryStats stats = tag < TagCount ? GetStats((MemoryTag)tag) : GetTotal();
+		out << "  " << (tag < TagCount ? GetTagName((MemoryTag)tag) : "all") << ": ";
+		PrintBytes(out, stats.liveBytes);
+		out << " in " << stats.liveAllocations << " blocks / ";
+		PrintBytes(out, stats.peakBytes);
+		out << ", " << stats.frameAllocations << " allocations (";
+		PrintBytes(out, stats.frameBytes);
+		out << "), " << stats.totalAllocations << std::endl;
+	}
+
+	out << "GPU objects:" << std::endl;
+	for (size_t type = 0; type < ResourceCount; type++)
+	{
+		GpuStats stats = GetGpuStats((GpuResource)type);
+		out << "  " << GetResourceName((GpuResource)type) << ": " << stats.count << ", ";
+		PrintBytes(out, stats.bytes);
+		out << std::endl;
+	}
+
+	if (listGpuObjects)
+	{
+		std::lock_guard<std::mutex> lock(GetGpuMutex());
+		const std::map<unsigned long long, GpuObject>& objects = GetGpuObjects();
+		for (auto it = objects.begin(); it != objects.end(); ++it)
+		{
+			out << "  still alive: " << GetResourceName((GpuResource)(it->first >> 32)) << " " << (GLuint)(it->first & 0xFFFFFFFF)
+				<< " (" << GetTagName(it->second.tag) << ", ";
+			PrintBytes(out, it->second.bytes);
+			out << ")" << std::endl;
+		}
+	}
+}
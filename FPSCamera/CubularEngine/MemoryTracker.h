@@ -0,0 +1,127 @@
+#pragma once
+#include "stdafx.h"
+#include <cstddef>
+#include <ostream>
+
+/// <summary>
+/// Which part of the game an allocation is for. Set for a stretch of code with MemoryScope,
+/// it's per thread (the asset workers are always MemoryTag::Assets).
+/// </summary>
+enum class MemoryTag
+{
+	General,
+	Physics,
+	Render,
+	Assets,
+	Audio,
+	Count
+};
+
+/// <summary>
+/// Kinds of GPU objects that get tracked
+/// </summary>
+enum class GpuResource
+{
+	Texture,
+	Buffer,
+	Program,
+	VertexArray,
+	Count
+};
+
+/// <summary>
+/// Heap use of one tag (or all of them)
+/// </summary>
+struct MemoryStats
+{
+	size_t liveAllocations;
+	size_t liveBytes;
+	size_t peakBytes;
+	size_t totalAllocations;
+	size_t totalBytes;
+	size_t frameAllocations;    //during the last whole frame
+	size_t frameBytes;
+};
+
+/// <summary>
+/// GPU objects of one kind that are still alive, and how much memory they were given
+/// </summary>
+struct GpuStats
+{
+	size_t count;
+	size_t bytes;
+};
+
+/// <summary>
+/// Tracks where memory goes, on every platform. Every operator new in the program goes
+/// through MemoryTracker.cpp, which puts a small header in front of each block to remember
+/// its size and tag, so heap use is known per tag: live, peak, total and per frame.
+/// GPU objects are reported by the code that creates and deletes them (TrackGpu/UntrackGpu),
+/// whatever is still tracked at exit has leaked. Report() prints all of it.
+/// </summary>
+class MemoryTracker
+{
+public:
+	static const char* GetTagName(MemoryTag tag);
+	static const char* GetResourceName(GpuResource type);
+
+	/// <summary>
+	/// What this thread's allocations are counted as, returns the previous tag
+	/// </summary>
+	static MemoryTag SetThreadTag(MemoryTag tag);
+	static MemoryTag GetThreadTag();
+
+	/// <summary>
+	/// Marks the start of a frame, what happened since the last call becomes the frame stats
+	/// </summary>
+	static void BeginFrame();
+
+	/// <summary>
+	/// Heap use of one tag
+	/// </summary>
+	static MemoryStats GetStats(MemoryTag tag);
+
+	/// <summary>
+	/// Heap use of all tags together
+	/// </summary>
+	static MemoryStats GetTotal();
+
+	/// <summary>
+	/// Records a GPU object, or changes its size if it's already tracked (e.g. a buffer's storage was respecified)
+	/// </summary>
+	static void TrackGpu(GpuResource type, GLuint id, size_t bytes, MemoryTag tag);
+
+	/// <summary>
+	/// Adds to a tracked GPU object's size, e.g. as each face of a cubemap goes up
+	/// </summary>
+	static void AddGpuBytes(GpuResource type, GLuint id, size_t bytes);
+
+	/// <summary>
+	/// Forgets a GPU object, call it wherever it's deleted
+	/// </summary>
+	static void UntrackGpu(GpuResource type, GLuint id);
+
+	static GpuStats GetGpuStats(GpuResource type);
+
+	/// <summary>
+	/// Prints heap use per tag and GPU use per kind
+	/// </summary>
+	/// <param name="listGpuObjects">Also list every GPU object still alive (at exit, these are the leaks)</param>
+	static void Report(std::ostream& out, bool listGpuObjects);
+};
+
+/// <summary>
+/// Counts this thread's allocations under a tag until it goes out of scope
+/// </summary>
+class MemoryScope
+{
+private:
+	MemoryTag previous;
+
+public:
+	MemoryScope(MemoryTag tag) { previous = MemoryTracker::SetThreadTag(tag); }
+	~MemoryScope() { MemoryTracker::SetThreadTag(previous); }
+
+	MemoryScope(const MemoryScope&) = delete;
+	MemoryScope& operator=(const MemoryScope&) = delete;
+};
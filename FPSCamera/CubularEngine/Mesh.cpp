@@ -1,71 +1,489 @@
 #include "Mesh.h"
+#include "MemoryTracker.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjImporter.h"
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <cfloat>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+
+namespace
+{
+	const char MeshCacheMagic[4] = { 'C', 'M', 'S', 'H' };
+	const unsigned int MeshCacheVersion = 1;
+	const unsigned int MeshCacheMaxStreams = 4;
+
+	//the GPU block starts on a cache line, every stream and the indices on 16 bytes
+	const size_t MeshCacheDataAlignment = 64;
+	const size_t MeshCacheBlockAlignment = 16;
+
+	//front of a .mesh file. it's followed by the LOD table, then by one block that is
+	//uploaded as-is into a single GL buffer: every encoded vertex stream, then the indices
+	struct MeshCacheHeader
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned long long layoutHash;          //the VertexLayout the streams were encoded with
+		unsigned int maxLODs;                   //LOD settings the chain was built with
+		float lodReduction;
+		unsigned int vertCount;
+		unsigned int floatsPerVertex;
+		unsigned int indexCount;
+		unsigned int lodCount;
+		unsigned int streamCount;
+		unsigned int streamOffsets[MeshCacheMaxStreams];    //from the start of the block
+		unsigned int indexOffset;
+		float boundingRadius;
+		float boundsMin[3];
+		float boundsMax[3];
+		float acmrBefore;
+		float acmrAfter;
+		unsigned long long dataOffset;          //from the start of the file
+		unsigned long long dataSize;
+	};
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
 
 Mesh::Mesh()
 {
+	VAO = 0;
+	EBO = 0;
+	indexBufferOffset = 0;
+	vertexBufferSize = 0;
+	layout = VertexLayout::Default();
+	maxLODs = 1;
+	lodReduction = 0.5f;
+	boundingRadius = 0.0f;
+	boundsMin = glm::vec3(0.0f);
+	boundsMax = glm::vec3(0.0f);
+	vertCount = 0;
+	floatsPerVertex = 0;
+	acmrBefore = 0.0f;
+	acmrAfter = 0.0f;
 }
 
 Mesh::~Mesh()
 {
-	glDeleteBuffers(1, &VBO);
+	for (size_t i = 0; i < VBOs.size(); i++)
+	{
+		MemoryTracker::UntrackGpu(GpuResource::Buffer, VBOs[i]);
+	}
+	if (!VBOs.empty())
+	{
+		glDeleteBuffers((GLsizei)VBOs.size(), &VBOs[0]);
+	}
+	MemoryTracker::UntrackGpu(GpuResource::Buffer, EBO);
+	MemoryTracker::UntrackGpu(GpuResource::VertexArray, VAO);
+	glDeleteBuffers(1, &EBO);
+	glDeleteVertexArrays(1, &VAO);
+}
+
+void Mesh::SetVertexLayout(const VertexLayout& layout)
+{
+	this->layout = layout;
+}
+
+void Mesh::SetLODSettings(size_t maxLODs, float reduction)
+{
+	this->maxLODs = maxLODs > 0 ? maxLODs : 1;
+	this->lodReduction = reduction;
+}
+
+void Mesh::InitWithVertexArray(GLfloat vertices[], size_t count, GLuint shaderProgram, size_t floatsPerVertex)
+{
+	this->floatsPerVertex = (GLsizei)floatsPerVertex;
+
+	//the raw array is a plain triangle list, so every vertex is its own index
+	//which is the worst case for the vertex cache
+	size_t rawVertexCount = count / floatsPerVertex;
+	std::vector<GLuint> rawIndices(rawVertexCount);
+	for (size_t i = 0; i < rawVertexCount; i++)
+	{
+		rawIndices[i] = (GLuint)i;
+	}
+	acmrBefore = MeshOptimizer::CalculateACMR(rawIndices, rawVertexCount);
+
+	//merge the vertices that are exactly the same (same position AND normal)
+	MeshOptimizer::WeldVertices(vertices, rawVertexCount, floatsPerVertex, this->vertices, indices);
+	vertCount = (GLsizei)(this->vertices.size() / floatsPerVertex);
+
+	OptimizeIndices();
+	BuildLODs();
+
+	//we create the VAO, VBO and EBO based off of all these data
+	CreateBuffers(shaderProgram);
 }
 
-void Mesh::InitWithVertexArray(GLfloat vertices[], size_t count, GLuint shaderProgram)
+void Mesh::InitWithIndexedArray(GLfloat vertices[], size_t count, GLuint indices[], size_t indexCount,
+	GLuint shaderProgram, size_t floatsPerVertex, bool optimize)
 {
-	//allocate space for all these vertices
-	this->vertices = std::vector<GLfloat>(count);
-	memcpy(&(this->vertices[0]), vertices, count * sizeof(GLfloat));
+	this->floatsPerVertex = (GLsizei)floatsPerVertex;
+	this->vertices.assign(vertices, vertices + count);
+	this->indices.assign(indices, indices + indexCount);
+	vertCount = (GLsizei)(count / floatsPerVertex);
 
-	//vertCount is how many vertices we have
-	//since 3 floats make up one vertices, we divide by 3
-	//(yeah this is bad, and you should feel disgusted)
-	vertCount = count / 3;
+	acmrBefore = MeshOptimizer::CalculateACMR(this->indices, vertCount);
+	if (optimize)
+	{
+		OptimizeIndices();
+	}
+	else
+	{
+		acmrAfter = acmrBefore;
+	}
+	BuildLODs();
 
-	//we create the VAO and VBO based off of all these data
 	CreateBuffers(shaderProgram);
 }
 
-void Mesh::Render()
+void Mesh::OptimizeIndices()
+{
+	MeshOptimizer::OptimizeVertexCache(indices, vertCount);
+	MeshOptimizer::OptimizeVertexFetch(vertices, floatsPerVertex, indices);
+	vertCount = (GLsizei)(vertices.size() / floatsPerVertex);
+
+	acmrAfter = MeshOptimizer::CalculateACMR(indices, vertCount);
+#ifdef _DEBUG
+	std::cout << "Mesh built: " << vertCount << " vertices, " << indices.size() / 3 << " triangles, ACMR "
+		<< acmrBefore << " -> " << acmrAfter << std::endl;
+#endif
+}
+
+void Mesh::BuildLODs()
+{
+	boundingRadius = 0.0f;
+	boundsMin = glm::vec3(vertCount > 0 ? FLT_MAX : 0.0f);
+	boundsMax = glm::vec3(vertCount > 0 ? -FLT_MAX : 0.0f);
+	for (GLsizei v = 0; v < vertCount; v++)
+	{
+		const GLfloat* p = &vertices[v * floatsPerVertex];
+		glm::vec3 position = glm::vec3(p[0], p[1], p[2]);
+		boundingRadius = std::max(boundingRadius, glm::length(position));
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+
+	std::vector<GLuint> full = indices;
+	lods.clear();
+
+	MeshLOD lod;
+	lod.indexOffset = 0;
+	lod.indexCount = (GLsizei)full.size();
+	lod.error = 0.0f;
+	lods.push_back(lod);
+
+	//always simplify from the full mesh so the error is measured against it
+	size_t target = full.size();
+	while (lods.size() < maxLODs)
+	{
+		target = (size_t)(target * lodReduction) / 3 * 3;
+		if (target < 3 * 8)
+		{
+			break;
+		}
+
+		std::vector<GLuint> simplified;
+		float error = MeshSimplifier::Simplify(vertices, floatsPerVertex, full, target, simplified);
+
+		//stop once the simplifier can't make real progress (everything left is locked)
+		if (simplified.size() > (size_t)(lods.back().indexCount * 0.9f))
+		{
+			break;
+		}
+		MeshOptimizer::OptimizeVertexCache(simplified, vertCount);
+
+		lod.indexOffset = (GLuint)indices.size();
+		lod.indexCount = (GLsizei)simplified.size();
+		lod.error = error;
+		lods.push_back(lod);
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		target = simplified.size();
+
+#ifdef _DEBUG
+		std::cout << "  LOD " << lods.size() - 1 << ": " << simplified.size() / 3 << " triangles, error " << error << std::endl;
+#endif
+	}
+}
+
+size_t Mesh::SelectLOD(float distance, float scale, float pixelsPerUnit, float maxPixelError) const
+{
+	if (distance <= 0.0f)
+	{
+		return 0;
+	}
+
+	//how many pixels one model unit covers at this distance
+	float pixelsPerModelUnit = scale * pixelsPerUnit / distance;
+
+	//errors grow with the level, so walk from the coarsest level down
+	for (size_t l = lods.size() - 1; l > 0; l--)
+	{
+		if (lods[l].error * pixelsPerModelUnit <= maxPixelError)
+		{
+			return l;
+		}
+	}
+	return 0;
+}
+
+void Mesh::Render(size_t lod)
 {
+	if (lod >= lods.size())
+	{
+		lod = lods.size() - 1;
+	}
+
 	//set VAO and draw
 	glBindVertexArray(VAO);
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, vertCount);
+	glDrawElements(GL_TRIANGLES, lods[lod].indexCount, GL_UNSIGNED_INT, (GLvoid*)(indexBufferOffset + lods[lod].indexOffset * sizeof(GLuint)));
 }
 
 void Mesh::CreateBuffers(GLuint shaderProgram)
 {
 	glGenVertexArrays(1, &VAO);	//create 1 VAO and store it
 	glBindVertexArray(VAO);		//tells OpenGL that this is our 'array' (descriptor)
+	MemoryTracker::TrackGpu(GpuResource::VertexArray, VAO, 0, MemoryTag::Assets);
+
+	//pack the float vertices into whatever formats the layout asks for
+	std::vector<std::vector<unsigned char>> streams;
+	layout.Encode(vertices.data(), vertCount, floatsPerVertex, streams);
+
+	VBOs.resize(streams.size());
+	glGenBuffers((GLsizei)VBOs.size(), &VBOs[0]);
+	vertexBufferSize = 0;
+	for (GLuint s = 0; s < (GLuint)streams.size(); s++)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, VBOs[s]);		//tells OpenGL that this is our 'array buffer' (memory)
+		if (!streams[s].empty())	//an empty mesh keeps its buffers, just without a store
+		{
+			glBufferData(			//create a 'buffer store' (place to put this memory in GPU)
+				GL_ARRAY_BUFFER,
+				streams[s].size(),	//the size of our buffer
+				streams[s].data(),	//pointer to starting loc
+				GL_STATIC_DRAW);	//'hints' at what this will be used for
+		}
+		vertexBufferSize += streams[s].size();
+		MemoryTracker::TrackGpu(GpuResource::Buffer, VBOs[s], streams[s].size(), MemoryTag::Assets);
+
+		//GL_ARRAY_BUFFER must be bound prior to setting the attribute pointers
+		layout.BindStream(s, shaderProgram);
+	}
 
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);		//tells OpenGL that this is our 'array buffer' (memory)
-	glBufferData(			//create a 'buffer store' (place to put this memory in GPU)						
-		GL_ARRAY_BUFFER,
-		sizeof(GLfloat) * 3 * vertCount,	//the size of our buffer
-		&(vertices[0]),		                //pointer to starting loc
-		GL_STATIC_DRAW);	                //'hints' at what this will be used for
-
-	//GL_ARRAY_BUFFER msut be bound prior to this call
-	GLuint attribIndex = glGetAttribLocation(shaderProgram, "position");
-	glVertexAttribPointer(
-		attribIndex,			//index of attribute
-		3,						//count of data (this case we have a vec3 -- which has 3 floats)
-		GL_FLOAT,				//kind of data (as mentioned, this is a float!)
-		GL_FALSE,				//should data be normalized?
-		6 * sizeof(GLfloat),	//stride - how many index to skip ahead to reach more of this data
-		(GLvoid*)0);			//offset - how many index to skip to reach first value
-	glEnableVertexAttribArray(attribIndex);	//enable what we just did earlier 
-	//set up the new vertex array to also take in normal positions used in lighting calculations
-	GLuint normalIndex = glGetAttribLocation(shaderProgram, "aNormal");
-	glVertexAttribPointer(
-		normalIndex,			//index of attribute
-		3,						//count of data (this case we have a vec3 -- which has 3 floats)
-		GL_FLOAT,				//kind of data (as mentioned, this is a float!)
-		GL_FALSE,				//should data be normalized?
-		6 * sizeof(GLfloat),	//stride - how many index to skip ahead to reach more of this data
-		(GLvoid*)0);			//offset - how many index to skip to reach first value
-	glEnableVertexAttribArray(normalIndex);
-
-	//unbind things
+	//the element array binding is part of the VAO state, so it stays bound
+	glGenBuffers(1, &EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	if (!indices.empty())
+	{
+		glBufferData(
+			GL_ELEMENT_ARRAY_BUFFER,
+			sizeof(GLuint) * indices.size(),
+			indices.data(),
+			GL_STATIC_DRAW);
+	}
+	MemoryTracker::TrackGpu(GpuResource::Buffer, EBO, sizeof(GLuint) * indices.size(), MemoryTag::Assets);
+
+#ifdef _DEBUG
+	std::cout << "Mesh vertex data: " << vertexBufferSize << " bytes ("
+		<< vertCount * floatsPerVertex * sizeof(GLfloat) << " as floats)" << std::endl;
+#endif
+
+	//unbind things (VAO first so it keeps the EBO)
+	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+std::string Mesh::GetCachePath(const std::string& modelPath)
+{
+	return std::filesystem::path(modelPath).replace_extension(".mesh").generic_string();
+}
+
+bool Mesh::InitFromFile(const std::string& path, GLuint shaderProgram)
+{
+	std::string cachePath = GetCachePath(path);
+	if (AssetPack::GetInstance()->IsBuildFresh(path, cachePath) && InitFromCache(cachePath, shaderProgram))
+	{
+		return true;
+	}
+
+	std::vector<GLfloat> modelVertices;
+	std::vector<GLuint> modelIndices;
+	if (!ObjImporter::Import(path, modelVertices, modelIndices))
+	{
+		return false;
+	}
+	InitWithIndexedArray(modelVertices.data(), modelVertices.size(), modelIndices.data(), modelIndices.size(), shaderProgram);
+
+	//a failed write only costs us the import again next time
+	if (!SaveCache(cachePath))
+	{
+		std::cout << "Couldn't write the mesh cache: " << cachePath << std::endl;
+	}
+	return true;
+}
+
+bool Mesh::SaveCache(const std::string& path) const
+{
+	if (vertices.empty() || indices.empty() || layout.GetStreamCount() > MeshCacheMaxStreams)
+	{
+		return false;
+	}
+
+	std::vector<std::vector<unsigned char>> streams;
+	layout.Encode(&vertices[0], vertCount, floatsPerVertex, streams);
+
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MeshCacheMagic, sizeof(header.magic));
+	header.version = MeshCacheVersion;
+	header.layoutHash = layout.GetHash();
+	header.maxLODs = (unsigned int)maxLODs;
+	header.lodReduction = lodReduction;
+	header.vertCount = (unsigned int)vertCount;
+	header.floatsPerVertex = (unsigned int)floatsPerVertex;
+	header.indexCount = (unsigned int)indices.size();
+	header.lodCount = (unsigned int)lods.size();
+	header.streamCount = (unsigned int)streams.size();
+	header.boundingRadius = boundingRadius;
+	for (int k = 0; k < 3; k++)
+	{
+		header.boundsMin[k] = boundsMin[k];
+		header.boundsMax[k] = boundsMax[k];
+	}
+	header.acmrBefore = acmrBefore;
+	header.acmrAfter = acmrAfter;
+
+	//lay the GPU block out exactly like it goes into the buffer
+	size_t blockSize = 0;
+	for (size_t s = 0; s < streams.size(); s++)
+	{
+		header.streamOffsets[s] = (unsigned int)blockSize;
+		blockSize = AlignUp(blockSize + streams[s].size(), MeshCacheBlockAlignment);
+	}
+	header.indexOffset = (unsigned int)blockSize;
+	blockSize += indices.size() * sizeof(GLuint);
+
+	header.dataOffset = AlignUp(sizeof(MeshCacheHeader) + lods.size() * sizeof(MeshLOD), MeshCacheDataAlignment);
+	header.dataSize = blockSize;
+
+	std::vector<char> block(blockSize, 0);
+	for (size_t s = 0; s < streams.size(); s++)
+	{
+		memcpy(&block[header.streamOffsets[s]], streams[s].data(), streams[s].size());
+	}
+	memcpy(&block[header.indexOffset], indices.data(), indices.size() * sizeof(GLuint));
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.good())
+	{
+		return false;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)&lods[0], lods.size() * sizeof(MeshLOD));
+	std::vector<char> padding(header.dataOffset - sizeof(header) - lods.size() * sizeof(MeshLOD), 0);
+	file.write(padding.data(), padding.size());
+	file.write(block.data(), block.size());
+	return file.good();
+}
+
+bool Mesh::InitFromCache(const std::string& path, GLuint shaderProgram)
+{
+	//a cooked cache is already mapped as part of the pack
+	MappedFile mapping;
+	AssetView view = AssetPack::GetInstance()->Find(path);
+	if (!view.IsValid())
+	{
+		if (!mapping.Open(path))
+		{
+			return false;
+		}
+		view.data = (const char*)mapping.GetData();
+		view.size = mapping.GetSize();
+	}
+
+	MeshCacheHeader header;
+	if (view.size < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, view.data, sizeof(header));
+	if (memcmp(header.magic, MeshCacheMagic, sizeof(header.magic)) != 0 || header.version != MeshCacheVersion)
+	{
+		return false;
+	}
+
+	//built for another layout or LOD chain, the caller re-imports and overwrites it
+	if (header.layoutHash != layout.GetHash() || header.maxLODs != maxLODs || header.lodReduction != lodReduction)
+	{
+		return false;
+	}
+	if (header.lodCount == 0 || header.streamCount != layout.GetStreamCount()
+		|| sizeof(header) + header.lodCount * sizeof(MeshLOD) > header.dataOffset
+		|| header.dataOffset + header.dataSize > view.size
+		|| header.indexOffset + (unsigned long long)header.indexCount * sizeof(GLuint) > header.dataSize)
+	{
+		std::cout << "Mesh cache is corrupt: " << path << std::endl;
+		return false;
+	}
+
+	//every LOD has to draw from inside the index range, the caller re-imports if one doesn't
+	std::vector<MeshLOD> cachedLODs(header.lodCount);
+	memcpy(cachedLODs.data(), view.data + sizeof(header), cachedLODs.size() * sizeof(MeshLOD));
+	for (size_t i = 0; i < cachedLODs.size(); i++)
+	{
+		if ((unsigned long long)cachedLODs[i].indexOffset + cachedLODs[i].indexCount > header.indexCount)
+		{
+			std::cout << "Mesh cache is corrupt: " << path << std::endl;
+			return false;
+		}
+	}
+
+	vertCount = (GLsizei)header.vertCount;
+	floatsPerVertex = (GLsizei)header.floatsPerVertex;
+	lods.swap(cachedLODs);
+	boundingRadius = header.boundingRadius;
+	boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	acmrBefore = header.acmrBefore;
+	acmrAfter = header.acmrAfter;
+	vertices.clear();
+	indices.clear();
+
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+	MemoryTracker::TrackGpu(GpuResource::VertexArray, VAO, 0, MemoryTag::Assets);
+
+	//streams and indices are one upload into one buffer, bound for both roles
+	VBOs.resize(1);
+	glGenBuffers(1, &VBOs[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, VBOs[0]);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)header.dataSize, view.data + header.dataOffset, GL_STATIC_DRAW);
+	MemoryTracker::TrackGpu(GpuResource::Buffer, VBOs[0], (size_t)header.dataSize, MemoryTag::Assets);
+	for (GLuint s = 0; s < header.streamCount; s++)
+	{
+		layout.BindStream(s, shaderProgram, header.streamOffsets[s]);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, VBOs[0]);
+	EBO = 0;
+	indexBufferOffset = header.indexOffset;
+	vertexBufferSize = (size_t)vertCount * layout.GetVertexSize();
+
+#ifdef _DEBUG
+	std::cout << "Mesh loaded from cache: " << path << ", " << vertCount << " vertices, "
+		<< header.indexCount << " indices over " << lods.size() << " LODs" << std::endl;
+#endif
+
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	return true;
 }
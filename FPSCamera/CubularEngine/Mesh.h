@@ -6,7 +6,20 @@
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
 #include <vector>
+#include <string>
+#include "VertexLayout.h"
+
+/// <summary>
+/// One level of detail: a range of the shared index buffer
+/// </summary>
+struct MeshLOD
+{
+	GLuint indexOffset;     //first index of this level in the index buffer
+	GLsizei indexCount;     //how many indices this level draws
+	float error;            //how far (in model units) this level strays from the full mesh
+};
 
 /// <summary>
 /// This represents on 'mesh' for our rendering pipeline
@@ -25,38 +38,148 @@ public:
 	~Mesh();
 
 	/// <summary>
-	/// Creates our VAO & VBO based on an array of vertices
+	/// Sets how the vertices are encoded on the GPU. Must be called before Init.
+	/// The CPU copy in 'vertices' always stays as plain floats.
+	/// </summary>
+	/// <param name="layout">The layout to encode and bind with</param>
+	void SetVertexLayout(const VertexLayout& layout);
+
+	/// <summary>
+	/// Sets how many levels of detail get generated on Init. Must be called before Init.
+	/// </summary>
+	/// <param name="maxLODs">Most levels to keep, including the full mesh (1 = no LODs)</param>
+	/// <param name="reduction">Triangle ratio between one level and the next</param>
+	void SetLODSettings(size_t maxLODs, float reduction = 0.5f);
+
+	/// <summary>
+	/// Creates our VAO, VBO & EBO based on an unindexed array of vertices (a triangle list).
+	/// Duplicate vertices are welded and the triangles are reordered for the vertex cache.
 	/// </summary>
 	/// <param name="vertices">The array of vertices</param>
-	/// <param name="count">The count of vertices</param>
+	/// <param name="count">The count of floats in the array</param>
+	/// <param name="shaderProgram">The 'handle' to the shader program</param>
+	/// <param name="floatsPerVertex">How many floats make up one vertex (position + normal by default)</param>
+	void InitWithVertexArray(GLfloat vertices[], size_t count, GLuint shaderProgram, size_t floatsPerVertex = 6);
+
+	/// <summary>
+	/// Creates our VAO, VBO & EBO from data that is already indexed
+	/// </summary>
+	/// <param name="vertices">The array of unique vertices</param>
+	/// <param name="count">The count of floats in the vertex array</param>
+	/// <param name="indices">Triangle list indices into the vertex array</param>
+	/// <param name="indexCount">The count of indices</param>
 	/// <param name="shaderProgram">The 'handle' to the shader program</param>
-	void InitWithVertexArray(GLfloat vertices[], size_t count, GLuint shaderProgram);
+	/// <param name="floatsPerVertex">How many floats make up one vertex</param>
+	/// <param name="optimize">Whether to reorder the triangles for the vertex cache</param>
+	void InitWithIndexedArray(GLfloat vertices[], size_t count, GLuint indices[], size_t indexCount,
+		GLuint shaderProgram, size_t floatsPerVertex = 6, bool optimize = true);
+
+	/// <summary>
+	/// Loads a model file (OBJ) through its binary cache, the .mesh file next to it.
+	/// A fresh cache that matches our layout and LOD settings is mapped and uploaded as one
+	/// buffer, otherwise the OBJ is imported, built like InitWithIndexedArray and cached.
+	/// Meshes loaded from the cache have no CPU copy of their vertices or indices.
+	/// </summary>
+	/// <param name="path">Path to the .obj file</param>
+	/// <param name="shaderProgram">The 'handle' to the shader program</param>
+	/// <returns>False if neither the cache nor the model could be loaded</returns>
+	bool InitFromFile(const std::string& path, GLuint shaderProgram);
+
+	/// <summary>
+	/// Writes the mesh as it goes to the GPU (encoded streams, all LODs' indices) to a cache file.
+	/// Needs the CPU copy, so it can't re-save a mesh that was loaded from a cache.
+	/// </summary>
+	bool SaveCache(const std::string& path) const;
+
+	/// <summary>
+	/// Where the cache for a model file goes (same name, .mesh extension)
+	/// </summary>
+	static std::string GetCachePath(const std::string& modelPath);
 
 	/// <summary>
 	/// Bind our VAO and draw our shape!
 	/// </summary>
-	void Render();
+	/// <param name="lod">Which level of detail to draw (0 is the full mesh)</param>
+	void Render(size_t lod = 0);
+
+	/// <summary>
+	/// Picks the coarsest level whose error stays under a pixel budget on screen
+	/// </summary>
+	/// <param name="distance">Distance from the camera to the mesh</param>
+	/// <param name="scale">Largest scale the mesh is drawn with</param>
+	/// <param name="pixelsPerUnit">Pixels covered by one unit at a distance of one (see Camera)</param>
+	/// <param name="maxPixelError">How many pixels of error are acceptable</param>
+	size_t SelectLOD(float distance, float scale, float pixelsPerUnit, float maxPixelError = 1.0f) const;
+
+	//how many (unique) vertices we have
 	GLsizei vertCount;
+
+	//how many floats make up one vertex
+	GLsizei floatsPerVertex;
+
+	//vector of (unique, interleaved) vertices
 	std::vector<GLfloat> vertices;
 
-private:
+	//triangle list indices into vertices, every LOD one after the other
+	std::vector<GLuint> indices;
+
+	//the levels of detail, lods[0] is the full mesh
+	std::vector<MeshLOD> lods;
 
-	//vector of vertices
-	
+	//radius of a sphere around the origin that holds every vertex
+	float boundingRadius;
+
+	//model space box around every vertex
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+
+	//how many bytes the encoded vertices take on the GPU
+	size_t vertexBufferSize;
+
+	//average cache miss ratio of the source data and of what we upload
+	float acmrBefore;
+	float acmrAfter;
+
+private:
 
 	//our VAO
 	GLuint VAO;
 
-	//our VBO
-	GLuint VBO;
+	//our VBOs, one per stream of the layout
+	std::vector<GLuint> VBOs;
+
+	//how the vertices get encoded into the VBOs
+	VertexLayout layout;
 
-	//how many vertices we have
-	
+	//LOD generation settings
+	size_t maxLODs;
+	float lodReduction;
+
+	//our EBO (index buffer), 0 when the indices share the vertex buffer
+	GLuint EBO;
+
+	//byte offset of the indices in the element buffer
+	size_t indexBufferOffset;
+
+	/// <summary>
+	/// Runs the cache optimisation over our indices and reports the ACMR
+	/// </summary>
+	void OptimizeIndices();
+
+	/// <summary>
+	/// Simplifies the full mesh into the rest of the LOD chain and works out the bounds
+	/// </summary>
+	void BuildLODs();
 
 	/// <summary>
-	/// Helper function to create the VAO & VBO
+	/// Helper function to create the VAO, VBO & EBO
 	/// </summary>
 	/// <param name="shaderProgram">The 'handle' to the shader program to create the VAO for</param>
 	void CreateBuffers(GLuint shaderProgram);
-};
 
+	/// <summary>
+	/// Maps a cache file and uploads it as a single buffer
+	/// </summary>
+	/// <returns>False if the cache is missing, corrupt or was built with other settings</returns>
+	bool InitFromCache(const std::string& path, GLuint shaderProgram);
+};
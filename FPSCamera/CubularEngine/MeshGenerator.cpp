@@ -0,0 +1,71 @@
+#include "MeshGenerator.h"
+#include <unordered_map>
+
+void MeshGenerator::Icosphere(int subdivisions, float radius, std::vector<GLfloat>& outVertices, std::vector<GLuint>& outIndices)
+{
+	//the 12 corners of an icosahedron are 3 orthogonal golden rectangles
+	const float t = (1.0f + sqrtf(5.0f)) / 2.0f;
+	std::vector<glm::vec3> points = {
+		glm::vec3(-1, t, 0), glm::vec3(1, t, 0), glm::vec3(-1, -t, 0), glm::vec3(1, -t, 0),
+		glm::vec3(0, -1, t), glm::vec3(0, 1, t), glm::vec3(0, -1, -t), glm::vec3(0, 1, -t),
+		glm::vec3(t, 0, -1), glm::vec3(t, 0, 1), glm::vec3(-t, 0, -1), glm::vec3(-t, 0, 1)
+	};
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		points[i] = glm::normalize(points[i]);
+	}
+
+	std::vector<GLuint> triangles = {
+		0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+		1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+		3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+		4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1
+	};
+
+	for (int s = 0; s < subdivisions; s++)
+	{
+		//each edge gets one midpoint, shared by the two triangles on either side
+		std::unordered_map<unsigned long long, GLuint> midpoints;
+		auto midpoint = [&points, &midpoints](GLuint a, GLuint b) -> GLuint {
+			unsigned long long key = a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+			auto found = midpoints.find(key);
+			if (found != midpoints.end())
+			{
+				return found->second;
+			}
+			GLuint index = (GLuint)points.size();
+			points.push_back(glm::normalize(points[a] + points[b]));
+			midpoints[key] = index;
+			return index;
+		};
+
+		std::vector<GLuint> subdivided;
+		subdivided.reserve(triangles.size() * 4);
+		for (size_t i = 0; i < triangles.size(); i += 3)
+		{
+			GLuint a = triangles[i];
+			GLuint b = triangles[i + 1];
+			GLuint c = triangles[i + 2];
+			GLuint ab = midpoint(a, b);
+			GLuint bc = midpoint(b, c);
+			GLuint ca = midpoint(c, a);
+
+			GLuint split[] = { a, ab, ca,   b, bc, ab,   c, ca, bc,   ab, bc, ca };
+			subdivided.insert(subdivided.end(), split, split + 12);
+		}
+		triangles.swap(subdivided);
+	}
+
+	//on a unit sphere the normal is just the position
+	outVertices.resize(points.size() * 6);
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		outVertices[i * 6 + 0] = points[i].x * radius;
+		outVertices[i * 6 + 1] = points[i].y * radius;
+		outVertices[i * 6 + 2] = points[i].z * radius;
+		outVertices[i * 6 + 3] = points[i].x;
+		outVertices[i * 6 + 4] = points[i].y;
+		outVertices[i * 6 + 5] = points[i].z;
+	}
+	outIndices.swap(triangles);
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+/// <summary>
+/// Builds procedural meshes as indexed position + normal (6 float) vertices
+/// </summary>
+class MeshGenerator
+{
+public:
+	/// <summary>
+	/// Builds a sphere by repeatedly subdividing an icosahedron. Unlike a UV sphere
+	/// the triangles are all close to the same size, which suits the simplifier.
+	/// </summary>
+	/// <param name="subdivisions">How many times to split every triangle into 4 (0 = icosahedron)</param>
+	/// <param name="radius">Radius of the sphere</param>
+	/// <param name="outVertices">Receives position + normal vertices</param>
+	/// <param name="outIndices">Receives the triangle list</param>
+	static void Icosphere(int subdivisions, float radius, std::vector<GLfloat>& outVertices, std::vector<GLuint>& outIndices);
+};
@@ -0,0 +1,289 @@
+#include "MeshOptimizer.h"
+#include <cstring>
+#include <cmath>
+
+//scoring constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+//https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+namespace
+{
+	const int ForsythCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	//scores a vertex based on where it sits in the simulated cache and how many
+	//triangles still need it (vertices with few triangles left get a boost so we
+	//finish them off and don't leave lonely triangles behind)
+	float ScoreVertex(int cachePosition, int remainingTris)
+	{
+		if (remainingTris == 0)
+		{
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				//the three vertices of the last triangle get a fixed score so we
+				//don't favour re-using them over their neighbours
+				score = LastTriScore;
+			}
+			else
+			{
+				const float scaler = 1.0f / (ForsythCacheSize - 3);
+				score = 1.0f - (cachePosition - 3) * scaler;
+				score = powf(score, CacheDecayPower);
+			}
+		}
+
+		score += ValenceBoostScale * powf((float)remainingTris, -ValenceBoostPower);
+		return score;
+	}
+
+	//FNV-1a over the raw bits of one vertex
+	size_t HashVertex(const GLfloat* vertex, size_t floatsPerVertex)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(vertex);
+		size_t hash = 2166136261u;
+		for (size_t i = 0; i < floatsPerVertex * sizeof(GLfloat); i++)
+		{
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+}
+
+void MeshOptimizer::WeldVertices(const GLfloat* vertices, size_t vertexCount, size_t floatsPerVertex,
+	std::vector<GLfloat>& outVertices, std::vector<GLuint>& outIndices)
+{
+	outVertices.clear();
+	outIndices.resize(vertexCount);
+
+	//open addressing table, power of two and at least twice the vertex count
+	size_t tableSize = 1;
+	while (tableSize < vertexCount * 2)
+	{
+		tableSize <<= 1;
+	}
+	const GLuint empty = ~0u;
+	std::vector<GLuint> table(tableSize, empty);
+
+	GLuint uniqueCount = 0;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const GLfloat* vertex = vertices + i * floatsPerVertex;
+		size_t slot = HashVertex(vertex, floatsPerVertex) & (tableSize - 1);
+
+		//linear probe until we find the same vertex or a free slot
+		while (table[slot] != empty)
+		{
+			const GLfloat* existing = &outVertices[table[slot] * floatsPerVertex];
+			if (memcmp(existing, vertex, floatsPerVertex * sizeof(GLfloat)) == 0)
+			{
+				break;
+			}
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if (table[slot] == empty)
+		{
+			table[slot] = uniqueCount++;
+			outVertices.insert(outVertices.end(), vertex, vertex + floatsPerVertex);
+		}
+		outIndices[i] = table[slot];
+	}
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount)
+{
+	size_t triCount = indices.size() / 3;
+	if (triCount == 0 || vertexCount == 0)
+	{
+		return;
+	}
+
+	//per vertex: how many triangles use it, and where those triangles are listed
+	std::vector<int> remainingTris(vertexCount, 0);
+	for (size_t i = 0; i < triCount * 3; i++)
+	{
+		remainingTris[indices[i]]++;
+	}
+
+	std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + remainingTris[v];
+	}
+	std::vector<size_t> adjacency(adjacencyOffset[vertexCount]);
+	std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (size_t t = 0; t < triCount; t++)
+	{
+		for (size_t k = 0; k < 3; k++)
+		{
+			GLuint v = indices[t * 3 + k];
+			adjacency[fill[v]++] = t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertexScore[v] = ScoreVertex(-1, remainingTris[v]);
+	}
+
+	std::vector<bool> triAdded(triCount, false);
+	std::vector<float> triScore(triCount);
+	for (size_t t = 0; t < triCount; t++)
+	{
+		triScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	//the simulated LRU cache, with room for the 3 vertices pushed in per step
+	int cache[ForsythCacheSize + 3];
+	int cacheCount = 0;
+
+	std::vector<GLuint> output;
+	output.reserve(indices.size());
+
+	size_t nextUnadded = 0;
+	size_t bestTri = 0;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < triCount; t++)
+	{
+		if (triScore[t] > bestScore)
+		{
+			bestScore = triScore[t];
+			bestTri = t;
+		}
+	}
+
+	for (size_t emitted = 0; emitted < triCount; emitted++)
+	{
+		//nothing in the cache is connected to an unadded triangle, so fall back
+		//to the next one in the original order
+		if (bestScore < 0.0f)
+		{
+			while (triAdded[nextUnadded])
+			{
+				nextUnadded++;
+			}
+			bestTri = nextUnadded;
+		}
+
+		triAdded[bestTri] = true;
+		GLuint* tri = &indices[bestTri * 3];
+		output.insert(output.end(), tri, tri + 3);
+
+		//push the triangle's vertices to the front of the cache, dropping duplicates
+		int newCache[ForsythCacheSize + 3];
+		int newCount = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			newCache[newCount++] = (int)tri[k];
+			remainingTris[tri[k]]--;
+		}
+		for (int c = 0; c < cacheCount; c++)
+		{
+			int v = cache[c];
+			if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+			{
+				newCache[newCount++] = v;
+			}
+		}
+
+		//anything that fell off the end is no longer cached
+		for (int c = ForsythCacheSize; c < newCount; c++)
+		{
+			cachePosition[newCache[c]] = -1;
+			vertexScore[newCache[c]] = ScoreVertex(-1, remainingTris[newCache[c]]);
+		}
+		cacheCount = newCount < ForsythCacheSize ? newCount : ForsythCacheSize;
+		memcpy(cache, newCache, cacheCount * sizeof(int));
+
+		for (int c = 0; c < cacheCount; c++)
+		{
+			cachePosition[cache[c]] = c;
+			vertexScore[cache[c]] = ScoreVertex(c, remainingTris[cache[c]]);
+		}
+
+		//only triangles touching the cache can have changed score
+		bestScore = -1.0f;
+		for (int c = 0; c < cacheCount; c++)
+		{
+			int v = cache[c];
+			for (size_t a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; a++)
+			{
+				size_t t = adjacency[a];
+				if (triAdded[t])
+				{
+					continue;
+				}
+				triScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				if (triScore[t] > bestScore)
+				{
+					bestScore = triScore[t];
+					bestTri = t;
+				}
+			}
+		}
+	}
+
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<GLfloat>& vertices, size_t floatsPerVertex, std::vector<GLuint>& indices)
+{
+	size_t vertexCount = vertices.size() / floatsPerVertex;
+	const GLuint unassigned = ~0u;
+	std::vector<GLuint> remap(vertexCount, unassigned);
+	std::vector<GLfloat> reordered(vertices.size());
+
+	GLuint next = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		GLuint v = indices[i];
+		if (remap[v] == unassigned)
+		{
+			remap[v] = next;
+			memcpy(&reordered[next * floatsPerVertex], &vertices[v * floatsPerVertex], floatsPerVertex * sizeof(GLfloat));
+			next++;
+		}
+		indices[i] = remap[v];
+	}
+
+	//drop vertices that no triangle references
+	reordered.resize(next * floatsPerVertex);
+	vertices.swap(reordered);
+}
+
+float MeshOptimizer::CalculateACMR(const std::vector<GLuint>& indices, size_t vertexCount, size_t cacheSize)
+{
+	size_t triCount = indices.size() / 3;
+	if (triCount == 0)
+	{
+		return 0.0f;
+	}
+
+	//FIFO cache, tracked by the "time" each vertex entered it
+	std::vector<size_t> enteredAt(vertexCount, 0);
+	std::vector<bool> everCached(vertexCount, false);
+	size_t misses = 0;
+
+	for (size_t i = 0; i < triCount * 3; i++)
+	{
+		GLuint v = indices[i];
+		if (!everCached[v] || misses - enteredAt[v] > cacheSize)
+		{
+			everCached[v] = true;
+			enteredAt[v] = misses;
+			misses++;
+		}
+	}
+
+	return (float)misses / (float)triCount;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+/// <summary>
+/// Offline-style helpers that turn raw triangle soup into an indexed mesh that is
+/// friendly to the GPU's post-transform vertex cache
+/// </summary>
+class MeshOptimizer
+{
+public:
+	/// <summary>
+	/// The FIFO size used when measuring ACMR (matches most desktop GPUs)
+	/// </summary>
+	static const size_t DefaultCacheSize = 16;
+
+	/// <summary>
+	/// Merges bit-identical vertices and builds an index list that references them
+	/// </summary>
+	/// <param name="vertices">Interleaved vertex data (triangle list)</param>
+	/// <param name="vertexCount">How many vertices are in the array</param>
+	/// <param name="floatsPerVertex">How many floats make up one vertex</param>
+	/// <param name="outVertices">Receives the unique vertices</param>
+	/// <param name="outIndices">Receives one index per input vertex</param>
+	static void WeldVertices(
+		const GLfloat* vertices,
+		size_t vertexCount,
+		size_t floatsPerVertex,
+		std::vector<GLfloat>& outVertices,
+		std::vector<GLuint>& outIndices);
+
+	/// <summary>
+	/// Reorders triangles in place for the post-transform vertex cache using
+	/// Tom Forsyth's linear-speed vertex cache optimisation
+	/// </summary>
+	/// <param name="indices">Triangle list indices to reorder</param>
+	/// <param name="vertexCount">How many unique vertices the indices reference</param>
+	static void OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount);
+
+	/// <summary>
+	/// Reorders the vertex buffer so vertices appear in the order they are first used,
+	/// which keeps vertex fetches sequential after OptimizeVertexCache
+	/// </summary>
+	static void OptimizeVertexFetch(
+		std::vector<GLfloat>& vertices,
+		size_t floatsPerVertex,
+		std::vector<GLuint>& indices);
+
+	/// <summary>
+	/// Average cache miss ratio: transformed vertices per triangle with a FIFO cache.
+	/// 3.0 is the worst case (no reuse), ~0.5 is the best case for large regular grids
+	/// </summary>
+	static float CalculateACMR(const std::vector<GLuint>& indices, size_t vertexCount, size_t cacheSize = DefaultCacheSize);
+};
@@ -0,0 +1,297 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+
+namespace
+{
+	//symmetric 4x4 matrix, stored as the upper triangle
+	struct Quadric
+	{
+		double a2, ab, ac, ad;
+		double b2, bc, bd;
+		double c2, cd;
+		double d2;
+
+		Quadric()
+		{
+			a2 = ab = ac = ad = b2 = bc = bd = c2 = cd = d2 = 0.0;
+		}
+
+		//quadric of the plane ax + by + cz + d = 0
+		Quadric(double a, double b, double c, double d)
+		{
+			a2 = a * a; ab = a * b; ac = a * c; ad = a * d;
+			b2 = b * b; bc = b * c; bd = b * d;
+			c2 = c * c; cd = c * d;
+			d2 = d * d;
+		}
+
+		void Add(const Quadric& q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+		}
+
+		//sum of squared distances from the point to every plane in the quadric
+		double Error(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double error = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+				+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+				+ c2 * z * z + 2 * cd * z
+				+ d2;
+			return error > 0.0 ? error : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		GLuint from;
+		GLuint to;
+		double cost;
+
+		bool operator<(const Collapse& other) const
+		{
+			return cost < other.cost;
+		}
+	};
+
+	//position of a vertex
+	glm::vec3 GetPosition(const std::vector<GLfloat>& vertices, size_t floatsPerVertex, GLuint v)
+	{
+		const GLfloat* p = &vertices[v * floatsPerVertex];
+		return glm::vec3(p[0], p[1], p[2]);
+	}
+
+	//checks whether moving 'from' onto 'to' would flip any of the triangles around 'from'
+	bool WouldFlip(const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices,
+		const std::vector<size_t>& adjacencyOffset, const std::vector<size_t>& adjacency,
+		GLuint from, GLuint to)
+	{
+		for (size_t a = adjacencyOffset[from]; a < adjacencyOffset[from + 1]; a++)
+		{
+			const GLuint* tri = &indices[adjacency[a] * 3];
+			if (tri[0] == to || tri[1] == to || tri[2] == to)
+			{
+				//this triangle disappears with the collapse
+				continue;
+			}
+
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			for (int k = 0; k < 3; k++)
+			{
+				before[k] = positions[tri[k]];
+				after[k] = tri[k] == from ? positions[to] : before[k];
+			}
+
+			glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+			float l0 = glm::length(n0);
+			float l1 = glm::length(n1);
+			if (l1 <= 0.0f || glm::dot(n0, n1) < 0.25f * l0 * l1)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+float MeshSimplifier::Simplify(const std::vector<GLfloat>& vertices, size_t floatsPerVertex,
+	const std::vector<GLuint>& indices, size_t targetIndexCount, std::vector<GLuint>& outIndices)
+{
+	size_t vertexCount = vertices.size() / floatsPerVertex;
+	outIndices = indices;
+	if (indices.size() <= targetIndexCount || vertexCount == 0)
+	{
+		return 0.0f;
+	}
+
+	std::vector<glm::vec3> positions(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		positions[v] = GetPosition(vertices, floatsPerVertex, (GLuint)v);
+	}
+
+	//vertices that share a position with another vertex sit on an attribute seam
+	//(e.g. a hard edge with two normals), collapsing them would tear the mesh open
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::vector<GLuint> byPosition(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			byPosition[v] = (GLuint)v;
+		}
+		std::sort(byPosition.begin(), byPosition.end(), [&positions](GLuint l, GLuint r) {
+			const glm::vec3& a = positions[l];
+			const glm::vec3& b = positions[r];
+			return a.x < b.x || (a.x == b.x && (a.y < b.y || (a.y == b.y && a.z < b.z)));
+		});
+		for (size_t i = 1; i < vertexCount; i++)
+		{
+			if (positions[byPosition[i]] == positions[byPosition[i - 1]])
+			{
+				locked[byPosition[i]] = true;
+				locked[byPosition[i - 1]] = true;
+			}
+		}
+	}
+
+	//edges only used by one triangle are on an open border, keep those in place too
+	{
+		std::unordered_map<unsigned long long, int> edgeUse;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint a = indices[i + k];
+				GLuint b = indices[i + (k + 1) % 3];
+				unsigned long long key = ((unsigned long long)std::min(a, b) << 32) | std::max(a, b);
+				edgeUse[key]++;
+			}
+		}
+		for (auto it = edgeUse.begin(); it != edgeUse.end(); ++it)
+		{
+			if (it->second == 1)
+			{
+				locked[(GLuint)(it->first >> 32)] = true;
+				locked[(GLuint)(it->first & 0xffffffffu)] = true;
+			}
+		}
+	}
+
+	//every vertex starts with the planes of the triangles around it
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		glm::vec3 p0 = positions[indices[i]];
+		glm::vec3 n = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+		float length = glm::length(n);
+		if (length <= 0.0f)
+		{
+			continue;
+		}
+		n /= length;
+		Quadric plane(n.x, n.y, n.z, -glm::dot(n, p0));
+		for (int k = 0; k < 3; k++)
+		{
+			quadrics[indices[i + k]].Add(plane);
+		}
+	}
+
+	double maxError = 0.0;
+	std::vector<GLuint> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<Collapse> collapses;
+
+	while (outIndices.size() > targetIndexCount)
+	{
+		size_t triCount = outIndices.size() / 3;
+
+		//vertex -> triangle adjacency for the current triangles
+		std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+		for (size_t i = 0; i < outIndices.size(); i++)
+		{
+			adjacencyOffset[outIndices[i] + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			adjacencyOffset[v + 1] += adjacencyOffset[v];
+		}
+		std::vector<size_t> adjacency(outIndices.size());
+		std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for (size_t i = 0; i < outIndices.size(); i++)
+		{
+			adjacency[fill[outIndices[i]]++] = i / 3;
+		}
+
+		//every directed edge whose start is free to move is a candidate
+		collapses.clear();
+		for (size_t i = 0; i < outIndices.size(); i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint from = outIndices[i + k];
+				GLuint to = outIndices[i + (k + 1) % 3];
+				if (locked[from])
+				{
+					continue;
+				}
+				Quadric q = quadrics[from];
+				q.Add(quadrics[to]);
+
+				Collapse collapse;
+				collapse.from = from;
+				collapse.to = to;
+				collapse.cost = q.Error(positions[to]);
+				collapses.push_back(collapse);
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		//each collapse removes about two triangles, stop once we'd pass the target
+		size_t targetTris = targetIndexCount / 3;
+		size_t removable = triCount > targetTris ? (triCount - targetTris + 1) / 2 : 0;
+
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			remap[v] = (GLuint)v;
+			touched[v] = false;
+		}
+
+		size_t performed = 0;
+		for (size_t c = 0; c < collapses.size() && performed < removable; c++)
+		{
+			const Collapse& collapse = collapses[c];
+			if (touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+			if (WouldFlip(positions, outIndices, adjacencyOffset, adjacency, collapse.from, collapse.to))
+			{
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			maxError = std::max(maxError, collapse.cost);
+			performed++;
+
+			//freeze the whole 1-ring so later collapses in this pass see valid geometry
+			for (size_t a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1]; a++)
+			{
+				const GLuint* tri = &outIndices[adjacency[a] * 3];
+				touched[tri[0]] = true;
+				touched[tri[1]] = true;
+				touched[tri[2]] = true;
+			}
+		}
+
+		if (performed == 0)
+		{
+			break;
+		}
+
+		//apply the collapses and drop the triangles that became degenerate
+		size_t write = 0;
+		for (size_t i = 0; i < outIndices.size(); i += 3)
+		{
+			GLuint a = remap[outIndices[i]];
+			GLuint b = remap[outIndices[i + 1]];
+			GLuint c = remap[outIndices[i + 2]];
+			if (a != b && b != c && a != c)
+			{
+				outIndices[write++] = a;
+				outIndices[write++] = b;
+				outIndices[write++] = c;
+			}
+		}
+		outIndices.resize(write);
+	}
+
+	return (float)sqrt(maxError);
+}
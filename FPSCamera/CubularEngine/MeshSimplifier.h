@@ -0,0 +1,28 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+/// <summary>
+/// Reduces the triangle count of an indexed mesh with quadric error metrics
+/// (Garland & Heckbert). Vertices are only ever collapsed onto existing vertices,
+/// so every level can share the original vertex buffer and only needs new indices.
+/// </summary>
+class MeshSimplifier
+{
+public:
+	/// <summary>
+	/// Simplifies a triangle list down to (at most) a target index count
+	/// </summary>
+	/// <param name="vertices">Interleaved vertices, position in the first 3 floats</param>
+	/// <param name="floatsPerVertex">How many floats make up one vertex</param>
+	/// <param name="indices">The triangle list to simplify</param>
+	/// <param name="targetIndexCount">How many indices we want to end up with</param>
+	/// <param name="outIndices">Receives the simplified triangle list</param>
+	/// <returns>The geometric error of the result, in model units</returns>
+	static float Simplify(
+		const std::vector<GLfloat>& vertices,
+		size_t floatsPerVertex,
+		const std::vector<GLuint>& indices,
+		size_t targetIndexCount,
+		std::vector<GLuint>& outIndices);
+};
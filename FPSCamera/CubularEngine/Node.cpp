@@ -1,4 +1,5 @@
 #include "Node.h"
+#include <algorithm>
 
 
 
@@ -16,15 +17,9 @@ Node::~Node()
 //removes the desired node from this nodes branches
 void Node::RemoveNode(Node *obj)
 {
+	//in place, keeping the order
 	if (numNodes > 0) {
-		vector<Node*> tempNodes;
-		for (size_t i = 0; i < numNodes; i++)
-		{
-			if (nodes[i] != obj) {
-				tempNodes.push_back(nodes[i]);
-			}
-		}
-		nodes = tempNodes;
+		nodes.erase(std::remove(nodes.begin(), nodes.end(), obj), nodes.end());
 		numNodes--;
 	}
 }
@@ -39,15 +34,9 @@ void Node::AddNode(Node *obj)
 //removes the desired object from this node
 void Node::RemoveObj(GameEntity * obj)
 {
+	//in place, keeping the order
 	if (numObjs > 0) {
-		vector<GameEntity*> tempObjs;
-		for (size_t i = 0; i < numObjs; i++)
-		{
-			if (objects[i] != obj) {
-				tempObjs.push_back(objects[i]);
-			}
-		}
-		objects = tempObjs;
+		objects.erase(std::remove(objects.begin(), objects.end(), obj), objects.end());
 		numObjs--;
 	}
 }
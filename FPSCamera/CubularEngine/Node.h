@@ -19,7 +19,7 @@ public:
 	void RemoveNode(Node *obj);
 	void AddNode(Node *obj);
 
-	vector<Node*> GetNodes() {
+	const vector<Node*>& GetNodes() const {
 		return nodes;
 	}
 
@@ -27,7 +27,7 @@ public:
 	void RemoveObj(GameEntity *obj);
 	void ClearObjs();
 
-	vector<GameEntity*> GetObjects() {
+	const vector<GameEntity*>& GetObjects() const {
 		return objects;
 	}
 	int GetNumObjs() {
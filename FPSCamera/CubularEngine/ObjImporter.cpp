@@ -0,0 +1,470 @@
+#include "ObjImporter.h"
+#include "AssetLoader.h"
+#include "AssetPack.h"
+#include <unordered_map>
+#include <iostream>
+#include <thread>
+#include <future>
+
+namespace
+{
+	//below this a file isn't worth splitting up
+	const size_t MinChunkSize = 256 * 1024;
+
+	//powers of ten that are exact in a double
+	const double PowersOf10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	//one face corner. negative OBJ indices count back from the vertices read so far, which
+	//a chunk can't know until the chunks before it are counted, so those are stored relative
+	//to the start of the chunk and fixed up after the merge
+	struct ObjCorner
+	{
+		int position;
+		int normal;             //-1 if the corner has no normal
+		unsigned char relative; //bit 0: position is chunk relative, bit 1: normal is
+	};
+
+	//everything one chunk of the file declared
+	struct ObjChunk
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<ObjCorner> corners;     //3 per triangle
+		bool valid = true;
+	};
+
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	inline const char* SkipSpace(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		while (p < end && *p != '\n')
+		{
+			p++;
+		}
+		return p < end ? p + 1 : end;
+	}
+
+	const char* ParseInt(const char* p, const char* end, int& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+		const char* start = p;
+		int value = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			value = value * 10 + (*p - '0');
+			p++;
+		}
+		if (p == start)
+		{
+			return start;
+		}
+		out = negative ? -value : value;
+		return p;
+	}
+
+	//reads up to 3 floats, missing ones stay 0
+	const char* ParseVec3(const char* p, const char* end, glm::vec3& out)
+	{
+		out = glm::vec3(0.0f);
+		for (int k = 0; k < 3; k++)
+		{
+			p = SkipSpace(p, end);
+			p = ObjImporter::ParseFloat(p, end, out[k]);
+		}
+		return p;
+	}
+
+	//OBJ indices are 1 based, negative ones count back from the end
+	inline bool ResolveIndex(int index, int localCount, int& out, bool& relative)
+	{
+		if (index > 0)
+		{
+			out = index - 1;
+			relative = false;
+			return true;
+		}
+		if (index < 0)
+		{
+			out = localCount + index;
+			relative = true;
+			return true;
+		}
+		return false;
+	}
+
+	//parses one "f a/b/c d/e/f ..." line, fanning polygons into triangles
+	const char* ParseFace(const char* p, const char* end, ObjChunk& chunk)
+	{
+		ObjCorner first, previous;
+		int cornerCount = 0;
+
+		while (true)
+		{
+			p = SkipSpace(p, end);
+			if (p >= end || *p == '\n' || *p == '\r' || *p == '#')
+			{
+				break;
+			}
+
+			int position = 0, normal = 0, texcoord = 0;
+			const char* next = ParseInt(p, end, position);
+			if (next == p)
+			{
+				chunk.valid = false;
+				break;
+			}
+			p = next;
+			if (p < end && *p == '/')
+			{
+				p++;
+				p = ParseInt(p, end, texcoord);
+				if (p < end && *p == '/')
+				{
+					p++;
+					p = ParseInt(p, end, normal);
+				}
+			}
+
+			ObjCorner corner;
+			bool relative = false;
+			corner.relative = 0;
+			if (!ResolveIndex(position, (int)chunk.positions.size(), corner.position, relative))
+			{
+				chunk.valid = false;
+				break;
+			}
+			corner.relative |= relative ? 1 : 0;
+			if (ResolveIndex(normal, (int)chunk.normals.size(), corner.normal, relative))
+			{
+				corner.relative |= relative ? 2 : 0;
+			}
+			else
+			{
+				corner.normal = -1;
+			}
+
+			if (cornerCount == 0)
+			{
+				first = corner;
+			}
+			else if (cornerCount >= 2)
+			{
+				chunk.corners.push_back(first);
+				chunk.corners.push_back(previous);
+				chunk.corners.push_back(corner);
+			}
+			previous = corner;
+			cornerCount++;
+		}
+		return p;
+	}
+
+	void ParseChunk(const char* p, const char* end, ObjChunk& chunk)
+	{
+		while (p < end)
+		{
+			p = SkipSpace(p, end);
+			if (p >= end)
+			{
+				break;
+			}
+
+			if (p[0] == 'v' && p + 1 < end)
+			{
+				if (IsSpace(p[1]))
+				{
+					glm::vec3 position;
+					p = ParseVec3(p + 2, end, position);
+					chunk.positions.push_back(position);
+				}
+				else if (p[1] == 'n' && p + 2 < end && IsSpace(p[2]))
+				{
+					glm::vec3 normal;
+					p = ParseVec3(p + 3, end, normal);
+					chunk.normals.push_back(normal);
+				}
+			}
+			else if (p[0] == 'f' && p + 1 < end && IsSpace(p[1]))
+			{
+				p = ParseFace(p + 2, end, chunk);
+			}
+
+			//comments, texcoords, groups, materials etc. are all skipped
+			p = SkipLine(p, end);
+		}
+	}
+}
+
+const char* ObjImporter::ParseFloat(const char* p, const char* end, float& out)
+{
+	const char* start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	//gather up to 19 significant digits, anything past that only moves the exponent
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool any = false;
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0)
+			{
+				digits++;
+			}
+		}
+		else
+		{
+			exponent++;
+		}
+		any = true;
+		p++;
+	}
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+				if (mantissa != 0)
+				{
+					digits++;
+				}
+			}
+			any = true;
+			p++;
+		}
+	}
+	if (!any)
+	{
+		return start;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		int power = 0;
+		const char* after = ParseInt(p + 1, end, power);
+		if (after != p + 1)
+		{
+			exponent += power;
+			p = after;
+		}
+	}
+
+	double value = (double)mantissa;
+	while (exponent > 22)
+	{
+		value *= 1e22;
+		exponent -= 22;
+	}
+	while (exponent < -22)
+	{
+		value /= 1e22;
+		exponent += 22;
+	}
+	value = exponent >= 0 ? value * PowersOf10[exponent] : value / PowersOf10[-exponent];
+
+	out = (float)(negative ? -value : value);
+	return p;
+}
+
+bool ObjImporter::Import(const std::string& path, std::vector<GLfloat>& outVertices, std::vector<GLuint>& outIndices)
+{
+	std::string storage;
+	AssetView view = AssetPack::GetInstance()->Load(path, storage);
+	if (!view.IsValid())
+	{
+		std::cout << "OBJ file not found: " << path << std::endl;
+		return false;
+	}
+	if (!Parse(view.data, view.size, outVertices, outIndices))
+	{
+		std::cout << "OBJ file is malformed: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool ObjImporter::Parse(const char* text, size_t size, std::vector<GLfloat>& outVertices, std::vector<GLuint>& outIndices)
+{
+	outVertices.clear();
+	outIndices.clear();
+
+	//split on line boundaries, one chunk per core at most. On a loader worker it's all done
+	//here, waiting on other workers from one could deadlock the pool.
+	size_t threads = AssetLoader::IsWorkerThread() ? 1 : std::thread::hardware_concurrency();
+	size_t chunkCount = size / MinChunkSize + 1;
+	if (threads > 0 && chunkCount > threads)
+	{
+		chunkCount = threads;
+	}
+
+	std::vector<const char*> bounds(chunkCount + 1);
+	bounds[0] = text;
+	bounds[chunkCount] = text + size;
+	for (size_t c = 1; c < chunkCount; c++)
+	{
+		const char* split = text + size * c / chunkCount;
+		if (split < bounds[c - 1])
+		{
+			split = bounds[c - 1];
+		}
+		bounds[c] = SkipLine(split, text + size);
+	}
+
+	//the first chunk is parsed on this thread while the workers do the rest
+	std::vector<ObjChunk> chunks(chunkCount);
+	std::vector<std::future<bool>> jobs;
+	for (size_t c = 1; c < chunkCount; c++)
+	{
+		const char* begin = bounds[c];
+		const char* end = bounds[c + 1];
+		ObjChunk* chunk = &chunks[c];
+		jobs.push_back(AssetLoader::GetInstance()->Run<bool>([begin, end, chunk]() {
+			ParseChunk(begin, end, *chunk);
+			return chunk->valid;
+		}));
+	}
+	ParseChunk(bounds[0], bounds[1], chunks[0]);
+
+	bool valid = chunks[0].valid;
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		valid = jobs[j].get() && valid;
+	}
+	if (!valid)
+	{
+		return false;
+	}
+
+	//merge the chunks, turning the relative indices absolute
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<ObjCorner> corners;
+	size_t cornerTotal = 0;
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		cornerTotal += chunks[c].corners.size();
+	}
+	corners.reserve(cornerTotal);
+
+	bool missingNormals = false;
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		ObjChunk& chunk = chunks[c];
+		int positionBase = (int)positions.size();
+		int normalBase = (int)normals.size();
+		for (size_t i = 0; i < chunk.corners.size(); i++)
+		{
+			ObjCorner corner = chunk.corners[i];
+			if (corner.relative & 1)
+			{
+				corner.position += positionBase;
+			}
+			if (corner.relative & 2)
+			{
+				corner.normal += normalBase;
+			}
+			missingNormals |= corner.normal < 0;
+			corners.push_back(corner);
+		}
+		positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+		normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+		chunk = ObjChunk();
+	}
+
+	for (size_t i = 0; i < corners.size(); i++)
+	{
+		if (corners[i].position < 0 || corners[i].position >= (int)positions.size()
+			|| corners[i].normal >= (int)normals.size())
+		{
+			return false;
+		}
+	}
+
+	//corners without a normal share an area weighted one per position
+	std::vector<glm::vec3> smoothNormals;
+	if (missingNormals)
+	{
+		smoothNormals.assign(positions.size(), glm::vec3(0.0f));
+		for (size_t i = 0; i < corners.size(); i += 3)
+		{
+			glm::vec3 p0 = positions[corners[i].position];
+			glm::vec3 faceNormal = glm::cross(positions[corners[i + 1].position] - p0, positions[corners[i + 2].position] - p0);
+			for (int k = 0; k < 3; k++)
+			{
+				smoothNormals[corners[i + k].position] += faceNormal;
+			}
+		}
+		for (size_t v = 0; v < smoothNormals.size(); v++)
+		{
+			float length = glm::length(smoothNormals[v]);
+			smoothNormals[v] = length > 0.0f ? smoothNormals[v] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+	}
+
+	//weld identical position/normal pairs, in the order they are first used
+	std::unordered_map<unsigned long long, GLuint> welded;
+	welded.reserve(corners.size() / 2);
+	outIndices.reserve(corners.size());
+	for (size_t i = 0; i < corners.size(); i++)
+	{
+		const ObjCorner& corner = corners[i];
+		unsigned long long key = ((unsigned long long)(unsigned int)corner.position << 32) | (unsigned int)(corner.normal + 1);
+		auto found = welded.find(key);
+		if (found != welded.end())
+		{
+			outIndices.push_back(found->second);
+			continue;
+		}
+
+		GLuint index = (GLuint)(outVertices.size() / 6);
+		welded.emplace(key, index);
+		outIndices.push_back(index);
+
+		glm::vec3 position = positions[corner.position];
+		glm::vec3 normal = corner.normal >= 0 ? normals[corner.normal] : smoothNormals[corner.position];
+		outVertices.push_back(position.x);
+		outVertices.push_back(position.y);
+		outVertices.push_back(position.z);
+		outVertices.push_back(normal.x);
+		outVertices.push_back(normal.y);
+		outVertices.push_back(normal.z);
+	}
+
+#ifdef _DEBUG
+	std::cout << "OBJ parsed in " << chunkCount << " chunks: " << positions.size() << " positions, "
+		<< outVertices.size() / 6 << " vertices, " << outIndices.size() / 3 << " triangles" << std::endl;
+#endif
+	return !outIndices.empty();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "stdafx.h"
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Wavefront OBJ reader. Big files are split into line-aligned chunks that are parsed on the
+/// AssetLoader workers with a hand-rolled number parser (no streams, no strtof), then the
+/// position/normal pairs are welded into one indexed triangle list.
+/// Only v, vn and f are used, polygons are fanned into triangles, and any corner without a
+/// normal gets a smooth one generated from the faces around its position.
+/// </summary>
+class ObjImporter
+{
+public:
+	/// <summary>
+	/// Reads an OBJ file (out of the asset pack if it's mounted) into engine vertices.
+	/// Waits on the worker pool, so call it from the main thread and not from a job.
+	/// </summary>
+	/// <param name="path">Path of the .obj file</param>
+	/// <param name="outVertices">Receives position + normal, 6 floats per vertex</param>
+	/// <param name="outIndices">Receives the triangle list</param>
+	/// <returns>False if the file is missing or malformed</returns>
+	static bool Import(const std::string& path, std::vector<GLfloat>& outVertices, std::vector<GLuint>& outIndices);
+
+	/// <summary>
+	/// Same as Import, from OBJ text that's already in memory
+	/// </summary>
+	static bool Parse(const char* text, size_t size, std::vector<GLfloat>& outVertices, std::vector<GLuint>& outIndices);
+
+	/// <summary>
+	/// Parses a decimal float ("-1.5e-3" style) starting at p
+	/// </summary>
+	/// <returns>Where parsing stopped, p itself if there was no number</returns>
+	static const char* ParseFloat(const char* p, const char* end, float& out);
+};
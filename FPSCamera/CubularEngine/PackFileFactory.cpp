@@ -0,0 +1,86 @@
+#include "PackFileFactory.h"
+#include "MemoryTracker.h"
+#include <cstring>
+
+irrklang::IFileReader* PackFileFactory::createFileReader(const irrklang::ik_c8* filename)
+{
+	//irrKlang's own allocations aren't seen, the readers it asks for are
+	MemoryScope audioMemory(MemoryTag::Audio);
+	AssetView view = AssetPack::GetInstance()->Find(filename);
+	if (view.IsValid())
+	{
+		return new PackFileReader(view, filename);
+	}
+
+	PackFileReader* reader = new PackFileReader(std::string(filename));
+	if (!reader->IsOpen())
+	{
+		reader->drop();
+		return 0;
+	}
+	return reader;
+}
+
+void PackFileFactory::Install(irrklang::ISoundEngine* engine)
+{
+	if (engine == nullptr)
+	{
+		return;
+	}
+	PackFileFactory* factory = new PackFileFactory();
+	engine->addFileFactory(factory);
+	factory->drop();
+}
+
+PackFileReader::PackFileReader(AssetView view, const std::string& name)
+{
+	this->view = view;
+	this->name = name;
+	position = 0;
+}
+
+PackFileReader::PackFileReader(const std::string& path)
+{
+	name = path;
+	position = 0;
+	if (looseFile.Open(path))
+	{
+		view.data = (const char*)looseFile.GetData();
+		view.size = looseFile.GetSize();
+	}
+}
+
+irrklang::ik_s32 PackFileReader::read(void* buffer, irrklang::ik_u32 sizeToRead)
+{
+	size_t remaining = view.size - (size_t)position;
+	size_t count = sizeToRead < remaining ? sizeToRead : remaining;
+	memcpy(buffer, view.data + position, count);
+	position += (irrklang::ik_s32)count;
+	return (irrklang::ik_s32)count;
+}
+
+bool PackFileReader::seek(irrklang::ik_s32 finalPos, bool relativeMovement)
+{
+	long long target = relativeMovement ? (long long)position + finalPos : finalPos;
+	if (target < 0 || target > (long long)view.size)
+	{
+		return false;
+	}
+	position = (irrklang::ik_s32)target;
+	return true;
+}
+
+irrklang::ik_s32 PackFileReader::getSize()
+{
+	return (irrklang::ik_s32)view.size;
+}
+
+irrklang::ik_s32 PackFileReader::getPos()
+{
+	return position;
+}
+
+const irrklang::ik_c8* PackFileReader::getFileName()
+{
+	return name.c_str();
+}
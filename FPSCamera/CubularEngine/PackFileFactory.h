@@ -0,0 +1,53 @@
+#pragma once
+#include "AssetPack.h"
+#include <irrKlang.h>
+
+/// <summary>
+/// Lets irrKlang read sounds out of the mounted AssetPack. Packed files are read straight
+/// from the mapping, anything else is memory-mapped on its own, so audio never goes
+/// through irrKlang's own file access. Add it with ISoundEngine::addFileFactory.
+/// </summary>
+class PackFileFactory : public irrklang::IFileFactory
+{
+public:
+	/// <summary>
+	/// Opens a sound, returns 0 if it's neither in the pack nor on disk
+	/// </summary>
+	virtual irrklang::IFileReader* createFileReader(const irrklang::ik_c8* filename);
+
+	/// <summary>
+	/// Makes a factory, gives it to the engine and drops our reference to it
+	/// </summary>
+	static void Install(irrklang::ISoundEngine* engine);
+};
+
+/// <summary>
+/// Reads from a view of memory, either into the pack or into a file it mapped itself
+/// </summary>
+class PackFileReader : public irrklang::IFileReader
+{
+private:
+	AssetView view;
+	MappedFile looseFile;   //only open for files that weren't packed
+	irrklang::ik_s32 position;
+	std::string name;
+
+public:
+	/// <summary>
+	/// Reads from the pack's memory
+	/// </summary>
+	PackFileReader(AssetView view, const std::string& name);
+
+	/// <summary>
+	/// Maps a loose file, check IsOpen() afterwards
+	/// </summary>
+	PackFileReader(const std::string& path);
+
+	bool IsOpen() const { return view.IsValid(); }
+
+	virtual irrklang::ik_s32 read(void* buffer, irrklang::ik_u32 sizeToRead);
+	virtual bool seek(irrklang::ik_s32 finalPos, bool relativeMovement = false);
+	virtual irrklang::ik_s32 getSize();
+	virtual irrklang::ik_s32 getPos();
+	virtual const irrklang::ik_c8* getFileName();
+};
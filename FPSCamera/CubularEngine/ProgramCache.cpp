@@ -0,0 +1,263 @@
+#include "ProgramCache.h"
+#include "MemoryTracker.h"
+#include "AssetLoader.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+
+//for singleton
+ProgramCache* ProgramCache::instance = nullptr;
+
+//tags the front of every cache file, followed by the binary format and length
+static const GLuint CacheFileMagic = 0x4e494250; //"PBIN"
+
+//glGetString can hand back null on a broken context
+static std::string GetString(GLenum name)
+{
+	const GLubyte* value = glGetString(name);
+	return value != nullptr ? (const char*)value : "";
+}
+
+ProgramCache::ProgramCache()
+{
+	cacheDirectory = "cache";
+	driver = GetString(GL_VENDOR) + "|" + GetString(GL_RENDERER) + "|" + GetString(GL_VERSION);
+
+	//some drivers expose the extension but support no formats at all
+	GLint formatCount = 0;
+	if (GLEW_ARB_get_program_binary)
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	}
+	binariesSupported = formatCount > 0;
+
+	//let the driver use as many compiler threads as it likes
+	parallelCompile = false;
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		parallelCompile = true;
+	}
+	else if (GLEW_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		parallelCompile = true;
+	}
+
+	if (binariesSupported)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(cacheDirectory, error);
+	}
+}
+
+ProgramCache::~ProgramCache()
+{
+	for (auto it = pending.begin(); it != pending.end(); ++it)
+	{
+		DeleteShaders(it->second);
+	}
+}
+
+ProgramCache* ProgramCache::GetInstance()
+{
+	if (instance == nullptr)
+	{
+		instance = new ProgramCache();
+	}
+	return instance;
+}
+
+void ProgramCache::Release()
+{
+	delete instance;
+	instance = nullptr;
+}
+
+std::string ProgramCache::MakeKey(const std::vector<ShaderSource>& sources) const
+{
+	unsigned long long hash = AssetLoader::HashBytes(driver);
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		hash = AssetLoader::HashBytes(std::to_string(sources[i].type), hash);
+		hash = AssetLoader::HashBytes(sources[i].code, hash);
+	}
+
+	char key[17];
+	snprintf(key, sizeof(key), "%016llx", hash);
+	return key;
+}
+
+std::string ProgramCache::GetCachePath(const std::string& key) const
+{
+	return cacheDirectory + "/" + key + ".bin";
+}
+
+bool ProgramCache::LoadBinary(GLuint program, const std::string& key)
+{
+	std::ifstream file(GetCachePath(key), std::ios::binary);
+	if (!file.good())
+	{
+		return false;
+	}
+
+	GLuint magic = 0;
+	GLenum format = 0;
+	GLuint length = 0;
+	file.read((char*)&magic, sizeof(magic));
+	file.read((char*)&format, sizeof(format));
+	file.read((char*)&length, sizeof(length));
+	if (!file.good() || magic != CacheFileMagic || length == 0)
+	{
+		return false;
+	}
+
+	std::vector<char> binary(length);
+	file.read(&binary[0], length);
+	if (!file.good())
+	{
+		return false;
+	}
+
+	//the link status tells us if the driver took it, checked in Finish
+	glProgramBinary(program, format, &binary[0], (GLsizei)length);
+	return true;
+}
+
+void ProgramCache::SaveBinary(GLuint program, const std::string& key)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		return;
+	}
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, nullptr, &format, &binary[0]);
+
+	std::ofstream file(GetCachePath(key), std::ios::binary);
+	if (!file.good())
+	{
+		return;
+	}
+	GLuint magic = CacheFileMagic;
+	GLuint size = (GLuint)length;
+	file.write((const char*)&magic, sizeof(magic));
+	file.write((const char*)&format, sizeof(format));
+	file.write((const char*)&size, sizeof(size));
+	file.write(&binary[0], length);
+}
+
+void ProgramCache::CompileFromSource(GLuint program, PendingProgram& entry)
+{
+	for (size_t i = 0; i < entry.sources.size(); i++)
+	{
+		Shader* shader = new Shader();
+		shader->InitFromString(entry.sources[i].code, entry.sources[i].type, false);
+		glAttachShader(program, shader->GetShaderLoc());
+		entry.shaders.push_back(shader);
+	}
+
+	if (binariesSupported)
+	{
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(program);
+	entry.fromBinary = false;
+}
+
+void ProgramCache::DeleteShaders(PendingProgram& entry)
+{
+	for (size_t i = 0; i < entry.shaders.size(); i++)
+	{
+		delete entry.shaders[i];
+	}
+	entry.shaders.clear();
+}
+
+GLuint ProgramCache::CreateProgram(const std::vector<ShaderSource>& sources)
+{
+	GLuint program = glCreateProgram();
+	MemoryTracker::TrackGpu(GpuResource::Program, program, 0, MemoryTag::Render);
+
+	PendingProgram& entry = pending[program];
+	entry.key = MakeKey(sources);
+	entry.sources = sources;
+	entry.fromBinary = binariesSupported && LoadBinary(program, entry.key);
+	if (!entry.fromBinary)
+	{
+		CompileFromSource(program, entry);
+	}
+	return program;
+}
+
+bool ProgramCache::IsReady(GLuint program) const
+{
+	if (!parallelCompile || pending.find(program) == pending.end())
+	{
+		return true;
+	}
+	GLint done = GL_FALSE;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+bool ProgramCache::Finish(GLuint program)
+{
+	auto it = pending.find(program);
+	if (it == pending.end())
+	{
+		return program != 0;
+	}
+	PendingProgram& entry = it->second;
+
+	GLint isLinked;
+	glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+
+	//a binary from another driver build, compile it properly and overwrite the file
+	if (!isLinked && entry.fromBinary)
+	{
+#ifdef _DEBUG
+		std::cout << "Cached program binary " << entry.key << " was rejected, compiling from source" << std::endl;
+#endif
+		CompileFromSource(program, entry);
+		glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+	}
+
+	if (!isLinked)
+	{
+		for (size_t i = 0; i < entry.shaders.size(); i++)
+		{
+			entry.shaders[i]->CheckCompileStatus();
+		}
+		char infolog[1024];
+		glGetProgramInfoLog(program, 1024, NULL, infolog);
+#ifdef _DEBUG
+		std::cout << "Shader Program linking failed with error: " << infolog << std::endl;
+#endif
+		DeleteShaders(entry);
+		pending.erase(it);
+		MemoryTracker::UntrackGpu(GpuResource::Program, program);
+		glDeleteProgram(program);
+		return false;
+	}
+
+	if (!entry.fromBinary && binariesSupported)
+	{
+		SaveBinary(program, entry.key);
+	}
+
+	//everything's in the program, we don't need these
+	DeleteShaders(entry);
+	pending.erase(it);
+	return true;
+}
+
+GLuint ProgramCache::Build(const std::vector<ShaderSource>& sources)
+{
+	GLuint program = CreateProgram(sources);
+	return Finish(program) ? program : 0;
+}
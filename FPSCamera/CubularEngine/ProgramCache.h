@@ -0,0 +1,103 @@
+#pragma once
+#include "stdafx.h"
+#include "Shader.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/// <summary>
+/// One stage of a program, as GLSL source
+/// </summary>
+struct ShaderSource
+{
+	GLenum type;
+	std::string code;
+};
+
+/// <summary>
+/// Singleton that builds shader programs and keeps their driver binaries on disk.
+/// Binaries are keyed by a hash of the sources and the GL vendor/renderer/version, so a
+/// driver update or an edited shader just misses the cache and compiles from source again.
+/// With KHR/ARB_parallel_shader_compile the driver compiles in the background, so a program
+/// can be started early and only waited on (Finish) right before it's first needed.
+/// </summary>
+class ProgramCache
+{
+private:
+	/// <summary>
+	/// Singleton implementation (private constructor & destructor)
+	/// </summary>
+	ProgramCache();
+	~ProgramCache();
+
+	static ProgramCache* instance;
+
+	//a program that's been started but not checked yet
+	struct PendingProgram
+	{
+		std::string key;
+		std::vector<ShaderSource> sources;
+		std::vector<Shader*> shaders;
+		bool fromBinary;
+	};
+
+	std::unordered_map<GLuint, PendingProgram> pending;
+
+	std::string driver;            //vendor, renderer & version, part of every key
+	std::string cacheDirectory;
+	bool binariesSupported;
+	bool parallelCompile;
+
+	std::string MakeKey(const std::vector<ShaderSource>& sources) const;
+	std::string GetCachePath(const std::string& key) const;
+
+	/// <summary>
+	/// Tries to fill the program from a cached binary
+	/// </summary>
+	bool LoadBinary(GLuint program, const std::string& key);
+
+	void SaveBinary(GLuint program, const std::string& key);
+
+	/// <summary>
+	/// Compiles and attaches every stage, then links (without waiting)
+	/// </summary>
+	void CompileFromSource(GLuint program, PendingProgram& entry);
+
+	void DeleteShaders(PendingProgram& entry);
+
+public:
+	/// <summary>
+	/// Singleton reference to the instance
+	/// </summary>
+	static ProgramCache* GetInstance();
+
+	/// <summary>
+	/// De-allocation
+	/// </summary>
+	static void Release();
+
+	/// <summary>
+	/// Starts building a program, from the binary cache if it can. The program may still be
+	/// compiling when this returns, call Finish before using it.
+	/// </summary>
+	/// <returns>The program's name</returns>
+	GLuint CreateProgram(const std::vector<ShaderSource>& sources);
+
+	/// <summary>
+	/// Whether Finish would return without waiting on the driver
+	/// </summary>
+	bool IsReady(GLuint program) const;
+
+	/// <summary>
+	/// Waits for the program to link, saves its binary if it came from source, and prints
+	/// the log if it didn't link. A stale binary falls back to compiling the source.
+	/// </summary>
+	/// <returns>Whether the program linked, it's deleted if it didn't</returns>
+	bool Finish(GLuint program);
+
+	/// <summary>
+	/// CreateProgram and Finish in one go
+	/// </summary>
+	/// <returns>The program, or 0 if it failed</returns>
+	GLuint Build(const std::vector<ShaderSource>& sources);
+};
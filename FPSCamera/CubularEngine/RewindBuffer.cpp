@@ -0,0 +1,436 @@
+#include "RewindBuffer.h"
+#include "Scene.h"
+#include "GameEntity.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	unsigned int FloatBits(float value)
+	{
+		unsigned int bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	float BitsFloat(unsigned int bits)
+	{
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	//small steps either way become small numbers
+	unsigned int ZigZag(int value)
+	{
+		return ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+	}
+
+	int UnZigZag(unsigned int value)
+	{
+		return (int)(value >> 1) ^ -(int)(value & 1);
+	}
+
+	void WriteVarint(std::vector<unsigned char>& bytes, unsigned long long value)
+	{
+		//7 bits at a time, the high bit says more follow
+		while (value >= 0x80)
+		{
+			bytes.push_back((unsigned char)(value & 0x7F) | 0x80);
+			value >>= 7;
+		}
+		bytes.push_back((unsigned char)value);
+	}
+
+	//the deltas are only ever read back by the buffer that wrote them, no bounds to check
+	unsigned long long ReadVarint(const unsigned char*& p)
+	{
+		unsigned long long value = 0;
+		for (int shift = 0; ; shift += 7)
+		{
+			unsigned char byte = *p++;
+			value |= (unsigned long long)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return value;
+			}
+		}
+	}
+}
+
+RewindBuffer::RewindBuffer(Scene* scene)
+{
+	this->scene = scene;
+	maxBytes = DefaultMaxBytes;
+	keyframeInterval = DefaultKeyframeInterval;
+	usedBytes = 0;
+}
+
+void RewindBuffer::SetLimits(size_t maxBytes, unsigned int keyframeInterval)
+{
+	this->maxBytes = maxBytes;
+	this->keyframeInterval = std::max(keyframeInterval, 1u);
+	Trim();
+}
+
+void RewindBuffer::Clear()
+{
+	segments.clear();
+	references.clear();
+	usedBytes = 0;
+}
+
+int RewindBuffer::Quantize(float value)
+{
+	double scaled = std::floor((double)value * QuantizeScale + 0.5);
+	if (!(scaled > (double)INT_MIN))
+	{
+		return INT_MIN;
+	}
+	if (scaled > (double)INT_MAX)
+	{
+		return INT_MAX;
+	}
+	return (int)scaled;
+}
+
+float RewindBuffer::Dequantize(int value)
+{
+	return (float)((double)value / QuantizeScale);
+}
+
+RewindBuffer::Reference RewindBuffer::MakeReference(const SavedBody& body, unsigned int generation)
+{
+	Reference reference;
+	reference.generation = generation;
+	reference.valid = true;
+	for (int c = 0; c < 3; c++)
+	{
+		reference.quantized[c] = Quantize(body.position[c]);
+		reference.quantized[3 + c] = Quantize(body.motion.velocity[c]);
+		reference.scaleBits[c] = FloatBits(body.scale[c]);
+	}
+	reference.massBits = FloatBits(body.motion.mass);
+	reference.flags = body.flags.bits;
+	reference.spinBits = FloatBits(body.animation.eulerAngles.y);
+	return reference;
+}
+
+size_t RewindBuffer::GetSegmentBytes(const Segment& segment)
+{
+	size_t bytes = sizeof(Segment);
+	bytes += segment.keyframe.bodies.capacity() * sizeof(SavedBody);
+	bytes += segment.handles.capacity() * sizeof(EntityHandle);
+	bytes += segment.deltas.capacity();
+	bytes += segment.offsets.capacity() * sizeof(size_t);
+	return bytes;
+}
+
+void RewindBuffer::DropFrom(unsigned long long tick)
+{
+	while (!segments.empty() && segments.back().tick >= tick)
+	{
+		usedBytes -= GetSegmentBytes(segments.back());
+		segments.pop_back();
+	}
+	if (segments.empty())
+	{
+		return;
+	}
+
+	//the deltas for the ticks before it stay
+	Segment& last = segments.back();
+	size_t keep = (size_t)(tick - last.tick - 1);
+	if (keep < last.offsets.size())
+	{
+		usedBytes -= GetSegmentBytes(last);
+		last.deltas.resize(last.offsets[keep]);
+		last.offsets.resize(keep);
+		usedBytes += GetSegmentBytes(last);
+	}
+}
+
+void RewindBuffer::Trim()
+{
+	while (usedBytes > maxBytes && segments.size() > 1)
+	{
+		usedBytes -= GetSegmentBytes(segments.front());
+		segments.pop_front();
+	}
+}
+
+void RewindBuffer::CloseSegment()
+{
+	if (segments.empty())
+	{
+		return;
+	}
+	Segment& last = segments.back();
+	usedBytes -= GetSegmentBytes(last);
+	last.deltas.shrink_to_fit();
+	last.offsets.shrink_to_fit();
+	usedBytes += GetSegmentBytes(last);
+}
+
+bool RewindBuffer::NeedsKeyframe(unsigned long long tick) const
+{
+	if (segments.empty() || tick != GetLastTick() + 1)
+	{
+		return true;
+	}
+	const Segment& last = segments.back();
+	if (last.offsets.size() + 1 >= keyframeInterval)
+	{
+		return true;
+	}
+
+	//what the segment comes to with one more delta the size of the last, counting the deltas
+	//doubling their storage if it doesn't fit, so the newest segment never outgrows its share
+	size_t lastDelta = last.offsets.empty() ? 0 : last.deltas.size() - last.offsets.back();
+	size_t bytes = GetSegmentBytes(last);
+	if (last.deltas.size() + lastDelta > last.deltas.capacity())
+	{
+		bytes += std::max(last.deltas.capacity(), lastDelta);
+	}
+	return bytes > maxBytes / 2;
+}
+
+void RewindBuffer::AddKeyframe(unsigned long long tick, SimState& state, const std::vector<EntityHandle>& handles)
+{
+	DropFrom(tick);
+	CloseSegment();
+
+	segments.emplace_back();
+	Segment& segment = segments.back();
+	segment.tick = tick;
+	segment.keyframe = std::move(state);
+	segment.handles = handles;
+	for (size_t m = 0; m < segment.keyframe.meshes.size(); m++)
+	{
+		segment.meshes.push_back(scene->GetMesh(segment.keyframe.meshes[m]));
+	}
+	for (size_t m = 0; m < segment.keyframe.materials.size(); m++)
+	{
+		segment.materials.push_back(scene->GetMaterial(segment.keyframe.materials[m]));
+	}
+
+	//the next delta is against this
+	references.assign(references.size(), Reference());
+	for (size_t b = 0; b < segment.handles.size(); b++)
+	{
+		EntityHandle handle = segment.handles[b];
+		if (handle.index >= references.size())
+		{
+			references.resize(handle.index + 1, Reference());
+		}
+		references[handle.index] = MakeReference(segment.keyframe.bodies[b], handle.generation);
+	}
+
+	usedBytes += GetSegmentBytes(segment);
+	Trim();
+}
+
+void RewindBuffer::AddDelta(const std::vector<GameEntity*>& active, const GameEntity* center, unsigned int stepsSinceSort)
+{
+	Segment& segment = segments.back();
+	usedBytes -= GetSegmentBytes(segment);
+	std::vector<unsigned char>& bytes = segment.deltas;
+	segment.offsets.push_back(bytes.size());
+
+	EntityWorld* world = EntityWorld::GetInstance();
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	size_t centerIndex = std::find(active.begin(), active.end(), center) - active.begin();
+	WriteVarint(bytes, stepsSinceSort);
+	WriteVarint(bytes, active.size());
+	WriteVarint(bytes, centerIndex);
+
+	for (size_t i = 0; i < active.size(); i++)
+	{
+		EntityHandle handle = active[i]->GetHandle();
+		WriteVarint(bytes, handle.index);
+		WriteVarint(bytes, handle.generation);
+		if (handle.index >= references.size())
+		{
+			references.resize(handle.index + 1, Reference());
+		}
+		Reference& reference = references[handle.index];
+
+		//one the last tick didn't have goes in whole, the decoder can tell from its own references
+		if (!reference.valid || reference.generation != handle.generation)
+		{
+			const Renderable* renderable = world->Get<Renderable>(handle);
+			size_t mesh = std::find(segment.meshes.begin(), segment.meshes.end(), renderable->mesh) - segment.meshes.begin();
+			if (mesh == segment.meshes.size())
+			{
+				segment.meshes.push_back(renderable->mesh);
+				segment.keyframe.meshes.push_back(scene->GetName(renderable->mesh));
+			}
+			size_t material = std::find(segment.materials.begin(), segment.materials.end(), renderable->material) - segment.materials.begin();
+			if (material == segment.materials.size())
+			{
+				segment.materials.push_back(renderable->material);
+				segment.keyframe.materials.push_back(scene->GetName(renderable->material));
+			}
+
+			SavedBody body = {};
+			body.mesh = (unsigned int)mesh;
+			body.material = (unsigned int)material;
+			SaveBody(handle, body);
+			const unsigned char* raw = reinterpret_cast<const unsigned char*>(&body);
+			bytes.insert(bytes.end(), raw, raw + sizeof(body));
+			reference = MakeReference(body, handle.generation);
+			continue;
+		}
+
+		TransformId transform = world->Get<Transform>(handle)->id;
+		glm::vec3 position = transforms->GetPosition(transform);
+		glm::vec3 scale = transforms->GetScale(transform);
+		const Motion* motion = world->Get<Motion>(handle);
+		for (int c = 0; c < 3; c++)
+		{
+			int quantized = Quantize(position[c]);
+			WriteVarint(bytes, ZigZag((int)((unsigned int)quantized - (unsigned int)reference.quantized[c])));
+			reference.quantized[c] = quantized;
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			int quantized = Quantize(motion->velocity[c]);
+			WriteVarint(bytes, ZigZag((int)((unsigned int)quantized - (unsigned int)reference.quantized[3 + c])));
+			reference.quantized[3 + c] = quantized;
+		}
+
+		unsigned int massBits = FloatBits(motion->mass);
+		WriteVarint(bytes, massBits ^ reference.massBits);
+		reference.massBits = massBits;
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int scaleBits = FloatBits(scale[c]);
+			WriteVarint(bytes, scaleBits ^ reference.scaleBits[c]);
+			reference.scaleBits[c] = scaleBits;
+		}
+		unsigned int flags = world->Get<EntityFlags>(handle)->bits;
+		WriteVarint(bytes, flags ^ reference.flags);
+		reference.flags = flags;
+		unsigned int spinBits = FloatBits(world->Get<Animation>(handle)->eulerAngles.y);
+		WriteVarint(bytes, spinBits ^ reference.spinBits);
+		reference.spinBits = spinBits;
+	}
+
+	//references of bodies that are gone stay behind, harmless: a handle that comes back has a new generation
+	usedBytes += GetSegmentBytes(segment);
+	Trim();
+}
+
+bool RewindBuffer::Reconstruct(unsigned long long tick, SimState& outState) const
+{
+	//the newest segment that starts at or before tick
+	size_t s = segments.size();
+	while (s > 0 && segments[s - 1].tick > tick)
+	{
+		s--;
+	}
+	if (s == 0 || tick > segments[s - 1].tick + segments[s - 1].offsets.size())
+	{
+		return false;
+	}
+	const Segment& segment = segments[s - 1];
+	outState = segment.keyframe;
+	if (tick == segment.tick)
+	{
+		return true;
+	}
+
+	//the bodies & references by handle index, as the encoder had them
+	std::vector<Reference> decoded;
+	std::vector<SavedBody> last;
+	for (size_t b = 0; b < segment.handles.size(); b++)
+	{
+		EntityHandle handle = segment.handles[b];
+		if (handle.index >= decoded.size())
+		{
+			decoded.resize(handle.index + 1, Reference());
+			last.resize(handle.index + 1);
+		}
+		decoded[handle.index] = MakeReference(segment.keyframe.bodies[b], handle.generation);
+		last[handle.index] = segment.keyframe.bodies[b];
+	}
+
+	size_t count = (size_t)(tick - segment.tick);
+	for (size_t d = 0; d < count; d++)
+	{
+		const unsigned char* p = segment.deltas.data() + segment.offsets[d];
+		outState.stepsSinceSort = (unsigned int)ReadVarint(p);
+		size_t bodyCount = (size_t)ReadVarint(p);
+		outState.center = (unsigned int)ReadVarint(p);
+		bool lastTick = d + 1 == count;
+		if (lastTick)
+		{
+			outState.bodies.clear();
+			outState.bodies.reserve(bodyCount);
+		}
+
+		for (size_t i = 0; i < bodyCount; i++)
+		{
+			EntityHandle handle;
+			handle.index = (unsigned int)ReadVarint(p);
+			handle.generation = (unsigned int)ReadVarint(p);
+			if (handle.index >= decoded.size())
+			{
+				decoded.resize(handle.index + 1, Reference());
+				last.resize(handle.index + 1);
+			}
+			Reference& reference = decoded[handle.index];
+			SavedBody& body = last[handle.index];
+
+			if (!reference.valid || reference.generation != handle.generation)
+			{
+				memcpy(&body, p, sizeof(body));
+				p += sizeof(body);
+				reference = MakeReference(body, handle.generation);
+			}
+			else
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					reference.quantized[c] = (int)((unsigned int)reference.quantized[c] + (unsigned int)UnZigZag((unsigned int)ReadVarint(p)));
+					body.position[c] = Dequantize(reference.quantized[c]);
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					reference.quantized[3 + c] = (int)((unsigned int)reference.quantized[3 + c] + (unsigned int)UnZigZag((unsigned int)ReadVarint(p)));
+					body.motion.velocity[c] = Dequantize(reference.quantized[3 + c]);
+				}
+				reference.massBits ^= (unsigned int)ReadVarint(p);
+				body.motion.mass = BitsFloat(reference.massBits);
+				for (int c = 0; c < 3; c++)
+				{
+					reference.scaleBits[c] ^= (unsigned int)ReadVarint(p);
+					body.scale[c] = BitsFloat(reference.scaleBits[c]);
+				}
+				reference.flags ^= (unsigned int)ReadVarint(p);
+				body.flags.bits = reference.flags;
+				unsigned int spinBits = reference.spinBits ^ (unsigned int)ReadVarint(p);
+				if (spinBits != reference.spinBits)
+				{
+					//the rotation follows the spin, as EntitySystems::Animate sets it
+					reference.spinBits = spinBits;
+					body.animation.eulerAngles.y = BitsFloat(spinBits);
+					body.rotation = glm::angleAxis(body.animation.eulerAngles.y, glm::vec3(0.f, 1.f, 0.f));
+				}
+			}
+
+			if (lastTick)
+			{
+				//they come back in the active list's order, which is then their storage order as well
+				body.activeIndex = (unsigned int)i;
+				outState.bodies.push_back(body);
+			}
+		}
+	}
+
+	outState.stepCount += count;
+	outState.hash = 0;
+	return true;
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include "stdafx.h"
+#include "SimStateFile.h"
+#include <deque>
+#include <vector>
+
+class Scene;
+class GameEntity;
+
+/// <summary>
+/// The last stretch of the simulation, kept so it can be scrubbed back and forth (e.g. to look at
+/// the merges the collision pass made). Storing every tick in full would take far too much at our
+/// body counts, so every keyframeInterval ticks there's a full SimState, and every tick in between
+/// is a delta against the tick before it: per body its handle, then how far its position & velocity
+/// moved in 1/QuantizeScale steps, and its mass, scale, flags & spin XORed with the last tick's bits,
+/// all as varints. A body that barely moved takes a byte or two per field, one that didn't change
+/// at all one byte. Bodies the last tick didn't have are stored whole, ones it had that are
+/// missing are gone.
+///
+/// A keyframe and the deltas after it form a segment. Segments are dropped oldest first to stay
+/// within maxBytes, so the buffer holds as much history as fits. The newest one can't be dropped,
+/// so a segment is cut short with an early keyframe before it grows past half of maxBytes (with
+/// lots of bodies that's well before keyframeInterval). Only a keyframe bigger than that on its
+/// own takes the history over budget.
+///
+/// Reconstructing a tick starts from the nearest keyframe before it and applies the deltas up to
+/// it. Keyframe ticks come back exactly, the ones in between with positions & velocities rounded
+/// to the nearest 1/QuantizeScale (everything else is exact).
+/// </summary>
+class RewindBuffer
+{
+private:
+	struct Segment
+	{
+		unsigned long long tick;            //the keyframe's, the deltas are for the ticks after it
+		SimState keyframe;
+		std::vector<EntityHandle> handles;  //keyframe.bodies' handles
+
+		std::vector<unsigned char> deltas;
+		std::vector<size_t> offsets;        //where each tick's delta starts in deltas
+
+		//meshes & materials the names in keyframe refer to, for new bodies in the deltas
+		std::vector<const Mesh*> meshes;
+		std::vector<const Material*> materials;
+	};
+
+	//what a tick's delta is taken against, by handle index
+	struct Reference
+	{
+		unsigned int generation;
+		bool valid;             //a body with this index & generation was in the last tick
+		int quantized[6];           //position, velocity
+		unsigned int massBits;
+		unsigned int scaleBits[3];
+		unsigned int flags;
+		unsigned int spinBits;      //Animation::eulerAngles.y
+	};
+
+	Scene* scene;
+	size_t maxBytes;
+	unsigned int keyframeInterval;
+
+	std::deque<Segment> segments;
+	size_t usedBytes;
+
+	//last tick's values by handle index, for the next delta
+	std::vector<Reference> references;
+
+	static int Quantize(float value);
+	static float Dequantize(int value);
+	static Reference MakeReference(const SavedBody& body, unsigned int generation);
+
+	static size_t GetSegmentBytes(const Segment& segment);
+
+	/// <summary>
+	/// Forgets tick and every one after it
+	/// </summary>
+	void DropFrom(unsigned long long tick);
+
+	/// <summary>
+	/// Drops the oldest segments until the history fits in maxBytes, the newest always stays
+	/// </summary>
+	void Trim();
+
+	/// <summary>
+	/// Gives back the slack the growing left in the newest segment's deltas, once it's complete
+	/// </summary>
+	void CloseSegment();
+
+public:
+	/// <summary>
+	/// Default size of the history
+	/// </summary>
+	static const size_t DefaultMaxBytes = 64 * 1024 * 1024;
+	static const unsigned int DefaultKeyframeInterval = 120;
+
+	/// <summary>
+	/// Positions & velocities between keyframes are kept to the nearest 1/1024th
+	/// </summary>
+	static const int QuantizeScale = 1024;
+
+	/// <param name="scene">Where the meshes & materials get their names from</param>
+	RewindBuffer(Scene* scene);
+
+	RewindBuffer(const RewindBuffer&) = delete;
+	RewindBuffer& operator=(const RewindBuffer&) = delete;
+
+	/// <summary>
+	/// How much history to keep, in bytes, and how often a full keyframe is stored. Drops what no longer fits.
+	/// </summary>
+	void SetLimits(size_t maxBytes, unsigned int keyframeInterval);
+
+	/// <summary>
+	/// Forgets everything, e.g. when the bodies were reset
+	/// </summary>
+	void Clear();
+
+	/// <summary>
+	/// Whether tick has to be stored as a keyframe (the first one, one after a gap or a rewind,
+	/// the interval is up or another delta would take the segment past half of maxBytes), in which
+	/// case AddKeyframe it, otherwise AddDelta
+	/// </summary>
+	bool NeedsKeyframe(unsigned long long tick) const;
+
+	/// <summary>
+	/// Stores tick in full. Anything stored from it on before is forgotten.
+	/// </summary>
+	/// <param name="state">The whole simulation, it's moved from</param>
+	/// <param name="handles">The handle of each of state's bodies</param>
+	void AddKeyframe(unsigned long long tick, SimState& state, const std::vector<EntityHandle>& handles);
+
+	/// <summary>
+	/// Stores the tick after the last one stored as a delta to it. Only when NeedsKeyframe() said no.
+	/// </summary>
+	/// <param name="active">The bodies, in the EntityPool's order</param>
+	/// <param name="center">The broadphase's center, one of them</param>
+	/// <param name="stepsSinceSort">When the next spatial sort is due</param>
+	void AddDelta(const std::vector<GameEntity*>& active, const GameEntity* center, unsigned int stepsSinceSort);
+
+	/// <summary>
+	/// Builds the state the simulation had at tick
+	/// </summary>
+	/// <returns>False if tick isn't in the history (anymore)</returns>
+	bool Reconstruct(unsigned long long tick, SimState& outState) const;
+
+	bool IsEmpty() const { return segments.empty(); }
+
+	/// <summary>
+	/// The oldest & newest ticks in the history
+	/// </summary>
+	unsigned long long GetFirstTick() const { return segments.empty() ? 0 : segments.front().tick; }
+	unsigned long long GetLastTick() const { return segments.empty() ? 0 : segments.back().tick + segments.back().offsets.size(); }
+
+	/// <summary>
+	/// Bytes the history takes up
+	/// </summary>
+	size_t GetMemoryUsed() const { return usedBytes; }
+};
@@ -0,0 +1,231 @@
+#include "Scene.h"
+#include "MeshGenerator.h"
+#include "TransformSystem.h"
+#include <iostream>
+
+Scene::Scene()
+{
+}
+
+Scene::~Scene()
+{
+	Clear();
+}
+
+void Scene::Clear()
+{
+	//entities in bound pools belong to the pool's owner
+	entities.Clear();
+	groupEntities.clear();
+
+	for (size_t m = 0; m < materials.size(); m++)
+	{
+		delete materials[m];
+	}
+	materials.clear();
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		delete meshes[m];
+	}
+	meshes.clear();
+	data = SceneData();
+}
+
+void Scene::RegisterProgram(const std::string& name, GLuint program)
+{
+	programs[name] = program;
+}
+
+void Scene::BindGroup(const std::string& name, EntityPool* pool)
+{
+	boundPools[name] = pool;
+}
+
+bool Scene::Load(const std::string& path)
+{
+	SceneData scene;
+	if (!SceneFile::Load(path, scene))
+	{
+		return false;
+	}
+	return Instantiate(scene);
+}
+
+bool Scene::Instantiate(const SceneData& scene)
+{
+	Clear();
+	data = scene;
+
+	//everything the file names has to exist before anything gets made
+	for (size_t m = 0; m < data.meshes.size(); m++)
+	{
+		if (programs.find(data.meshes[m].program) == programs.end())
+		{
+			std::cout << "Scene mesh " << data.meshes[m].name << " uses an unknown program: " << data.meshes[m].program << std::endl;
+			return false;
+		}
+	}
+	for (size_t m = 0; m < data.materials.size(); m++)
+	{
+		if (programs.find(data.materials[m].program) == programs.end())
+		{
+			std::cout << "Scene material " << data.materials[m].name << " uses an unknown program: " << data.materials[m].program << std::endl;
+			return false;
+		}
+	}
+
+	//spheres of the same detail share their generated vertices
+	std::map<int, std::pair<std::vector<GLfloat>, std::vector<GLuint>>> spheres;
+	for (size_t m = 0; m < data.meshes.size(); m++)
+	{
+		const SceneMesh& description = data.meshes[m];
+		Mesh* mesh = new Mesh();
+		meshes.push_back(mesh);
+		mesh->SetVertexLayout(description.compact ? VertexLayout::Compact() : VertexLayout::Default());
+		mesh->SetLODSettings(description.lods);
+
+		GLuint program = programs[description.program];
+		if (description.source == SceneMeshSource::Model)
+		{
+			if (!mesh->InitFromFile(description.path, program))
+			{
+				std::cout << "Scene mesh " << description.name << " failed to load: " << description.path << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			std::pair<std::vector<GLfloat>, std::vector<GLuint>>& sphere = spheres[description.subdivisions];
+			if (sphere.second.empty())
+			{
+				MeshGenerator::Icosphere(description.subdivisions, 0.5f, sphere.first, sphere.second);
+			}
+			mesh->InitWithIndexedArray(&sphere.first[0], sphere.first.size(), &sphere.second[0], sphere.second.size(), program);
+		}
+	}
+
+	//lit materials are shaded as seen from the scene's first camera
+	glm::vec3 viewPosition = data.cameras.empty() ? glm::vec3(0.0f) : data.cameras[0].position;
+	for (size_t m = 0; m < data.materials.size(); m++)
+	{
+		const SceneMaterial& description = data.materials[m];
+		GLuint program = programs[description.program];
+		if (description.lit)
+		{
+			materials.push_back(new Material(program, data.lightColor, description.color, data.lightPosition, viewPosition,
+				description.ambient, description.diffuse, description.specular, description.shininess));
+		}
+		else
+		{
+			materials.push_back(new Material(program, data.lightColor, description.color));
+		}
+	}
+
+	groupEntities.resize(data.groups.size());
+	for (size_t g = 0; g < data.groups.size(); g++)
+	{
+		SpawnGroup(data.groups[g].name);
+	}
+
+#ifdef _DEBUG
+	std::cout << "Scene created: " << meshes.size() << " meshes, " << materials.size() << " materials, "
+		<< data.entities.size() << " entities" << std::endl;
+#endif
+	return true;
+}
+
+bool Scene::SpawnGroup(const std::string& name)
+{
+	for (size_t g = 0; g < data.groups.size(); g++)
+	{
+		if (data.groups[g].name != name)
+		{
+			continue;
+		}
+
+		auto bound = boundPools.find(name);
+		EntityPool* pool = bound != boundPools.end() ? bound->second : &entities;
+
+		const SceneGroup& group = data.groups[g];
+		groupEntities[g].clear();
+		if (group.count > 0)
+		{
+			pool->SpawnBatch(&data.entities[group.first], group.count, meshes, materials, &groupEntities[g]);
+		}
+		return true;
+	}
+	return false;
+}
+
+const std::vector<GameEntity*>& Scene::GetGroup(const std::string& name) const
+{
+	static const std::vector<GameEntity*> none;
+	for (size_t g = 0; g < data.groups.size() && g < groupEntities.size(); g++)
+	{
+		if (data.groups[g].name == name)
+		{
+			return groupEntities[g];
+		}
+	}
+	return none;
+}
+
+Mesh* Scene::GetMesh(const std::string& name) const
+{
+	for (size_t m = 0; m < data.meshes.size(); m++)
+	{
+		if (data.meshes[m].name == name && m < meshes.size())
+		{
+			return meshes[m];
+		}
+	}
+	return nullptr;
+}
+
+Material* Scene::GetMaterial(const std::string& name) const
+{
+	for (size_t m = 0; m < data.materials.size(); m++)
+	{
+		if (data.materials[m].name == name && m < materials.size())
+		{
+			return materials[m];
+		}
+	}
+	return nullptr;
+}
+
+std::string Scene::GetName(const Mesh* mesh) const
+{
+	for (size_t m = 0; m < meshes.size() && m < data.meshes.size(); m++)
+	{
+		if (meshes[m] == mesh)
+		{
+			return data.meshes[m].name;
+		}
+	}
+	return std::string();
+}
+
+std::string Scene::GetName(const Material* material) const
+{
+	for (size_t m = 0; m < materials.size() && m < data.materials.size(); m++)
+	{
+		if (materials[m] == material)
+		{
+			return data.materials[m].name;
+		}
+	}
+	return std::string();
+}
+
+glm::vec3 Scene::GetCameraPosition(const std::string& name, glm::vec3 fallback) const
+{
+	for (size_t c = 0; c < data.cameras.size(); c++)
+	{
+		if (data.cameras[c].name == name)
+		{
+			return data.cameras[c].position;
+		}
+	}
+	return fallback;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "stdafx.h"
+#include "SceneFile.h"
+#include "GameEntity.h"
+#include "EntityPool.h"
+#include <map>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// The live version of a scene file: owns the meshes, materials and entities it describes.
+/// Each group is spawned as one batch into an EntityPool (one allocation however big it is),
+/// the scene's own pool unless the group was bound to another one, e.g. the simulation's.
+/// </summary>
+class Scene
+{
+private:
+	//programs the scene's meshes and materials can name
+	std::map<std::string, GLuint> programs;
+
+	SceneData data;
+	std::vector<Mesh*> meshes;
+	std::vector<Material*> materials;
+
+	//where the groups that weren't bound elsewhere live
+	EntityPool entities;
+
+	//pools that groups were bound to, by group name
+	std::map<std::string, EntityPool*> boundPools;
+
+	//the entities each group spawned last, by group index
+	std::vector<std::vector<GameEntity*>> groupEntities;
+
+	/// <summary>
+	/// Destroys everything that was created
+	/// </summary>
+	void Clear();
+
+public:
+	Scene();
+	~Scene();
+
+	/// <summary>
+	/// Entities can't move, the game holds pointers to them
+	/// </summary>
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	/// <summary>
+	/// Makes a shader program available to the scene under a name, before Load
+	/// </summary>
+	void RegisterProgram(const std::string& name, GLuint program);
+
+	/// <summary>
+	/// Spawns a group into another pool instead of the scene's, before Load. The scene
+	/// doesn't own those entities, whoever owns the pool does.
+	/// </summary>
+	void BindGroup(const std::string& name, EntityPool* pool);
+
+	/// <summary>
+	/// Reads a scene file (see SceneFile) and creates everything in it
+	/// </summary>
+	/// <returns>False if the file can't be read or names something that doesn't exist</returns>
+	bool Load(const std::string& path);
+
+	/// <summary>
+	/// Creates the meshes, materials and entities of an already loaded scene,
+	/// replacing whatever this scene held before
+	/// </summary>
+	bool Instantiate(const SceneData& scene);
+
+	/// <summary>
+	/// Spawns a group's entities again in their initial state (after the pool was cleared, to restart)
+	/// </summary>
+	/// <returns>False if there is no such group</returns>
+	bool SpawnGroup(const std::string& name);
+
+	/// <summary>
+	/// The entities a group spawned last, in file order. Empty if there is no such group.
+	/// </summary>
+	const std::vector<GameEntity*>& GetGroup(const std::string& name) const;
+
+	/// <summary>
+	/// A mesh or material by name, nullptr if the scene doesn't have it
+	/// </summary>
+	Mesh* GetMesh(const std::string& name) const;
+	Material* GetMaterial(const std::string& name) const;
+
+	/// <summary>
+	/// The name a mesh or material has in the scene, empty if it isn't one of the scene's
+	/// </summary>
+	std::string GetName(const Mesh* mesh) const;
+	std::string GetName(const Material* material) const;
+
+	/// <summary>
+	/// Where a named camera is placed, or the fallback if the scene doesn't place it
+	/// </summary>
+	glm::vec3 GetCameraPosition(const std::string& name, glm::vec3 fallback) const;
+};
@@ -0,0 +1,730 @@
+#include "SceneFile.h"
+#include "ObjImporter.h"
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include <unordered_map>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+namespace
+{
+	const char SceneMagic[4] = { 'C', 'S', 'C', 'N' };
+	const unsigned int SceneVersion = 1;
+
+	//the entity array starts on a cache line
+	const size_t SceneEntityAlignment = 64;
+
+	//front of a .scenebin file. the tables (meshes, materials, cameras, groups) follow it,
+	//then the SceneEntity array, unchanged from how it is laid out in memory
+	struct SceneBinaryHeader
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned int entitySize;            //sizeof(SceneEntity) of whoever wrote it
+		unsigned int meshCount;
+		unsigned int materialCount;
+		unsigned int cameraCount;
+		unsigned int groupCount;
+		unsigned int entityCount;
+		float lightPosition[3];
+		float lightColor[3];
+		unsigned long long tablesOffset;
+		unsigned long long entitiesOffset;
+	};
+
+	//splits one line of the text form into words and numbers
+	struct LineReader
+	{
+		const char* p;
+		const char* end;
+
+		void SkipSpace()
+		{
+			while (p < end && (*p == ' ' || *p == '\t'))
+			{
+				p++;
+			}
+		}
+
+		//true once only whitespace or a comment is left
+		bool AtEnd()
+		{
+			SkipSpace();
+			return p >= end || *p == '#';
+		}
+
+		bool Word(std::string& out)
+		{
+			if (AtEnd())
+			{
+				return false;
+			}
+			const char* start = p;
+			while (p < end && *p != ' ' && *p != '\t' && *p != '#')
+			{
+				p++;
+			}
+			out.assign(start, p);
+			return true;
+		}
+
+		bool Float(float& out)
+		{
+			SkipSpace();
+			const char* next = ObjImporter::ParseFloat(p, end, out);
+			if (next == p || (next < end && *next != ' ' && *next != '\t' && *next != '#'))
+			{
+				return false;
+			}
+			p = next;
+			return true;
+		}
+
+		bool Int(int& out)
+		{
+			float value;
+			if (!Float(value) || value != (float)(int)value)
+			{
+				return false;
+			}
+			out = (int)value;
+			return true;
+		}
+
+		bool Vec3(glm::vec3& out)
+		{
+			return Float(out.x) && Float(out.y) && Float(out.z);
+		}
+	};
+
+	//appends plain values & strings for the binary tables
+	struct TableWriter
+	{
+		std::vector<char> bytes;
+
+		void Raw(const void* data, size_t size)
+		{
+			bytes.insert(bytes.end(), (const char*)data, (const char*)data + size);
+		}
+
+		void UInt(unsigned int value) { Raw(&value, sizeof(value)); }
+		void Float(float value) { Raw(&value, sizeof(value)); }
+		void Vec3(const glm::vec3& value) { Raw(&value[0], sizeof(float) * 3); }
+
+		void String(const std::string& value)
+		{
+			UInt((unsigned int)value.size());
+			Raw(value.data(), value.size());
+		}
+	};
+
+	//the reading side, which refuses to run past the end of the data
+	struct TableReader
+	{
+		const char* p;
+		const char* end;
+
+		bool Raw(void* data, size_t size)
+		{
+			if ((size_t)(end - p) < size)
+			{
+				return false;
+			}
+			memcpy(data, p, size);
+			p += size;
+			return true;
+		}
+
+		bool UInt(unsigned int& value) { return Raw(&value, sizeof(value)); }
+		bool Float(float& value) { return Raw(&value, sizeof(value)); }
+		bool Vec3(glm::vec3& value) { return Raw(&value[0], sizeof(float) * 3); }
+
+		bool String(std::string& value)
+		{
+			unsigned int length;
+			if (!UInt(length) || (size_t)(end - p) < length)
+			{
+				return false;
+			}
+			value.assign(p, length);
+			p += length;
+			return true;
+		}
+	};
+
+	bool ParseMesh(LineReader& line, SceneMesh& mesh, std::string& error)
+	{
+		std::string source;
+		if (!line.Word(mesh.name) || !line.Word(source))
+		{
+			error = "expected: mesh name model|icosphere ...";
+			return false;
+		}
+
+		mesh.subdivisions = 0;
+		mesh.lods = 1;
+		mesh.compact = false;
+		if (source == "model")
+		{
+			mesh.source = SceneMeshSource::Model;
+			if (!line.Word(mesh.path))
+			{
+				error = "expected a model path";
+				return false;
+			}
+		}
+		else if (source == "icosphere")
+		{
+			mesh.source = SceneMeshSource::Icosphere;
+			if (!line.Int(mesh.subdivisions) || mesh.subdivisions < 0)
+			{
+				error = "expected an icosphere subdivision count";
+				return false;
+			}
+		}
+		else
+		{
+			error = "unknown mesh source '" + source + "'";
+			return false;
+		}
+
+		if (!line.Word(mesh.program))
+		{
+			error = "expected a program name";
+			return false;
+		}
+
+		std::string option;
+		while (line.Word(option))
+		{
+			if (option == "lods" && line.Int(mesh.lods) && mesh.lods > 0)
+			{
+				continue;
+			}
+			if (option == "compact")
+			{
+				mesh.compact = true;
+				continue;
+			}
+			error = "bad mesh option '" + option + "'";
+			return false;
+		}
+		return true;
+	}
+
+	bool ParseMaterial(LineReader& line, SceneMaterial& material, std::string& error)
+	{
+		std::string kind;
+		if (!line.Word(material.name) || !line.Word(kind) || !line.Word(material.program) || !line.Vec3(material.color))
+		{
+			error = "expected: material name flat|lit program r g b ...";
+			return false;
+		}
+
+		material.ambient = glm::vec3(0.0f);
+		material.diffuse = glm::vec3(0.0f);
+		material.specular = glm::vec3(0.0f);
+		material.shininess = 0.0f;
+		if (kind == "flat")
+		{
+			material.lit = false;
+			return true;
+		}
+		if (kind != "lit")
+		{
+			error = "unknown material kind '" + kind + "'";
+			return false;
+		}
+
+		material.lit = true;
+		std::string option;
+		while (line.Word(option))
+		{
+			bool valid = false;
+			if (option == "ambient")
+			{
+				valid = line.Vec3(material.ambient);
+			}
+			else if (option == "diffuse")
+			{
+				valid = line.Vec3(material.diffuse);
+			}
+			else if (option == "specular")
+			{
+				valid = line.Vec3(material.specular);
+			}
+			else if (option == "shininess")
+			{
+				valid = line.Float(material.shininess);
+			}
+			if (!valid)
+			{
+				error = "bad material option '" + option + "'";
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool ParseEntity(LineReader& line, const std::unordered_map<std::string, unsigned int>& meshes,
+		const std::unordered_map<std::string, unsigned int>& materials, SceneEntity& entity, std::string& error)
+	{
+		std::string mesh, material;
+		if (!line.Word(mesh) || !line.Word(material) || !line.Vec3(entity.position))
+		{
+			error = "expected: entity mesh material x y z ...";
+			return false;
+		}
+
+		auto foundMesh = meshes.find(mesh);
+		auto foundMaterial = materials.find(material);
+		if (foundMesh == meshes.end() || foundMaterial == materials.end())
+		{
+			error = "unknown mesh or material in '" + mesh + " " + material + "'";
+			return false;
+		}
+		entity.mesh = foundMesh->second;
+		entity.material = foundMaterial->second;
+		entity.rotation = glm::vec3(0.0f);
+		entity.scale = glm::vec3(1.0f);
+		entity.velocity = glm::vec3(0.0f);
+		entity.mass = 1.0f;
+		entity.flags = 0;
+
+		std::string option;
+		while (line.Word(option))
+		{
+			bool valid = false;
+			if (option == "rotation")
+			{
+				valid = line.Vec3(entity.rotation);
+			}
+			else if (option == "scale")
+			{
+				valid = line.Vec3(entity.scale);
+			}
+			else if (option == "velocity")
+			{
+				valid = line.Vec3(entity.velocity);
+			}
+			else if (option == "mass")
+			{
+				valid = line.Float(entity.mass);
+			}
+			else if (option == "attractor")
+			{
+				entity.flags |= SceneEntityAttractor;
+				valid = true;
+			}
+			if (!valid)
+			{
+				error = "bad entity option '" + option + "'";
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int SceneData::FindMesh(const std::string& name) const
+{
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		if (meshes[m].name == name)
+		{
+			return (int)m;
+		}
+	}
+	return -1;
+}
+
+int SceneData::FindMaterial(const std::string& name) const
+{
+	for (size_t m = 0; m < materials.size(); m++)
+	{
+		if (materials[m].name == name)
+		{
+			return (int)m;
+		}
+	}
+	return -1;
+}
+
+bool SceneFile::ParseText(const char* text, size_t size, SceneData& outScene, std::string& error)
+{
+	outScene = SceneData();
+	outScene.lightPosition = glm::vec3(0.0f);
+	outScene.lightColor = glm::vec3(1.0f);
+
+	//count the entities first so the array is allocated once
+	size_t entityLines = 0;
+	for (const char* p = text; p + 6 < text + size; p++)
+	{
+		if (*p == 'e' && (p == text || p[-1] == '\n') && strncmp(p, "entity", 6) == 0)
+		{
+			entityLines++;
+		}
+	}
+	outScene.entities.reserve(entityLines);
+
+	std::unordered_map<std::string, unsigned int> meshes;
+	std::unordered_map<std::string, unsigned int> materials;
+	std::string keyword;
+	std::string name;
+
+	const char* end = text + size;
+	const char* p = text;
+	for (int lineNumber = 1; p < end; lineNumber++)
+	{
+		const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+		if (lineEnd == nullptr)
+		{
+			lineEnd = end;
+		}
+		LineReader line = { p, lineEnd > p && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd };
+		p = lineEnd < end ? lineEnd + 1 : end;
+
+		if (!line.Word(keyword))
+		{
+			continue;
+		}
+
+		bool valid = true;
+		std::string lineError;
+		if (keyword == "entity")
+		{
+			SceneEntity entity;
+			valid = ParseEntity(line, meshes, materials, entity, lineError);
+			if (valid)
+			{
+				if (outScene.groups.empty())
+				{
+					SceneGroup group = { "default", 0, 0 };
+					outScene.groups.push_back(group);
+				}
+				outScene.groups.back().count++;
+				outScene.entities.push_back(entity);
+			}
+		}
+		else if (keyword == "group")
+		{
+			valid = line.Word(name);
+			for (size_t g = 0; valid && g < outScene.groups.size(); g++)
+			{
+				valid = outScene.groups[g].name != name;
+			}
+			if (valid)
+			{
+				SceneGroup group = { name, (unsigned int)outScene.entities.size(), 0 };
+				outScene.groups.push_back(group);
+			}
+			else
+			{
+				lineError = "expected a new group name (a group's entities have to be together)";
+			}
+		}
+		else if (keyword == "mesh")
+		{
+			SceneMesh mesh;
+			valid = ParseMesh(line, mesh, lineError);
+			if (valid)
+			{
+				meshes[mesh.name] = (unsigned int)outScene.meshes.size();
+				outScene.meshes.push_back(mesh);
+			}
+		}
+		else if (keyword == "material")
+		{
+			SceneMaterial material;
+			valid = ParseMaterial(line, material, lineError);
+			if (valid)
+			{
+				materials[material.name] = (unsigned int)outScene.materials.size();
+				outScene.materials.push_back(material);
+			}
+		}
+		else if (keyword == "camera")
+		{
+			SceneCamera camera;
+			valid = line.Word(camera.name) && line.Vec3(camera.position);
+			if (valid)
+			{
+				outScene.cameras.push_back(camera);
+			}
+			else
+			{
+				lineError = "expected: camera name x y z";
+			}
+		}
+		else if (keyword == "light")
+		{
+			valid = line.Vec3(outScene.lightPosition) && line.Vec3(outScene.lightColor);
+			if (!valid)
+			{
+				lineError = "expected: light x y z r g b";
+			}
+		}
+		else
+		{
+			valid = false;
+			lineError = "unknown statement '" + keyword + "'";
+		}
+
+		if (valid && !line.AtEnd())
+		{
+			valid = false;
+			lineError = "unexpected text at the end of the line";
+		}
+		if (!valid)
+		{
+			error = "line " + std::to_string(lineNumber) + ": " + lineError;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SceneFile::ParseBinary(const char* bytes, size_t size, SceneData& outScene)
+{
+	SceneBinaryHeader header;
+	if (size < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, bytes, sizeof(header));
+	if (memcmp(header.magic, SceneMagic, sizeof(header.magic)) != 0 || header.version != SceneVersion
+		|| header.entitySize != sizeof(SceneEntity)
+		|| header.tablesOffset > size || header.entitiesOffset > size
+		|| (size - header.entitiesOffset) / sizeof(SceneEntity) < header.entityCount)
+	{
+		return false;
+	}
+
+	outScene = SceneData();
+	outScene.lightPosition = glm::vec3(header.lightPosition[0], header.lightPosition[1], header.lightPosition[2]);
+	outScene.lightColor = glm::vec3(header.lightColor[0], header.lightColor[1], header.lightColor[2]);
+
+	TableReader tables = { bytes + header.tablesOffset, bytes + header.entitiesOffset };
+	outScene.meshes.resize(header.meshCount);
+	for (size_t m = 0; m < outScene.meshes.size(); m++)
+	{
+		SceneMesh& mesh = outScene.meshes[m];
+		unsigned int source, subdivisions, lods, compact;
+		if (!tables.String(mesh.name) || !tables.UInt(source) || !tables.String(mesh.path) || !tables.UInt(subdivisions)
+			|| !tables.String(mesh.program) || !tables.UInt(lods) || !tables.UInt(compact))
+		{
+			return false;
+		}
+		mesh.source = (SceneMeshSource)source;
+		mesh.subdivisions = (int)subdivisions;
+		mesh.lods = (int)lods;
+		mesh.compact = compact != 0;
+	}
+
+	outScene.materials.resize(header.materialCount);
+	for (size_t m = 0; m < outScene.materials.size(); m++)
+	{
+		SceneMaterial& material = outScene.materials[m];
+		unsigned int lit;
+		if (!tables.String(material.name) || !tables.String(material.program) || !tables.UInt(lit)
+			|| !tables.Vec3(material.color) || !tables.Vec3(material.ambient) || !tables.Vec3(material.diffuse)
+			|| !tables.Vec3(material.specular) || !tables.Float(material.shininess))
+		{
+			return false;
+		}
+		material.lit = lit != 0;
+	}
+
+	outScene.cameras.resize(header.cameraCount);
+	for (size_t c = 0; c < outScene.cameras.size(); c++)
+	{
+		if (!tables.String(outScene.cameras[c].name) || !tables.Vec3(outScene.cameras[c].position))
+		{
+			return false;
+		}
+	}
+
+	outScene.groups.resize(header.groupCount);
+	for (size_t g = 0; g < outScene.groups.size(); g++)
+	{
+		SceneGroup& group = outScene.groups[g];
+		if (!tables.String(group.name) || !tables.UInt(group.first) || !tables.UInt(group.count)
+			|| group.first > header.entityCount || group.count > header.entityCount - group.first)
+		{
+			return false;
+		}
+	}
+
+	//the big part is a straight copy
+	outScene.entities.resize(header.entityCount);
+	if (header.entityCount > 0)
+	{
+		memcpy(&outScene.entities[0], bytes + header.entitiesOffset, header.entityCount * sizeof(SceneEntity));
+	}
+	for (size_t e = 0; e < outScene.entities.size(); e++)
+	{
+		if (outScene.entities[e].mesh >= header.meshCount || outScene.entities[e].material >= header.materialCount)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SceneFile::WriteBinary(const std::string& path, const SceneData& scene)
+{
+	TableWriter tables;
+	for (size_t m = 0; m < scene.meshes.size(); m++)
+	{
+		const SceneMesh& mesh = scene.meshes[m];
+		tables.String(mesh.name);
+		tables.UInt((unsigned int)mesh.source);
+		tables.String(mesh.path);
+		tables.UInt((unsigned int)mesh.subdivisions);
+		tables.String(mesh.program);
+		tables.UInt((unsigned int)mesh.lods);
+		tables.UInt(mesh.compact ? 1 : 0);
+	}
+	for (size_t m = 0; m < scene.materials.size(); m++)
+	{
+		const SceneMaterial& material = scene.materials[m];
+		tables.String(material.name);
+		tables.String(material.program);
+		tables.UInt(material.lit ? 1 : 0);
+		tables.Vec3(material.color);
+		tables.Vec3(material.ambient);
+		tables.Vec3(material.diffuse);
+		tables.Vec3(material.specular);
+		tables.Float(material.shininess);
+	}
+	for (size_t c = 0; c < scene.cameras.size(); c++)
+	{
+		tables.String(scene.cameras[c].name);
+		tables.Vec3(scene.cameras[c].position);
+	}
+	for (size_t g = 0; g < scene.groups.size(); g++)
+	{
+		tables.String(scene.groups[g].name);
+		tables.UInt(scene.groups[g].first);
+		tables.UInt(scene.groups[g].count);
+	}
+
+	SceneBinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SceneMagic, sizeof(header.magic));
+	header.version = SceneVersion;
+	header.entitySize = sizeof(SceneEntity);
+	header.meshCount = (unsigned int)scene.meshes.size();
+	header.materialCount = (unsigned int)scene.materials.size();
+	header.cameraCount = (unsigned int)scene.cameras.size();
+	header.groupCount = (unsigned int)scene.groups.size();
+	header.entityCount = (unsigned int)scene.entities.size();
+	for (int k = 0; k < 3; k++)
+	{
+		header.lightPosition[k] = scene.lightPosition[k];
+		header.lightColor[k] = scene.lightColor[k];
+	}
+	header.tablesOffset = sizeof(header);
+	header.entitiesOffset = (sizeof(header) + tables.bytes.size() + SceneEntityAlignment - 1) / SceneEntityAlignment * SceneEntityAlignment;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.good())
+	{
+		return false;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write(tables.bytes.data(), tables.bytes.size());
+	std::vector<char> padding(header.entitiesOffset - sizeof(header) - tables.bytes.size(), 0);
+	file.write(padding.data(), padding.size());
+	if (!scene.entities.empty())
+	{
+		file.write((const char*)&scene.entities[0], scene.entities.size() * sizeof(SceneEntity));
+	}
+	return file.good();
+}
+
+std::string SceneFile::GetBinaryPath(const std::string& path)
+{
+	return std::filesystem::path(path).replace_extension(".scenebin").generic_string();
+}
+
+bool SceneFile::Load(const std::string& path, SceneData& outScene)
+{
+	AssetPack* pack = AssetPack::GetInstance();
+	std::string binaryPath = GetBinaryPath(path);
+	std::string storage;
+
+	if (pack->IsBuildFresh(path, binaryPath))
+	{
+		//mapped, so the entity array is only copied once, into outScene
+		MappedFile mapping;
+		AssetView view = pack->Find(binaryPath);
+		if (!view.IsValid() && mapping.Open(binaryPath))
+		{
+			view.data = (const char*)mapping.GetData();
+			view.size = mapping.GetSize();
+		}
+		if (view.IsValid() && ParseBinary(view.data, view.size, outScene))
+		{
+			return true;
+		}
+	}
+
+	AssetView view = pack->Load(path, storage);
+	if (!view.IsValid())
+	{
+		std::cout << "Scene not found: " << path << std::endl;
+		return false;
+	}
+
+	std::string error;
+	if (!ParseText(view.data, view.size, outScene, error))
+	{
+		std::cout << "Scene " << path << ", " << error << std::endl;
+		return false;
+	}
+
+	//next time this is one read & copy
+	if (!WriteBinary(binaryPath, outScene))
+	{
+		std::cout << "Couldn't write the binary scene: " << binaryPath << std::endl;
+	}
+	return true;
+}
+
+int SceneFile::CookDirectory(const std::string& directory)
+{
+	int failed = 0;
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator it(directory, error), end; it != end; it.increment(error))
+	{
+		if (!it->is_regular_file() || it->path().extension() != ".scene")
+		{
+			continue;
+		}
+
+		std::string path = it->path().generic_string();
+		std::ifstream file(path, std::ios::binary);
+		std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		SceneData scene;
+		std::string parseError;
+		if (!ParseText(text.data(), text.size(), scene, parseError))
+		{
+			std::cout << "Scene " << path << ", " << parseError << std::endl;
+			failed++;
+		}
+		else if (!WriteBinary(GetBinaryPath(path), scene))
+		{
+			std::cout << "Couldn't write the binary scene: " << GetBinaryPath(path) << std::endl;
+			failed++;
+		}
+		else
+		{
+			std::cout << "Cooked " << path << " -> " << GetBinaryPath(path) << std::endl;
+		}
+	}
+	return failed;
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include "stdafx.h"
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Where a scene mesh's vertices come from
+/// </summary>
+enum class SceneMeshSource
+{
+	Model,          //an OBJ file, loaded through its mesh cache
+	Icosphere       //MeshGenerator::Icosphere
+};
+
+/// <summary>
+/// A mesh the scene's entities can use
+/// </summary>
+struct SceneMesh
+{
+	std::string name;
+	SceneMeshSource source;
+	std::string path;           //model file, for SceneMeshSource::Model
+	int subdivisions;           //for SceneMeshSource::Icosphere
+	std::string program;        //name of the program the VAO is set up for
+	int lods;                   //most levels of detail to build
+	bool compact;               //VertexLayout::Compact instead of Default
+};
+
+/// <summary>
+/// A material, either flat colored or lit with the scene's light
+/// </summary>
+struct SceneMaterial
+{
+	std::string name;
+	std::string program;
+	bool lit;
+	glm::vec3 color;
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+	float shininess;
+};
+
+/// <summary>
+/// A named camera placement
+/// </summary>
+struct SceneCamera
+{
+	std::string name;
+	glm::vec3 position;
+};
+
+/// <summary>
+/// A named run of entities, entities[first, first + count)
+/// </summary>
+struct SceneGroup
+{
+	std::string name;
+	unsigned int first;
+	unsigned int count;
+};
+
+//SceneEntity::flags
+const unsigned int SceneEntityAttractor = 1;    //pulls the other bodies in (orbital = false)
+
+/// <summary>
+/// Initial state of one entity. Plain data, so the binary form stores the array as-is.
+/// </summary>
+struct SceneEntity
+{
+	unsigned int mesh;          //index into SceneData::meshes
+	unsigned int material;      //index into SceneData::materials
+	glm::vec3 position;
+	glm::vec3 rotation;         //euler angles
+	glm::vec3 scale;
+	glm::vec3 velocity;
+	float mass;
+	unsigned int flags;
+};
+
+/// <summary>
+/// Everything a scene file describes, before any of it is created
+/// </summary>
+struct SceneData
+{
+	glm::vec3 lightPosition;
+	glm::vec3 lightColor;
+	std::vector<SceneMesh> meshes;
+	std::vector<SceneMaterial> materials;
+	std::vector<SceneCamera> cameras;
+	std::vector<SceneGroup> groups;
+	std::vector<SceneEntity> entities;
+
+	/// <summary>
+	/// Index of a mesh or material by name, -1 if there is none
+	/// </summary>
+	int FindMesh(const std::string& name) const;
+	int FindMaterial(const std::string& name) const;
+};
+
+/// <summary>
+/// Reads and writes scene descriptions. The text form (.scene) is for people to edit, the
+/// binary form (.scenebin) is what gets loaded: a few small tables and the entity array
+/// exactly as it sits in memory, so a big scene is one copy instead of parsing every line.
+///
+/// Text form, one statement per line, '#' starts a comment:
+///   light x y z  r g b
+///   mesh name model path program [lods n] [compact]
+///   mesh name icosphere subdivisions program [lods n] [compact]
+///   material name flat program  r g b
+///   material name lit program  r g b  ambient r g b  diffuse r g b  specular r g b  shininess s
+///   camera name x y z
+///   group name                  (the entities after it belong to it)
+///   entity mesh material  x y z [rotation x y z] [scale x y z] [velocity x y z] [mass m] [attractor]
+/// </summary>
+class SceneFile
+{
+public:
+	/// <summary>
+	/// Loads a scene, from its binary form if that's newer than the text (or the only one there)
+	/// </summary>
+	/// <param name="path">Path of the .scene file</param>
+	/// <param name="outScene">Receives the scene</param>
+	/// <returns>False if neither form could be read</returns>
+	static bool Load(const std::string& path, SceneData& outScene);
+
+	/// <summary>
+	/// Parses the text form
+	/// </summary>
+	/// <param name="error">Receives "line n: what went wrong" on failure</param>
+	static bool ParseText(const char* text, size_t size, SceneData& outScene, std::string& error);
+
+	/// <summary>
+	/// Reads the binary form out of memory
+	/// </summary>
+	static bool ParseBinary(const char* bytes, size_t size, SceneData& outScene);
+
+	/// <summary>
+	/// Writes the binary form
+	/// </summary>
+	static bool WriteBinary(const std::string& path, const SceneData& scene);
+
+	/// <summary>
+	/// Where the binary form of a scene goes (same name, .scenebin extension)
+	/// </summary>
+	static std::string GetBinaryPath(const std::string& path);
+
+	/// <summary>
+	/// Converts every .scene under a folder to its binary form (for --cook)
+	/// </summary>
+	/// <returns>How many scenes failed</returns>
+	static int CookDirectory(const std::string& directory);
+};
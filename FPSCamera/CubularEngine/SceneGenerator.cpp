@@ -0,0 +1,249 @@
+#include "SceneGenerator.h"
+#include "AssetLoader.h"
+#include <future>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	//bodies per job, fixed so the random streams don't depend on the thread count
+	const size_t ChunkSize = 16384;
+
+	const float TwoPi = 6.28318530718f;
+
+	//splitmix64. the std distributions aren't the same across standard libraries,
+	//this gives the same numbers everywhere
+	struct Random
+	{
+		unsigned long long state;
+
+		unsigned long long Next()
+		{
+			unsigned long long z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		}
+
+		//[0, 1)
+		float Float()
+		{
+			return (float)(Next() >> 40) * (1.0f / 16777216.0f);
+		}
+
+		//[min, max)
+		float Range(float min, float max)
+		{
+			return min + (max - min) * Float();
+		}
+
+		//evenly spread over the unit sphere
+		glm::vec3 Direction()
+		{
+			float z = Range(-1.0f, 1.0f);
+			float angle = Range(0.0f, TwoPi);
+			float ring = sqrtf(1.0f - z * z);
+			return glm::vec3(ring * cosf(angle), ring * sinf(angle), z);
+		}
+	};
+
+	SceneEntity MakeBody(const GeneratorSettings& settings, glm::vec3 position, glm::vec3 velocity)
+	{
+		SceneEntity entity;
+		entity.mesh = settings.mesh;
+		entity.material = settings.material;
+		entity.position = position;
+		entity.rotation = glm::vec3(0.0f);
+		entity.scale = glm::vec3(settings.bodyScale);
+		entity.velocity = velocity;
+		entity.mass = settings.bodyMass;
+		entity.flags = 0;
+		return entity;
+	}
+
+	//Plummer (1911) sphere sampled as in Aarseth, Henon & Wielen (1974), in units of the
+	//scale length and total mass. the far tail is cut at 10 scale lengths. the velocities are
+	//the Newtonian ones, which EntitySystems::Attract doesn't keep in equilibrium
+	void PlummerBody(float scaleLength, float totalMass, float gravity, Random& random, glm::vec3& outPosition, glm::vec3& outVelocity)
+	{
+		float r;
+		do
+		{
+			float mass = random.Range(1e-6f, 1.0f);
+			r = 1.0f / sqrtf(powf(mass, -2.0f / 3.0f) - 1.0f);
+		} while (r > 10.0f);
+
+		//speed as a fraction q of the local escape speed, by rejection from q^2 (1 - q^2)^3.5
+		float q, g;
+		do
+		{
+			q = random.Float();
+			g = random.Range(0.0f, 0.1f);
+		} while (g > q * q * powf(1.0f - q * q, 3.5f));
+		float escape = sqrtf(2.0f) * powf(1.0f + r * r, -0.25f);
+
+		float velocityUnit = sqrtf(gravity * totalMass / scaleLength);
+		outPosition = random.Direction() * (r * scaleLength);
+		outVelocity = random.Direction() * (q * escape * velocityUnit);
+	}
+
+	void KeplerianDisk(const GeneratorSettings& settings, size_t index, Random& random, SceneEntity& out)
+	{
+		//body 0 is what everything orbits
+		if (index == 0)
+		{
+			out = MakeBody(settings, settings.center, glm::vec3(0.0f));
+			out.mass = settings.centralMass;
+			out.scale = glm::vec3(settings.bodyScale * 4.0f);
+			out.flags = SceneEntityAttractor;
+			return;
+		}
+
+		//even surface density between 10% and 100% of the radius, in the xz plane
+		float inner = settings.radius * 0.1f;
+		float r = sqrtf(random.Range(inner * inner, settings.radius * settings.radius));
+		float angle = random.Range(0.0f, TwoPi);
+		glm::vec3 radial = glm::vec3(cosf(angle), 0.0f, sinf(angle));
+		glm::vec3 tangent = glm::vec3(-radial.z, 0.0f, radial.x);
+		float height = random.Range(-0.5f, 0.5f) * settings.radius * 0.02f;
+
+		//EntitySystems::Attract pulls a body towards each attractor as hard as the body is fast,
+		//whatever the distance or masses, so a circular orbit needs v^2 / r = v, i.e. v = r
+		float speed = r;
+		out = MakeBody(settings, settings.center + radial * r + glm::vec3(0.0f, height, 0.0f), tangent * speed);
+	}
+
+	void PlummerSphere(const GeneratorSettings& settings, size_t index, Random& random, SceneEntity& out)
+	{
+		glm::vec3 position, velocity;
+		PlummerBody(settings.radius, settings.bodyMass * settings.count, settings.gravity, random, position, velocity);
+		out = MakeBody(settings, settings.center + position, velocity);
+	}
+
+	void CollidingClusters(const GeneratorSettings& settings, size_t index, Random& random, SceneEntity& out)
+	{
+		//half the bodies in each, starting 6 scale lengths apart and slightly off center
+		size_t half = (settings.count + 1) / 2;
+		float side = index < half ? -1.0f : 1.0f;
+		float clusterRadius = settings.radius * 0.5f;
+		glm::vec3 offset = glm::vec3(side * clusterRadius * 3.0f, side * clusterRadius * 0.5f, 0.0f);
+		glm::vec3 drift = glm::vec3(-side * settings.speed, 0.0f, 0.0f);
+
+		glm::vec3 position, velocity;
+		PlummerBody(clusterRadius, settings.bodyMass * half, settings.gravity, random, position, velocity);
+		out = MakeBody(settings, settings.center + offset + position, drift + velocity);
+	}
+
+	void UniformCube(const GeneratorSettings& settings, size_t index, Random& random, SceneEntity& out)
+	{
+		float r = settings.radius;
+		glm::vec3 position = glm::vec3(random.Range(-r, r), random.Range(-r, r), random.Range(-r, r));
+		glm::vec3 velocity = glm::vec3(random.Range(-1.0f, 1.0f), random.Range(-1.0f, 1.0f), random.Range(-1.0f, 1.0f)) * settings.speed;
+		out = MakeBody(settings, settings.center + position, velocity);
+	}
+
+	typedef void(*BodyGenerator)(const GeneratorSettings&, size_t, Random&, SceneEntity&);
+
+	BodyGenerator GetBodyGenerator(GeneratorKind kind)
+	{
+		switch (kind)
+		{
+		case GeneratorKind::KeplerianDisk:
+			return KeplerianDisk;
+		case GeneratorKind::PlummerSphere:
+			return PlummerSphere;
+		case GeneratorKind::CollidingClusters:
+			return CollidingClusters;
+		default:
+			return UniformCube;
+		}
+	}
+}
+
+bool SceneGenerator::ParseKind(const std::string& name, GeneratorKind& outKind)
+{
+	if (name == "disk")
+	{
+		outKind = GeneratorKind::KeplerianDisk;
+	}
+	else if (name == "plummer")
+	{
+		outKind = GeneratorKind::PlummerSphere;
+	}
+	else if (name == "clusters")
+	{
+		outKind = GeneratorKind::CollidingClusters;
+	}
+	else if (name == "cube")
+	{
+		outKind = GeneratorKind::UniformCube;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+void SceneGenerator::Generate(GeneratorKind kind, const GeneratorSettings& settings, SceneEntity* outEntities)
+{
+	BodyGenerator body = GetBodyGenerator(kind);
+	size_t chunkCount = (settings.count + ChunkSize - 1) / ChunkSize;
+
+	auto generateChunk = [body, &settings, outEntities](size_t chunk) {
+		Random random;
+		random.state = AssetLoader::HashBytes((const char*)&chunk, sizeof(chunk), settings.seed);
+		size_t end = std::min(settings.count, (chunk + 1) * ChunkSize);
+		for (size_t i = chunk * ChunkSize; i < end; i++)
+		{
+			body(settings, i, random, outEntities[i]);
+		}
+		return true;
+	};
+
+	//the first chunk is done here while the workers take the rest
+	std::vector<std::future<bool>> jobs;
+	for (size_t chunk = 1; chunk < chunkCount; chunk++)
+	{
+		jobs.push_back(AssetLoader::GetInstance()->Run<bool>([generateChunk, chunk]() { return generateChunk(chunk); }));
+	}
+	if (chunkCount > 0)
+	{
+		generateChunk(0);
+	}
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		jobs[j].get();
+	}
+}
+
+void SceneGenerator::ReplaceGroup(SceneData& scene, const std::string& group, GeneratorKind kind, const GeneratorSettings& settings)
+{
+	//take the old group out and close the gap, the new one goes on the end
+	for (size_t g = 0; g < scene.groups.size(); g++)
+	{
+		if (scene.groups[g].name != group)
+		{
+			continue;
+		}
+		SceneGroup removed = scene.groups[g];
+		scene.entities.erase(scene.entities.begin() + removed.first, scene.entities.begin() + removed.first + removed.count);
+		scene.groups.erase(scene.groups.begin() + g);
+		for (size_t other = 0; other < scene.groups.size(); other++)
+		{
+			if (scene.groups[other].first > removed.first)
+			{
+				scene.groups[other].first -= removed.count;
+			}
+		}
+		break;
+	}
+
+	SceneGroup generated = { group, (unsigned int)scene.entities.size(), (unsigned int)settings.count };
+	scene.groups.push_back(generated);
+	scene.entities.resize(scene.entities.size() + settings.count);
+	if (settings.count > 0)
+	{
+		Generate(kind, settings, &scene.entities[generated.first]);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "stdafx.h"
+#include "SceneFile.h"
+#include <string>
+
+/// <summary>
+/// The kinds of body distributions SceneGenerator can make
+/// </summary>
+enum class GeneratorKind
+{
+	KeplerianDisk,      //a thin disk on circular orbits around a heavy attractor
+	PlummerSphere,      //a cluster where every body attracts, with Newtonian Plummer velocities
+	CollidingClusters,  //two Plummer spheres heading into each other
+	UniformCube         //evenly spread through a cube with small random velocities
+};
+
+/// <summary>
+/// What to generate. The radius is the disk's outer radius, the Plummer scale length or
+/// the cube's half size depending on the kind.
+/// </summary>
+struct GeneratorSettings
+{
+	unsigned long long seed = 1;
+	size_t count = 1000;
+	unsigned int mesh = 0;          //index into SceneData::meshes
+	unsigned int material = 0;      //index into SceneData::materials
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 50.0f;
+	float bodyMass = 1.0f;
+	float bodyScale = 0.5f;
+	float centralMass = 1000.0f;    //the disk's attractor
+	float gravity = 1.0f;           //G the Plummer velocities are worked out with
+	float speed = 1.0f;             //random velocity (cube), approach speed (clusters)
+};
+
+/// <summary>
+/// Seeded initial conditions for big stress test scenes, written straight into the
+/// scene's entity array. The bodies are made in fixed size chunks on the AssetLoader
+/// workers, each chunk with its own random stream seeded from the seed and the chunk,
+/// so the same settings give the same scene on any machine and any number of threads.
+/// </summary>
+class SceneGenerator
+{
+public:
+	/// <summary>
+	/// Reads "disk", "plummer", "clusters" or "cube"
+	/// </summary>
+	static bool ParseKind(const std::string& name, GeneratorKind& outKind);
+
+	/// <summary>
+	/// Fills settings.count entities. Waits on the worker pool, so call it from the main thread.
+	/// </summary>
+	/// <param name="outEntities">Where to write, room for settings.count entities</param>
+	static void Generate(GeneratorKind kind, const GeneratorSettings& settings, SceneEntity* outEntities);
+
+	/// <summary>
+	/// Swaps a group's entities for generated ones (making the group if it doesn't exist)
+	/// </summary>
+	static void ReplaceGroup(SceneData& scene, const std::string& group, GeneratorKind kind, const GeneratorSettings& settings);
+};
@@ -1,4 +1,5 @@
 #include "Shader.h"
+#include "AssetPack.h"
 
 Shader::Shader()
 {
@@ -12,10 +13,12 @@ Shader::~Shader()
 
 bool Shader::InitFromFile(std::string filePath, GLenum shaderType)
 {
-	std::ifstream file(filePath);
+	// Packed shaders come out of the asset pack, the rest straight from disk.
+	std::string storage;
+	AssetView file = AssetPack::GetInstance()->Load(filePath, storage);
 
 	// Check if the file exists
-	if (!file.good())
+	if (!file.IsValid())
 	{
 #ifdef _DEBUG
 		// If we encounter an error, print a message and return false.
@@ -24,29 +27,11 @@ bool Shader::InitFromFile(std::string filePath, GLenum shaderType)
 		return false;
 	}
 
-	// ifstream internally keeps track of where in the file.
-
-	// Here we find the end of the file.
-	file.seekg(0, std::ios::end);
-
-	// Make a string and set its size equal to the length of the file.
-	std::string shaderCode;
-	shaderCode.resize((size_t)file.tellg());
-
-	// Go back to the beginning of the file.
-	file.seekg(0, std::ios::beg);
-
-	// Read the file into the string until we reach the end of the string.
-	file.read(&shaderCode[0], shaderCode.size());
-
-	// Close the file.
-	file.close();
-
 	// Init using the string.
-	return InitFromString(shaderCode, shaderType);
+	return InitFromString(std::string(file.data, file.size), shaderType);
 }
 
-bool Shader::InitFromString(std::string shaderCode, GLenum shaderType)
+bool Shader::InitFromString(std::string shaderCode, GLenum shaderType, bool waitForCompile)
 {
 	// Get the char* and length
 	const char* shaderCodePointer = shaderCode.data();
@@ -58,6 +43,16 @@ bool Shader::InitFromString(std::string shaderCode, GLenum shaderType)
 	glShaderSource(shaderLoc, 1, &shaderCodePointer, &shaderCodeLength);
 	glCompileShader(shaderLoc);
 
+	// Asking for the status makes us wait on the compile, leave that for later if asked to.
+	if (!waitForCompile)
+	{
+		return true;
+	}
+	return CheckCompileStatus();
+}
+
+bool Shader::CheckCompileStatus()
+{
 	GLint isCompiled;
 
 	// Check if the fragmentShader compiles:
@@ -82,4 +77,3 @@ bool Shader::InitFromString(std::string shaderCode, GLenum shaderType)
 		return true;
 	}
 }
-
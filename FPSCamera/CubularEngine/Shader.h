@@ -27,8 +27,16 @@ public:
 	/// </summary>
 	/// <param name="shaderCode">A string that makes up the .glsl file</param>
 	/// <param name="shaderType">GLenum representing the type</param>
+	/// <param name="waitForCompile">False to return right away and call CheckCompileStatus later,
+	/// so a driver with parallel compilation can work on it in the background</param>
 	/// <returns>Wether or note the compilation succeeds</returns>
-	bool InitFromString(std::string shaderCode, GLenum shaderType);
+	bool InitFromString(std::string shaderCode, GLenum shaderType, bool waitForCompile = true);
+
+	/// <summary>
+	/// Waits for the compile to finish and prints the log if it failed (the shader is deleted then)
+	/// </summary>
+	/// <returns>Wether or note the compilation succeeded</returns>
+	bool CheckCompileStatus();
 
 	///<summary>The location of the shader</summary>
 	GLuint GetShaderLoc() const { return shaderLoc; }
@@ -0,0 +1,230 @@
+#include "ShaderVariantBuilder.h"
+#include "AssetLoader.h"
+#include <algorithm>
+#include <sstream>
+#include <iostream>
+
+//for singleton
+ShaderVariantBuilder* ShaderVariantBuilder::instance = nullptr;
+
+//the directory part of a path, including the trailing slash
+static std::string GetDirectory(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+//strips leading spaces & tabs
+static std::string TrimStart(const std::string& line)
+{
+	size_t start = line.find_first_not_of(" \t");
+	return start == std::string::npos ? "" : line.substr(start);
+}
+
+ShaderVariantBuilder::ShaderVariantBuilder()
+{
+}
+
+ShaderVariantBuilder::~ShaderVariantBuilder()
+{
+}
+
+ShaderVariantBuilder* ShaderVariantBuilder::GetInstance()
+{
+	if (instance == nullptr)
+	{
+		instance = new ShaderVariantBuilder();
+	}
+	return instance;
+}
+
+void ShaderVariantBuilder::Release()
+{
+	delete instance;
+	instance = nullptr;
+}
+
+void ShaderVariantBuilder::Prefetch(const std::vector<std::string>& paths)
+{
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		if (files.find(paths[i]) == files.end())
+		{
+			files[paths[i]] = AssetLoader::GetInstance()->ReadFileAsync(paths[i]).share();
+		}
+	}
+}
+
+const std::string& ShaderVariantBuilder::ReadSource(const std::string& path)
+{
+	Prefetch({ path });
+	return files[path].get();
+}
+
+bool ShaderVariantBuilder::ExpandIncludes(const std::string& path, std::vector<std::string>& included, std::string& out)
+{
+	const std::string& source = ReadSource(path);
+	if (source.empty())
+	{
+#ifdef _DEBUG
+		std::cout << "Can't read shader file: " << path << std::endl;
+#endif
+		return false;
+	}
+
+	//the #line source number is the file's position in the include list
+	int fileIndex = (int)included.size();
+	included.push_back(path);
+
+	std::istringstream lines(source);
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(lines, line))
+	{
+		lineNumber++;
+		std::string trimmed = TrimStart(line);
+		if (trimmed.compare(0, 8, "#include") != 0)
+		{
+			out += line;
+			out += '\n';
+			continue;
+		}
+
+		size_t open = trimmed.find('"');
+		size_t close = open == std::string::npos ? std::string::npos : trimmed.find('"', open + 1);
+		if (close == std::string::npos)
+		{
+#ifdef _DEBUG
+			std::cout << path << "(" << lineNumber << "): malformed #include" << std::endl;
+#endif
+			return false;
+		}
+
+		//includes are relative to the file they're in
+		std::string includePath = GetDirectory(path) + trimmed.substr(open + 1, close - open - 1);
+		if (std::find(included.begin(), included.end(), includePath) == included.end())
+		{
+			out += "#line 1 " + std::to_string(included.size()) + "\n";
+			if (!ExpandIncludes(includePath, included, out))
+			{
+				return false;
+			}
+		}
+		out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+	}
+	return true;
+}
+
+std::string ShaderVariantBuilder::Preprocess(const std::string& path, const std::vector<std::string>& defines)
+{
+	std::vector<std::string> included;
+	std::string expanded;
+	if (!ExpandIncludes(path, included, expanded))
+	{
+		return "";
+	}
+
+	std::string defineBlock;
+	for (size_t i = 0; i < defines.size(); i++)
+	{
+		std::string define = defines[i];
+		size_t equals = define.find('=');
+		if (equals != std::string::npos)
+		{
+			define[equals] = ' ';
+		}
+		defineBlock += "#define " + define + "\n";
+	}
+
+	//#version has to stay the first directive, so the defines go right after it
+	size_t lineStart = 0;
+	for (int lineNumber = 1; lineStart < expanded.size(); lineNumber++)
+	{
+		size_t lineEnd = expanded.find('\n', lineStart);
+		lineEnd = lineEnd == std::string::npos ? expanded.size() : lineEnd;
+		if (TrimStart(expanded.substr(lineStart, lineEnd - lineStart)).compare(0, 8, "#version") == 0)
+		{
+			size_t insertAt = std::min(lineEnd + 1, expanded.size());
+			return expanded.substr(0, insertAt) + defineBlock
+				+ "#line " + std::to_string(lineNumber + 1) + " 0\n"
+				+ expanded.substr(insertAt);
+		}
+		lineStart = lineEnd + 1;
+	}
+	return defineBlock + "#line 1 0\n" + expanded;
+}
+
+GLuint ShaderVariantBuilder::GetProgram(const std::string& vertexPath, const std::string& fragmentPath, std::vector<std::string> defines)
+{
+	//the same set in another order is the same variant
+	std::sort(defines.begin(), defines.end());
+	defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+
+	std::string request = vertexPath + "|" + fragmentPath;
+	for (size_t i = 0; i < defines.size(); i++)
+	{
+		request += "|" + defines[i];
+	}
+	auto existing = programsByRequest.find(request);
+	if (existing != programsByRequest.end())
+	{
+		return existing->second;
+	}
+
+	std::vector<ShaderSource> sources;
+	sources.push_back({ GL_VERTEX_SHADER, Preprocess(vertexPath, defines) });
+	sources.push_back({ GL_FRAGMENT_SHADER, Preprocess(fragmentPath, defines) });
+	if (sources[0].code.empty() || sources[1].code.empty())
+	{
+		programsByRequest[request] = 0;
+		return 0;
+	}
+
+	//defines a stage doesn't look at can still give the same code as another variant
+	unsigned long long hash = AssetLoader::HashBytes(sources[0].code);
+	hash = AssetLoader::HashBytes(sources[1].code, hash);
+	auto sameSource = programsBySource.find(hash);
+	if (sameSource != programsBySource.end())
+	{
+		programsByRequest[request] = sameSource->second;
+		return sameSource->second;
+	}
+
+	GLuint program = ProgramCache::GetInstance()->CreateProgram(sources);
+	programsByRequest[request] = program;
+	programsBySource[hash] = program;
+	unfinished.push_back(program);
+	return program;
+}
+
+bool ShaderVariantBuilder::FinishAll()
+{
+	bool succeeded = true;
+	for (size_t i = 0; i < unfinished.size(); i++)
+	{
+		GLuint program = unfinished[i];
+		if (ProgramCache::GetInstance()->Finish(program))
+		{
+			continue;
+		}
+
+		//the program is gone, make sure nobody gets handed its old name
+		succeeded = false;
+		for (auto it = programsByRequest.begin(); it != programsByRequest.end(); ++it)
+		{
+			if (it->second == program)
+			{
+				it->second = 0;
+			}
+		}
+		for (auto it = programsBySource.begin(); it != programsBySource.end(); ++it)
+		{
+			if (it->second == program)
+			{
+				it->second = 0;
+			}
+		}
+	}
+	unfinished.clear();
+	return succeeded;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "stdafx.h"
+#include "ProgramCache.h"
+#include <string>
+#include <vector>
+#include <future>
+#include <unordered_map>
+
+/// <summary>
+/// Singleton that builds specialised programs out of shared GLSL files. Sources can
+/// #include other files, and each request injects its own set of #defines right after
+/// the #version line, so features are compiled in or out instead of branched on at runtime.
+/// Only the variants something asks for get built, and two requests that preprocess to the
+/// same sources share one program.
+/// </summary>
+class ShaderVariantBuilder
+{
+private:
+	/// <summary>
+	/// Singleton implementation (private constructor & destructor)
+	/// </summary>
+	ShaderVariantBuilder();
+	~ShaderVariantBuilder();
+
+	static ShaderVariantBuilder* instance;
+
+	//file contents, read on the AssetLoader's workers
+	std::unordered_map<std::string, std::shared_future<std::string>> files;
+
+	//request (paths + defines) -> program, so repeat requests skip the preprocessing
+	std::unordered_map<std::string, GLuint> programsByRequest;
+
+	//hash of the final sources -> program
+	std::unordered_map<unsigned long long, GLuint> programsBySource;
+
+	//programs that may still be compiling
+	std::vector<GLuint> unfinished;
+
+	const std::string& ReadSource(const std::string& path);
+
+	/// <summary>
+	/// Expands the #includes of a file into out, recursively. Every file is only included
+	/// once per variant, and #line directives keep compile errors pointing at the right file.
+	/// </summary>
+	bool ExpandIncludes(const std::string& path, std::vector<std::string>& included, std::string& out);
+
+public:
+	/// <summary>
+	/// Singleton reference to the instance
+	/// </summary>
+	static ShaderVariantBuilder* GetInstance();
+
+	/// <summary>
+	/// De-allocation, the programs themselves are left alone
+	/// </summary>
+	static void Release();
+
+	/// <summary>
+	/// Starts reading shader files in the background, before anything asks for them
+	/// </summary>
+	void Prefetch(const std::vector<std::string>& paths);
+
+	/// <summary>
+	/// Preprocesses one stage: includes expanded and defines injected after #version
+	/// </summary>
+	/// <param name="path">The file to start from</param>
+	/// <param name="defines">"NAME" or "NAME=VALUE" entries</param>
+	/// <returns>The final source, empty if the file couldn't be read</returns>
+	std::string Preprocess(const std::string& path, const std::vector<std::string>& defines);
+
+	/// <summary>
+	/// Gets the program for a vertex + fragment variant, starting its build if nobody
+	/// asked for it before. Call FinishAll before the program is used.
+	/// </summary>
+	/// <param name="defines">Applied to both stages, order doesn't matter</param>
+	GLuint GetProgram(const std::string& vertexPath, const std::string& fragmentPath, std::vector<std::string> defines);
+
+	/// <summary>
+	/// Waits for every variant that's still building
+	/// </summary>
+	/// <returns>False if any of them failed (those programs are 0 from then on)</returns>
+	bool FinishAll();
+
+	/// <summary>
+	/// How many distinct programs have been built
+	/// </summary>
+	size_t GetVariantCount() const { return programsBySource.size(); }
+};
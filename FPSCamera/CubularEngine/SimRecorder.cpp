@@ -0,0 +1,290 @@
+#include "SimRecorder.h"
+#include "Scene.h"
+#include <iterator>
+#include <cstring>
+
+namespace
+{
+	const char RecordingMagic[4] = { 'C', 'R', 'E', 'C' };
+	const unsigned int RecordingVersion = 1;
+
+	//the record type byte is a SimCommandType, or this for the end record
+	const unsigned char RecordEnd = 0xFF;
+
+	struct RecordingHeader
+	{
+		char magic[4];
+		unsigned int version;
+		float stepTime;
+		unsigned int playing;
+		unsigned long long startHash;
+	};
+
+	//the reading side, which refuses to run past the end of the data
+	struct RecordReader
+	{
+		const char* p;
+		const char* end;
+
+		bool Raw(void* data, size_t size)
+		{
+			if ((size_t)(end - p) < size)
+			{
+				return false;
+			}
+			memcpy(data, p, size);
+			p += size;
+			return true;
+		}
+
+		bool Byte(unsigned char& value) { return Raw(&value, sizeof(value)); }
+		bool Float(float& value) { return Raw(&value, sizeof(value)); }
+		bool Vec3(glm::vec3& value) { return Raw(&value[0], sizeof(float) * 3); }
+
+		bool Varint(unsigned long long& value)
+		{
+			value = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				unsigned char byte;
+				if (!Byte(byte))
+				{
+					return false;
+				}
+				value |= (unsigned long long)(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool String(std::string& value)
+		{
+			unsigned long long size;
+			if (!Varint(size) || (size_t)(end - p) < size)
+			{
+				return false;
+			}
+			value.assign(p, (size_t)size);
+			p += size;
+			return true;
+		}
+	};
+}
+
+SimRecorder::SimRecorder(Scene* scene)
+{
+	this->scene = scene;
+	lastStep = 0;
+}
+
+bool SimRecorder::Open(const std::string& path, float stepTime, bool playing, unsigned long long startHash)
+{
+	if (file.is_open())
+	{
+		file.close();
+	}
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.good())
+	{
+#ifdef _DEBUG
+		std::cout << "Can't record to " << path << std::endl;
+#endif
+		file.close();
+		return false;
+	}
+
+	RecordingHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, RecordingMagic, sizeof(header.magic));
+	header.version = RecordingVersion;
+	header.stepTime = stepTime;
+	header.playing = playing ? 1 : 0;
+	header.startHash = startHash;
+	file.write((const char*)&header, sizeof(header));
+	lastStep = 0;
+	return file.good();
+}
+
+void SimRecorder::Byte(unsigned char value)
+{
+	file.put((char)value);
+}
+
+void SimRecorder::Varint(unsigned long long value)
+{
+	//7 bits at a time, the high bit says more follow
+	while (value >= 0x80)
+	{
+		Byte((unsigned char)(value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	Byte((unsigned char)value);
+}
+
+void SimRecorder::Float(float value)
+{
+	file.write((const char*)&value, sizeof(value));
+}
+
+void SimRecorder::Vec3(const glm::vec3& value)
+{
+	file.write((const char*)&value[0], sizeof(float) * 3);
+}
+
+void SimRecorder::String(const std::string& value)
+{
+	Varint(value.size());
+	file.write(value.data(), value.size());
+}
+
+void SimRecorder::Write(unsigned long long step, const SimCommand& command)
+{
+	//printing the graph or saving changes nothing, there's nothing to play back
+	if (!file.is_open() || command.type == SimCommandType::PrintFrameGraph || command.type == SimCommandType::SaveState)
+	{
+		return;
+	}
+
+	Byte((unsigned char)command.type);
+	Varint(step - lastStep);
+	lastStep = step;
+	switch (command.type)
+	{
+	case SimCommandType::Spawn:
+		String(scene->GetName(command.mesh));
+		String(scene->GetName(command.material));
+		Vec3(command.position);
+		Vec3(command.velocity);
+		Vec3(command.scale);
+		Float(command.mass);
+		Byte(command.orbital ? 1 : 0);
+		break;
+	case SimCommandType::SetPlaying:
+		Byte(command.playing ? 1 : 0);
+		break;
+	case SimCommandType::Seek:
+		Varint(command.tick);
+		break;
+	default:
+		break;
+	}
+}
+
+void SimRecorder::Finish(unsigned long long step, unsigned long long hash)
+{
+	if (!file.is_open())
+	{
+		return;
+	}
+	Byte(RecordEnd);
+	Varint(step - lastStep);
+	file.write((const char*)&hash, sizeof(hash));
+	file.close();
+}
+
+bool SimRecorder::Load(const std::string& path, Scene* scene, SimRecording& outRecording)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.good())
+	{
+		return false;
+	}
+	std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	RecordingHeader header;
+	if (bytes.size() < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, bytes.data(), sizeof(header));
+	if (memcmp(header.magic, RecordingMagic, sizeof(header.magic)) != 0 || header.version != RecordingVersion)
+	{
+		return false;
+	}
+
+	outRecording = SimRecording();
+	outRecording.stepTime = header.stepTime;
+	outRecording.playing = header.playing != 0;
+	outRecording.startHash = header.startHash;
+	outRecording.finished = false;
+	outRecording.endStep = 0;
+	outRecording.endHash = 0;
+
+	RecordReader reader = { bytes.data() + sizeof(header), bytes.data() + bytes.size() };
+	unsigned long long step = 0;
+	while (reader.p < reader.end)
+	{
+		unsigned char type;
+		unsigned long long delta;
+		if (!reader.Byte(type) || !reader.Varint(delta))
+		{
+			return false;
+		}
+		step += delta;
+
+		if (type == RecordEnd)
+		{
+			outRecording.finished = reader.Raw(&outRecording.endHash, sizeof(outRecording.endHash));
+			outRecording.endStep = step;
+			return outRecording.finished;
+		}
+
+		SimRecord record;
+		memset(&record.command, 0, sizeof(record.command));
+		record.step = step;
+		record.command.type = (SimCommandType)type;
+		switch (record.command.type)
+		{
+		case SimCommandType::Spawn:
+		{
+			std::string mesh, material;
+			unsigned char orbital;
+			if (!reader.String(mesh) || !reader.String(material) || !reader.Vec3(record.command.position)
+				|| !reader.Vec3(record.command.velocity) || !reader.Vec3(record.command.scale)
+				|| !reader.Float(record.command.mass) || !reader.Byte(orbital))
+			{
+				return false;
+			}
+			record.command.mesh = scene->GetMesh(mesh);
+			record.command.material = scene->GetMaterial(material);
+			record.command.orbital = orbital != 0;
+			if (record.command.mesh == nullptr || record.command.material == nullptr)
+			{
+#ifdef _DEBUG
+				std::cout << "The recording spawns " << mesh << "/" << material << ", which the scene doesn't have" << std::endl;
+#endif
+				return false;
+			}
+			break;
+		}
+		case SimCommandType::Reset:
+			break;
+		case SimCommandType::SetPlaying:
+		{
+			unsigned char playing;
+			if (!reader.Byte(playing))
+			{
+				return false;
+			}
+			record.command.playing = playing != 0;
+			break;
+		}
+		case SimCommandType::Seek:
+			if (!reader.Varint(record.command.tick))
+			{
+				return false;
+			}
+			break;
+		default:
+			return false;
+		}
+		outRecording.records.push_back(record);
+	}
+
+	//cut off (the game crashed or was killed), what's there still plays back
+	outRecording.endStep = step;
+	return true;
+}
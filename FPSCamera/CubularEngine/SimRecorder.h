@@ -0,0 +1,88 @@
+#pragma once
+#include "stdafx.h"
+#include "Simulation.h"
+#include <string>
+#include <vector>
+#include <fstream>
+
+class Scene;
+
+/// <summary>
+/// A command and the step (counted from the start of the recording) it ran before
+/// </summary>
+struct SimRecord
+{
+	unsigned long long step;
+	SimCommand command;
+};
+
+/// <summary>
+/// A recorded game session, everything Simulation::Replay needs to step it again
+/// </summary>
+struct SimRecording
+{
+	float stepTime;
+	bool playing;                       //whether it started out paused
+	unsigned long long startHash;       //Simulation::HashState() when it started
+	std::vector<SimRecord> records;
+
+	//where it ended, if it was finished properly
+	bool finished;
+	unsigned long long endStep;
+	unsigned long long endHash;
+};
+
+/// <summary>
+/// Writes a session of the simulation to a compact binary stream as it runs. Everything the
+/// player does reaches the bodies as commands (the camera & mouse only matter through where a
+/// spawn starts and how fast), and the steps are fixed, so the commands and the step each one
+/// ran on are all it takes to play the session back without a window or anyone at the mouse.
+///
+/// The file: a header, then one record per command: its type (a byte), how many steps after the
+/// previous record it ran (a varint) and its fields, meshes & materials by their scene names.
+/// An end record with the last step and the final state's hash closes it.
+/// </summary>
+class SimRecorder
+{
+private:
+	std::ofstream file;
+	Scene* scene;
+	unsigned long long lastStep;
+
+	void Byte(unsigned char value);
+	void Varint(unsigned long long value);
+	void Float(float value);
+	void Vec3(const glm::vec3& value);
+	void String(const std::string& value);
+
+public:
+	/// <param name="scene">Where the meshes & materials get their names from</param>
+	SimRecorder(Scene* scene);
+
+	SimRecorder(const SimRecorder&) = delete;
+	SimRecorder& operator=(const SimRecorder&) = delete;
+
+	/// <summary>
+	/// Starts a new recording, replacing whatever was at path
+	/// </summary>
+	/// <returns>False if the file can't be written</returns>
+	bool Open(const std::string& path, float stepTime, bool playing, unsigned long long startHash);
+
+	bool IsOpen() const { return file.is_open(); }
+
+	/// <summary>
+	/// Adds a command that ran before step (counted from Open). Steps can't go backwards.
+	/// </summary>
+	void Write(unsigned long long step, const SimCommand& command);
+
+	/// <summary>
+	/// Writes the end record and closes the file
+	/// </summary>
+	void Finish(unsigned long long step, unsigned long long hash);
+
+	/// <summary>
+	/// Reads a recording back, with its meshes & materials looked up in the scene
+	/// </summary>
+	/// <returns>False if the file can't be read, isn't a recording or names something the scene doesn't have</returns>
+	static bool Load(const std::string& path, Scene* scene, SimRecording& outRecording);
+};
@@ -0,0 +1,231 @@
+#include "SimStateFile.h"
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+
+namespace
+{
+	const char StateMagic[4] = { 'C', 'S', 'I', 'M' };
+	const unsigned int StateVersion = 1;
+
+	//the sections start on page boundaries
+	const size_t StatePageSize = 4096;
+
+	//first page of a state file
+	struct StateHeader
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned int bodySize;              //sizeof(SavedBody) of whoever wrote it
+		unsigned int meshCount;
+		unsigned int materialCount;
+		unsigned int stepsSinceSort;
+		unsigned int center;
+		float stepTime;
+		unsigned long long stepCount;
+		unsigned long long hash;
+		unsigned long long bodyCount;
+		unsigned long long tablesOffset;
+		unsigned long long bodiesOffset;
+	};
+
+	size_t AlignToPage(size_t offset)
+	{
+		return (offset + StatePageSize - 1) / StatePageSize * StatePageSize;
+	}
+
+	void WriteString(std::vector<char>& bytes, const std::string& value)
+	{
+		unsigned int size = (unsigned int)value.size();
+		bytes.insert(bytes.end(), (const char*)&size, (const char*)&size + sizeof(size));
+		bytes.insert(bytes.end(), value.begin(), value.end());
+	}
+
+	bool ReadString(const unsigned char*& p, const unsigned char* end, std::string& value)
+	{
+		unsigned int size;
+		if ((size_t)(end - p) < sizeof(size))
+		{
+			return false;
+		}
+		memcpy(&size, p, sizeof(size));
+		p += sizeof(size);
+		if ((size_t)(end - p) < size)
+		{
+			return false;
+		}
+		value.assign((const char*)p, size);
+		p += size;
+		return true;
+	}
+}
+
+void SaveBody(EntityHandle handle, SavedBody& outBody)
+{
+	EntityWorld* world = EntityWorld::GetInstance();
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	TransformId transform = world->Get<Transform>(handle)->id;
+	outBody.position = transforms->GetPosition(transform);
+	outBody.rotation = transforms->GetRotation(transform);
+	outBody.scale = transforms->GetScale(transform);
+	outBody.motion = *world->Get<Motion>(handle);
+	outBody.collider = *world->Get<Collider>(handle);
+	outBody.flags = *world->Get<EntityFlags>(handle);
+	outBody.animation = *world->Get<Animation>(handle);
+	outBody.spawnPoint = *world->Get<SpawnPoint>(handle);
+}
+
+void LoadBody(EntityHandle handle, const SavedBody& body)
+{
+	EntityWorld* world = EntityWorld::GetInstance();
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	TransformId transform = world->Get<Transform>(handle)->id;
+	transforms->SetPosition(transform, body.position);
+	transforms->SetRotation(transform, body.rotation);
+	transforms->SetScale(transform, body.scale);
+	*world->Get<Motion>(handle) = body.motion;
+	*world->Get<Collider>(handle) = body.collider;
+	*world->Get<EntityFlags>(handle) = body.flags;
+	*world->Get<Animation>(handle) = body.animation;
+	*world->Get<SpawnPoint>(handle) = body.spawnPoint;
+}
+
+SimStateFile::SimStateFile()
+{
+	Close();
+}
+
+bool SimStateFile::Write(const std::string& path, const SimState& state)
+{
+	std::vector<char> tables;
+	for (size_t m = 0; m < state.meshes.size(); m++)
+	{
+		WriteString(tables, state.meshes[m]);
+	}
+	for (size_t m = 0; m < state.materials.size(); m++)
+	{
+		WriteString(tables, state.materials[m]);
+	}
+
+	StateHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, StateMagic, sizeof(header.magic));
+	header.version = StateVersion;
+	header.bodySize = sizeof(SavedBody);
+	header.meshCount = (unsigned int)state.meshes.size();
+	header.materialCount = (unsigned int)state.materials.size();
+	header.stepsSinceSort = state.stepsSinceSort;
+	header.center = state.center;
+	header.stepTime = state.stepTime;
+	header.stepCount = state.stepCount;
+	header.hash = state.hash;
+	header.bodyCount = state.bodies.size();
+	header.tablesOffset = StatePageSize;
+	header.bodiesOffset = AlignToPage(header.tablesOffset + tables.size());
+
+	//written next to it and renamed over it once it's complete, so a crash or a full disk
+	//half way through leaves the last save as it was instead of a cut off one
+	std::string tempPath = path + ".tmp";
+	std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+	if (!out.good())
+	{
+		return false;
+	}
+	std::vector<char> padding(StatePageSize, 0);
+	out.write((const char*)&header, sizeof(header));
+	out.write(padding.data(), header.tablesOffset - sizeof(header));
+	out.write(tables.data(), tables.size());
+	out.write(padding.data(), header.bodiesOffset - header.tablesOffset - tables.size());
+	if (!state.bodies.empty())
+	{
+		out.write((const char*)&state.bodies[0], state.bodies.size() * sizeof(SavedBody));
+	}
+	out.flush();
+	bool written = out.good();
+	out.close();
+
+	std::error_code error;
+	if (written && !out.fail())
+	{
+		std::filesystem::rename(tempPath, path, error);
+		if (!error)
+		{
+			return true;
+		}
+	}
+	std::filesystem::remove(tempPath, error);
+	return false;
+}
+
+bool SimStateFile::Open(const std::string& path)
+{
+	Close();
+	if (!file.Open(path))
+	{
+		return false;
+	}
+
+	const unsigned char* data = file.GetData();
+	size_t size = file.GetSize();
+	StateHeader header;
+	if (size < sizeof(header))
+	{
+		Close();
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, StateMagic, sizeof(header.magic)) != 0 || header.version != StateVersion
+		|| header.bodySize != sizeof(SavedBody)
+		|| header.tablesOffset > header.bodiesOffset || header.bodiesOffset > size
+		|| header.bodiesOffset % StatePageSize != 0
+		|| (size - header.bodiesOffset) / sizeof(SavedBody) < header.bodyCount)
+	{
+		Close();
+		return false;
+	}
+
+	const unsigned char* p = data + header.tablesOffset;
+	const unsigned char* end = data + header.bodiesOffset;
+	meshes.resize(header.meshCount);
+	materials.resize(header.materialCount);
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		if (!ReadString(p, end, meshes[m]))
+		{
+			Close();
+			return false;
+		}
+	}
+	for (size_t m = 0; m < materials.size(); m++)
+	{
+		if (!ReadString(p, end, materials[m]))
+		{
+			Close();
+			return false;
+		}
+	}
+
+	//the mapping starts on a page, so the array is aligned for SavedBody too
+	bodies = reinterpret_cast<const SavedBody*>(data + header.bodiesOffset);
+	bodyCount = (size_t)header.bodyCount;
+	stepTime = header.stepTime;
+	stepCount = header.stepCount;
+	stepsSinceSort = header.stepsSinceSort;
+	center = header.center;
+	hash = header.hash;
+	return true;
+}
+
+void SimStateFile::Close()
+{
+	file.Close();
+	bodies = nullptr;
+	bodyCount = 0;
+	meshes.clear();
+	materials.clear();
+	stepTime = 0.0f;
+	stepCount = 0;
+	stepsSinceSort = 0;
+	center = 0;
+	hash = 0;
+}
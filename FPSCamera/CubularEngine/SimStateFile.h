@@ -0,0 +1,109 @@
+#pragma once
+#include "stdafx.h"
+#include "EntityWorld.h"
+#include "MappedFile.h"
+#include <glm/gtc/quaternion.hpp>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Everything about one body, plain data so the file stores the array exactly as it is here
+/// </summary>
+struct SavedBody
+{
+	unsigned int mesh;          //index into the file's mesh names
+	unsigned int material;      //index into the file's material names
+	unsigned int activeIndex;   //where it was in its EntityPool's active list
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+	Motion motion;
+	Collider collider;
+	EntityFlags flags;
+	Animation animation;
+	SpawnPoint spawnPoint;
+};
+
+/// <summary>
+/// Copies an entity's components into a SavedBody, all but mesh, material & activeIndex
+/// </summary>
+void SaveBody(EntityHandle handle, SavedBody& outBody);
+
+/// <summary>
+/// Sets an entity's components to a SavedBody's, all but its mesh & material
+/// </summary>
+void LoadBody(EntityHandle handle, const SavedBody& body);
+
+/// <summary>
+/// A copy of the whole simulation at the end of a step. A save fills one in on the simulation
+/// thread and hands it to a loading worker to write out, so the bodies keep stepping meanwhile.
+/// </summary>
+struct SimState
+{
+	float stepTime;
+	unsigned long long stepCount;       //steps that led here, for information
+	unsigned int stepsSinceSort;        //when the next spatial sort is due
+	unsigned int center;                //the broadphase's center, an index into bodies
+	unsigned long long hash;            //Simulation::HashState() when it was taken
+
+	std::vector<std::string> meshes;    //scene names
+	std::vector<std::string> materials;
+	std::vector<SavedBody> bodies;      //in storage order
+};
+
+/// <summary>
+/// Simulation states on disk. The layout is page aligned: the header on the first page, the
+/// name tables after it, and the SavedBody array starting on a page of its own, unchanged from
+/// memory. Loading maps the file and hands out a pointer straight into the mapping, nothing is
+/// parsed or copied but the few names; the OS pages the bodies in as they're read.
+/// </summary>
+class SimStateFile
+{
+private:
+	MappedFile file;
+	const SavedBody* bodies;
+	size_t bodyCount;
+	std::vector<std::string> meshes;
+	std::vector<std::string> materials;
+
+	float stepTime;
+	unsigned long long stepCount;
+	unsigned int stepsSinceSort;
+	unsigned int center;
+	unsigned long long hash;
+
+public:
+	SimStateFile();
+
+	SimStateFile(const SimStateFile&) = delete;
+	SimStateFile& operator=(const SimStateFile&) = delete;
+
+	/// <summary>
+	/// Writes a state, replacing whatever was at path only once all of it has been written
+	/// </summary>
+	/// <returns>False if the file can't be written, path is left as it was</returns>
+	static bool Write(const std::string& path, const SimState& state);
+
+	/// <summary>
+	/// Maps a state file, closing whatever was open before
+	/// </summary>
+	/// <returns>False if it can't be mapped, isn't a state file or was written by a different build (body layout)</returns>
+	bool Open(const std::string& path);
+
+	void Close();
+
+	/// <summary>
+	/// The bodies, in storage order. Points into the mapping, valid until Close().
+	/// </summary>
+	const SavedBody* GetBodies() const { return bodies; }
+	size_t GetBodyCount() const { return bodyCount; }
+
+	const std::vector<std::string>& GetMeshes() const { return meshes; }
+	const std::vector<std::string>& GetMaterials() const { return materials; }
+
+	float GetStepTime() const { return stepTime; }
+	unsigned long long GetStepCount() const { return stepCount; }
+	unsigned int GetStepsSinceSort() const { return stepsSinceSort; }
+	unsigned int GetCenter() const { return center; }
+	unsigned long long GetHash() const { return hash; }
+};
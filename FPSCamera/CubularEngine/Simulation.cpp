@@ -0,0 +1,693 @@
+#include "Simulation.h"
+#include "Scene.h"
+#include "EntityPool.h"
+#include "EntitySystems.h"
+#include "SpatialSort.h"
+#include "KDTree.h"
+#include "FrameArena.h"
+#include "MemoryTracker.h"
+#include "JobSystem.h"
+#include "SimRecorder.h"
+#include "SimStateFile.h"
+#include "RewindBuffer.h"
+#include "AssetLoader.h"
+#include <memory>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+
+namespace
+{
+	//if it falls this far behind it stops trying to catch up
+	const int MaxLagSteps = 5;
+
+	//where PrintFrameGraph writes the last step as a Chrome trace
+	const char* const FrameGraphTracePath = "framegraph.json";
+
+	//FNV-1a
+	const unsigned long long HashBasis = 14695981039346656037ULL;
+	const unsigned long long HashPrime = 1099511628211ULL;
+
+	void HashBytes(unsigned long long& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * HashPrime;
+		}
+	}
+}
+
+Simulation::Simulation(Scene* scene, const std::string& group, EntityPool* bodies, KDTree* tree, float stepTime)
+	: running(false), stepCount(0)
+{
+	this->scene = scene;
+	this->group = group;
+	this->bodies = bodies;
+	this->tree = tree;
+	this->stepTime = stepTime;
+	stepsSinceSort = 0;
+	merges = 0;
+	playing = false;
+	saving = std::make_shared<std::atomic<bool>>(false);
+	recorder = new SimRecorder(scene);
+	sessionStart = 0;
+	rewind = new RewindBuffer(scene);
+	tick = 0;
+	rewindKeyframe = false;
+
+	//one step: the broadphase & merges, then the forces & integration. most stages need the
+	//one before them and split their own work over the job system. the spin is the exception,
+	//nothing in a step reads rotations, so it runs next to the bounds & the tree build. it
+	//still has to finish before the merges, those set scales through the same (not thread
+	//safe) TransformSystem setters
+	TaskId boundsTask = frameGraph.AddTask("bounds", []() {
+		EntitySystems::UpdateBounds(IsSimulated);
+	});
+	TaskId animateTask = frameGraph.AddTask("animate", []() {
+		EntitySystems::Animate(IsSimulated);
+	});
+	TaskId treeTask = frameGraph.AddTask("tree", [this]() {
+		const std::vector<GameEntity*>& cubes = this->bodies->GetActive();
+		this->tree->UpdateTree(cubes, cubes.size());
+	}, { boundsTask });
+	TaskId collisionsTask = frameGraph.AddTask("collisions", [this]() {
+		//only counted here, irrKlang is left to the render thread rather than whichever worker this lands on
+		const std::vector<GameEntity*>& cubes = this->bodies->GetActive();
+		merges += this->tree->CheckCollisions(cubes, cubes.size());
+	}, { treeTask, animateTask });
+	TaskId retireTask = frameGraph.AddTask("retire", [this]() {
+		//bodies that merged into another are gone for good. backwards, since retiring
+		//moves the last body into the hole. the center stays, the tree is split around it
+		const std::vector<GameEntity*>& cubes = this->bodies->GetActive();
+		for (size_t i = cubes.size(); i > 0; i--)
+		{
+			GameEntity* body = cubes[i - 1];
+			if (!body->IsEnabled() && body != this->tree->center) {
+				this->bodies->Retire(body);
+			}
+		}
+	}, { collisionsTask });
+	TaskId sortTask = frameGraph.AddTask("sort", [this]() {
+		//bodies drift away from where they were spawned, so every couple of seconds they're put
+		//back in Z order, bodies that are close in space are then close in memory as well
+		if (++stepsSinceSort >= 120) {
+			stepsSinceSort = 0;
+			SpatialSort::Run(IsSimulated, MortonBits::Bits30);
+			this->bodies->SortActive();
+		}
+	}, { retireTask });
+	//the bodies' physics runs over their component columns, not the entity objects
+	TaskId attractTask = frameGraph.AddTask("attract", []() {
+		EntitySystems::Attract(IsSimulated);
+	}, { sortTask });
+	frameGraph.AddTask("integrate", [this]() {
+		EntitySystems::Integrate(IsSimulated, this->stepTime);
+	}, { attractTask });
+}
+
+Simulation::~Simulation()
+{
+	Stop();
+	delete recorder;
+	delete rewind;
+}
+
+void Simulation::Start(bool playing)
+{
+	if (running.load())
+	{
+		return;
+	}
+	this->playing = playing;
+	sessionStart = stepCount.load();
+	merges = 0;
+	if (!recordPath.empty())
+	{
+		recorder->Open(recordPath, stepTime, playing, HashState());
+	}
+	Publish();
+	running = true;
+	thread = std::thread(&Simulation::Loop, this);
+}
+
+void Simulation::Stop()
+{
+	if (!running.load())
+	{
+		return;
+	}
+	running = false;
+	thread.join();
+
+	//the simulation thread is gone, so popping from here is fine
+	SimCommand dropped;
+	while (commands.Pop(dropped))
+	{
+	}
+
+	if (recorder->IsOpen())
+	{
+		recorder->Finish(stepCount.load() - sessionStart, HashState());
+	}
+}
+
+void Simulation::Loop()
+{
+	MemoryTracker::SetThreadTag(MemoryTag::Physics);
+	std::chrono::steady_clock::duration step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(stepTime));
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+	while (running.load())
+	{
+		//last step's scratch is done with
+		FrameArena::GetInstance()->Reset();
+
+		bool changed = RunCommands();
+		if (playing)
+		{
+			RunStep();
+			changed = true;
+		}
+		if (changed)
+		{
+			Publish();
+		}
+
+		//a fixed rate, however fast the frames are drawn
+		next += step;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now - next > step * MaxLagSteps)
+		{
+			next = now;
+		}
+		std::this_thread::sleep_until(next);
+	}
+
+	//every Start() is a new thread, don't leave an arena behind for each
+	FrameArena::ReleaseThread();
+}
+
+void Simulation::RunStep()
+{
+	frameGraph.Run();
+	stepCount++;
+	tick++;
+	RecordRewind();
+}
+
+void Simulation::RecordRewind()
+{
+	//a keyframe after a seek as well, the bodies were respawned so none of their handles carry on
+	if (rewindKeyframe || rewind->NeedsKeyframe(tick))
+	{
+		SimState state;
+		std::vector<EntityHandle> handles;
+		CaptureState(state, &handles);
+		rewind->AddKeyframe(tick, state, handles);
+		rewindKeyframe = false;
+	}
+	else
+	{
+		rewind->AddDelta(bodies->GetActive(), tree->center, (unsigned int)stepsSinceSort);
+	}
+}
+
+void Simulation::ResetBodies()
+{
+	bool restored = false;
+	if (!startStatePath.empty())
+	{
+		SimStateFile state;
+		restored = state.Open(startStatePath) && RestoreState(state);
+		if (!restored)
+		{
+			std::cout << "Can't restore the simulation from " << startStatePath << ", starting from the scene" << std::endl;
+		}
+	}
+
+	if (!restored)
+	{
+		bodies->Clear();
+		scene->SpawnGroup(group);
+		tree->center = scene->GetGroup(group)[0];
+
+		//the sorts have to land on the same steps as last time for a replay to match
+		stepsSinceSort = 0;
+	}
+
+	//the history starts over from the new bodies
+	rewind->Clear();
+	tick = 0;
+	RecordRewind();
+}
+
+void Simulation::CaptureState(SimState& outState, std::vector<EntityHandle>* outHandles)
+{
+	EntityWorld* world = EntityWorld::GetInstance();
+	const std::vector<GameEntity*>& active = bodies->GetActive();
+
+	outState.stepTime = stepTime;
+	outState.stepCount = stepCount.load();
+	outState.stepsSinceSort = (unsigned int)stepsSinceSort;
+	outState.center = 0;
+	outState.hash = HashState();
+	outState.meshes.clear();
+	outState.materials.clear();
+	outState.bodies.clear();
+	outState.bodies.reserve(active.size());
+	if (outHandles != nullptr)
+	{
+		outHandles->clear();
+		outHandles->reserve(active.size());
+	}
+
+	//in storage order, which the attraction sums follow, with the active list's order kept on the side
+	std::vector<std::pair<size_t, unsigned int>> rows(active.size());
+	for (size_t i = 0; i < active.size(); i++)
+	{
+		rows[i] = std::make_pair(world->GetRow(active[i]->GetHandle()), (unsigned int)i);
+	}
+	std::sort(rows.begin(), rows.end());
+
+	//the handful of meshes & materials, by name
+	std::vector<const Mesh*> meshes;
+	std::vector<const Material*> materials;
+	for (size_t r = 0; r < rows.size(); r++)
+	{
+		GameEntity* entity = active[rows[r].second];
+		EntityHandle handle = entity->GetHandle();
+		const Renderable* renderable = world->Get<Renderable>(handle);
+
+		SavedBody body = {};
+		size_t mesh = std::find(meshes.begin(), meshes.end(), renderable->mesh) - meshes.begin();
+		if (mesh == meshes.size())
+		{
+			meshes.push_back(renderable->mesh);
+			outState.meshes.push_back(scene->GetName(renderable->mesh));
+		}
+		size_t material = std::find(materials.begin(), materials.end(), renderable->material) - materials.begin();
+		if (material == materials.size())
+		{
+			materials.push_back(renderable->material);
+			outState.materials.push_back(scene->GetName(renderable->material));
+		}
+		body.mesh = (unsigned int)mesh;
+		body.material = (unsigned int)material;
+		body.activeIndex = rows[r].second;
+		SaveBody(handle, body);
+		if (entity == tree->center)
+		{
+			outState.center = (unsigned int)r;
+		}
+		outState.bodies.push_back(body);
+		if (outHandles != nullptr)
+		{
+			outHandles->push_back(handle);
+		}
+	}
+}
+
+bool Simulation::RestoreState(const SimStateFile& state)
+{
+	if (!RestoreBodies(state.GetMeshes(), state.GetMaterials(), state.GetBodies(), state.GetBodyCount(), state.GetCenter(), state.GetStepsSinceSort()))
+	{
+		return false;
+	}
+	if (HashState() != state.GetHash())
+	{
+		std::cout << "The restored simulation doesn't hash the same as the saved one" << std::endl;
+	}
+	return true;
+}
+
+bool Simulation::RestoreBodies(const std::vector<std::string>& meshNames, const std::vector<std::string>& materialNames,
+	const SavedBody* saved, size_t count, unsigned int center, unsigned int stepsSinceSort)
+{
+	std::vector<Mesh*> meshes(meshNames.size());
+	std::vector<Material*> materials(materialNames.size());
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		meshes[m] = scene->GetMesh(meshNames[m]);
+		if (meshes[m] == nullptr)
+		{
+			return false;
+		}
+	}
+	for (size_t m = 0; m < materials.size(); m++)
+	{
+		materials[m] = scene->GetMaterial(materialNames[m]);
+		if (materials[m] == nullptr)
+		{
+			return false;
+		}
+	}
+	//the active indices have to be a permutation, a hole would leave the active list with a null in it
+	std::vector<bool> placed(count, false);
+	for (size_t b = 0; b < count; b++)
+	{
+		if (saved[b].mesh >= meshes.size() || saved[b].material >= materials.size() || saved[b].activeIndex >= count
+			|| placed[saved[b].activeIndex])
+		{
+			return false;
+		}
+		placed[saved[b].activeIndex] = true;
+	}
+	if (center >= count)
+	{
+		return false;
+	}
+
+	//spawned in the saved storage order into an empty pool, so they're stored in it again
+	bodies->Clear();
+	bodies->Reserve(count);
+	std::vector<GameEntity*> order(count);
+	for (size_t b = 0; b < count; b++)
+	{
+		const SavedBody& body = saved[b];
+		GameEntity* entity = bodies->Spawn(meshes[body.mesh], materials[body.material], body.position, body.animation.eulerAngles, body.scale);
+		LoadBody(entity->GetHandle(), body);
+		order[body.activeIndex] = entity;
+		if (b == center)
+		{
+			tree->center = entity;
+		}
+	}
+	bodies->SetActiveOrder(order);
+	this->stepsSinceSort = (int)stepsSinceSort;
+	return true;
+}
+
+bool Simulation::RunCommands()
+{
+	bool changed = false;
+	SimCommand command;
+	while (commands.Pop(command))
+	{
+		//before this step runs, whatever thread count it runs with
+		recorder->Write(stepCount.load() - sessionStart, command);
+		changed |= RunCommand(command);
+	}
+	return changed;
+}
+
+bool Simulation::RunCommand(const SimCommand& command)
+{
+	switch (command.type)
+	{
+	case SimCommandType::Spawn:
+	{
+		GameEntity* body = bodies->Spawn(command.mesh, command.material, command.position, glm::vec3(0.f, 0.f, 0.f), command.scale);
+		body->SetVelocity(command.velocity);
+		body->SetMass(command.mass);
+		body->SetOrbital(command.orbital);
+		return true;
+	}
+	case SimCommandType::Reset:
+		ResetBodies();
+		return true;
+	case SimCommandType::SetPlaying:
+		playing = command.playing;
+		return false;
+	case SimCommandType::PrintFrameGraph:
+	{
+		frameGraph.Print(std::cout);
+		std::ofstream trace(FrameGraphTracePath);
+		frameGraph.WriteTrace(trace);
+		std::cout << "Trace written to " << FrameGraphTracePath << std::endl;
+		return false;
+	}
+	case SimCommandType::SaveState:
+	{
+		//one save at a time, two workers writing the same file would interleave into garbage
+		if (saving->exchange(true))
+		{
+			std::cout << "Still writing the last save, skipped this one" << std::endl;
+			return false;
+		}
+
+		//the copy is the worker's alone, the bodies carry on stepping while it's written out
+		std::shared_ptr<SimState> state = std::make_shared<SimState>();
+		CaptureState(*state);
+		std::string path = savePath;
+		std::shared_ptr<std::atomic<bool>> inFlight = saving;
+		AssetLoader::GetInstance()->Enqueue([state, path, inFlight]() {
+			if (SimStateFile::Write(path, *state))
+			{
+				std::cout << "Saved " << state->bodies.size() << " bodies at step " << state->stepCount << " to " << path << std::endl;
+			}
+			else
+			{
+				std::cout << "Can't save the simulation to " << path << std::endl;
+			}
+			*inFlight = false;
+		});
+		return false;
+	}
+	case SimCommandType::Seek:
+	{
+		//rebuilt from the history, paused there. stepping on from it starts a new future
+		SimState state;
+		if (!rewind->Reconstruct(command.tick, state)
+			|| !RestoreBodies(state.meshes, state.materials, state.bodies.data(), state.bodies.size(), state.center, state.stepsSinceSort))
+		{
+#ifdef _DEBUG
+			std::cout << "Can't seek to tick " << command.tick << ", the history goes from " << rewind->GetFirstTick() << " to " << rewind->GetLastTick() << std::endl;
+#endif
+			return false;
+		}
+		tick = command.tick;
+		playing = false;
+		rewindKeyframe = true;
+		return true;
+	}
+	}
+	return false;
+}
+
+void Simulation::Publish()
+{
+	TransformSystem* transforms = TransformSystem::GetInstance();
+	EntityWorld* world = EntityWorld::GetInstance();
+	transforms->UpdateMatrices();
+
+	//the back copy keeps its capacity, so this only allocates when the body count grows
+	SimSnapshot& snapshot = snapshots.GetBack();
+	snapshot.totals = EntitySystems::Measure(IsSimulated);
+	snapshot.bodies.clear();
+	snapshot.step = stepCount.load();
+	snapshot.tick = tick;
+	snapshot.oldestTick = rewind->GetFirstTick();
+	snapshot.merges = merges;
+	const std::vector<GameEntity*>& active = bodies->GetActive();
+	for (size_t i = 0; i < active.size(); i++)
+	{
+		if (!active[i]->IsEnabled())
+		{
+			continue;
+		}
+		EntityHandle handle = active[i]->GetHandle();
+		TransformId transform = world->Get<Transform>(handle)->id;
+
+		BodyState body;
+		body.world = transforms->GetWorldMatrix(transform);
+		body.position = transforms->GetPosition(transform);
+		body.maxScale = transforms->GetMaxScale(transform);
+		body.renderable = *world->Get<Renderable>(handle);
+		body.handle = handle;
+		body.slot = bodies->GetSlot(active[i]);
+		snapshot.bodies.push_back(body);
+	}
+	snapshots.Publish();
+}
+
+void Simulation::Send(const SimCommand& command)
+{
+	if (!commands.Push(command))
+	{
+#ifdef _DEBUG
+		std::cout << "The simulation's command queue is full, dropped a command" << std::endl;
+#endif
+	}
+}
+
+void Simulation::Spawn(Mesh* mesh, Material* material, glm::vec3 position, glm::vec3 velocity, glm::vec3 scale, float mass, bool orbital)
+{
+	SimCommand command = {};
+	command.type = SimCommandType::Spawn;
+	command.mesh = mesh;
+	command.material = material;
+	command.position = position;
+	command.velocity = velocity;
+	command.scale = scale;
+	command.mass = mass;
+	command.orbital = orbital;
+	Send(command);
+}
+
+void Simulation::Reset()
+{
+	SimCommand command = {};
+	command.type = SimCommandType::Reset;
+	Send(command);
+}
+
+void Simulation::SetPlaying(bool playing)
+{
+	SimCommand command = {};
+	command.type = SimCommandType::SetPlaying;
+	command.playing = playing;
+	Send(command);
+}
+
+void Simulation::PrintFrameGraph()
+{
+	SimCommand command = {};
+	command.type = SimCommandType::PrintFrameGraph;
+	Send(command);
+}
+
+void Simulation::SaveState()
+{
+	SimCommand command = {};
+	command.type = SimCommandType::SaveState;
+	Send(command);
+}
+
+void Simulation::Seek(unsigned long long tick)
+{
+	SimCommand command = {};
+	command.type = SimCommandType::Seek;
+	command.tick = tick;
+	Send(command);
+}
+
+void Simulation::SetRewindLimits(size_t maxBytes, unsigned int keyframeInterval)
+{
+	rewind->SetLimits(maxBytes, keyframeInterval);
+}
+
+unsigned long long Simulation::HashState()
+{
+	unsigned long long hash = HashBasis;
+	const std::vector<GameEntity*>& active = bodies->GetActive();
+	for (size_t i = 0; i < active.size(); i++)
+	{
+		glm::vec3 position = active[i]->GetPos();
+		glm::vec3 velocity = active[i]->GetVelocity();
+		glm::vec3 scale = active[i]->GetScale();
+		float mass = active[i]->GetMass();
+		bool enabled = active[i]->IsEnabled();
+		HashBytes(hash, &position, sizeof(position));
+		HashBytes(hash, &velocity, sizeof(velocity));
+		HashBytes(hash, &scale, sizeof(scale));
+		HashBytes(hash, &mass, sizeof(mass));
+		HashBytes(hash, &enabled, sizeof(enabled));
+	}
+
+	SimTotals totals = EntitySystems::Measure(IsSimulated);
+	HashBytes(hash, &totals.count, sizeof(totals.count));
+	HashBytes(hash, &totals.mass, sizeof(totals.mass));
+	HashBytes(hash, &totals.momentum, sizeof(totals.momentum));
+	HashBytes(hash, &totals.kineticEnergy, sizeof(totals.kineticEnergy));
+	return hash;
+}
+
+bool Simulation::VerifyDeterminism(unsigned int steps, std::ostream& out)
+{
+	if (running.load())
+	{
+		return false;
+	}
+
+	//one job thread, so every sum runs in one order, then as many as there are cores
+	const unsigned int threadCounts[] = { 1, 0 };
+	unsigned long long hashes[2];
+	for (int run = 0; run < 2; run++)
+	{
+		JobSystem::Release();
+		JobSystem::SetThreadCount(threadCounts[run]);
+		ResetBodies();
+		stepCount = 0;
+		for (unsigned int i = 0; i < steps; i++)
+		{
+			FrameArena::GetInstance()->Reset();
+			RunStep();
+		}
+		FrameArena::GetInstance()->Reset();
+
+		hashes[run] = HashState();
+		SimTotals totals = EntitySystems::Measure(IsSimulated);
+		out << JobSystem::GetInstance()->GetThreadCount() << " thread(s), " << steps << " steps: "
+			<< totals.count << " bodies, mass " << totals.mass << ", momentum (" << totals.momentum.x << ", "
+			<< totals.momentum.y << ", " << totals.momentum.z << "), kinetic energy " << totals.kineticEnergy
+			<< ", hash " << std::hex << hashes[run] << std::dec << std::endl;
+	}
+
+	//back to how the game runs
+	JobSystem::Release();
+	JobSystem::SetThreadCount(0);
+	ResetBodies();
+	stepCount = 0;
+
+	bool same = hashes[0] == hashes[1];
+	out << (same ? "Deterministic: the runs are bitwise identical" : "NOT deterministic: the runs differ") << std::endl;
+	return same;
+}
+
+bool Simulation::Replay(const SimRecording& recording, std::ostream& out)
+{
+	if (running.load())
+	{
+		return false;
+	}
+
+	ResetBodies();
+	if (HashState() != recording.startHash)
+	{
+		out << "The bodies don't start out where the recording's did (a different scene?), it won't play back the same" << std::endl;
+	}
+
+	float liveStepTime = stepTime;
+	stepTime = recording.stepTime;
+	playing = recording.playing;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	unsigned long long step = 0;
+	size_t next = 0;
+	while (true)
+	{
+		FrameArena::GetInstance()->Reset();
+		while (next < recording.records.size() && recording.records[next].step == step)
+		{
+			RunCommand(recording.records[next].command);
+			next++;
+		}
+
+		//paused with nothing left to resume it means the recording ends here
+		if (step >= recording.endStep || !playing)
+		{
+			break;
+		}
+		RunStep();
+		step++;
+	}
+	FrameArena::GetInstance()->Reset();
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	stepTime = liveStepTime;
+
+	unsigned long long hash = HashState();
+	SimTotals totals = EntitySystems::Measure(IsSimulated);
+	out << "Replayed " << step << " steps (" << recording.records.size() << " commands) in " << seconds * 1000.0 << " ms, "
+		<< (seconds > 0.0 ? step / seconds : 0.0) << " steps/s on " << JobSystem::GetInstance()->GetThreadCount() << " thread(s)" << std::endl;
+	out << totals.count << " bodies, kinetic energy " << totals.kineticEnergy << ", hash " << std::hex << hash << std::dec << std::endl;
+
+	if (!recording.finished)
+	{
+		out << "The recording was cut off, there's no end state to compare with" << std::endl;
+		return true;
+	}
+	bool same = step == recording.endStep && hash == recording.endHash;
+	out << (same ? "Matches the recorded session bitwise" : "DIFFERS from the recorded session") << std::endl;
+	return same;
+}
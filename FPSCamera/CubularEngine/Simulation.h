@@ -0,0 +1,285 @@
+#pragma once
+#include "stdafx.h"
+#include "EntityWorld.h"
+#include "EntitySystems.h"
+#include "TaskGraph.h"
+#include "TripleBuffer.h"
+#include "SpscQueue.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <memory>
+
+class Scene;
+class EntityPool;
+class KDTree;
+class SimRecorder;
+struct SimRecording;
+struct SimState;
+class SimStateFile;
+struct SavedBody;
+class RewindBuffer;
+
+enum class SimCommandType
+{
+	Spawn,              //a new body
+	Reset,              //respawn the group from the scene
+	SetPlaying,         //pause or resume
+	PrintFrameGraph,    //print how the last step's tasks ran, and write it as a trace
+	SaveState,          //write the bodies out to the save path
+	Seek                //go back (or forward) to a tick in the rewind history, paused
+};
+
+/// <summary>
+/// Something the render thread wants the simulation to do, only the fields its type uses are set
+/// </summary>
+struct SimCommand
+{
+	SimCommandType type;
+
+	//Spawn
+	Mesh* mesh;
+	Material* material;
+	glm::vec3 position;
+	glm::vec3 velocity;
+	glm::vec3 scale;
+	float mass;
+	bool orbital;
+
+	//SetPlaying
+	bool playing;
+
+	//Seek
+	unsigned long long tick;
+};
+
+/// <summary>
+/// One body as it's drawn
+/// </summary>
+struct BodyState
+{
+	glm::mat4 world;
+	glm::vec3 position;
+	float maxScale;
+	Renderable renderable;
+	EntityHandle handle;
+	unsigned int slot;      //EntityPool slot, what the trails are kept by
+};
+
+/// <summary>
+/// Everything the render thread needs from one simulation step
+/// </summary>
+struct SimSnapshot
+{
+	std::vector<BodyState> bodies;     //enabled bodies only, in storage order
+	SimTotals totals;
+	unsigned long long step;
+	unsigned long long tick;            //where on the timeline the bodies are, goes back on a seek
+	unsigned long long oldestTick;      //the furthest back a seek can go
+	unsigned long long merges;          //collisions merged since Start(), the render thread plays a sound when it goes up
+};
+
+/// <summary>
+/// Runs a group of bodies on its own thread at a fixed rate, so a heavy collision step doesn't
+/// hold up drawing and a slow frame doesn't slow the physics down. While it's running the thread
+/// owns the EntityWorld & TransformSystem: the render thread only sees the bodies through the
+/// snapshots it publishes after every step (a TripleBuffer, so neither side ever waits), and
+/// changes them by sending commands (an SpscQueue). Stop() it before touching the world directly.
+/// </summary>
+class Simulation
+{
+private:
+	Scene* scene;
+	std::string group;
+	EntityPool* bodies;
+	KDTree* tree;
+	float stepTime;
+
+	//the stages of one step, on the job system
+	TaskGraph frameGraph;
+	int stepsSinceSort;
+	unsigned long long merges;
+
+	SpscQueue<SimCommand, 256> commands;
+	TripleBuffer<SimSnapshot> snapshots;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	std::atomic<unsigned long long> stepCount;
+	bool playing;
+
+	//records every session Start() begins when there's a path
+	SimRecorder* recorder;
+	std::string recordPath;
+	unsigned long long sessionStart;     //stepCount at Start()
+
+	//where SaveState writes, and the state ResetBodies() goes back to instead of the scene's
+	std::string savePath;
+	std::string startStatePath;
+
+	//set while a worker is writing a save, shared with it so it can outlive the simulation
+	std::shared_ptr<std::atomic<bool>> saving;
+
+	//the last stretch of ticks, for seeking. tick counts the steps since the last reset, less what was seeked back
+	RewindBuffer* rewind;
+	unsigned long long tick;
+	bool rewindKeyframe;        //the next tick has to be a keyframe
+
+	void Loop();
+
+	/// <summary>
+	/// One step of every body
+	/// </summary>
+	void RunStep();
+
+	/// <summary>
+	/// Adds the current tick to the rewind history
+	/// </summary>
+	void RecordRewind();
+
+	/// <summary>
+	/// Runs the queued commands (recording them), true if any of them changed the bodies
+	/// </summary>
+	bool RunCommands();
+
+	/// <summary>
+	/// Runs one command, true if it changed the bodies
+	/// </summary>
+	bool RunCommand(const SimCommand& command);
+
+	/// <summary>
+	/// Copies every body, the broadphase's center and the step's bookkeeping
+	/// </summary>
+	/// <param name="outHandles">If set, gets each body's handle, in the same order</param>
+	void CaptureState(SimState& outState, std::vector<EntityHandle>* outHandles = nullptr);
+
+	/// <summary>
+	/// Replaces the bodies with a saved state's
+	/// </summary>
+	/// <returns>False if the state names meshes or materials the scene doesn't have</returns>
+	bool RestoreState(const SimStateFile& state);
+
+	/// <summary>
+	/// Respawns the bodies from saved ones, RestoreState without the file
+	/// </summary>
+	/// <param name="center">Index of the broadphase's center in saved</param>
+	/// <returns>False if they name meshes or materials the scene doesn't have or don't add up</returns>
+	bool RestoreBodies(const std::vector<std::string>& meshNames, const std::vector<std::string>& materialNames,
+		const SavedBody* saved, size_t count, unsigned int center, unsigned int stepsSinceSort);
+
+	/// <summary>
+	/// Writes the bodies into the back snapshot and hands it over
+	/// </summary>
+	void Publish();
+
+	void Send(const SimCommand& command);
+
+public:
+	/// <param name="scene">Where Reset respawns the group from</param>
+	/// <param name="group">The scene group the bodies come from</param>
+	/// <param name="bodies">The pool the group is bound to</param>
+	/// <param name="tree">Broadphase for the collisions</param>
+	/// <param name="stepTime">Seconds per step</param>
+	Simulation(Scene* scene, const std::string& group, EntityPool* bodies, KDTree* tree, float stepTime);
+
+	/// <summary>
+	/// Stops the thread if it's still running
+	/// </summary>
+	~Simulation();
+
+	Simulation(const Simulation&) = delete;
+	Simulation& operator=(const Simulation&) = delete;
+
+	/// <summary>
+	/// Publishes the bodies as they are and starts stepping them on the simulation thread. With a
+	/// record path set, the session is recorded from here on, ResetBodies() first so it can be replayed.
+	/// </summary>
+	void Start(bool playing);
+
+	/// <summary>
+	/// Waits for the current step to finish and stops the thread, commands it hasn't run are dropped.
+	/// Finishes the recording.
+	/// </summary>
+	void Stop();
+
+	/// <summary>
+	/// Respawns the group from the scene as it was when the game started, or restores the start
+	/// state if there is one. Only while the simulation isn't running.
+	/// </summary>
+	void ResetBodies();
+
+	/// <summary>
+	/// Where SaveState() writes to
+	/// </summary>
+	void SetSavePath(const std::string& path) { savePath = path; }
+
+	/// <summary>
+	/// A saved state (see SimStateFile) for ResetBodies() to start from instead of the scene, e.g.
+	/// to benchmark a scene that has been running a while without stepping it all over again.
+	/// Empty for the scene.
+	/// </summary>
+	void SetStartState(const std::string& path) { startStatePath = path; }
+
+	/// <summary>
+	/// Every session Start() begins from now on is recorded to path (the last one wins), empty to stop recording
+	/// </summary>
+	void SetRecordPath(const std::string& path) { recordPath = path; }
+
+	/// <summary>
+	/// How much rewind history to keep and how often it stores a full keyframe (see RewindBuffer).
+	/// Only while the simulation isn't running. A replay seeks to the same bodies only with the
+	/// limits the session was recorded with.
+	/// </summary>
+	void SetRewindLimits(size_t maxBytes, unsigned int keyframeInterval);
+
+	bool IsRunning() const { return running.load(); }
+
+	//commands, from the thread that calls Start/Stop only
+	void Spawn(Mesh* mesh, Material* material, glm::vec3 position, glm::vec3 velocity, glm::vec3 scale, float mass, bool orbital);
+	void Reset();
+	void SetPlaying(bool playing);
+	void PrintFrameGraph();
+	void SaveState();
+	void Seek(unsigned long long tick);
+
+	/// <summary>
+	/// Render thread: takes the newest snapshot if there is one it hasn't seen, true if it did
+	/// </summary>
+	bool AcquireSnapshot() { return snapshots.Acquire(); }
+
+	/// <summary>
+	/// Render thread: the snapshot taken last, valid until the next AcquireSnapshot()
+	/// </summary>
+	const SimSnapshot& GetSnapshot() const { return snapshots.GetFront(); }
+
+	/// <summary>
+	/// How many steps have run, from any thread
+	/// </summary>
+	unsigned long long GetStepCount() const { return stepCount.load(); }
+
+	/// <summary>
+	/// Hash of every body's bits (position, velocity, mass, scale, enabled) in storage order and
+	/// of their totals. Only while the simulation isn't running.
+	/// </summary>
+	unsigned long long HashState();
+
+	/// <summary>
+	/// Self check for replays: steps the group from its start with a single job thread, then with
+	/// one per core, and compares the states bitwise. Leaves the group reset. Only while the
+	/// simulation isn't running.
+	/// </summary>
+	/// <param name="steps">Steps per run</param>
+	/// <param name="out">Where the hashes & totals are printed</param>
+	/// <returns>True if both runs ended up identical</returns>
+	bool VerifyDeterminism(unsigned int steps, std::ostream& out);
+
+	/// <summary>
+	/// Steps a recorded session again on this thread, as fast as it goes, and prints how long it
+	/// took. Leaves the bodies where the session ended. Only while the simulation isn't running.
+	/// </summary>
+	/// <returns>True if it ended up bitwise where the recording did</returns>
+	bool Replay(const SimRecording& recording, std::ostream& out);
+};
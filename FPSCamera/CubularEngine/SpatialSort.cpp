@@ -0,0 +1,264 @@
+#include "SpatialSort.h"
+#include "TransformSystem.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+	//below this the workers cost more than they save
+	const size_t ParallelThreshold = 64 * 1024;
+
+	//entries per job once it's worth splitting up
+	const size_t ChunkSize = 32 * 1024;
+
+	const unsigned int RadixBits = 8;
+	const size_t Buckets = 1 << RadixBits;
+
+	//calls work(chunk) for every chunk, spread over the job system's threads
+	template<typename Function>
+	void ParallelFor(size_t chunkCount, Function work)
+	{
+		JobSystem::GetInstance()->ParallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+			for (size_t chunk = begin; chunk < end; chunk++)
+			{
+				work(chunk);
+			}
+		});
+	}
+
+	//spreads the low 10 bits out to every third bit
+	unsigned int Spread10(unsigned int value)
+	{
+		value &= 0x3FF;
+		value = (value | (value << 16)) & 0x030000FF;
+		value = (value | (value << 8)) & 0x0300F00F;
+		value = (value | (value << 4)) & 0x030C30C3;
+		value = (value | (value << 2)) & 0x09249249;
+		return value;
+	}
+
+	//spreads the low 21 bits out to every third bit
+	unsigned long long Spread21(unsigned long long value)
+	{
+		value &= 0x1FFFFF;
+		value = (value | (value << 32)) & 0x001F00000000FFFFULL;
+		value = (value | (value << 16)) & 0x001F0000FF0000FFULL;
+		value = (value | (value << 8)) & 0x100F00F00F00F00FULL;
+		value = (value | (value << 4)) & 0x10C30C30C30C30C3ULL;
+		value = (value | (value << 2)) & 0x1249249249249249ULL;
+		return value;
+	}
+
+	//what Run gathers about each entity before sorting
+	struct SortEntry
+	{
+		EntityHandle handle;
+		unsigned int archetype;     //index into the masks Run sorts
+		unsigned int row;
+		TransformId transform;
+	};
+}
+
+unsigned int SpatialSort::Encode30(unsigned int x, unsigned int y, unsigned int z)
+{
+	return (Spread10(x) << 2) | (Spread10(y) << 1) | Spread10(z);
+}
+
+unsigned long long SpatialSort::Encode63(unsigned int x, unsigned int y, unsigned int z)
+{
+	return (Spread21(x) << 2) | (Spread21(y) << 1) | Spread21(z);
+}
+
+void SpatialSort::ComputeCodes(const glm::vec3* positions, size_t count, glm::vec3 boundsMin, glm::vec3 boundsMax,
+	MortonBits bits, unsigned long long* outCodes)
+{
+	float cells = bits == MortonBits::Bits30 ? 1024.0f : 2097152.0f;
+	glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+	glm::vec3 scale = glm::vec3(cells) / extent;
+
+	auto encodeChunk = [&](size_t chunk) {
+		size_t end = std::min(count, (chunk + 1) * ChunkSize);
+		for (size_t i = chunk * ChunkSize; i < end; i++)
+		{
+			glm::vec3 cell = glm::clamp((positions[i] - boundsMin) * scale, glm::vec3(0.0f), glm::vec3(cells - 1.0f));
+			unsigned int x = (unsigned int)cell.x;
+			unsigned int y = (unsigned int)cell.y;
+			unsigned int z = (unsigned int)cell.z;
+			outCodes[i] = bits == MortonBits::Bits30 ? Encode30(x, y, z) : Encode63(x, y, z);
+		}
+	};
+	size_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+	if (count < ParallelThreshold)
+	{
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			encodeChunk(chunk);
+		}
+	}
+	else
+	{
+		ParallelFor(chunkCount, encodeChunk);
+	}
+}
+
+void SpatialSort::RadixSort(unsigned long long* codes, unsigned int* values, size_t count, unsigned int bits)
+{
+	if (count < 2)
+	{
+		return;
+	}
+	size_t chunkCount = count < ParallelThreshold ? 1 : (count + ChunkSize - 1) / ChunkSize;
+	size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+	std::vector<unsigned long long> codeScratch(count);
+	std::vector<unsigned int> valueScratch(count);
+	unsigned long long* codesIn = codes;
+	unsigned long long* codesOut = codeScratch.data();
+	unsigned int* valuesIn = values;
+	unsigned int* valuesOut = valueScratch.data();
+
+	//per chunk histograms, then per chunk write positions
+	std::vector<size_t> histograms(chunkCount * Buckets);
+
+	for (unsigned int shift = 0; shift < bits; shift += RadixBits)
+	{
+		ParallelFor(chunkCount, [&](size_t chunk) {
+			size_t* histogram = &histograms[chunk * Buckets];
+			std::fill(histogram, histogram + Buckets, 0);
+			size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < end; i++)
+			{
+				histogram[(codesIn[i] >> shift) & (Buckets - 1)]++;
+			}
+		});
+
+		//every code has the same digit here, nothing would move
+		bool skip = false;
+		for (size_t bucket = 0; bucket < Buckets && !skip; bucket++)
+		{
+			size_t total = 0;
+			for (size_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				total += histograms[chunk * Buckets + bucket];
+			}
+			skip = total == count;
+		}
+		if (skip)
+		{
+			continue;
+		}
+
+		//a bucket's entries from earlier chunks go first, which keeps the sort stable
+		size_t offset = 0;
+		for (size_t bucket = 0; bucket < Buckets; bucket++)
+		{
+			for (size_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				size_t bucketCount = histograms[chunk * Buckets + bucket];
+				histograms[chunk * Buckets + bucket] = offset;
+				offset += bucketCount;
+			}
+		}
+
+		ParallelFor(chunkCount, [&](size_t chunk) {
+			size_t* position = &histograms[chunk * Buckets];
+			size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < end; i++)
+			{
+				size_t to = position[(codesIn[i] >> shift) & (Buckets - 1)]++;
+				codesOut[to] = codesIn[i];
+				valuesOut[to] = valuesIn[i];
+			}
+		});
+
+		std::swap(codesIn, codesOut);
+		std::swap(valuesIn, valuesOut);
+	}
+
+	//an odd number of passes moved leaves the result in the scratch
+	if (codesIn != codes)
+	{
+		std::copy(codesIn, codesIn + count, codes);
+		std::copy(valuesIn, valuesIn + count, values);
+	}
+}
+
+void SpatialSort::Run(ComponentMask required, MortonBits bits)
+{
+	EntityWorld* world = EntityWorld::GetInstance();
+	TransformSystem* transforms = TransformSystem::GetInstance();
+
+	std::vector<ComponentMask> masks;
+	world->GetArchetypes(required | HasTransform, masks);
+	size_t count = world->Count(required | HasTransform);
+	if (count == 0)
+	{
+		return;
+	}
+
+	//gather everything in storage order, archetype by archetype
+	std::vector<SortEntry> entries;
+	std::vector<glm::vec3> positions;
+	entries.reserve(count);
+	positions.reserve(count);
+	glm::vec3 boundsMin(FLT_MAX);
+	glm::vec3 boundsMax(-FLT_MAX);
+	for (size_t a = 0; a < masks.size(); a++)
+	{
+		unsigned int row = 0;
+		world->ForEachChunkOf(masks[a], [&](const EntityChunkView& chunk) {
+			const EntityHandle* handles = chunk.GetHandles();
+			const Transform* transform = chunk.Get<Transform>();
+			for (size_t i = 0; i < chunk.GetCount(); i++)
+			{
+				SortEntry entry = { handles[i], (unsigned int)a, row++, transform[i].id };
+				entries.push_back(entry);
+				glm::vec3 position = transforms->GetPosition(transform[i].id);
+				positions.push_back(position);
+				boundsMin = glm::min(boundsMin, position);
+				boundsMax = glm::max(boundsMax, position);
+			}
+		});
+	}
+
+	std::vector<unsigned long long> codes(count);
+	std::vector<unsigned int> order(count);
+	ComputeCodes(positions.data(), count, boundsMin, boundsMax, bits, codes.data());
+	for (size_t i = 0; i < count; i++)
+	{
+		order[i] = (unsigned int)i;
+	}
+	RadixSort(codes.data(), order.data(), count, (unsigned int)bits);
+
+	//each archetype's rows take the order its entities come in along the curve
+	std::vector<unsigned int> rows;
+	for (size_t a = 0; a < masks.size(); a++)
+	{
+		rows.clear();
+		for (size_t i = 0; i < count; i++)
+		{
+			const SortEntry& entry = entries[order[i]];
+			if (entry.archetype == a)
+			{
+				rows.push_back(entry.row);
+			}
+		}
+		world->Reorder(masks[a], rows.data());
+	}
+
+	//the same ids, handed out again in curve order, so the transform arrays are walked front to back too
+	std::vector<TransformId> from(count);
+	std::vector<TransformId> to(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		from[i] = entries[order[i]].transform;
+		to[i] = from[i];
+	}
+	std::sort(to.begin(), to.end());
+	transforms->Permute(from.data(), to.data(), count);
+	for (size_t i = 0; i < count; i++)
+	{
+		world->Get<Transform>(entries[order[i]].handle)->id = to[i];
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "stdafx.h"
+#include "EntityWorld.h"
+#include <vector>
+
+/// <summary>
+/// How many bits a Morton code gets. 30 bits (10 per axis, a 1024^3 grid over the bodies' bounds)
+/// sort in 4 radix passes, 63 bits (21 per axis) take 8 but tell apart bodies that are very close.
+/// </summary>
+enum class MortonBits
+{
+	Bits30 = 30,
+	Bits63 = 63
+};
+
+/// <summary>
+/// Puts entities back in spatial order. Bodies are stored in spawn order, so neighbours in
+/// space end up scattered through memory and every neighbour access in the broadphase and
+/// force passes is a cache miss. Run() gives each entity a Morton code (its position's bits
+/// interleaved, so sorting by it walks space along a Z shaped curve), radix sorts the codes
+/// and then moves the component rows and transforms into that order. Handles stay valid, only
+/// what they point to moves.
+/// </summary>
+class SpatialSort
+{
+public:
+	/// <summary>
+	/// Interleaves the low 10 bits of x, y & z
+	/// </summary>
+	static unsigned int Encode30(unsigned int x, unsigned int y, unsigned int z);
+
+	/// <summary>
+	/// Interleaves the low 21 bits of x, y & z
+	/// </summary>
+	static unsigned long long Encode63(unsigned int x, unsigned int y, unsigned int z);
+
+	/// <summary>
+	/// Morton codes for positions inside [boundsMin, boundsMax], anything outside is clamped onto it
+	/// </summary>
+	static void ComputeCodes(const glm::vec3* positions, size_t count, glm::vec3 boundsMin, glm::vec3 boundsMax,
+		MortonBits bits, unsigned long long* outCodes);
+
+	/// <summary>
+	/// Sorts codes ascending and takes values along, stable. Least significant byte first, with
+	/// each pass's histograms and scatters split over the JobSystem for big inputs.
+	/// </summary>
+	/// <param name="bits">Only this many low bits of the codes are sorted on</param>
+	static void RadixSort(unsigned long long* codes, unsigned int* values, size_t count, unsigned int bits);
+
+	/// <summary>
+	/// Reorders every archetype with the required components into Z order of their positions,
+	/// their transforms too. Call it every so often, the bodies drift apart as they move.
+	/// </summary>
+	static void Run(ComponentMask required, MortonBits bits);
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include "stdafx.h"
+#include <atomic>
+#include <cstddef>
+
+/// <summary>
+/// Fixed size queue from exactly one producer thread to exactly one consumer thread, without
+/// locks. Each side only writes its own index, and reads the other's to see how far it can go.
+/// The indices sit on their own cache lines so the two threads don't keep stealing them back.
+/// </summary>
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+private:
+	static_assert((Capacity & (Capacity - 1)) == 0, "the capacity has to be a power of two");
+
+	T items[Capacity];
+	alignas(64) std::atomic<size_t> head;   //next to pop, the consumer's
+	alignas(64) std::atomic<size_t> tail;   //next to push, the producer's
+
+public:
+	SpscQueue()
+		: head(0), tail(0)
+	{
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	/// <summary>
+	/// Producer: adds an item, false if the queue is full
+	/// </summary>
+	bool Push(const T& item)
+	{
+		size_t at = tail.load(std::memory_order_relaxed);
+		if (at - head.load(std::memory_order_acquire) == Capacity)
+		{
+			return false;
+		}
+		items[at & (Capacity - 1)] = item;
+		tail.store(at + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// <summary>
+	/// Consumer: takes the oldest item, false if the queue is empty
+	/// </summary>
+	bool Pop(T& outItem)
+	{
+		size_t at = head.load(std::memory_order_relaxed);
+		if (at == tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		outItem = items[at & (Capacity - 1)];
+		head.store(at + 1, std::memory_order_release);
+		return true;
+	}
+};
@@ -0,0 +1,130 @@
+#include "StreamingBuffer.h"
+#include "MemoryTracker.h"
+#include <iostream>
+
+StreamingBuffer::StreamingBuffer(GLenum target, size_t regionSize)
+{
+	this->target = target;
+	this->regionSize = regionSize;
+	currentRegion = 0;
+	writeOffset = 0;
+	flushedOffset = 0;
+	for (int i = 0; i < RegionCount; i++)
+	{
+		fences[i] = 0;
+	}
+
+	size_t totalSize = regionSize * RegionCount;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+
+	persistent = GLEW_ARB_buffer_storage == GL_TRUE;
+	if (persistent)
+	{
+		//coherent means our writes show up for the GPU without any flush calls,
+		//the fences are what stop us from writing over data it's still reading
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target, totalSize, nullptr, flags);
+		memory = (unsigned char*)glMapBufferRange(target, 0, totalSize, flags);
+	}
+	else
+	{
+		glBufferData(target, totalSize, nullptr, GL_STREAM_DRAW);
+		memory = new unsigned char[totalSize];
+	}
+	glBindBuffer(target, 0);
+	MemoryTracker::TrackGpu(GpuResource::Buffer, buffer, totalSize, MemoryTag::Render);
+
+#ifdef _DEBUG
+	std::cout << "Streaming buffer: " << RegionCount << " x " << regionSize << " bytes, "
+		<< (persistent ? "persistently mapped" : "sub-data uploads") << std::endl;
+#endif
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+	for (int i = 0; i < RegionCount; i++)
+	{
+		if (fences[i] != 0)
+		{
+			glDeleteSync(fences[i]);
+		}
+	}
+
+	if (persistent)
+	{
+		glBindBuffer(target, buffer);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+	}
+	else
+	{
+		delete[] memory;
+	}
+	MemoryTracker::UntrackGpu(GpuResource::Buffer, buffer);
+	glDeleteBuffers(1, &buffer);
+}
+
+void StreamingBuffer::BeginFrame()
+{
+	currentRegion = (currentRegion + 1) % RegionCount;
+	writeOffset = 0;
+	flushedOffset = 0;
+
+	GLsync fence = fences[currentRegion];
+	if (fence != 0)
+	{
+		//the first wait flushes so the fence is guaranteed to signal eventually
+		GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		while (true)
+		{
+			GLenum result = glClientWaitSync(fence, waitFlags, 1000000);   //1ms
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+			{
+				break;
+			}
+			waitFlags = 0;
+		}
+		glDeleteSync(fence);
+		fences[currentRegion] = 0;
+	}
+}
+
+void StreamingBuffer::EndFrame()
+{
+	if (writeOffset > 0)
+	{
+		fences[currentRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+void* StreamingBuffer::Allocate(size_t size, size_t alignment, GLintptr& outOffset)
+{
+	size_t aligned = (writeOffset + alignment - 1) / alignment * alignment;
+	if (aligned + size > regionSize)
+	{
+#ifdef _DEBUG
+		std::cout << "Streaming buffer region is full, dropping " << size << " bytes" << std::endl;
+#endif
+		return nullptr;
+	}
+
+	writeOffset = aligned + size;
+	outOffset = (GLintptr)(currentRegion * regionSize + aligned);
+	return memory + outOffset;
+}
+
+void StreamingBuffer::Flush()
+{
+	if (persistent || writeOffset == flushedOffset)
+	{
+		return;
+	}
+
+	//only upload what was written since the last flush
+	GLintptr start = (GLintptr)(currentRegion * regionSize + flushedOffset);
+	glBindBuffer(target, buffer);
+	glBufferSubData(target, start, writeOffset - flushedOffset, memory + start);
+	glBindBuffer(target, 0);
+	flushedOffset = writeOffset;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "stdafx.h"
+
+/// <summary>
+/// A GPU buffer for data that gets rewritten every frame (trails, per-instance data...).
+/// The buffer is split into 3 regions so the CPU can write one while the GPU is still
+/// reading the other two. With ARB_buffer_storage the buffer stays persistently mapped
+/// and writes land directly in GPU visible memory; without it writes go to a CPU copy
+/// that is uploaded on Flush().
+/// </summary>
+class StreamingBuffer
+{
+private:
+	static const int RegionCount = 3;
+
+	GLuint buffer;
+	GLenum target;
+	size_t regionSize;
+
+	//which region we're writing this frame, and how much of it is used
+	int currentRegion;
+	size_t writeOffset;
+
+	//how much of the region was uploaded already (fallback path only)
+	size_t flushedOffset;
+
+	//signalled once the GPU is done with everything drawn from that region
+	GLsync fences[RegionCount];
+
+	//start of the whole buffer (mapped memory or the CPU copy)
+	unsigned char* memory;
+	bool persistent;
+
+public:
+	/// <summary>
+	/// Creates the buffer
+	/// </summary>
+	/// <param name="target">What the buffer gets bound as, e.g. GL_ARRAY_BUFFER</param>
+	/// <param name="regionSize">How many bytes can be written per frame</param>
+	StreamingBuffer(GLenum target, size_t regionSize);
+
+	/// <summary>
+	/// Destruction
+	/// </summary>
+	~StreamingBuffer();
+
+	/// <summary>
+	/// Moves on to the next region, waiting if the GPU still reads from it
+	/// (only happens when the CPU is more than 2 frames ahead)
+	/// </summary>
+	void BeginFrame();
+
+	/// <summary>
+	/// Fences the region written this frame. Call after the last draw that reads it.
+	/// </summary>
+	void EndFrame();
+
+	/// <summary>
+	/// Reserves space in this frame's region
+	/// </summary>
+	/// <param name="size">How many bytes to reserve</param>
+	/// <param name="alignment">Alignment of the returned offset (use the vertex size for vertex data)</param>
+	/// <param name="outOffset">Receives the byte offset inside the buffer, for attribute pointers</param>
+	/// <returns>Where to write the data, or nullptr if this frame's region is full</returns>
+	void* Allocate(size_t size, size_t alignment, GLintptr& outOffset);
+
+	/// <summary>
+	/// Makes everything written so far visible to the GPU. Call before drawing from it.
+	/// </summary>
+	void Flush();
+
+	GLuint GetBuffer() const { return buffer; }
+	bool IsPersistent() const { return persistent; }
+};
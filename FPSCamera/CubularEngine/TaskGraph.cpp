@@ -0,0 +1,169 @@
+#include "TaskGraph.h"
+#include <thread>
+
+TaskGraph::TaskGraph()
+	: unfinished(0)
+{
+	lastRunTime = 0;
+}
+
+TaskGraph::~TaskGraph()
+{
+	for (size_t t = 0; t < tasks.size(); t++)
+	{
+		delete tasks[t];
+	}
+}
+
+TaskId TaskGraph::AddTask(const std::string& name, std::function<void()> work, std::vector<TaskId> dependencies, bool mainThread)
+{
+	TaskId id = (TaskId)tasks.size();
+	Task* task = new Task();
+	task->id = id;
+	task->name = name;
+	task->work = work;
+	task->mainThread = mainThread;
+	task->enabled = true;
+	task->start = 0;
+	task->end = 0;
+	task->thread = 0;
+	task->graph = this;
+	task->waitingOn = 0;
+
+	for (size_t d = 0; d < dependencies.size(); d++)
+	{
+		//only earlier tasks, which keeps the graph free of cycles
+		if (dependencies[d] >= id)
+		{
+#ifdef _DEBUG
+			std::cout << "Task " << name << " depends on a task that doesn't exist yet" << std::endl;
+#endif
+			continue;
+		}
+		task->dependencies.push_back(dependencies[d]);
+		tasks[dependencies[d]]->dependents.push_back(id);
+	}
+
+	tasks.push_back(task);
+	mainThreadReady.reserve(tasks.size());
+	return id;
+}
+
+void TaskGraph::RunTaskJob(void* data, size_t, size_t)
+{
+	Task* task = static_cast<Task*>(data);
+	task->graph->RunTask(task);
+}
+
+void TaskGraph::RunTask(Task* task)
+{
+	task->start = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - runStart).count();
+	task->thread = JobSystem::GetThreadIndex();
+	if (task->enabled)
+	{
+		task->work();
+	}
+	task->end = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - runStart).count();
+
+	for (size_t d = 0; d < task->dependents.size(); d++)
+	{
+		Task* dependent = tasks[task->dependents[d]];
+		if (dependent->waitingOn.fetch_sub(1) == 1)
+		{
+			MakeReady(dependent);
+		}
+	}
+	unfinished.fetch_sub(1);
+}
+
+void TaskGraph::MakeReady(Task* task)
+{
+	if (task->mainThread)
+	{
+		std::lock_guard<std::mutex> lock(mainThreadMutex);
+		mainThreadReady.push_back(task->id);
+		return;
+	}
+
+	Job job;
+	job.function = &TaskGraph::RunTaskJob;
+	job.data = task;
+	job.begin = 0;
+	job.end = 0;
+	job.counter = nullptr;
+	job.tag = MemoryTracker::GetThreadTag();
+	JobSystem::GetInstance()->Schedule(job);
+}
+
+void TaskGraph::Run()
+{
+	runStart = std::chrono::high_resolution_clock::now();
+	unfinished = (int)tasks.size();
+	for (size_t t = 0; t < tasks.size(); t++)
+	{
+		tasks[t]->waitingOn = (int)tasks[t]->dependencies.size();
+	}
+	for (size_t t = 0; t < tasks.size(); t++)
+	{
+		if (tasks[t]->dependencies.empty())
+		{
+			MakeReady(tasks[t]);
+		}
+	}
+
+	JobSystem* jobs = JobSystem::GetInstance();
+	while (unfinished.load() > 0)
+	{
+		TaskId ready = (TaskId)-1;
+		{
+			std::lock_guard<std::mutex> lock(mainThreadMutex);
+			if (!mainThreadReady.empty())
+			{
+				ready = mainThreadReady.back();
+				mainThreadReady.pop_back();
+			}
+		}
+		if (ready != (TaskId)-1)
+		{
+			RunTask(tasks[ready]);
+		}
+		else if (!jobs->RunPendingJob())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	lastRunTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - runStart).count();
+}
+
+void TaskGraph::Print(std::ostream& out) const
+{
+	out << "Frame graph, " << lastRunTime << " us:" << std::endl;
+	for (size_t t = 0; t < tasks.size(); t++)
+	{
+		const Task* task = tasks[t];
+		out << "  " << task->name << (task->enabled ? "" : " (off)") << ": thread " << task->thread
+			<< ", " << task->start << " us + " << (task->end - task->start) << " us";
+		if (!task->dependencies.empty())
+		{
+			out << ", after";
+			for (size_t d = 0; d < task->dependencies.size(); d++)
+			{
+				out << " " << tasks[task->dependencies[d]]->name;
+			}
+		}
+		out << std::endl;
+	}
+}
+
+void TaskGraph::WriteTrace(std::ostream& out) const
+{
+	out << "{\"traceEvents\":[";
+	for (size_t t = 0; t < tasks.size(); t++)
+	{
+		const Task* task = tasks[t];
+		out << (t > 0 ? ",\n" : "\n") << "{\"name\":\"" << task->name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << task->thread
+			<< ",\"ts\":" << task->start << ",\"dur\":" << (task->end - task->start) << "}";
+	}
+	out << "\n]}" << std::endl;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "stdafx.h"
+#include "JobSystem.h"
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <ostream>
+
+typedef unsigned int TaskId;
+
+/// <summary>
+/// The stages of a frame and what each one has to wait for. It's built once and Run() every
+/// frame: a task is handed to the JobSystem as soon as the last task it depends on finishes,
+/// so stages that don't depend on each other overlap on different cores. Tasks that have to
+/// stay on the calling thread (anything touching GL) are run by it, in between helping with
+/// the others. Every Run() records when and where each task ran, see Print() & WriteTrace().
+/// </summary>
+class TaskGraph
+{
+public:
+	/// <summary>
+	/// One task, and what happened to it last Run()
+	/// </summary>
+	struct Task
+	{
+		std::string name;
+		std::function<void()> work;
+		std::vector<TaskId> dependencies;
+		std::vector<TaskId> dependents;
+		bool mainThread;        //only run on the thread calling Run()
+		bool enabled;           //disabled tasks finish straight away, what depends on them still runs
+
+		//last Run(), microseconds since it started
+		long long start;
+		long long end;
+		unsigned int thread;    //JobSystem thread index
+
+		TaskId id;
+		TaskGraph* graph;
+		std::atomic<int> waitingOn;
+	};
+
+private:
+	//pointers, so a task's atomics and address stay put while tasks are added
+	std::vector<Task*> tasks;
+
+	//main thread tasks that are ready to go
+	std::vector<TaskId> mainThreadReady;
+	std::mutex mainThreadMutex;
+
+	std::atomic<int> unfinished;
+	std::chrono::high_resolution_clock::time_point runStart;
+	long long lastRunTime;
+
+	static void RunTaskJob(void* data, size_t begin, size_t end);
+	void RunTask(Task* task);
+	void MakeReady(Task* task);
+
+public:
+	TaskGraph();
+	~TaskGraph();
+
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+
+	/// <summary>
+	/// Adds a task that starts once all of its dependencies have finished. Dependencies have to
+	/// be added first, so the graph can't have cycles.
+	/// </summary>
+	/// <param name="mainThread">Only run it on the thread calling Run()</param>
+	TaskId AddTask(const std::string& name, std::function<void()> work, std::vector<TaskId> dependencies = std::vector<TaskId>(), bool mainThread = false);
+
+	/// <summary>
+	/// Skips a task's work from the next Run() on (or brings it back)
+	/// </summary>
+	void SetEnabled(TaskId task, bool enabled) { tasks[task]->enabled = enabled; }
+
+	/// <summary>
+	/// Runs every task once and returns when they've all finished, helping out with the jobs in the meantime
+	/// </summary>
+	void Run();
+
+	size_t GetTaskCount() const { return tasks.size(); }
+	const Task& GetTask(TaskId task) const { return *tasks[task]; }
+
+	/// <summary>
+	/// How long the last Run() took, in microseconds
+	/// </summary>
+	long long GetLastRunTime() const { return lastRunTime; }
+
+	/// <summary>
+	/// Prints the last Run(): every task with its dependencies, thread, start & duration
+	/// </summary>
+	void Print(std::ostream& out) const;
+
+	/// <summary>
+	/// Writes the last Run() as a Chrome trace (chrome://tracing or Perfetto can open it), one row per thread
+	/// </summary>
+	void WriteTrace(std::ostream& out) const;
+};
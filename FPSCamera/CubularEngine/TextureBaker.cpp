@@ -0,0 +1,308 @@
+#include "TextureBaker.h"
+#include "AssetLoader.h"
+#include "stb_image.h"
+#include <filesystem>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BAKER_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	//888 -> 565, rounded
+	unsigned short Pack565(const float* color)
+	{
+		int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+		int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+		int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+		r = std::min(std::max(r, 0), 31);
+		g = std::min(std::max(g, 0), 63);
+		b = std::min(std::max(b, 0), 31);
+		return (unsigned short)((r << 11) | (g << 5) | b);
+	}
+
+	//565 -> 888 the way the hardware expands it
+	void Unpack565(unsigned short packed, int* color)
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	//one 4x4 block, 16 RGB pixels in, 8 bytes out
+	void CompressBlock(const unsigned char block[16][4], unsigned char* out)
+	{
+		//endpoints are the extremes along the principal axis of the colors
+		float mean[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				mean[c] += block[i][c];
+			}
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			mean[c] /= 16.0f;
+		}
+
+		float cov[6] = { 0, 0, 0, 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+			cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+			cov[3] += g * g; cov[4] += g * b;
+			cov[5] += b * b;
+		}
+
+		//a few rounds of power iteration are plenty for a 3x3
+		float axis[3] = { 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 4; iteration++)
+		{
+			float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+			float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+			float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+			float length = std::max(std::max(fabsf(x), fabsf(y)), fabsf(z));
+			if (length <= 0.0f)
+			{
+				break;
+			}
+			axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+		}
+
+		float minDot = 1e30f, maxDot = -1e30f;
+		for (int i = 0; i < 16; i++)
+		{
+			float d = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+			minDot = std::min(minDot, d);
+			maxDot = std::max(maxDot, d);
+		}
+
+		float axisLengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		float high[3], low[3];
+		for (int c = 0; c < 3; c++)
+		{
+			float scale = axisLengthSq > 0.0f ? axis[c] / axisLengthSq : 0.0f;
+			high[c] = mean[c] + maxDot * scale;
+			low[c] = mean[c] + minDot * scale;
+
+			//pull the endpoints in a little, the palette covers the range better that way
+			float inset = (high[c] - low[c]) / 16.0f;
+			high[c] = std::min(std::max(high[c] - inset, 0.0f), 255.0f);
+			low[c] = std::min(std::max(low[c] + inset, 0.0f), 255.0f);
+		}
+
+		unsigned short c0 = Pack565(high);
+		unsigned short c1 = Pack565(low);
+
+		//c0 > c1 selects the 4 color mode, c0 == c1 is a flat block
+		if (c0 < c1)
+		{
+			std::swap(c0, c1);
+		}
+		unsigned int indices = 0;
+		if (c0 != c1)
+		{
+			int palette[4][3];
+			Unpack565(c0, palette[0]);
+			Unpack565(c1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0;
+				int bestDistance = 1 << 30;
+				for (int p = 0; p < 4; p++)
+				{
+					int dr = block[i][0] - palette[p][0];
+					int dg = block[i][1] - palette[p][1];
+					int db = block[i][2] - palette[p][2];
+					int distance = dr * dr + dg * dg + db * db;
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= (unsigned int)best << (2 * i);
+			}
+		}
+
+		memcpy(out, &c0, 2);
+		memcpy(out + 2, &c1, 2);
+		memcpy(out + 4, &indices, 4);
+	}
+}
+
+std::string TextureBaker::GetBakedPath(const std::string& sourcePath)
+{
+	return std::filesystem::path(sourcePath).replace_extension(".ktx").string();
+}
+
+void TextureBaker::Downsample(const unsigned char* source, int width, int height, std::vector<unsigned char>& outPixels)
+{
+	int outWidth = width > 1 ? width / 2 : 1;
+	int outHeight = height > 1 ? height / 2 : 1;
+	outPixels.resize((size_t)outWidth * outHeight * 4);
+
+	int x = 0;
+	for (int y = 0; y < outHeight; y++)
+	{
+		const unsigned char* row0 = source + (size_t)std::min(y * 2, height - 1) * width * 4;
+		const unsigned char* row1 = source + (size_t)std::min(y * 2 + 1, height - 1) * width * 4;
+		unsigned char* dest = &outPixels[(size_t)y * outWidth * 4];
+		x = 0;
+
+#ifdef BAKER_USE_SSE2
+		//4 source pixels -> 2 output pixels per step
+		if (width == outWidth * 2)
+		{
+			for (; x + 2 <= outWidth; x += 2)
+			{
+				__m128i top = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+				__m128i bottom = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+				__m128i vertical = _mm_avg_epu8(top, bottom);
+
+				//average each pixel with its right neighbour, the results land in pixels 0 and 2
+				__m128i horizontal = _mm_avg_epu8(vertical, _mm_srli_epi64(vertical, 32));
+				__m128i packed = _mm_shuffle_epi32(horizontal, _MM_SHUFFLE(3, 1, 2, 0));
+				_mm_storel_epi64((__m128i*)(dest + x * 4), packed);
+			}
+		}
+#endif
+
+		for (; x < outWidth; x++)
+		{
+			int x0 = std::min(x * 2, width - 1) * 4;
+			int x1 = std::min(x * 2 + 1, width - 1) * 4;
+			for (int c = 0; c < 4; c++)
+			{
+				dest[x * 4 + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+			}
+		}
+	}
+}
+
+void TextureBaker::CompressBC1(const unsigned char* pixels, int width, int height, std::string& outBlocks)
+{
+	int blocksX = (width + 3) / 4;
+	int blocksY = (height + 3) / 4;
+	outBlocks.resize((size_t)blocksX * blocksY * 8);
+
+	unsigned char block[16][4];
+	for (int by = 0; by < blocksY; by++)
+	{
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				int x = std::min(bx * 4 + (i & 3), width - 1);
+				int y = std::min(by * 4 + (i >> 2), height - 1);
+				memcpy(block[i], pixels + ((size_t)y * width + x) * 4, 4);
+			}
+			CompressBlock(block, (unsigned char*)&outBlocks[((size_t)by * blocksX + bx) * 8]);
+		}
+	}
+}
+
+bool TextureBaker::BakeImage(const std::string& sourcePath)
+{
+	int width, height, channels;
+	unsigned char* pixels = stbi_load(sourcePath.c_str(), &width, &height, &channels, 4);
+	if (pixels == nullptr)
+	{
+		std::cout << "Bake failed to load: " << sourcePath << std::endl;
+		return false;
+	}
+
+	KtxImage image;
+	image.internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	image.baseFormat = GL_RGB;
+	image.width = width;
+	image.height = height;
+
+	std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * 4);
+	stbi_image_free(pixels);
+
+	std::vector<unsigned char> next;
+	std::string blocks;
+	while (true)
+	{
+		CompressBC1(&level[0], width, height, blocks);
+
+		KtxLevel info;
+		info.width = width;
+		info.height = height;
+		info.offset = image.data.size();
+		info.size = blocks.size();
+		image.levels.push_back(info);
+		image.data += blocks;
+
+		if (width == 1 && height == 1)
+		{
+			break;
+		}
+		Downsample(&level[0], width, height, next);
+		level.swap(next);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	if (!Ktx::Write(GetBakedPath(sourcePath), image))
+	{
+		std::cout << "Bake failed to write: " << GetBakedPath(sourcePath) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int TextureBaker::BakeDirectory(const std::string& directory)
+{
+	std::vector<std::future<bool>> bakes;
+	std::vector<std::string> sources;
+
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator it(directory, error), end; it != end; it.increment(error))
+	{
+		if (!it->is_regular_file())
+		{
+			continue;
+		}
+		std::string extension = it->path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension != ".png" && extension != ".jpg" && extension != ".tga")
+		{
+			continue;
+		}
+
+		std::string path = it->path().string();
+		sources.push_back(path);
+		bakes.push_back(AssetLoader::GetInstance()->Run<bool>([path]() { return BakeImage(path); }));
+	}
+
+	int failed = 0;
+	for (size_t i = 0; i < bakes.size(); i++)
+	{
+		if (bakes[i].get())
+		{
+			std::cout << "Baked " << sources[i] << " -> " << GetBakedPath(sources[i]) << std::endl;
+		}
+		else
+		{
+			failed++;
+		}
+	}
+	return failed;
+}
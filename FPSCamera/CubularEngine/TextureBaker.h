@@ -0,0 +1,41 @@
+#pragma once
+#include "stdafx.h"
+#include "Ktx.h"
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Offline step that turns source images into BC1 (DXT1) compressed KTX files with a
+/// full mip chain, so the runtime can hand the blocks straight to glCompressedTexImage2D
+/// instead of inflating PNGs. Run the game with --bake-textures to bake everything under assets/.
+/// </summary>
+class TextureBaker
+{
+public:
+	/// <summary>
+	/// Where the baked version of an image lives (same path, .ktx extension)
+	/// </summary>
+	static std::string GetBakedPath(const std::string& sourcePath);
+
+	/// <summary>
+	/// Bakes one image to GetBakedPath(sourcePath)
+	/// </summary>
+	/// <returns>Whether the image could be read and the KTX written</returns>
+	static bool BakeImage(const std::string& sourcePath);
+
+	/// <summary>
+	/// Bakes every .png / .jpg / .tga under a directory, spread over the AssetLoader's workers
+	/// </summary>
+	/// <returns>How many images failed to bake</returns>
+	static int BakeDirectory(const std::string& directory);
+
+	/// <summary>
+	/// Halves an RGBA8 image with a 2x2 box filter (SSE2 when the size allows)
+	/// </summary>
+	static void Downsample(const unsigned char* source, int width, int height, std::vector<unsigned char>& outPixels);
+
+	/// <summary>
+	/// Compresses an RGBA8 image to BC1 blocks, edge blocks repeat the last row / column
+	/// </summary>
+	static void CompressBC1(const unsigned char* pixels, int width, int height, std::string& outBlocks);
+};
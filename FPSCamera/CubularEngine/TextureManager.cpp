@@ -0,0 +1,594 @@
+#include "TextureManager.h"
+#include "MemoryTracker.h"
+#include "AssetLoader.h"
+#include "TextureBaker.h"
+#include "AssetPack.h"
+#include "stb_image.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+//for singleton
+TextureManager* TextureManager::instance = nullptr;
+
+//prefers the baked .ktx next to an image (or in the pack), if it's up to date and the driver can use it
+static std::string ResolvePath(const std::string& path)
+{
+	if (!GLEW_EXT_texture_compression_s3tc)
+	{
+		return path;
+	}
+	std::string baked = TextureBaker::GetBakedPath(path);
+	if (AssetPack::GetInstance()->IsBuildFresh(path, baked))
+	{
+		return baked;
+	}
+	return path;
+}
+
+TextureManager::TextureManager()
+{
+	uploadPBO = 0;
+}
+
+TextureManager::~TextureManager()
+{
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		if (textures[i].alive)
+		{
+			MemoryTracker::UntrackGpu(GpuResource::Texture, textures[i].id);
+			glDeleteTextures(1, &textures[i].id);
+		}
+	}
+	if (uploadPBO != 0)
+	{
+		MemoryTracker::UntrackGpu(GpuResource::Buffer, uploadPBO);
+		glDeleteBuffers(1, &uploadPBO);
+	}
+	TrimImageCache();
+}
+
+TextureManager* TextureManager::GetInstance()
+{
+	if (instance == nullptr)
+	{
+		instance = new TextureManager();
+	}
+	return instance;
+}
+
+void TextureManager::Release()
+{
+	delete instance;
+	instance = nullptr;
+}
+
+int TextureManager::FindOrLoadImage(const std::string& path)
+{
+	auto byPath = imagesByPath.find(path);
+	if (byPath != imagesByPath.end())
+	{
+		return (int)byPath->second;
+	}
+
+	//packed images are decoded straight out of the mapped pack
+	std::string storage;
+	AssetView bytes = AssetPack::GetInstance()->Load(ResolvePath(path), storage);
+	if (!bytes.IsValid())
+	{
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+		return -1;
+	}
+
+	//same contents under another path, no need to decode it again
+	unsigned long long hash = AssetLoader::HashBytes(bytes.data, bytes.size);
+	auto byHash = imagesByHash.find(hash);
+	if (byHash != imagesByHash.end())
+	{
+		imagesByPath[path] = byHash->second;
+		return (int)byHash->second;
+	}
+
+	Image image;
+	image.hash = hash;
+	image.path = path;
+	if (!DecodeBytes(bytes, image))
+	{
+		std::cout << "Texture failed to decode at path: " << path << std::endl;
+		return -1;
+	}
+
+	size_t index = images.size();
+	images.push_back(image);
+	imagesByPath[path] = index;
+	imagesByHash[hash] = index;
+	return (int)index;
+}
+
+bool TextureManager::DecodeImage(Image& image)
+{
+	if (image.HasData())
+	{
+		return true;
+	}
+
+	std::string storage;
+	AssetView bytes = AssetPack::GetInstance()->Load(ResolvePath(image.path), storage);
+	if (!bytes.IsValid())
+	{
+		return false;
+	}
+	return DecodeBytes(bytes, image);
+}
+
+bool TextureManager::DecodeBytes(AssetView bytes, Image& image)
+{
+	image.pixels = nullptr;
+	image.compressed.reset();
+
+	//baked files are already in the GPU's format, nothing to inflate
+	if (Ktx::IsKtx(bytes.data, bytes.size))
+	{
+		std::shared_ptr<KtxImage> compressed = std::make_shared<KtxImage>();
+		if (!Ktx::Parse(bytes.data, bytes.size, *compressed))
+		{
+			return false;
+		}
+		image.width = compressed->width;
+		image.height = compressed->height;
+		image.channels = 0;
+		image.compressed = compressed;
+		return true;
+	}
+
+	image.pixels = stbi_load_from_memory((const stbi_uc*)bytes.data, (int)bytes.size,
+		&image.width, &image.height, &image.channels, 0);
+	return image.pixels != nullptr;
+}
+
+TextureHandle TextureManager::AddTexture(GLuint id, GLenum target, const std::string& key)
+{
+	unsigned int index;
+	if (!freeTextures.empty())
+	{
+		index = freeTextures.back();
+		freeTextures.pop_back();
+	}
+	else
+	{
+		index = (unsigned int)textures.size();
+		Texture empty;
+		empty.generation = 0;
+		textures.push_back(empty);
+	}
+
+	Texture& texture = textures[index];
+	texture.id = id;
+	texture.target = target;
+	texture.key = key;
+	texture.refCount = 1;
+	texture.generation++;
+	texture.alive = true;
+	texture.ready = true;
+	texturesByKey[key] = index;
+	return MakeHandle(index);
+}
+
+TextureHandle TextureManager::MakeHandle(unsigned int index) const
+{
+	TextureHandle handle;
+	handle.index = index;
+	handle.generation = textures[index].generation;
+	return handle;
+}
+
+std::string TextureManager::CubemapKey(const int faceImages[6]) const
+{
+	//key the cubemap by its face contents, not its paths
+	std::string key = "cube:";
+	for (size_t i = 0; i < 6; i++)
+	{
+		key += faceImages[i] >= 0 ? std::to_string(images[faceImages[i]].hash) : "missing";
+		key += ";";
+	}
+	return key;
+}
+
+TextureHandle TextureManager::LoadCubemap(const std::vector<std::string>& faces)
+{
+	int faceImages[6];
+	for (size_t i = 0; i < 6; i++)
+	{
+		faceImages[i] = i < faces.size() ? FindOrLoadImage(faces[i]) : -1;
+	}
+	std::string key = CubemapKey(faceImages);
+
+	auto existing = texturesByKey.find(key);
+	if (existing != texturesByKey.end())
+	{
+		textures[existing->second].refCount++;
+		return MakeHandle(existing->second);
+	}
+
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	MemoryTracker::TrackGpu(GpuResource::Texture, textureID, 0, MemoryTag::Assets);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+	//loads each face of the cube map
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		if (faceImages[i] < 0 || !DecodeImage(images[faceImages[i]]))
+		{
+			continue;
+		}
+		UploadFace(textureID, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, images[faceImages[i]]);
+	}
+	SetCubemapParameters(faceImages);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	return AddTexture(textureID, GL_TEXTURE_CUBE_MAP, key);
+}
+
+GLuint TextureManager::GetTexture(TextureHandle handle) const
+{
+	if (!handle.IsValid() || handle.index >= textures.size())
+	{
+		return 0;
+	}
+	const Texture& texture = textures[handle.index];
+	if (!texture.alive || !texture.ready || texture.generation != handle.generation)
+	{
+		return 0;
+	}
+	return texture.id;
+}
+
+bool TextureManager::IsLoaded(TextureHandle handle) const
+{
+	return GetTexture(handle) != 0;
+}
+
+bool TextureManager::IsLive(TextureHandle handle) const
+{
+	return handle.IsValid() && handle.index < textures.size()
+		&& textures[handle.index].alive && textures[handle.index].generation == handle.generation;
+}
+
+void TextureManager::AddRef(TextureHandle handle)
+{
+	if (IsLive(handle))
+	{
+		textures[handle.index].refCount++;
+	}
+}
+
+void TextureManager::ReleaseTexture(TextureHandle handle)
+{
+	if (IsLive(handle) && textures[handle.index].refCount > 0)
+	{
+		textures[handle.index].refCount--;
+	}
+}
+
+size_t TextureManager::EvictUnused()
+{
+	size_t evicted = 0;
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		Texture& texture = textures[i];
+		if (texture.alive && texture.ready && texture.refCount <= 0)
+		{
+			MemoryTracker::UntrackGpu(GpuResource::Texture, texture.id);
+			glDeleteTextures(1, &texture.id);
+			texturesByKey.erase(texture.key);
+			texture.alive = false;
+			freeTextures.push_back(i);
+			evicted++;
+		}
+	}
+	return evicted;
+}
+
+void TextureManager::TrimImageCache()
+{
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		if (images[i].pixels != nullptr)
+		{
+			stbi_image_free(images[i].pixels);
+			images[i].pixels = nullptr;
+		}
+		images[i].compressed.reset();
+	}
+}
+
+TextureManager::Image TextureManager::DecodeFile(const std::string& path)
+{
+	Image image;
+	image.path = path;
+	image.hash = 0;
+	image.width = image.height = image.channels = 0;
+	image.pixels = nullptr;
+
+	std::string storage;
+	AssetView bytes = AssetPack::GetInstance()->Load(ResolvePath(path), storage);
+	if (!bytes.IsValid())
+	{
+		return image;
+	}
+	image.hash = AssetLoader::HashBytes(bytes.data, bytes.size);
+	DecodeBytes(bytes, image);
+	return image;
+}
+
+int TextureManager::AdoptImage(Image& decoded)
+{
+	if (!decoded.HasData())
+	{
+		std::cout << "Texture failed to load at path: " << decoded.path << std::endl;
+		return -1;
+	}
+
+	//another load got there first, keep the cached copy
+	auto byPath = imagesByPath.find(decoded.path);
+	auto byHash = imagesByHash.find(decoded.hash);
+	size_t index;
+	if (byPath != imagesByPath.end() || byHash != imagesByHash.end())
+	{
+		index = byPath != imagesByPath.end() ? byPath->second : byHash->second;
+		if (!images[index].HasData())
+		{
+			//trimmed since, just take the fresh pixels
+			images[index].pixels = decoded.pixels;
+			images[index].compressed = decoded.compressed;
+		}
+		else if (decoded.pixels != nullptr)
+		{
+			stbi_image_free(decoded.pixels);
+		}
+	}
+	else
+	{
+		index = images.size();
+		images.push_back(decoded);
+		imagesByHash[decoded.hash] = index;
+	}
+	decoded.pixels = nullptr;
+	decoded.compressed.reset();
+	imagesByPath[decoded.path] = index;
+	return (int)index;
+}
+
+int TextureManager::AdoptFace(const std::shared_future<Image>& decode)
+{
+	const std::string& path = decode.get().path;
+	auto inFlight = faceDecodes.find(path);
+	if (inFlight != faceDecodes.end())
+	{
+		//the pixels go to the cache once, whoever else waited on it shares them from there
+		Image decoded = decode.get();
+		faceDecodes.erase(inFlight);
+		return AdoptImage(decoded);
+	}
+	auto byPath = imagesByPath.find(path);
+	return byPath != imagesByPath.end() ? (int)byPath->second : -1;
+}
+
+void TextureManager::UploadFace(GLuint texture, GLenum face, const Image& image)
+{
+	const KtxImage* compressed = image.compressed.get();
+	GLenum format = image.channels == 4 ? GL_RGBA : GL_RGB;
+	size_t size = compressed != nullptr ? compressed->data.size() : (size_t)image.width * image.height * image.channels;
+	const void* source = compressed != nullptr ? (const void*)compressed->data.data() : (const void*)image.pixels;
+
+	if (uploadPBO == 0)
+	{
+		glGenBuffers(1, &uploadPBO);
+	}
+
+	//orphan the old storage so we never wait on the previous face's transfer
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	MemoryTracker::TrackGpu(GpuResource::Buffer, uploadPBO, size, MemoryTag::Assets);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped != nullptr)
+	{
+		memcpy(mapped, source, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		//with a PBO bound the data pointer is an offset into it
+		source = nullptr;
+	}
+	else
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	if (compressed != nullptr)
+	{
+		//baked blocks go up as they are, mips included
+		for (size_t level = 0; level < compressed->levels.size(); level++)
+		{
+			const KtxLevel& info = compressed->levels[level];
+			glCompressedTexImage2D(face, (GLint)level, compressed->internalFormat, info.width, info.height, 0,
+				(GLsizei)info.size, (const char*)source + info.offset);
+		}
+	}
+	else
+	{
+		glTexImage2D(face, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, source);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	//roughly what the driver keeps for it (compressed blocks as they are, RGB is usually padded out)
+	MemoryTracker::AddGpuBytes(GpuResource::Texture, texture, compressed != nullptr ? size : (size_t)image.width * image.height * 4);
+}
+
+void TextureManager::SetCubemapParameters(const int faceImages[6])
+{
+	//only mip if every face brought its own chain
+	size_t levels = ~(size_t)0;
+	for (size_t i = 0; i < 6; i++)
+	{
+		const Image* image = faceImages[i] >= 0 ? &images[faceImages[i]] : nullptr;
+		levels = std::min(levels, image != nullptr && image->compressed ? image->compressed->levels.size() : (size_t)1);
+	}
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, (GLint)levels - 1);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
+TextureHandle TextureManager::LoadCubemapAsync(const std::vector<std::string>& faces, std::function<void(TextureHandle)> onLoaded)
+{
+	//faces we already have pixels for don't need a worker
+	int faceImages[6];
+	bool allCached = true;
+	std::string pendingKey = "pending:";
+	for (size_t i = 0; i < 6; i++)
+	{
+		faceImages[i] = -1;
+		if (i < faces.size())
+		{
+			auto byPath = imagesByPath.find(faces[i]);
+			if (byPath != imagesByPath.end() && images[byPath->second].HasData())
+			{
+				faceImages[i] = (int)byPath->second;
+			}
+			pendingKey += faces[i];
+		}
+		allCached = allCached && (faceImages[i] >= 0 || i >= faces.size());
+		pendingKey += ";";
+	}
+
+	//already built (or everything is in memory anyway), nothing to wait for
+	if (allCached)
+	{
+		TextureHandle handle = LoadCubemap(faces);
+		if (onLoaded)
+		{
+			onLoaded(handle);
+		}
+		return handle;
+	}
+
+	//the same faces are already on their way
+	auto pending = pendingLoads.find(pendingKey);
+	if (pending != pendingLoads.end())
+	{
+		textures[pending->second->texture].refCount++;
+		if (onLoaded)
+		{
+			pending->second->callbacks.push_back(onLoaded);
+		}
+		return MakeHandle(pending->second->texture);
+	}
+
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	MemoryTracker::TrackGpu(GpuResource::Texture, textureID, 0, MemoryTag::Assets);
+	TextureHandle handle = AddTexture(textureID, GL_TEXTURE_CUBE_MAP, pendingKey);
+	textures[handle.index].ready = false;
+
+	std::shared_ptr<CubemapLoad> load = std::make_shared<CubemapLoad>();
+	load->texture = handle.index;
+	load->pendingKey = pendingKey;
+	load->adopted = false;
+	load->nextFace = 0;
+	if (onLoaded)
+	{
+		load->callbacks.push_back(onLoaded);
+	}
+
+	//decode the missing faces side by side, joining the decodes other cubemaps already started
+	AssetLoader* loader = AssetLoader::GetInstance();
+	for (size_t i = 0; i < 6; i++)
+	{
+		load->faceImages[i] = faceImages[i];
+		if (faceImages[i] < 0 && i < faces.size())
+		{
+			std::string path = faces[i];
+			auto inFlight = faceDecodes.find(path);
+			if (inFlight == faceDecodes.end())
+			{
+				inFlight = faceDecodes.emplace(path, loader->Run<Image>([path]() { return DecodeFile(path); }).share()).first;
+			}
+			load->decodes[i] = inFlight->second;
+		}
+	}
+	pendingLoads[pendingKey] = load;
+
+	loader->RunOnMainThread([this, load]() { return ContinueCubemapLoad(load); });
+	return handle;
+}
+
+bool TextureManager::ContinueCubemapLoad(const std::shared_ptr<CubemapLoad>& load)
+{
+	if (!load->adopted)
+	{
+		for (size_t i = 0; i < 6; i++)
+		{
+			if (load->decodes[i].valid() && !AssetLoader::IsReady(load->decodes[i]))
+			{
+				return false;
+			}
+		}
+		for (size_t i = 0; i < 6; i++)
+		{
+			if (load->decodes[i].valid())
+			{
+				load->faceImages[i] = AdoptFace(load->decodes[i]);
+				load->decodes[i] = std::shared_future<Image>();
+			}
+		}
+		load->adopted = true;
+	}
+
+	//at least one face per frame, more if the frame still has loading time
+	Texture& texture = textures[load->texture];
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture.id);
+	do
+	{
+		unsigned int i = load->nextFace++;
+		if (load->faceImages[i] >= 0 && DecodeImage(images[load->faceImages[i]]))
+		{
+			UploadFace(texture.id, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, images[load->faceImages[i]]);
+		}
+	} while (load->nextFace < 6 && AssetLoader::GetInstance()->HasTimeLeft());
+
+	if (load->nextFace < 6)
+	{
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+		return false;
+	}
+
+	SetCubemapParameters(load->faceImages);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	//now the contents are known, later loads of the same images can share it
+	std::string key = CubemapKey(load->faceImages);
+	texturesByKey.erase(load->pendingKey);
+	if (texturesByKey.find(key) == texturesByKey.end())
+	{
+		texturesByKey[key] = load->texture;
+		texture.key = key;
+	}
+	else
+	{
+		texture.key.clear();
+	}
+	texture.ready = true;
+	pendingLoads.erase(load->pendingKey);
+
+	TextureHandle handle = MakeHandle(load->texture);
+	for (size_t i = 0; i < load->callbacks.size(); i++)
+	{
+		load->callbacks[i](handle);
+	}
+	return true;
+}
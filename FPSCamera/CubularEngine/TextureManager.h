@@ -0,0 +1,217 @@
+#pragma once
+#include "stdafx.h"
+#include "Ktx.h"
+#include "AssetPack.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <future>
+#include <memory>
+
+/// <summary>
+/// Lightweight reference to a texture owned by the TextureManager. The generation
+/// catches handles that outlive the texture they pointed at.
+/// </summary>
+struct TextureHandle
+{
+	unsigned int index;
+	unsigned int generation;
+
+	TextureHandle()
+	{
+		index = ~0u;
+		generation = 0;
+	}
+
+	bool IsValid() const { return index != ~0u; }
+};
+
+/// <summary>
+/// Singleton that loads every image once and shares the GL textures built from them.
+/// Images are cached by path and by a hash of their file contents, so the same picture
+/// under two paths is only decoded once. If the TextureBaker has left an up to date .ktx
+/// next to an image, the compressed blocks and mips from that are used instead. Textures are reference counted and only
+/// deleted on an explicit EvictUnused().
+/// </summary>
+class TextureManager
+{
+private:
+	/// <summary>
+	/// Singleton implementation (private constructor & destructor)
+	/// </summary>
+	TextureManager();
+	~TextureManager();
+
+	static TextureManager* instance;
+
+	//one decoded source image
+	struct Image
+	{
+		unsigned long long hash;
+		int width;
+		int height;
+		int channels;
+		unsigned char* pixels;   //nullptr once trimmed, decoded again on demand
+		std::shared_ptr<KtxImage> compressed;   //baked blocks instead of pixels, if there was a .ktx
+		std::string path;        //where it was first loaded from
+
+		bool HasData() const { return pixels != nullptr || compressed; }
+	};
+
+	//one GL texture
+	struct Texture
+	{
+		GLuint id;
+		GLenum target;
+		std::string key;
+		int refCount;
+		unsigned int generation;
+		bool alive;
+		bool ready;              //false while an async load is still filling it in
+	};
+
+	//an async cubemap load that hasn't finished uploading yet
+	struct CubemapLoad
+	{
+		unsigned int texture;
+		std::string pendingKey;
+		std::shared_future<Image> decodes[6];
+		int faceImages[6];
+		bool adopted;
+		unsigned int nextFace;
+		std::vector<std::function<void(TextureHandle)>> callbacks;
+	};
+
+	std::vector<Image> images;
+	std::unordered_map<std::string, size_t> imagesByPath;
+	std::unordered_map<unsigned long long, size_t> imagesByHash;
+
+	std::vector<Texture> textures;
+	std::unordered_map<std::string, unsigned int> texturesByKey;
+	std::vector<unsigned int> freeTextures;
+
+	std::unordered_map<std::string, std::shared_ptr<CubemapLoad>> pendingLoads;
+
+	//face decodes still on a worker, by path, so cubemaps sharing a face wait on the same one
+	std::unordered_map<std::string, std::shared_future<Image>> faceDecodes;
+
+	//pixel unpack buffer the async uploads go through
+	GLuint uploadPBO;
+
+	/// <summary>
+	/// Finds or decodes an image, returns its index or -1 if it couldn't be loaded
+	/// </summary>
+	int FindOrLoadImage(const std::string& path);
+
+	/// <summary>
+	/// Makes sure the pixels of a cached image are in memory
+	/// </summary>
+	bool DecodeImage(Image& image);
+
+	TextureHandle AddTexture(GLuint id, GLenum target, const std::string& key);
+
+	/// <summary>
+	/// Reads, hashes and decodes an image file. Touches no shared state, so workers can call it.
+	/// </summary>
+	static Image DecodeFile(const std::string& path);
+
+	/// <summary>
+	/// Puts an image decoded by a worker into the cache, or frees it if the cache already
+	/// has the same contents. Returns its index or -1 if the decode failed.
+	/// </summary>
+	int AdoptImage(Image& decoded);
+
+	/// <summary>
+	/// AdoptImage for a face decode other cubemaps may share: the first load to get here adopts
+	/// it, the others find the image it went into. Returns its index or -1 if the decode failed.
+	/// </summary>
+	int AdoptFace(const std::shared_future<Image>& decode);
+
+	/// <summary>
+	/// Decodes a PNG (etc.) into pixels, or a baked KTX into its compressed blocks
+	/// </summary>
+	static bool DecodeBytes(AssetView bytes, Image& image);
+
+	/// <summary>
+	/// Uploads one face of the bound cubemap (texture) through the pixel buffer
+	/// </summary>
+	void UploadFace(GLuint texture, GLenum face, const Image& image);
+
+	/// <summary>
+	/// Filtering, wrapping and mip range of the bound cubemap
+	/// </summary>
+	void SetCubemapParameters(const int faceImages[6]);
+
+	/// <summary>
+	/// The GL thread side of an async cubemap load, returns true when it's done
+	/// </summary>
+	bool ContinueCubemapLoad(const std::shared_ptr<CubemapLoad>& load);
+
+	//the content key of a cubemap, from the images of its faces
+	std::string CubemapKey(const int faceImages[6]) const;
+
+	TextureHandle MakeHandle(unsigned int index) const;
+
+	//true for textures that exist, even if they're still loading
+	bool IsLive(TextureHandle handle) const;
+
+public:
+	/// <summary>
+	/// Singleton reference to the instance
+	/// </summary>
+	static TextureManager* GetInstance();
+
+	/// <summary>
+	/// De-allocation, deletes every texture still around
+	/// </summary>
+	static void Release();
+
+	/// <summary>
+	/// Gets a cubemap built from 6 face images (+x, -x, +y, -y, +z, -z).
+	/// If a cubemap with the same images exists it is shared and its count goes up.
+	/// </summary>
+	/// <param name="faces">Paths of the 6 face images</param>
+	TextureHandle LoadCubemap(const std::vector<std::string>& faces);
+
+	/// <summary>
+	/// Same as LoadCubemap, but the faces are decoded in parallel on the AssetLoader's
+	/// workers and uploaded over the next frames. The handle is valid straight away,
+	/// GetTexture just returns 0 until the upload is finished.
+	/// </summary>
+	/// <param name="faces">Paths of the 6 face images</param>
+	/// <param name="onLoaded">Called on the GL thread once the texture can be used</param>
+	TextureHandle LoadCubemapAsync(const std::vector<std::string>& faces, std::function<void(TextureHandle)> onLoaded = nullptr);
+
+	/// <summary>
+	/// Whether a texture is fully uploaded
+	/// </summary>
+	bool IsLoaded(TextureHandle handle) const;
+
+	/// <summary>
+	/// The GL name of a texture, or 0 if the handle is stale
+	/// </summary>
+	GLuint GetTexture(TextureHandle handle) const;
+
+	/// <summary>
+	/// Adds a reference to a texture
+	/// </summary>
+	void AddRef(TextureHandle handle);
+
+	/// <summary>
+	/// Drops a reference. The texture stays resident until EvictUnused().
+	/// </summary>
+	void ReleaseTexture(TextureHandle handle);
+
+	/// <summary>
+	/// Deletes every texture nobody references anymore (textures still loading are kept)
+	/// </summary>
+	/// <returns>How many textures were deleted</returns>
+	size_t EvictUnused();
+
+	/// <summary>
+	/// Frees the decoded pixels of every cached image (textures stay on the GPU).
+	/// Call once the textures you need are built.
+	/// </summary>
+	void TrimImageCache();
+};
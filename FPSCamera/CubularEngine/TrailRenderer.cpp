@@ -0,0 +1,167 @@
+#include "TrailRenderer.h"
+#include "MemoryTracker.h"
+
+TrailRenderer::TrailRenderer(StreamingBuffer* stream, size_t trailLength)
+{
+	this->stream = stream;
+	this->trailLength = trailLength;
+	updateCount = 0;
+	color = glm::vec3(0.8f, 0.9f, 1.0f);
+
+	shader = new DynamicShader("assets/shaders/trailVertex.glsl", "assets/shaders/trailFragment.glsl");
+
+	//xyz = position, w = age along the trail (0 oldest, 1 newest)
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+	MemoryTracker::TrackGpu(GpuResource::VertexArray, VAO, 0, MemoryTag::Render);
+	glBindBuffer(GL_ARRAY_BUFFER, stream->GetBuffer());
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+TrailRenderer::~TrailRenderer()
+{
+	MemoryTracker::UntrackGpu(GpuResource::VertexArray, VAO);
+	MemoryTracker::UntrackGpu(GpuResource::Program, shader->ID);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteProgram(shader->ID);
+	delete shader;
+}
+
+void TrailRenderer::Record(size_t body, glm::vec3 position)
+{
+	if (body >= heads.size())
+	{
+		heads.resize(body + 1, 0);
+		counts.resize(body + 1, 0);
+		points.resize((body + 1) * trailLength);
+	}
+
+	points[body * trailLength + heads[body]] = position;
+	heads[body] = (heads[body] + 1) % trailLength;
+	if (counts[body] < trailLength)
+	{
+		counts[body]++;
+	}
+}
+
+void TrailRenderer::BeginUpdate()
+{
+	updateCount++;
+}
+
+void TrailRenderer::Record(size_t body, unsigned long long owner, glm::vec3 position)
+{
+	if (body >= owners.size())
+	{
+		owners.resize(body + 1, 0);
+		updated.resize(body + 1, 0);
+	}
+	if (owners[body] != owner)
+	{
+		owners[body] = owner;
+		Clear(body);
+	}
+	updated[body] = updateCount;
+	Record(body, position);
+}
+
+void TrailRenderer::EndUpdate()
+{
+	for (size_t i = 0; i < counts.size(); i++)
+	{
+		if (counts[i] > 0 && (i >= updated.size() || updated[i] != updateCount))
+		{
+			Clear(i);
+		}
+	}
+}
+
+void TrailRenderer::Clear(size_t body)
+{
+	if (body < counts.size())
+	{
+		counts[body] = 0;
+		heads[body] = 0;
+	}
+}
+
+void TrailRenderer::ClearAll()
+{
+	for (size_t i = 0; i < counts.size(); i++)
+	{
+		Clear(i);
+	}
+}
+
+void TrailRenderer::Render(Camera* camera)
+{
+	size_t totalPoints = 0;
+	for (size_t i = 0; i < counts.size(); i++)
+	{
+		if (counts[i] > 1)
+		{
+			totalPoints += counts[i];
+		}
+	}
+	if (totalPoints == 0)
+	{
+		return;
+	}
+
+	const size_t vertexSize = 4 * sizeof(GLfloat);
+	GLintptr offset;
+	GLfloat* out = (GLfloat*)stream->Allocate(totalPoints * vertexSize, vertexSize, offset);
+	if (out == nullptr)
+	{
+		return;
+	}
+
+	//unroll each ring oldest to newest, straight into the mapped buffer
+	firsts.clear();
+	drawCounts.clear();
+	GLint first = (GLint)(offset / vertexSize);
+	for (size_t i = 0; i < counts.size(); i++)
+	{
+		size_t count = counts[i];
+		if (count < 2)
+		{
+			continue;
+		}
+
+		size_t start = (heads[i] + trailLength - count) % trailLength;
+		const glm::vec3* ring = &points[i * trailLength];
+		for (size_t p = 0; p < count; p++)
+		{
+			const glm::vec3& point = ring[(start + p) % trailLength];
+			*out++ = point.x;
+			*out++ = point.y;
+			*out++ = point.z;
+			*out++ = (float)p / (float)(count - 1);
+		}
+
+		firsts.push_back(first);
+		drawCounts.push_back((GLsizei)count);
+		first += (GLint)count;
+	}
+	stream->Flush();
+
+	shader->use();
+	shader->setMat4("view", camera->GetView());
+	shader->setMat4("projection", camera->GetProjection());
+	shader->setVec3("trailColor", color);
+
+	//trails fade out, so blend them over the scene without writing depth
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+
+	glBindVertexArray(VAO);
+	glMultiDrawArrays(GL_LINE_STRIP, &firsts[0], &drawCounts[0], (GLsizei)firsts.size());
+	glBindVertexArray(0);
+
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+}
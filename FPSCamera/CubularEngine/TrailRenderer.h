@@ -0,0 +1,95 @@
+#pragma once
+#include "stdafx.h"
+#include "Camera.h"
+#include "DynamicShader.h"
+#include "StreamingBuffer.h"
+#include <vector>
+
+/// <summary>
+/// Keeps the last few positions of every body in a ring and draws them all as
+/// fading line strips with a single glMultiDrawArrays call. The points are streamed
+/// through a shared StreamingBuffer every frame.
+/// </summary>
+class TrailRenderer
+{
+private:
+	//how many points each trail keeps
+	size_t trailLength;
+
+	//ring of points per body, body i owns points [i * trailLength, (i + 1) * trailLength)
+	std::vector<glm::vec3> points;
+	std::vector<size_t> heads;     //where the next point goes
+	std::vector<size_t> counts;    //how many points are valid
+	//who each trail belongs to, and the last update that recorded it (see BeginUpdate)
+	std::vector<unsigned long long> owners;
+	std::vector<unsigned int> updated;
+	unsigned int updateCount;
+
+	//scratch for the multi draw, kept around so they don't reallocate
+	std::vector<GLint> firsts;
+	std::vector<GLsizei> drawCounts;
+
+	StreamingBuffer* stream;
+	DynamicShader* shader;
+	GLuint VAO;
+
+public:
+	/// <summary>
+	/// Creates the trail shader and VAO
+	/// </summary>
+	/// <param name="stream">Where the trail points get written every frame</param>
+	/// <param name="trailLength">How many points each trail keeps</param>
+	TrailRenderer(StreamingBuffer* stream, size_t trailLength);
+
+	/// <summary>
+	/// Destruction
+	/// </summary>
+	~TrailRenderer();
+
+	/// <summary>
+	/// The color of the trails
+	/// </summary>
+	glm::vec3 color;
+
+	/// <summary>
+	/// Adds the newest position of a body to its trail
+	/// </summary>
+	/// <param name="body">Index of the body</param>
+	/// <param name="position">Where it is now</param>
+	void Record(size_t body, glm::vec3 position);
+
+	/// <summary>
+	/// Starts recording a whole set of bodies, e.g. a simulation snapshot. Between BeginUpdate()
+	/// and EndUpdate() record every body that's still there with its owner.
+	/// </summary>
+	void BeginUpdate();
+
+	/// <summary>
+	/// Adds the newest position of a body to its trail, starting the trail over if the body's
+	/// index now belongs to someone else (it was retired and the index reused)
+	/// </summary>
+	/// <param name="body">Index of the body</param>
+	/// <param name="owner">Anything that tells apart the bodies that have had this index, e.g. an entity handle</param>
+	/// <param name="position">Where it is now</param>
+	void Record(size_t body, unsigned long long owner, glm::vec3 position);
+
+	/// <summary>
+	/// Clears the trails of the bodies that weren't recorded since BeginUpdate(), they're gone
+	/// </summary>
+	void EndUpdate();
+
+	/// <summary>
+	/// Forgets a body's trail (e.g. when it got merged or reset)
+	/// </summary>
+	void Clear(size_t body);
+
+	/// <summary>
+	/// Forgets every trail
+	/// </summary>
+	void ClearAll();
+
+	/// <summary>
+	/// Streams every trail and draws them
+	/// </summary>
+	void Render(Camera* camera);
+};
@@ -0,0 +1,261 @@
+#include "TransformSystem.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define TRANSFORM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	//values[to[i]] = old values[from[i]]
+	template<typename T>
+	void MoveValues(std::vector<T>& values, const TransformId* from, const TransformId* to, size_t count, std::vector<T>& scratch)
+	{
+		scratch.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			scratch[i] = values[from[i]];
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			values[to[i]] = scratch[i];
+		}
+	}
+}
+
+//for singleton
+TransformSystem* TransformSystem::instance = nullptr;
+
+TransformSystem::TransformSystem()
+{
+}
+
+TransformSystem::~TransformSystem()
+{
+}
+
+TransformSystem* TransformSystem::GetInstance()
+{
+	if (instance == nullptr)
+	{
+		instance = new TransformSystem();
+	}
+	return instance;
+}
+
+void TransformSystem::Release()
+{
+	delete instance;
+	instance = nullptr;
+}
+
+TransformId TransformSystem::Create(glm::vec3 position, glm::quat rotation, glm::vec3 scale)
+{
+	TransformId id;
+	if (!freeList.empty())
+	{
+		id = freeList.back();
+		freeList.pop_back();
+	}
+	else
+	{
+		id = (TransformId)posX.size();
+		posX.push_back(0.f); posY.push_back(0.f); posZ.push_back(0.f);
+		rotX.push_back(0.f); rotY.push_back(0.f); rotZ.push_back(0.f); rotW.push_back(1.f);
+		scaleX.push_back(1.f); scaleY.push_back(1.f); scaleZ.push_back(1.f);
+		worldMatrices.push_back(glm::mat4(1.0f));
+		dirty.push_back(false);
+	}
+
+	posX[id] = position.x; posY[id] = position.y; posZ[id] = position.z;
+	rotX[id] = rotation.x; rotY[id] = rotation.y; rotZ[id] = rotation.z; rotW[id] = rotation.w;
+	scaleX[id] = scale.x; scaleY[id] = scale.y; scaleZ[id] = scale.z;
+	MarkDirty(id);
+	return id;
+}
+
+void TransformSystem::Reserve(size_t count)
+{
+	size_t capacity = posX.size() + (count > freeList.size() ? count - freeList.size() : 0);
+	posX.reserve(capacity); posY.reserve(capacity); posZ.reserve(capacity);
+	rotX.reserve(capacity); rotY.reserve(capacity); rotZ.reserve(capacity); rotW.reserve(capacity);
+	scaleX.reserve(capacity); scaleY.reserve(capacity); scaleZ.reserve(capacity);
+	worldMatrices.reserve(capacity);
+	dirty.reserve(capacity);
+	dirtyList.reserve(dirtyList.size() + count);
+}
+
+void TransformSystem::Destroy(TransformId id)
+{
+	//UpdateMatrices skips anything that isn't flagged, so no need to search the dirty list
+	dirty[id] = false;
+	freeList.push_back(id);
+}
+
+void TransformSystem::MarkDirty(TransformId id)
+{
+	if (!dirty[id])
+	{
+		dirty[id] = true;
+		dirtyList.push_back(id);
+	}
+}
+
+void TransformSystem::SetPosition(TransformId id, glm::vec3 position)
+{
+	if (posX[id] != position.x || posY[id] != position.y || posZ[id] != position.z)
+	{
+		posX[id] = position.x; posY[id] = position.y; posZ[id] = position.z;
+		MarkDirty(id);
+	}
+}
+
+void TransformSystem::SetRotation(TransformId id, glm::quat rotation)
+{
+	if (rotX[id] != rotation.x || rotY[id] != rotation.y || rotZ[id] != rotation.z || rotW[id] != rotation.w)
+	{
+		rotX[id] = rotation.x; rotY[id] = rotation.y; rotZ[id] = rotation.z; rotW[id] = rotation.w;
+		MarkDirty(id);
+	}
+}
+
+void TransformSystem::SetScale(TransformId id, glm::vec3 scale)
+{
+	if (scaleX[id] != scale.x || scaleY[id] != scale.y || scaleZ[id] != scale.z)
+	{
+		scaleX[id] = scale.x; scaleY[id] = scale.y; scaleZ[id] = scale.z;
+		MarkDirty(id);
+	}
+}
+
+float TransformSystem::GetMaxScale(TransformId id) const
+{
+	return glm::max(scaleX[id], glm::max(scaleY[id], scaleZ[id]));
+}
+
+void TransformSystem::UpdateMatrices()
+{
+	TransformId batch[4];
+	size_t batchCount = 0;
+
+	for (size_t i = 0; i < dirtyList.size(); i++)
+	{
+		TransformId id = dirtyList[i];
+
+		//destroyed (or already handled) since it was listed
+		if (!dirty[id])
+		{
+			continue;
+		}
+		dirty[id] = false;
+
+		batch[batchCount++] = id;
+		if (batchCount == 4)
+		{
+			ComposeBatch(batch, 4);
+			batchCount = 0;
+		}
+	}
+	if (batchCount > 0)
+	{
+		ComposeBatch(batch, batchCount);
+	}
+
+	dirtyList.clear();
+}
+
+void TransformSystem::Permute(const TransformId* from, const TransformId* to, size_t count)
+{
+	//with nothing dirty the flags don't have to move along
+	UpdateMatrices();
+
+	std::vector<float> scratch;
+	MoveValues(posX, from, to, count, scratch);
+	MoveValues(posY, from, to, count, scratch);
+	MoveValues(posZ, from, to, count, scratch);
+	MoveValues(rotX, from, to, count, scratch);
+	MoveValues(rotY, from, to, count, scratch);
+	MoveValues(rotZ, from, to, count, scratch);
+	MoveValues(rotW, from, to, count, scratch);
+	MoveValues(scaleX, from, to, count, scratch);
+	MoveValues(scaleY, from, to, count, scratch);
+	MoveValues(scaleZ, from, to, count, scratch);
+
+	std::vector<glm::mat4> matrixScratch;
+	MoveValues(worldMatrices, from, to, count, matrixScratch);
+}
+
+void TransformSystem::ComposeBatch(const TransformId* ids, size_t count)
+{
+	//gather the 4 transforms into SIMD lanes, unused lanes repeat the first one
+	float px[4], py[4], pz[4], qx[4], qy[4], qz[4], qw[4], sx[4], sy[4], sz[4];
+	for (size_t lane = 0; lane < 4; lane++)
+	{
+		TransformId id = ids[lane < count ? lane : 0];
+		px[lane] = posX[id]; py[lane] = posY[id]; pz[lane] = posZ[id];
+		qx[lane] = rotX[id]; qy[lane] = rotY[id]; qz[lane] = rotZ[id]; qw[lane] = rotW[id];
+		sx[lane] = scaleX[id]; sy[lane] = scaleY[id]; sz[lane] = scaleZ[id];
+	}
+
+#ifdef TRANSFORM_USE_SSE
+	__m128 x = _mm_loadu_ps(qx), y = _mm_loadu_ps(qy), z = _mm_loadu_ps(qz), w = _mm_loadu_ps(qw);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 zero = _mm_setzero_ps();
+
+	//same terms as glm::mat4_cast, all doubled up front
+	__m128 x2 = _mm_mul_ps(x, two), y2 = _mm_mul_ps(y, two), z2 = _mm_mul_ps(z, two);
+	__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+	__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+	__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+	__m128 scale0 = _mm_loadu_ps(sx), scale1 = _mm_loadu_ps(sy), scale2 = _mm_loadu_ps(sz);
+
+	//rotation columns, each scaled by that axis' scale (T * R * S)
+	__m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), scale0);
+	__m128 c0y = _mm_mul_ps(_mm_add_ps(xy, wz), scale0);
+	__m128 c0z = _mm_mul_ps(_mm_sub_ps(xz, wy), scale0);
+
+	__m128 c1x = _mm_mul_ps(_mm_sub_ps(xy, wz), scale1);
+	__m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), scale1);
+	__m128 c1z = _mm_mul_ps(_mm_add_ps(yz, wx), scale1);
+
+	__m128 c2x = _mm_mul_ps(_mm_add_ps(xz, wy), scale2);
+	__m128 c2y = _mm_mul_ps(_mm_sub_ps(yz, wx), scale2);
+	__m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), scale2);
+
+	__m128 c3x = _mm_loadu_ps(px), c3y = _mm_loadu_ps(py), c3z = _mm_loadu_ps(pz);
+
+	//turn the lanes around so each register holds one column of one matrix
+	__m128 c0w = zero, c1w = zero, c2w = zero, c3w = one;
+	_MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+	_MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+	_MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+	_MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+
+	__m128 columns[4][4] = {
+		{ c0x, c1x, c2x, c3x },
+		{ c0y, c1y, c2y, c3y },
+		{ c0z, c1z, c2z, c3z },
+		{ c0w, c1w, c2w, c3w }
+	};
+	for (size_t lane = 0; lane < count; lane++)
+	{
+		float* m = &worldMatrices[ids[lane]][0][0];
+		_mm_storeu_ps(m + 0, columns[lane][0]);
+		_mm_storeu_ps(m + 4, columns[lane][1]);
+		_mm_storeu_ps(m + 8, columns[lane][2]);
+		_mm_storeu_ps(m + 12, columns[lane][3]);
+	}
+#else
+	for (size_t lane = 0; lane < count; lane++)
+	{
+		glm::mat4 rotation = glm::mat4_cast(glm::quat(qw[lane], qx[lane], qy[lane], qz[lane]));
+		glm::mat4& m = worldMatrices[ids[lane]];
+		m[0] = rotation[0] * sx[lane];
+		m[1] = rotation[1] * sy[lane];
+		m[2] = rotation[2] * sz[lane];
+		m[3] = glm::vec4(px[lane], py[lane], pz[lane], 1.0f);
+	}
+#endif
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "stdafx.h"
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+typedef unsigned int TransformId;
+
+/// <summary>
+/// Singleton that owns every entity's position, rotation and scale in structure-of-arrays
+/// form. Setters mark a transform dirty, and UpdateMatrices() rebuilds the world matrices of
+/// only the dirty transforms, four at a time with SSE.
+/// </summary>
+class TransformSystem
+{
+private:
+	/// <summary>
+	/// Singleton implementation (private constructor & destructor)
+	/// </summary>
+	TransformSystem();
+	~TransformSystem();
+
+	static TransformSystem* instance;
+
+	//SoA storage, one entry per transform id
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> rotX, rotY, rotZ, rotW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<glm::mat4> worldMatrices;
+
+	//dirty transforms are listed once each, in the order they were touched
+	std::vector<bool> dirty;
+	std::vector<TransformId> dirtyList;
+
+	//ids of destroyed transforms, handed out again by Create
+	std::vector<TransformId> freeList;
+
+	void MarkDirty(TransformId id);
+
+	/// <summary>
+	/// Builds T * R * S for 4 transforms at once, count can be less than 4 for the tail
+	/// </summary>
+	void ComposeBatch(const TransformId* ids, size_t count);
+
+public:
+	/// <summary>
+	/// Singleton reference to the instance
+	/// </summary>
+	static TransformSystem* GetInstance();
+
+	/// <summary>
+	/// De-allocation
+	/// </summary>
+	static void Release();
+
+	/// <summary>
+	/// Allocates a transform, its matrix gets built on the next UpdateMatrices()
+	/// </summary>
+	TransformId Create(glm::vec3 position, glm::quat rotation, glm::vec3 scale);
+
+	/// <summary>
+	/// Makes room for this many more transforms, so creating a big batch doesn't keep regrowing the arrays
+	/// </summary>
+	void Reserve(size_t count);
+
+	/// <summary>
+	/// Gives the transform's slot back to be reused
+	/// </summary>
+	void Destroy(TransformId id);
+
+	void SetPosition(TransformId id, glm::vec3 position);
+	glm::vec3 GetPosition(TransformId id) const { return glm::vec3(posX[id], posY[id], posZ[id]); }
+
+	void SetRotation(TransformId id, glm::quat rotation);
+	glm::quat GetRotation(TransformId id) const { return glm::quat(rotW[id], rotX[id], rotY[id], rotZ[id]); }
+
+	void SetScale(TransformId id, glm::vec3 scale);
+	glm::vec3 GetScale(TransformId id) const { return glm::vec3(scaleX[id], scaleY[id], scaleZ[id]); }
+
+	/// <summary>
+	/// The largest scale axis, for things that only need a bounding radius (impostors, LOD)
+	/// </summary>
+	float GetMaxScale(TransformId id) const;
+
+	/// <summary>
+	/// The cached world matrix, valid after UpdateMatrices() if the transform changed
+	/// </summary>
+	const glm::mat4& GetWorldMatrix(TransformId id) const { return worldMatrices[id]; }
+
+	bool IsDirty(TransformId id) const { return dirty[id]; }
+
+	/// <summary>
+	/// Rebuilds the world matrices of every transform that changed since the last call
+	/// </summary>
+	void UpdateMatrices();
+
+	/// <summary>
+	/// Moves transforms to other ids: what was at from[i] ends up at to[i]. from & to have to hold
+	/// the same ids, the caller updates whoever refers to them. Pending matrices get rebuilt first.
+	/// </summary>
+	void Permute(const TransformId* from, const TransformId* to, size_t count);
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include "stdafx.h"
+#include <atomic>
+
+/// <summary>
+/// Hands the latest version of some state from one writer thread to one reader thread without
+/// locks or waiting. There are three copies: the writer fills its back copy and swaps it with
+/// the middle one, the reader swaps the middle one with its front copy when there's something
+/// new. Neither side ever touches the copy the other one holds, and versions the reader was
+/// too slow for are simply skipped. Copies are reused, so a T that keeps its capacity (vectors
+/// that get clear()ed) never allocates once it's warmed up.
+/// </summary>
+template<typename T>
+class TripleBuffer
+{
+private:
+	//the middle copy's index, with NewBit set when the writer put something there the reader hasn't taken
+	static const int NewBit = 4;
+
+	T buffers[3];
+	std::atomic<int> middle;
+	int back;       //writer's
+	int front;      //reader's
+
+public:
+	TripleBuffer()
+		: middle(1)
+	{
+		back = 0;
+		front = 2;
+	}
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	/// <summary>
+	/// Writer: the copy to fill in. It's whatever the writer published two versions ago (or the reader gave back).
+	/// </summary>
+	T& GetBack() { return buffers[back]; }
+
+	/// <summary>
+	/// Writer: makes the back copy the latest version
+	/// </summary>
+	void Publish()
+	{
+		back = middle.exchange(back | NewBit, std::memory_order_acq_rel) & ~NewBit;
+	}
+
+	/// <summary>
+	/// Reader: takes the latest version if there's one it hasn't seen, true if it did
+	/// </summary>
+	bool Acquire()
+	{
+		if ((middle.load(std::memory_order_relaxed) & NewBit) == 0)
+		{
+			return false;
+		}
+		front = middle.exchange(front, std::memory_order_acq_rel) & ~NewBit;
+		return true;
+	}
+
+	/// <summary>
+	/// Reader: the version it took last, stays put until the next Acquire()
+	/// </summary>
+	const T& GetFront() const { return buffers[front]; }
+};
@@ -0,0 +1,217 @@
+#include "VertexLayout.h"
+#include "AssetLoader.h"
+#include <glm/gtc/packing.hpp>
+#include <cstring>
+
+//how many bytes each format takes
+static GLuint FormatSize(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Float3:
+		return 3 * sizeof(GLfloat);
+	case VertexFormat::Half4:
+		return 4 * sizeof(GLushort);
+	case VertexFormat::Int2_10_10_10_Rev:
+	case VertexFormat::UNorm8x4:
+		return sizeof(GLuint);
+	}
+	return 0;
+}
+
+VertexLayout::VertexLayout()
+{
+}
+
+VertexLayout& VertexLayout::Add(const char* name, VertexSemantic semantic, VertexFormat format, GLuint stream)
+{
+	if (stream >= strides.size())
+	{
+		strides.resize(stream + 1, 0);
+	}
+
+	VertexAttribute attribute;
+	attribute.name = name;
+	attribute.semantic = semantic;
+	attribute.format = format;
+	attribute.stream = stream;
+	attribute.offset = strides[stream];
+	attributes.push_back(attribute);
+
+	//keep every attribute 4 byte aligned, which all of our formats already are
+	strides[stream] += FormatSize(format);
+	return *this;
+}
+
+void VertexLayout::Encode(const GLfloat* source, size_t vertexCount, size_t floatsPerVertex,
+	std::vector<std::vector<unsigned char>>& outStreams) const
+{
+	outStreams.resize(strides.size());
+	for (size_t s = 0; s < strides.size(); s++)
+	{
+		outStreams[s].resize(strides[s] * vertexCount);
+	}
+
+	for (size_t a = 0; a < attributes.size(); a++)
+	{
+		const VertexAttribute& attribute = attributes[a];
+		int sourceOffset = GetSourceOffset(attribute.semantic, floatsPerVertex);
+		GLuint stride = strides[attribute.stream];
+		unsigned char* dest = &outStreams[attribute.stream][attribute.offset];
+
+		for (size_t v = 0; v < vertexCount; v++, dest += stride)
+		{
+			//missing data gets a sensible default (+z normal, white)
+			glm::vec4 value = attribute.semantic == VertexSemantic::Normal ? glm::vec4(0.f, 0.f, 1.f, 0.f) : glm::vec4(1.f);
+			if (sourceOffset >= 0)
+			{
+				const GLfloat* src = source + v * floatsPerVertex + sourceOffset;
+				value.x = src[0];
+				value.y = src[1];
+				value.z = src[2];
+				if (attribute.semantic == VertexSemantic::Color && floatsPerVertex >= (size_t)sourceOffset + 4)
+				{
+					value.w = src[3];
+				}
+			}
+
+			switch (attribute.format)
+			{
+			case VertexFormat::Float3:
+				memcpy(dest, &value[0], 3 * sizeof(GLfloat));
+				break;
+			case VertexFormat::Half4:
+			{
+				glm::uint64 packed = glm::packHalf4x16(glm::vec4(value.x, value.y, value.z, 1.0f));
+				memcpy(dest, &packed, sizeof(packed));
+				break;
+			}
+			case VertexFormat::Int2_10_10_10_Rev:
+			{
+				glm::uint32 packed = glm::packSnorm3x10_1x2(glm::vec4(value.x, value.y, value.z, 0.0f));
+				memcpy(dest, &packed, sizeof(packed));
+				break;
+			}
+			case VertexFormat::UNorm8x4:
+			{
+				glm::uint32 packed = glm::packUnorm4x8(value);
+				memcpy(dest, &packed, sizeof(packed));
+				break;
+			}
+			}
+		}
+	}
+}
+
+void VertexLayout::BindStream(GLuint stream, GLuint shaderProgram, size_t baseOffset) const
+{
+	for (size_t a = 0; a < attributes.size(); a++)
+	{
+		const VertexAttribute& attribute = attributes[a];
+		if (attribute.stream != stream)
+		{
+			continue;
+		}
+
+		//the shader may not use (or may have optimised out) this attribute
+		GLint location = glGetAttribLocation(shaderProgram, attribute.name);
+		if (location < 0)
+		{
+			continue;
+		}
+
+		GLint size = 4;
+		GLenum type = GL_FLOAT;
+		GLboolean normalized = GL_FALSE;
+		switch (attribute.format)
+		{
+		case VertexFormat::Float3:
+			size = 3;
+			type = GL_FLOAT;
+			break;
+		case VertexFormat::Half4:
+			type = GL_HALF_FLOAT;
+			break;
+		case VertexFormat::Int2_10_10_10_Rev:
+			type = GL_INT_2_10_10_10_REV;
+			normalized = GL_TRUE;
+			break;
+		case VertexFormat::UNorm8x4:
+			type = GL_UNSIGNED_BYTE;
+			normalized = GL_TRUE;
+			break;
+		}
+
+		glVertexAttribPointer(
+			location,                           //index of attribute
+			size,                               //count of components
+			type,                               //kind of data
+			normalized,                         //should data be normalized?
+			strides[stream],                    //stride - bytes to skip to reach the next vertex
+			(GLvoid*)(baseOffset + attribute.offset)); //offset - bytes to skip to reach the first value
+		glEnableVertexAttribArray(location);
+	}
+}
+
+GLuint VertexLayout::GetVertexSize() const
+{
+	GLuint size = 0;
+	for (size_t s = 0; s < strides.size(); s++)
+	{
+		size += strides[s];
+	}
+	return size;
+}
+
+unsigned long long VertexLayout::GetHash() const
+{
+	unsigned long long hash = AssetLoader::HashBytes((const char*)strides.data(), strides.size() * sizeof(GLuint));
+	for (size_t a = 0; a < attributes.size(); a++)
+	{
+		const VertexAttribute& attribute = attributes[a];
+		GLuint fields[4] = { (GLuint)attribute.semantic, (GLuint)attribute.format, attribute.stream, attribute.offset };
+		hash = AssetLoader::HashBytes((const char*)fields, sizeof(fields), hash);
+		hash = AssetLoader::HashBytes(attribute.name, strlen(attribute.name), hash);
+	}
+	return hash;
+}
+
+int VertexLayout::GetSourceOffset(VertexSemantic semantic, size_t floatsPerVertex)
+{
+	switch (semantic)
+	{
+	case VertexSemantic::Position:
+		return floatsPerVertex >= 3 ? 0 : -1;
+	case VertexSemantic::Normal:
+		return floatsPerVertex >= 6 ? 3 : -1;
+	case VertexSemantic::Color:
+		return floatsPerVertex >= 9 ? 6 : -1;
+	default:
+		return -1;
+	}
+}
+
+VertexLayout VertexLayout::Default()
+{
+	VertexLayout layout;
+	layout.Add("position", VertexSemantic::Position, VertexFormat::Float3)
+		.Add("aNormal", VertexSemantic::Normal, VertexFormat::Float3);
+	return layout;
+}
+
+VertexLayout VertexLayout::Compact()
+{
+	VertexLayout layout;
+	layout.Add("position", VertexSemantic::Position, VertexFormat::Half4)
+		.Add("aNormal", VertexSemantic::Normal, VertexFormat::Int2_10_10_10_Rev);
+	return layout;
+}
+
+VertexLayout VertexLayout::CompactSplit()
+{
+	VertexLayout layout;
+	layout.Add("position", VertexSemantic::Position, VertexFormat::Half4, 0)
+		.Add("aNormal", VertexSemantic::Normal, VertexFormat::Int2_10_10_10_Rev, 1)
+		.Add("aColor", VertexSemantic::Color, VertexFormat::UNorm8x4, 1);
+	return layout;
+}
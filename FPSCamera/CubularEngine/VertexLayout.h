@@ -0,0 +1,115 @@
+#pragma once
+#include "stdafx.h"
+#include <vector>
+
+/// <summary>
+/// What a vertex attribute means, so it can be pulled out of the source floats
+/// </summary>
+enum class VertexSemantic
+{
+	Position,
+	Normal,
+	Color,
+	Count
+};
+
+/// <summary>
+/// How a vertex attribute is stored on the GPU
+/// </summary>
+enum class VertexFormat
+{
+	Float3,             //3 x 32 bit float (12 bytes)
+	Half4,              //4 x 16 bit float, w padded to 1 (8 bytes)
+	Int2_10_10_10_Rev,  //signed normalized 10:10:10:2 (4 bytes), for unit vectors
+	UNorm8x4            //4 x normalized unsigned byte (4 bytes), for colors
+};
+
+/// <summary>
+/// One attribute in a layout
+/// </summary>
+struct VertexAttribute
+{
+	const char* name;           //name of the 'in' variable in the vertex shader
+	VertexSemantic semantic;
+	VertexFormat format;
+	GLuint stream;              //which vertex buffer this lives in
+	GLuint offset;              //byte offset inside one vertex of that stream
+};
+
+/// <summary>
+/// Describes how a mesh's vertices are laid out in one or more vertex buffers.
+/// Attributes sharing a stream are interleaved, different streams are separate buffers.
+/// </summary>
+class VertexLayout
+{
+private:
+	std::vector<VertexAttribute> attributes;
+	std::vector<GLuint> strides;
+
+public:
+	VertexLayout();
+
+	/// <summary>
+	/// Appends an attribute to the end of a stream
+	/// </summary>
+	/// <param name="name">Name of the attribute in the shader</param>
+	/// <param name="semantic">What the attribute holds</param>
+	/// <param name="format">How the attribute is encoded</param>
+	/// <param name="stream">Which buffer the attribute goes in</param>
+	VertexLayout& Add(const char* name, VertexSemantic semantic, VertexFormat format, GLuint stream = 0);
+
+	/// <summary>
+	/// Encodes float source vertices into one byte buffer per stream
+	/// </summary>
+	/// <param name="source">Interleaved source floats</param>
+	/// <param name="vertexCount">How many vertices are in source</param>
+	/// <param name="floatsPerVertex">How many floats make up one source vertex</param>
+	/// <param name="outStreams">Receives the encoded data, one entry per stream</param>
+	void Encode(const GLfloat* source, size_t vertexCount, size_t floatsPerVertex,
+		std::vector<std::vector<unsigned char>>& outStreams) const;
+
+	/// <summary>
+	/// Sets the attribute pointers for one stream. The stream's buffer must be bound
+	/// to GL_ARRAY_BUFFER and the VAO must be bound.
+	/// </summary>
+	/// <param name="stream">Which stream to bind</param>
+	/// <param name="shaderProgram">The program to look the attribute locations up in</param>
+	/// <param name="baseOffset">Where the stream starts in the bound buffer</param>
+	void BindStream(GLuint stream, GLuint shaderProgram, size_t baseOffset = 0) const;
+
+	/// <summary>
+	/// A hash of the attributes and strides, to tell if data encoded with another layout still fits
+	/// </summary>
+	unsigned long long GetHash() const;
+
+	GLuint GetStreamCount() const { return (GLuint)strides.size(); }
+	GLuint GetStride(GLuint stream) const { return strides[stream]; }
+	const std::vector<VertexAttribute>& GetAttributes() const { return attributes; }
+
+	/// <summary>
+	/// The byte size of one encoded vertex over all streams
+	/// </summary>
+	GLuint GetVertexSize() const;
+
+	/// <summary>
+	/// Where a semantic sits in the engine's float source vertices
+	/// (position 0-2, normal 3-5, color 6-9), or -1 if the source doesn't have it
+	/// </summary>
+	static int GetSourceOffset(VertexSemantic semantic, size_t floatsPerVertex);
+
+	/// <summary>
+	/// float3 position + float3 normal, interleaved (24 bytes)
+	/// </summary>
+	static VertexLayout Default();
+
+	/// <summary>
+	/// half position + 10:10:10:2 normal, interleaved (12 bytes)
+	/// </summary>
+	static VertexLayout Compact();
+
+	/// <summary>
+	/// half position in stream 0, 10:10:10:2 normal + uint8 color in stream 1.
+	/// Position-only passes (depth, shadows) only have to fetch stream 0.
+	/// </summary>
+	static VertexLayout CompactSplit();
+};
@@ -0,0 +1,35 @@
+/*
+Vertex shader for far away bodies, every instance is one camera facing quad
+*/
+#version 330 core
+
+//corner of the quad, from -1 to 1
+layout (location = 0) in vec2 corner;
+
+//per instance: xyz = world position, w = world radius
+layout (location = 1) in vec4 positionRadius;
+layout (location = 2) in vec4 instanceColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+//so tiny bodies still cover at least a couple of pixels
+uniform float pixelsPerUnit;
+uniform float minPixelRadius;
+
+out vec2 quadCoord;
+out vec4 bodyColor;
+
+void main()
+{
+    //move into view space first, so the quad always faces the camera
+    vec4 viewPos = view * vec4(positionRadius.xyz, 1.0);
+    float distance = max(-viewPos.z, 0.0001);
+    float radius = max(positionRadius.w, minPixelRadius * distance / pixelsPerUnit);
+
+    viewPos.xy += corner * radius;
+    gl_Position = projection * viewPos;
+
+    quadCoord = corner;
+    bodyColor = instanceColor;
+}
@@ -0,0 +1,29 @@
+/*
+This is the fragment shader for solid surfaces. It's compiled as variants by the
+ShaderVariantBuilder, and the defines pick what ends up in each one, so no variant
+branches on features it doesn't use:
+LIT      - phong lighting from the scene light, otherwise flat white (the sun)
+SPECULAR - adds the specular highlight (only with LIT)
+*/
+
+//specifies the version of the shader (and what features are enabled)
+#version 400 core
+
+out vec4 color;
+
+#ifdef LIT
+in vec3 Normal;
+in vec3 FragPos;
+
+#include "lighting.glsl"
+#endif
+
+//entry point for the fragment shader
+void main(void)
+{
+#ifdef LIT
+	color = vec4(Shade(normalize(Normal), FragPos), 1.0);
+#else
+	color = vec4(1, 1, 1, 1);
+#endif
+}
@@ -0,0 +1,18 @@
+/*
+Fragment shader for far away bodies, cuts the quad down to a disc
+*/
+#version 330 core
+
+in vec2 quadCoord;
+in vec4 bodyColor;
+
+out vec4 color;
+
+void main()
+{
+    if (dot(quadCoord, quadCoord) > 1.0)
+    {
+        discard;
+    }
+    color = bodyColor;
+}
@@ -0,0 +1,39 @@
+/*
+Phong lighting shared by every lit surface variant, pulled in with #include.
+Define SPECULAR before including it to get the highlight.
+*/
+
+struct Material{
+vec3 ambient;
+vec3 diffuse;
+vec3 specular;
+float shininess;
+};
+uniform Material material;
+uniform vec3 objectColor;
+uniform vec3 lightColor;
+uniform vec3 lightPos;
+uniform vec3 viewPos;
+
+//lights a surface point, norm has to be normalized already
+vec3 Shade(vec3 norm, vec3 fragPos)
+{
+	vec3 ambient = material.ambient * lightColor;
+
+	//diffuse
+	vec3 lightDir = normalize(lightPos - fragPos);
+	float diff = max(dot(norm, lightDir), 0.0);
+	vec3 diffuse = lightColor * (diff * material.diffuse);
+
+	vec3 result = ambient + diffuse;
+
+#ifdef SPECULAR
+	//specular
+	vec3 viewDir = normalize(viewPos - fragPos);
+	vec3 reflectDir = reflect(-lightDir, norm);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+	result += lightColor * (material.specular * spec);
+#endif
+
+	return result;
+}
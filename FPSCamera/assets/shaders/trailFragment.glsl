@@ -0,0 +1,15 @@
+/*
+Fragment shader for orbit trails, older points fade out
+*/
+#version 330 core
+
+in float age;
+
+uniform vec3 trailColor;
+
+out vec4 color;
+
+void main()
+{
+    color = vec4(trailColor, age * age);
+}
@@ -0,0 +1,18 @@
+/*
+Vertex shader for orbit trails
+*/
+#version 330 core
+
+//xyz = world position, w = how far along the trail this point is (0 oldest, 1 newest)
+layout (location = 0) in vec4 pointAge;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out float age;
+
+void main()
+{
+    age = pointAge.w;
+    gl_Position = projection * view * vec4(pointAge.xyz, 1.0);
+}